@@ -61,6 +61,7 @@ Python wrappers
 .. autosummary::
     hafnian
     hafnian_repeated
+    hafnian_auto
     hafnian_batched
     tor
     perm
@@ -88,11 +89,12 @@ from ._hafnian import (
     haf_rpt_complex,
     haf_rpt_real,
     hafnian,
+    hafnian_auto,
     hafnian_repeated,
     reduction,
 )
 from ._hermite_multidimensional import hafnian_batched, hermite_multidimensional
-from ._permanent import perm, perm_complex, perm_real, permanent_repeated
+from ._permanent import perm, perm_complex, perm_int, perm_real, permanent_repeated
 from ._torontonian import tor
 from ._version import __version__
 
@@ -100,6 +102,7 @@ from ._version import __version__
 __all__ = [
     "hafnian",
     "hafnian_repeated",
+    "hafnian_auto",
     "hafnian_batched",
     "tor",
     "perm",
@@ -16,7 +16,17 @@ Hafnian Python interface
 """
 import numpy as np
 
-from .lib.libhaf import haf_complex, haf_int, haf_real, haf_rpt_complex, haf_rpt_real
+from .lib.libhaf import (
+    haf_adaptive_complex,
+    haf_adaptive_real,
+    haf_auto_complex,
+    haf_auto_real,
+    haf_complex,
+    haf_int,
+    haf_real,
+    haf_rpt_complex,
+    haf_rpt_real,
+)
 
 
 def input_validation(A, tol=1e-12):
@@ -76,7 +86,16 @@ def reduction(A, rpt):
 
 
 def hafnian(
-    A, loop=False, recursive=True, tol=1e-12, quad=True, approx=False, num_samples=1000
+    A,
+    loop=False,
+    recursive=True,
+    tol=1e-12,
+    quad=True,
+    approx=False,
+    num_samples=1000,
+    adaptive=False,
+    rtol=1e-10,
+    return_precision=False,
 ):  # pylint: disable=too-many-arguments
     """Returns the hafnian of a matrix.
 
@@ -86,9 +105,8 @@ def hafnian(
     Args:
         A (array): a square, symmetric array of even dimensions.
         loop (bool): If ``True``, the loop hafnian is returned. Default is ``False``.
-        recursive (bool): If ``True``, the recursive algorithm is used. Note:
-            the recursive algorithm does not currently support the loop hafnian.
-            If ``loop=True``, then this keyword argument is ignored.
+        recursive (bool): If ``True``, the recursive algorithm is used. For the
+            loop hafnian, it carries the diagonal through the polynomial recursion.
         tol (float): the tolerance when checking that the matrix is
             symmetric. Default tolerance is 1e-12.
         quad (bool): If ``True``, the hafnian algorithm is performed with quadruple precision.
@@ -96,13 +114,33 @@ def hafnian(
             the approximation algorithm can only be applied to matrices ``A`` that only have non-negative entries.
         num_samples (int): If ``approx=True``, the approximation algorithm performs ``num_samples`` iterations
             for estimation of the hafnian of the non-negative matrix ``A``.
+        adaptive (bool): If ``True``, the hafnian is computed in double precision, and
+            recomputed in double-double precision only if its estimated relative error
+            exceeds ``rtol``. The ``recursive`` and ``quad`` keyword arguments are ignored.
+        rtol (float): If ``adaptive=True``, the largest acceptable estimated relative error
+            of the double precision result.
+        return_precision (bool): If ``adaptive=True`` and ``return_precision=True``, the
+            precision used (``"double"`` or ``"double-double"``) and the estimated relative
+            error of the double precision result are returned as well.
 
     Returns:
-        np.int64 or np.float64 or np.complex128: the hafnian of matrix A.
+        int or np.float64 or np.complex128 or tuple: the hafnian of matrix A. The hafnian
+        of an integer matrix is exact, and may exceed the range of ``np.int64``.
     """
     # pylint: disable=too-many-return-statements,too-many-branches
     input_validation(A, tol=tol)
 
+    if adaptive:
+        if loop:
+            raise ValueError("The adaptive precision hafnian does not support the loop hafnian.")
+
+        if np.any(np.iscomplex(A)):
+            result = haf_adaptive_complex(np.complex128(A), rtol=rtol)
+        else:
+            result = haf_adaptive_real(np.float64(np.real(A)), rtol=rtol)
+
+        return result if return_precision else result[0]
+
     matshape = A.shape
 
     if matshape == (0, 0):
@@ -241,3 +279,64 @@ def hafnian_repeated(A, rpt, mu=None, loop=False, tol=1e-12):
         return haf_rpt_complex(A, nud, mu=mu, loop=loop)
 
     return haf_rpt_real(A, nud, mu=mu, loop=loop)
+
+
+def hafnian_auto(
+    A, rpt=None, mu=None, loop=False, extended=False, return_decision=False, tol=1e-12
+):  # pylint: disable=too-many-arguments
+    r"""Returns the hafnian of matrix with repeated rows/columns, using the
+    algorithm with the smallest estimated time on this machine.
+
+    The C++ library estimates the time of the eigenvalue, recursive, repeated,
+    low rank and sparse algorithms from the size of the matrix, the repetitions,
+    the rank of the matrix and the width of a path decomposition of its graph,
+    using constants measured the first time it is called, and runs the fastest.
+    Integer matrices are computed using algorithms that only add and multiply
+    entries, whenever they apply.
+
+    Args:
+        A (array): a square, symmetric :math:`N\times N` array.
+        rpt (Sequence): a length-:math:`N` non-negative integer sequence, corresponding
+            to the number of times each row/column of matrix :math:`A` is repeated.
+            If not provided, each row/column appears once.
+        mu (array): a vector of length :math:`N` representing the vector of means/displacement.
+            If not provided, ``mu`` is set to the diagonal of matrix ``A``. Note that this
+            only affects the loop hafnian.
+        loop (bool): If ``True``, the loop hafnian is returned. Default is ``False``.
+        extended (bool): If ``True``, only algorithms evaluated in extended precision are used.
+        return_decision (bool): If ``True``, the name of the chosen algorithm and its
+            estimated time in seconds are returned as well.
+        tol (float): the tolerance when checking that the matrix is
+            symmetric. Default tolerance is 1e-12.
+
+    Returns:
+        np.float64 or np.complex128 or tuple: the hafnian of matrix A, followed by the
+        name of the algorithm and its estimated time if ``return_decision=True``.
+    """
+    input_validation(A, tol=tol)
+
+    if rpt is None:
+        rpt = [1] * len(A)
+
+    if len(rpt) != len(A):
+        raise ValueError("the rpt argument must be 1-dimensional sequence of length len(A).")
+
+    nud = np.array(rpt, dtype=np.int32)
+
+    if np.any(nud < 0):
+        raise ValueError("the rpt argument must contain non-negative integers.")
+
+    if mu is not None and len(mu) != len(A):
+        raise ValueError("Length of means vector must be the same length as the matrix A.")
+
+    if A.dtype == np.complex or (mu is not None and mu.dtype == np.complex):
+        mu = None if mu is None else np.complex128(mu)
+        result = haf_auto_complex(np.complex128(A), nud, mu=mu, loop=loop, extended=extended)
+    else:
+        mu = None if mu is None else np.float64(mu)
+        result = haf_auto_real(np.float64(A), nud, mu=mu, loop=loop, extended=extended)
+
+    if return_decision:
+        return result
+
+    return result[0]
@@ -17,15 +17,24 @@ Permanent Python interface
 import numpy as np
 
 from ._hafnian import hafnian_repeated
-from .lib.libhaf import perm_complex, perm_real
-
-
-def perm(A, quad=True, fsum=False):
+from .lib.libhaf import (
+    perm_adaptive_complex,
+    perm_adaptive_real,
+    perm_complex,
+    perm_int,
+    perm_real,
+)
+
+
+def perm(
+    A, quad=True, fsum=False, adaptive=False, rtol=1e-10, return_precision=False, glynn=False
+):  # pylint: disable=too-many-arguments
     """Returns the permanent of a matrix via the
-    `Ryser formula <https://en.wikipedia.org/wiki/Computing_the_permanent#Ryser_formula>`_.
+    `Ryser formula <https://en.wikipedia.org/wiki/Computing_the_permanent#Ryser_formula>`_,
+    or Glynn's formula if ``glynn=True``.
 
-    For more direct control, you may wish to call :func:`perm_real`
-    or :func:`perm_complex` directly.
+    For more direct control, you may wish to call :func:`perm_real`,
+    :func:`perm_complex` or :func:`perm_int` directly.
 
     Args:
         A (array): a square array.
@@ -34,10 +43,23 @@ def perm(A, quad=True, fsum=False):
         fsum (bool): Whether to use the ``fsum`` method for higher accuracy summation.
             Note that if ``fsum`` is true, double precision will be used, and the
             ``quad`` keyword argument will be ignored.
+        adaptive (bool): If ``True``, the permanent is computed in double precision, and
+            recomputed in double-double precision only if its estimated relative error
+            exceeds ``rtol``. The ``quad`` and ``fsum`` keyword arguments are ignored.
+        rtol (float): If ``adaptive=True``, the largest acceptable estimated relative error
+            of the double precision result.
+        return_precision (bool): If ``adaptive=True`` and ``return_precision=True``, the
+            precision used (``"double"`` or ``"double-double"``) and the estimated relative
+            error of the double precision result are returned as well.
+        glynn (bool): If ``True``, Glynn's formula is used, which has half as many terms
+            as Ryser's formula and cancels less in floating point. The ``fsum`` keyword
+            argument is then ignored.
 
     Returns:
-        np.float64 or np.complex128: the permanent of matrix A.
+        int or np.float64 or np.complex128 or tuple: the permanent of matrix A. The permanent
+        of an integer matrix is exact, and may exceed the range of ``np.int64``.
     """
+    # pylint: disable=too-many-return-statements
 
     if not isinstance(A, np.ndarray):
         raise TypeError("Input matrix must be a NumPy array.")
@@ -50,6 +72,14 @@ def perm(A, quad=True, fsum=False):
     if np.isnan(A).any():
         raise ValueError("Input matrix must not contain NaNs.")
 
+    if adaptive:
+        if np.any(np.iscomplex(A)):
+            result = perm_adaptive_complex(np.complex128(A), rtol=rtol)
+        else:
+            result = perm_adaptive_real(np.float64(np.real(A)), rtol=rtol)
+
+        return result if return_precision else result[0]
+
     if matshape[0] == 2:
         return A[0, 0] * A[1, 1] + A[0, 1] * A[1, 0]
 
@@ -65,23 +95,31 @@ def perm(A, quad=True, fsum=False):
 
     if A.dtype == np.complex:
         if np.any(np.iscomplex(A)):
-            return perm_complex(A, quad=quad)
-        return perm_real(np.float64(A.real), quad=quad, fsum=fsum)
+            return perm_complex(A, quad=quad, glynn=glynn)
+        return perm_real(np.float64(A.real), quad=quad, fsum=fsum, glynn=glynn)
+
+    if np.issubdtype(A.dtype, np.integer):
+        # array data is an integer type, and the exact permanent is returned
+        return perm_int(np.int64(A))
 
-    return perm_real(A, quad=quad, fsum=fsum)
+    return perm_real(A, quad=quad, fsum=fsum, glynn=glynn)
 
 
 def permanent_repeated(A, rpt):
     r"""Calculates the permanent of matrix :math:`A`, where the ith row/column
     of :math:`A` is repeated :math:`rpt_i` times.
 
-    This function constructs the matrix
+    The permanent is computed using whichever of the following is cheaper:
 
-    .. math:: B = \begin{bmatrix} 0 & A\\ A^T & 0 \end{bmatrix},
+    * Ryser's formula applied to the matrix of size :math:`N=\sum_i rpt_i`
+      containing the repeated rows and columns, requiring :math:`O(N 2^N)`
+      operations, or
 
-    and then calculates :math:`perm(A)=haf(B)`, by calling
+    * the repeated hafnian of the matrix
 
-    >>> hafnian_repeated(B, rpt*2, loop=False)
+      .. math:: B = \begin{bmatrix} 0 & A\\ A^T & 0 \end{bmatrix},
+
+      using :math:`perm(A)=haf(B)`, which requires :math:`\prod_i (rpt_i+1)^2` terms.
 
     Args:
         A (array): matrix of size [N, N]
@@ -91,8 +129,24 @@ def permanent_repeated(A, rpt):
     Returns:
         np.int64 or np.float64 or np.complex128: the permanent of matrix A.
     """
+    rpt = np.asarray(rpt, dtype=np.int64)
+    N = np.sum(rpt)
+
+    if N == 0:
+        return 1.0
+
+    # compare the logarithms of the number of terms of both methods
+    if N <= 2 * np.sum(np.log2(rpt + 1)):
+        idx = np.repeat(np.arange(len(rpt)), rpt)
+        Arpt = A[np.ix_(idx, idx)]
+
+        if not np.iscomplexobj(Arpt):
+            Arpt = np.float64(Arpt)
+
+        return perm(Arpt)
+
     n = A.shape[0]
     O = np.zeros([n, n])
     B = np.vstack([np.hstack([O, A]), np.hstack([A.T, O])])
 
-    return hafnian_repeated(B, rpt * 2, loop=False)
+    return hafnian_repeated(B, list(rpt) * 2, loop=False)
@@ -16,11 +16,12 @@ Torontonian Python interface
 """
 import numpy as np
 
+from .lib.libhaf import tor_adaptive_complex, tor_adaptive_real
 from .lib.libhaf import torontonian_complex as tor_complex
 from .lib.libhaf import torontonian_real as tor_real
 
 
-def tor(A, fsum=False):
+def tor(A, fsum=False, adaptive=False, rtol=1e-10, return_precision=False):
     """Returns the Torontonian of a matrix.
 
     For more direct control, you may wish to call :func:`tor_real` or
@@ -36,9 +37,17 @@ def tor(A, fsum=False):
             the `accuracy of the computation <https://link.springer.com/article/10.1007%2FPL00009321>`_,
             but no casting to quadruple precision takes place, as the Shewchuck algorithm
             only supports double precision.
+        adaptive (bool): If ``True``, the torontonian is computed in double precision, and
+            recomputed in double-double precision only if its estimated relative error
+            exceeds ``rtol``. The ``fsum`` keyword argument is ignored.
+        rtol (float): If ``adaptive=True``, the largest acceptable estimated relative error
+            of the double precision result.
+        return_precision (bool): If ``adaptive=True`` and ``return_precision=True``, the
+            precision used (``"double"`` or ``"double-double"``) and the estimated relative
+            error of the double precision result are returned as well.
 
     Returns:
-        np.float64 or np.complex128: the torontonian of matrix A.
+        np.float64 or np.complex128 or tuple: the torontonian of matrix A.
     """
     if not isinstance(A, np.ndarray):
         raise TypeError("Input matrix must be a NumPy array.")
@@ -48,6 +57,14 @@ def tor(A, fsum=False):
     if matshape[0] != matshape[1]:
         raise ValueError("Input matrix must be square.")
 
+    if adaptive:
+        if np.any(np.iscomplex(A)):
+            result = tor_adaptive_complex(np.complex128(A), rtol=rtol)
+        else:
+            result = tor_adaptive_real(np.float64(np.real(A)), rtol=rtol)
+
+        return result if return_precision else result[0]
+
     if A.dtype == np.complex:
         if np.any(np.iscomplex(A)):
             return tor_complex(A, fsum=fsum)
@@ -1,387 +1,734 @@
-# Copyright 2019 Xanadu Quantum Technologies Inc.
-
-# Licensed under the Apache License, Version 2.0 (the "License");
-# you may not use this file except in compliance with the License.
-# You may obtain a copy of the License at
-
-#     http://www.apache.org/licenses/LICENSE-2.0
-
-# Unless required by applicable law or agreed to in writing, software
-# distributed under the License is distributed on an "AS IS" BASIS,
-# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
-# See the License for the specific language governing permissions and
-# limitations under the License.
-#cython: boundscheck=False, wraparound=False, embedsignature=True
-# distutils: language=c++
-cimport cython
-from libcpp.vector cimport vector
-
-
-cdef extern from "../src/hafnian.hpp" namespace "hafnian":
-    T hafnian[T](vector[T] &mat)
-    T hafnian_recursive[T](vector[T] &mat)
-    T loop_hafnian[T](vector[T] &mat)
-    T permanent[T](vector[T] &mat)
-
-    T hafnian_rpt[T](vector[T] &mat, vector[int] &nud)
-    T loop_hafnian_rpt[T](vector[T] &mat, vector[T] &mu, vector[int] &nud)
-
-    double permanent_quad(vector[double] &mat)
-    double complex permanent_quad(vector[double complex] &mat)
-    double perm_fsum[T](vector[T] &mat)
-    double permanent_fsum(vector[double] &mat)
-
-    double hafnian_recursive_quad(vector[double] &mat)
-    double complex hafnian_recursive_quad(vector[double complex] &mat)
-
-    double hafnian_rpt_quad(vector[double] &mat, vector[int] &nud)
-    double complex hafnian_rpt_quad(vector[double complex] &mat, vector[int] &nu)
-
-    double loop_hafnian_rpt_quad(vector[double] &mat, vector[double] &mu, vector[int] &nud)
-    double complex loop_hafnian_rpt_quad(vector[double complex] &mat, vector[double complex] &mu, vector[int] &nud)
-
-    double hafnian_approx(vector[double] &mat, int &nsamples)
-
-    double torontonian_quad(vector[double] &mat)
-    double complex torontonian_quad(vector[double complex] &mat)
-    double torontonian_fsum[T](vector[T] &mat)
-
-    vector[double complex] hermite_multidimensional_cpp(vector[double complex] &mat, vector[double complex] &d, int &resolution, bint &renorm)
-
-
-# ==============================================================================
-# Torontonian
-
-
-def torontonian_complex(double complex[:, :] A, fsum=False):
-    """Returns the Torontonian of a complex matrix A via the C++ hafnian library.
-
-    The input matrix is cast to a ``long double complex``
-    matrix internally for a quadruple precision torontonian computation.
-
-    However, if ``fsum=True``, no casting takes place, as the Shewchuk algorithm
-    only support double precision.
-
-    Args:
-        A (array): a np.complex128, square, symmetric array of even dimensions.
-        fsum (bool): if ``True``, the `Shewchuk algorithm <https://github.com/achan001/fsum>_
-            for more accurate summation is performed. This can significantly increase
-            the accuracy of the computation.
-
-    Returns:
-        np.complex128: the torontonian of matrix A
-    """
-    cdef int i, j, n = A.shape[0]
-    cdef vector[double complex] mat
-    cdef int m = n/2
-
-    for i in range(n):
-        for j in range(n):
-            mat.push_back(A[i, j])
-
-    if fsum:
-        return torontonian_fsum(mat)
-
-    return torontonian_quad(mat)
-
-
-def torontonian_real(double[:, :] A, fsum=False):
-    """Returns the Torontonian of a real matrix A via the C++ hafnian library.
-
-    The input matrix is cast to a ``long double``
-    matrix internally for a quadruple precision torontonian computation.
-
-    However, if ``fsum=True``, no casting takes place, as the Shewchuk algorithm
-    only support double precision.
-
-    Args:
-        A (array): a np.float64, square, symmetric array of even dimensions.
-        fsum (bool): if ``True``, the `Shewchuk algorithm <https://github.com/achan001/fsum>_
-            for more accurate summation is performed. This can significantly increase
-            the accuracy of the computation.
-
-    Returns:
-        np.float64: the torontonian of matrix A
-    """
-    cdef int i, j, n = A.shape[0]
-    cdef vector[double] mat
-    cdef int m = n/2
-
-    for i in range(n):
-        for j in range(n):
-            mat.push_back(A[i, j])
-
-
-    if fsum:
-        return torontonian_fsum(mat)
-
-    return torontonian_quad(mat)
-
-
-# ==============================================================================
-# Hafnian repeated
-
-
-def haf_rpt_real(double[:, :] A, int[:] rpt, double[:] mu=None, bint loop=False):
-    r"""Returns the hafnian of a real matrix A via the C++ hafnian library
-    using the rpt method. This method is more efficient for matrices with
-    repeated rows and columns.
-
-    Args:
-        A (array): a np.float64, square, :math:`N\times N` array of even dimensions.
-        rpt (array): a length :math:`N` array corresponding to the number of times
-            each row/column of matrix A is repeated.
-        mu (array): a vector of length :math:`N` representing the vector of means/displacement.
-            If not provided, ``mu`` is set to the diagonal of matrix ``A``. Note that this
-            only affects the loop hafnian.
-        loop (bool): If ``True``, the loop hafnian is returned. Default false.
-
-    Returns:
-        np.float64: the hafnian
-    """
-    cdef int i, j, n = A.shape[0]
-    cdef vector[int] nud
-    cdef vector[double] mat, d
-
-    for i in range(n):
-        nud.push_back(rpt[i])
-
-        if mu is None:
-            d.push_back(A[i, i])
-        else:
-            d.push_back(mu[i])
-
-        for j in range(n):
-            mat.push_back(A[i, j])
-
-    # Exposes a c function to python
-    if loop:
-        return loop_hafnian_rpt_quad(mat, d, nud)
-
-    return hafnian_rpt_quad(mat, nud)
-
-
-def haf_rpt_complex(double complex[:, :] A, int[:] rpt, double complex[:] mu=None, bint loop=False):
-    r"""Returns the hafnian of a complex matrix A via the C++ hafnian library
-    using the rpt method. This method is more efficient for matrices with
-    repeated rows and columns.
-
-    Args:
-        A (array): a np.complex128, square, :math:`N\times N` array of even dimensions.
-        rpt (array): a length :math:`N` array corresponding to the number of times
-            each row/column of matrix A is repeated.
-        mu (array): a vector of length :math:`N` representing the vector of means/displacement.
-            If not provided, ``mu`` is set to the diagonal of matrix ``A``. Note that this
-            only affects the loop hafnian.
-        loop (bool): If ``True``, the loop hafnian is returned. Default false.
-
-    Returns:
-        np.complex128: the hafnian
-    """
-    cdef int i, j, n = A.shape[0]
-    cdef vector[int] nud
-    cdef vector[double complex] mat, d
-
-    for i in range(n):
-        nud.push_back(rpt[i])
-
-        if mu is None:
-            d.push_back(A[i, i])
-        else:
-            d.push_back(mu[i])
-
-        for j in range(n):
-            mat.push_back(A[i, j])
-
-    # Exposes a c function to python
-    if loop:
-        return loop_hafnian_rpt_quad(mat, d, nud)
-
-    return hafnian_rpt_quad(mat, nud)
-
-
-# ==============================================================================
-# Hafnian recursive
-
-
-def haf_int(long long[:, :] A):
-    """Returns the hafnian of an integer matrix A via the C++ hafnian library.
-    Modified with permission from https://github.com/eklotek/Hafnian.
-
-    .. note:: Currently does not support calculation of the loop hafnian.
-
-    Args:
-        A (array): a np.int64, square, symmetric array of even dimensions.
-
-    Returns:
-        np.int64: the hafnian of matrix A
-    """
-    cdef int i, j, n = A.shape[0]
-    cdef vector[long long] mat
-
-    for i in range(n):
-        for j in range(n):
-            mat.push_back(A[i, j])
-
-    # Exposes a c function to python
-    return hafnian_recursive(mat)
-
-
-# ==============================================================================
-# Hafnian recursive and powtrace
-
-
-def haf_complex(double complex[:, :] A, bint loop=False, bint recursive=True, quad=True):
-    """Returns the hafnian of a complex matrix A via the C++ hafnian library.
-
-    Args:
-        A (array): a np.complex128, square, symmetric array of even dimensions.
-        loop (bool): If ``True``, the loop hafnian is returned. Default false.
-        recursive (bool): If ``True``, the recursive algorithm is used. Note:
-            the recursive algorithm does not currently support the loop hafnian.
-        quad (bool): If ``True``, the input matrix is cast to a ``long double complex``
-            matrix internally for a quadruple precision hafnian computation.
-
-    Returns:
-        np.complex128: the hafnian of matrix A
-    """
-    cdef int i, j, n = A.shape[0]
-    cdef vector[double complex] mat
-
-    for i in range(n):
-        for j in range(n):
-            mat.push_back(A[i, j])
-
-    # Exposes a c function to python
-    if loop:
-        return loop_hafnian(mat)
-
-    if recursive:
-        if quad:
-            return hafnian_recursive_quad(mat)
-        return hafnian_recursive(mat)
-
-    return hafnian(mat)
-
-
-def haf_real(double[:, :] A, bint loop=False, bint recursive=True, quad=True, bint approx=False, nsamples=1000):
-    """Returns the hafnian of a real matrix A via the C++ hafnian library.
-
-    Args:
-        A (array): a np.float64, square, symmetric array of even dimensions.
-        loop (bool): If ``True``, the loop hafnian is returned. Default false.
-        recursive (bool): If ``True``, the recursive algorithm is used. Note:
-            the recursive algorithm does not currently support the loop hafnian.
-        quad (bool): If ``True``, the input matrix is cast to a ``long double``
-            matrix internally for a quadruple precision hafnian computation.
-        approx (bool): If ``True``, an approximation algorithm is used to estimate the hafnian. Note that
-            the approximation algorithm can only be applied to matrices ``A`` that only have non-negative entries.
-        num_samples (int): If ``approx=True``, the approximation algorithm performs ``num_samples`` iterations 
-        	for estimation of the hafnian of the non-negative matrix ``A``.
-
-    Returns:
-        np.float64: the hafnian of matrix A
-    """
-    cdef int i, j, n = A.shape[0]
-    cdef vector[double] mat
-
-    for i in range(n):
-        for j in range(n):
-            mat.push_back(A[i, j])
-
-    # Exposes a c function to python
-    if loop:
-        return loop_hafnian(mat)
-
-    if approx:
-        return hafnian_approx(mat, nsamples)
-
-    if recursive:
-        if quad:
-            return hafnian_recursive_quad(mat)
-        return hafnian_recursive(mat)
-
-    return hafnian(mat)
-
-
-
-# ==============================================================================
-# Permanent
-
-
-def perm_complex(double complex[:, :] A, quad=True):
-    """Returns the hafnian of a complex matrix A via the C++ hafnian library.
-
-    Args:
-        A (array): a np.float, square array
-        quad (bool): If ``True``, the input matrix is cast to a ``long double complex``
-            matrix internally for a quadruple precision hafnian computation.
-
-    Returns:
-        np.complex128: the hafnian of matrix A
-    """
-    cdef int i, j, n = A.shape[0]
-    cdef vector[double complex] mat
-
-    for i in range(n):
-        for j in range(n):
-            mat.push_back(A[i, j])
-
-    # Exposes a c function to python
-    if quad:
-        return permanent_quad(mat)
-
-    return permanent(mat)
-
-
-def perm_real(double [:, :] A, quad=True, fsum=False):
-    """Returns the hafnian of a real matrix A via the C++ hafnian library.
-
-    Args:
-        A (array): a np.float64, square array
-        quad (bool): If ``True``, the input matrix is cast to a ``long double``
-            matrix internally for a quadruple precision hafnian computation.
-        fsum (bool): If ``True``, ``fsum`` method is used for summation.
-
-
-    Returns:
-        np.float64: the hafnian of matrix A
-    """
-    cdef int i, j, n = A.shape[0]
-    cdef vector[double] mat
-
-    for i in range(n):
-        for j in range(n):
-            mat.push_back(A[i, j])
-		
-    if fsum:
-        return permanent_fsum(mat)
-
-    # Exposes a c function to python
-    if quad:
-        return permanent_quad(mat)
-
-    return permanent(mat)
-
-
-# ==============================================================================
-# Batch hafnian
-
-def hermite_multidimensional(double complex[:, :] A, double complex[:] d, int resolution, ren=False):
-    cdef int i, j, n = A.shape[0]
-    cdef vector[double complex] R_mat, y_mat
-	
-    cdef int renorm = 0
-
-    if ren:
-        renorm = 1
-
-    for i in range(n):
-        for j in range(n):
-            R_mat.push_back(A[i, j])
-
-
-    for i in range(n):
-        y_mat.push_back(d[i])
-
-    return hermite_multidimensional_cpp(R_mat, y_mat, resolution, renorm)
+# Copyright 2019 Xanadu Quantum Technologies Inc.
+
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+
+#     http://www.apache.org/licenses/LICENSE-2.0
+
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#cython: boundscheck=False, wraparound=False, embedsignature=True
+# distutils: language=c++
+cimport cython
+from libcpp.vector cimport vector
+from libcpp.string cimport string
+
+
+cdef extern from "../src/hafnian.hpp" namespace "hafnian":
+    T hafnian[T](vector[T] &mat)
+    T hafnian_recursive[T](vector[T] &mat)
+    T loop_hafnian_recursive[T](vector[T] &mat)
+    T loop_hafnian[T](vector[T] &mat)
+    T permanent[T](vector[T] &mat)
+    T permanent_glynn[T](vector[T] &mat)
+
+    T hafnian_rpt[T](vector[T] &mat, vector[int] &nud)
+    T loop_hafnian_rpt[T](vector[T] &mat, vector[T] &mu, vector[int] &nud)
+
+    double permanent_quad(vector[double] &mat)
+    double complex permanent_quad(vector[double complex] &mat)
+    double permanent_glynn_quad(vector[double] &mat)
+    double complex permanent_glynn_quad(vector[double complex] &mat)
+    double perm_fsum[T](vector[T] &mat)
+    double permanent_fsum(vector[double] &mat)
+
+    double hafnian_recursive_quad(vector[double] &mat)
+    double complex hafnian_recursive_quad(vector[double complex] &mat)
+    double loop_hafnian_recursive_quad(vector[double] &mat)
+    double complex loop_hafnian_recursive_quad(vector[double complex] &mat)
+
+    double hafnian_eigen(vector[double] &mat)
+    double complex hafnian_eigen(vector[double complex] &mat)
+    double loop_hafnian_eigen(vector[double] &mat)
+    double complex loop_hafnian_eigen(vector[double complex] &mat)
+
+    double hafnian_rpt_quad(vector[double] &mat, vector[int] &nud)
+    double complex hafnian_rpt_quad(vector[double complex] &mat, vector[int] &nu)
+
+    double loop_hafnian_rpt_quad(vector[double] &mat, vector[double] &mu, vector[int] &nud)
+    double complex loop_hafnian_rpt_quad(vector[double complex] &mat, vector[double complex] &mu, vector[int] &nud)
+
+    double hafnian_approx(vector[double] &mat, int &nsamples)
+
+    string hafnian_int(vector[long long] &mat)
+    string permanent_int(vector[long long] &mat)
+
+    cdef enum dispatch_algorithm:
+        trivial_algorithm
+        eigen_algorithm
+        recursive_algorithm
+        repeated_algorithm
+        lowrank_algorithm
+        sparse_algorithm
+
+    cdef enum dispatch_precision:
+        double_precision
+        extended_precision
+
+    cdef cppclass dispatch_decision:
+        dispatch_algorithm algorithm
+        double estimated_time
+
+    const char *dispatch_name(dispatch_algorithm algorithm)
+    double hafnian_auto(vector[double] &mat, vector[int] &rpt, bint loop, dispatch_precision precision, dispatch_decision *decision)
+    double complex hafnian_auto(vector[double complex] &mat, vector[int] &rpt, bint loop, dispatch_precision precision, dispatch_decision *decision)
+
+    cdef cppclass adaptive_report:
+        dispatch_precision precision
+        double estimated_error
+
+    double hafnian_adaptive(vector[double] &mat, double tol, adaptive_report *report)
+    double complex hafnian_adaptive(vector[double complex] &mat, double tol, adaptive_report *report)
+    double permanent_adaptive(vector[double] &mat, double tol, adaptive_report *report)
+    double complex permanent_adaptive(vector[double complex] &mat, double tol, adaptive_report *report)
+    double torontonian_adaptive(vector[double] &mat, double tol, adaptive_report *report)
+    double complex torontonian_adaptive(vector[double complex] &mat, double tol, adaptive_report *report)
+
+    double torontonian_quad(vector[double] &mat)
+    double complex torontonian_quad(vector[double complex] &mat)
+    double torontonian_fsum[T](vector[T] &mat)
+
+    vector[double complex] hermite_multidimensional_cpp(vector[double complex] &mat, vector[double complex] &d, int &resolution, bint &renorm)
+
+
+# ==============================================================================
+# Torontonian
+
+
+def torontonian_complex(double complex[:, :] A, fsum=False):
+    """Returns the Torontonian of a complex matrix A via the C++ hafnian library.
+
+    The input matrix is cast to a ``long double complex``
+    matrix internally for a quadruple precision torontonian computation.
+
+    However, if ``fsum=True``, no casting takes place, as the Shewchuk algorithm
+    only support double precision.
+
+    Args:
+        A (array): a np.complex128, square, symmetric array of even dimensions.
+        fsum (bool): if ``True``, the `Shewchuk algorithm <https://github.com/achan001/fsum>_
+            for more accurate summation is performed. This can significantly increase
+            the accuracy of the computation.
+
+    Returns:
+        np.complex128: the torontonian of matrix A
+    """
+    cdef int i, j, n = A.shape[0]
+    cdef vector[double complex] mat
+    cdef int m = n/2
+
+    for i in range(n):
+        for j in range(n):
+            mat.push_back(A[i, j])
+
+    if fsum:
+        return torontonian_fsum(mat)
+
+    return torontonian_quad(mat)
+
+
+def torontonian_real(double[:, :] A, fsum=False):
+    """Returns the Torontonian of a real matrix A via the C++ hafnian library.
+
+    The input matrix is cast to a ``long double``
+    matrix internally for a quadruple precision torontonian computation.
+
+    However, if ``fsum=True``, no casting takes place, as the Shewchuk algorithm
+    only support double precision.
+
+    Args:
+        A (array): a np.float64, square, symmetric array of even dimensions.
+        fsum (bool): if ``True``, the `Shewchuk algorithm <https://github.com/achan001/fsum>_
+            for more accurate summation is performed. This can significantly increase
+            the accuracy of the computation.
+
+    Returns:
+        np.float64: the torontonian of matrix A
+    """
+    cdef int i, j, n = A.shape[0]
+    cdef vector[double] mat
+    cdef int m = n/2
+
+    for i in range(n):
+        for j in range(n):
+            mat.push_back(A[i, j])
+
+
+    if fsum:
+        return torontonian_fsum(mat)
+
+    return torontonian_quad(mat)
+
+
+# ==============================================================================
+# Hafnian repeated
+
+
+def haf_rpt_real(double[:, :] A, int[:] rpt, double[:] mu=None, bint loop=False):
+    r"""Returns the hafnian of a real matrix A via the C++ hafnian library
+    using the rpt method. This method is more efficient for matrices with
+    repeated rows and columns.
+
+    Args:
+        A (array): a np.float64, square, :math:`N\times N` array of even dimensions.
+        rpt (array): a length :math:`N` array corresponding to the number of times
+            each row/column of matrix A is repeated.
+        mu (array): a vector of length :math:`N` representing the vector of means/displacement.
+            If not provided, ``mu`` is set to the diagonal of matrix ``A``. Note that this
+            only affects the loop hafnian.
+        loop (bool): If ``True``, the loop hafnian is returned. Default false.
+
+    Returns:
+        np.float64: the hafnian
+    """
+    cdef int i, j, n = A.shape[0]
+    cdef vector[int] nud
+    cdef vector[double] mat, d
+
+    for i in range(n):
+        nud.push_back(rpt[i])
+
+        if mu is None:
+            d.push_back(A[i, i])
+        else:
+            d.push_back(mu[i])
+
+        for j in range(n):
+            mat.push_back(A[i, j])
+
+    # Exposes a c function to python
+    if loop:
+        return loop_hafnian_rpt_quad(mat, d, nud)
+
+    return hafnian_rpt_quad(mat, nud)
+
+
+def haf_rpt_complex(double complex[:, :] A, int[:] rpt, double complex[:] mu=None, bint loop=False):
+    r"""Returns the hafnian of a complex matrix A via the C++ hafnian library
+    using the rpt method. This method is more efficient for matrices with
+    repeated rows and columns.
+
+    Args:
+        A (array): a np.complex128, square, :math:`N\times N` array of even dimensions.
+        rpt (array): a length :math:`N` array corresponding to the number of times
+            each row/column of matrix A is repeated.
+        mu (array): a vector of length :math:`N` representing the vector of means/displacement.
+            If not provided, ``mu`` is set to the diagonal of matrix ``A``. Note that this
+            only affects the loop hafnian.
+        loop (bool): If ``True``, the loop hafnian is returned. Default false.
+
+    Returns:
+        np.complex128: the hafnian
+    """
+    cdef int i, j, n = A.shape[0]
+    cdef vector[int] nud
+    cdef vector[double complex] mat, d
+
+    for i in range(n):
+        nud.push_back(rpt[i])
+
+        if mu is None:
+            d.push_back(A[i, i])
+        else:
+            d.push_back(mu[i])
+
+        for j in range(n):
+            mat.push_back(A[i, j])
+
+    # Exposes a c function to python
+    if loop:
+        return loop_hafnian_rpt_quad(mat, d, nud)
+
+    return hafnian_rpt_quad(mat, nud)
+
+
+# ==============================================================================
+# Hafnian with automatic algorithm selection
+
+
+def haf_auto_real(double[:, :] A, int[:] rpt, double[:] mu=None, bint loop=False, bint extended=False):
+    r"""Returns the hafnian of a real matrix A with repeated rows and columns via the
+    C++ hafnian library, using the algorithm with the smallest estimated time.
+
+    Args:
+        A (array): a np.float64, square, :math:`N\times N` array.
+        rpt (array): a length :math:`N` array corresponding to the number of times
+            each row/column of matrix A is repeated.
+        mu (array): a vector of length :math:`N` representing the vector of means/displacement.
+            If not provided, ``mu`` is set to the diagonal of matrix ``A``. Note that this
+            only affects the loop hafnian.
+        loop (bool): If ``True``, the loop hafnian is returned. Default false.
+        extended (bool): If ``True``, only algorithms evaluated in extended precision are used.
+
+    Returns:
+        tuple[np.float64, str, float]: the hafnian, the name of the chosen algorithm,
+        and its estimated time in seconds
+    """
+    cdef int i, j, n = A.shape[0]
+    cdef vector[int] nud
+    cdef vector[double] mat
+    cdef dispatch_decision decision
+    cdef dispatch_precision precision = extended_precision if extended else double_precision
+
+    for i in range(n):
+        nud.push_back(rpt[i])
+
+        for j in range(n):
+            if i == j and loop and mu is not None:
+                mat.push_back(mu[i])
+            else:
+                mat.push_back(A[i, j])
+
+    haf = hafnian_auto(mat, nud, loop, precision, &decision)
+    return haf, dispatch_name(decision.algorithm).decode(), decision.estimated_time
+
+
+def haf_auto_complex(double complex[:, :] A, int[:] rpt, double complex[:] mu=None, bint loop=False, bint extended=False):
+    r"""Returns the hafnian of a complex matrix A with repeated rows and columns via the
+    C++ hafnian library, using the algorithm with the smallest estimated time.
+
+    Args:
+        A (array): a np.complex128, square, :math:`N\times N` array.
+        rpt (array): a length :math:`N` array corresponding to the number of times
+            each row/column of matrix A is repeated.
+        mu (array): a vector of length :math:`N` representing the vector of means/displacement.
+            If not provided, ``mu`` is set to the diagonal of matrix ``A``. Note that this
+            only affects the loop hafnian.
+        loop (bool): If ``True``, the loop hafnian is returned. Default false.
+        extended (bool): If ``True``, only algorithms evaluated in extended precision are used.
+
+    Returns:
+        tuple[np.complex128, str, float]: the hafnian, the name of the chosen algorithm,
+        and its estimated time in seconds
+    """
+    cdef int i, j, n = A.shape[0]
+    cdef vector[int] nud
+    cdef vector[double complex] mat
+    cdef dispatch_decision decision
+    cdef dispatch_precision precision = extended_precision if extended else double_precision
+
+    for i in range(n):
+        nud.push_back(rpt[i])
+
+        for j in range(n):
+            if i == j and loop and mu is not None:
+                mat.push_back(mu[i])
+            else:
+                mat.push_back(A[i, j])
+
+    haf = hafnian_auto(mat, nud, loop, precision, &decision)
+    return haf, dispatch_name(decision.algorithm).decode(), decision.estimated_time
+
+
+# ==============================================================================
+# Adaptive precision
+
+
+cdef adaptive_result(value, adaptive_report &report):
+    """Returns the value with the name of the precision used and the estimated error."""
+    precision = "double" if report.precision == double_precision else "double-double"
+    return value, precision, report.estimated_error
+
+
+def haf_adaptive_real(double[:, :] A, double rtol=1e-10):
+    """Returns the hafnian of a real matrix A via the C++ hafnian library, computed in
+    double precision and recomputed in double-double precision only if the estimated
+    relative error of the double precision result exceeds ``rtol``.
+
+    Args:
+        A (array): a np.float64, square, symmetric array.
+        rtol (float): the largest acceptable estimated relative error of the double
+            precision result.
+
+    Returns:
+        tuple[np.float64, str, float]: the hafnian of matrix A, the precision used
+        (``"double"`` or ``"double-double"``), and the estimated relative error of the
+        double precision result
+    """
+    cdef int i, j, n = A.shape[0]
+    cdef vector[double] mat
+    cdef adaptive_report report
+
+    for i in range(n):
+        for j in range(n):
+            mat.push_back(A[i, j])
+
+    value = hafnian_adaptive(mat, rtol, &report)
+    return adaptive_result(value, report)
+
+
+def haf_adaptive_complex(double complex[:, :] A, double rtol=1e-10):
+    """Returns the hafnian of a complex matrix A via the C++ hafnian library, computed in
+    double precision and recomputed in double-double precision only if the estimated
+    relative error of the double precision result exceeds ``rtol``.
+
+    Args:
+        A (array): a np.complex128, square, symmetric array.
+        rtol (float): the largest acceptable estimated relative error of the double
+            precision result.
+
+    Returns:
+        tuple[np.complex128, str, float]: the hafnian of matrix A, the precision used
+        (``"double"`` or ``"double-double"``), and the estimated relative error of the
+        double precision result
+    """
+    cdef int i, j, n = A.shape[0]
+    cdef vector[double complex] mat
+    cdef adaptive_report report
+
+    for i in range(n):
+        for j in range(n):
+            mat.push_back(A[i, j])
+
+    value = hafnian_adaptive(mat, rtol, &report)
+    return adaptive_result(value, report)
+
+
+def perm_adaptive_real(double[:, :] A, double rtol=1e-10):
+    """Returns the permanent of a real matrix A via the C++ hafnian library, computed in
+    double precision and recomputed in double-double precision only if the estimated
+    relative error of the double precision result exceeds ``rtol``.
+
+    Args:
+        A (array): a np.float64, square, array.
+        rtol (float): the largest acceptable estimated relative error of the double
+            precision result.
+
+    Returns:
+        tuple[np.float64, str, float]: the permanent of matrix A, the precision used
+        (``"double"`` or ``"double-double"``), and the estimated relative error of the
+        double precision result
+    """
+    cdef int i, j, n = A.shape[0]
+    cdef vector[double] mat
+    cdef adaptive_report report
+
+    for i in range(n):
+        for j in range(n):
+            mat.push_back(A[i, j])
+
+    value = permanent_adaptive(mat, rtol, &report)
+    return adaptive_result(value, report)
+
+
+def perm_adaptive_complex(double complex[:, :] A, double rtol=1e-10):
+    """Returns the permanent of a complex matrix A via the C++ hafnian library, computed in
+    double precision and recomputed in double-double precision only if the estimated
+    relative error of the double precision result exceeds ``rtol``.
+
+    Args:
+        A (array): a np.complex128, square, array.
+        rtol (float): the largest acceptable estimated relative error of the double
+            precision result.
+
+    Returns:
+        tuple[np.complex128, str, float]: the permanent of matrix A, the precision used
+        (``"double"`` or ``"double-double"``), and the estimated relative error of the
+        double precision result
+    """
+    cdef int i, j, n = A.shape[0]
+    cdef vector[double complex] mat
+    cdef adaptive_report report
+
+    for i in range(n):
+        for j in range(n):
+            mat.push_back(A[i, j])
+
+    value = permanent_adaptive(mat, rtol, &report)
+    return adaptive_result(value, report)
+
+
+def tor_adaptive_real(double[:, :] A, double rtol=1e-10):
+    """Returns the Torontonian of a real matrix A via the C++ hafnian library, computed in
+    double precision and recomputed in double-double precision only if the estimated
+    relative error of the double precision result exceeds ``rtol``.
+
+    Args:
+        A (array): a np.float64, square, symmetric array.
+        rtol (float): the largest acceptable estimated relative error of the double
+            precision result.
+
+    Returns:
+        tuple[np.float64, str, float]: the Torontonian of matrix A, the precision used
+        (``"double"`` or ``"double-double"``), and the estimated relative error of the
+        double precision result
+    """
+    cdef int i, j, n = A.shape[0]
+    cdef vector[double] mat
+    cdef adaptive_report report
+
+    for i in range(n):
+        for j in range(n):
+            mat.push_back(A[i, j])
+
+    value = torontonian_adaptive(mat, rtol, &report)
+    return adaptive_result(value, report)
+
+
+def tor_adaptive_complex(double complex[:, :] A, double rtol=1e-10):
+    """Returns the Torontonian of a complex matrix A via the C++ hafnian library, computed in
+    double precision and recomputed in double-double precision only if the estimated
+    relative error of the double precision result exceeds ``rtol``.
+
+    Args:
+        A (array): a np.complex128, square, symmetric array.
+        rtol (float): the largest acceptable estimated relative error of the double
+            precision result.
+
+    Returns:
+        tuple[np.complex128, str, float]: the Torontonian of matrix A, the precision used
+        (``"double"`` or ``"double-double"``), and the estimated relative error of the
+        double precision result
+    """
+    cdef int i, j, n = A.shape[0]
+    cdef vector[double complex] mat
+    cdef adaptive_report report
+
+    for i in range(n):
+        for j in range(n):
+            mat.push_back(A[i, j])
+
+    value = torontonian_adaptive(mat, rtol, &report)
+    return adaptive_result(value, report)
+
+
+# ==============================================================================
+# Hafnian recursive
+
+
+def haf_int(long long[:, :] A):
+    """Returns the exact hafnian of an integer matrix A via the C++ hafnian library.
+    Modified with permission from https://github.com/eklotek/Hafnian.
+
+    The hafnian is computed modulo several primes in parallel using the recursive
+    algorithm, and reconstructed with the Chinese remainder theorem, so that the
+    result does not overflow.
+
+    .. note:: Currently does not support calculation of the loop hafnian.
+
+    Args:
+        A (array): a np.int64, square, symmetric array of even dimensions.
+
+    Returns:
+        int: the hafnian of matrix A
+    """
+    cdef int i, j, n = A.shape[0]
+    cdef vector[long long] mat
+
+    for i in range(n):
+        for j in range(n):
+            mat.push_back(A[i, j])
+
+    # Exposes a c function to python
+    return int(hafnian_int(mat).decode())
+
+
+# ==============================================================================
+# Hafnian recursive and powtrace
+
+
+def haf_complex(double complex[:, :] A, bint loop=False, bint recursive=True, quad=True):
+    """Returns the hafnian of a complex matrix A via the C++ hafnian library.
+
+    Args:
+        A (array): a np.complex128, square, symmetric array of even dimensions.
+        loop (bool): If ``True``, the loop hafnian is returned. Default false.
+        recursive (bool): If ``True``, the recursive algorithm is used.
+            For the loop hafnian, the recursive algorithm carries the diagonal
+            through the polynomial recursion.
+        quad (bool): If ``True``, the input matrix is cast to a ``long double complex``
+            matrix internally for a quadruple precision hafnian computation.
+
+    Returns:
+        np.complex128: the hafnian of matrix A
+    """
+    cdef int i, j, n = A.shape[0]
+    cdef vector[double complex] mat
+
+    for i in range(n):
+        for j in range(n):
+            mat.push_back(A[i, j])
+
+    # Exposes a c function to python
+    if loop:
+        if recursive:
+            if quad:
+                return loop_hafnian_recursive_quad(mat)
+            return loop_hafnian_recursive(mat)
+        return loop_hafnian_eigen(mat)
+
+    if recursive:
+        if quad:
+            return hafnian_recursive_quad(mat)
+        return hafnian_recursive(mat)
+
+    return hafnian_eigen(mat)
+
+
+def haf_real(double[:, :] A, bint loop=False, bint recursive=True, quad=True, bint approx=False, nsamples=1000):
+    """Returns the hafnian of a real matrix A via the C++ hafnian library.
+
+    Args:
+        A (array): a np.float64, square, symmetric array of even dimensions.
+        loop (bool): If ``True``, the loop hafnian is returned. Default false.
+        recursive (bool): If ``True``, the recursive algorithm is used.
+            For the loop hafnian, the recursive algorithm carries the diagonal
+            through the polynomial recursion.
+        quad (bool): If ``True``, the input matrix is cast to a ``long double``
+            matrix internally for a quadruple precision hafnian computation.
+        approx (bool): If ``True``, an approximation algorithm is used to estimate the hafnian. Note that
+            the approximation algorithm can only be applied to matrices ``A`` that only have non-negative entries.
+        num_samples (int): If ``approx=True``, the approximation algorithm performs ``num_samples`` iterations 
+        	for estimation of the hafnian of the non-negative matrix ``A``.
+
+    Returns:
+        np.float64: the hafnian of matrix A
+    """
+    cdef int i, j, n = A.shape[0]
+    cdef vector[double] mat
+
+    for i in range(n):
+        for j in range(n):
+            mat.push_back(A[i, j])
+
+    # Exposes a c function to python
+    if loop:
+        if recursive:
+            if quad:
+                return loop_hafnian_recursive_quad(mat)
+            return loop_hafnian_recursive(mat)
+        return loop_hafnian_eigen(mat)
+
+    if approx:
+        return hafnian_approx(mat, nsamples)
+
+    if recursive:
+        if quad:
+            return hafnian_recursive_quad(mat)
+        return hafnian_recursive(mat)
+
+    return hafnian_eigen(mat)
+
+
+
+# ==============================================================================
+# Permanent
+
+
+def perm_complex(double complex[:, :] A, quad=True, glynn=False):
+    """Returns the hafnian of a complex matrix A via the C++ hafnian library.
+
+    Args:
+        A (array): a np.float, square array
+        quad (bool): If ``True``, the input matrix is cast to a ``long double complex``
+            matrix internally for a quadruple precision hafnian computation.
+        glynn (bool): If ``True``, Glynn's formula is used instead of Ryser's formula.
+
+    Returns:
+        np.complex128: the hafnian of matrix A
+    """
+    cdef int i, j, n = A.shape[0]
+    cdef vector[double complex] mat
+
+    for i in range(n):
+        for j in range(n):
+            mat.push_back(A[i, j])
+
+    # Exposes a c function to python
+    if glynn:
+        if quad:
+            return permanent_glynn_quad(mat)
+        return permanent_glynn(mat)
+
+    if quad:
+        return permanent_quad(mat)
+
+    return permanent(mat)
+
+
+def perm_int(long long[:, :] A):
+    """Returns the exact permanent of an integer matrix A via the C++ hafnian library.
+
+    The permanent is computed modulo several primes in parallel using Ryser's
+    formula, and reconstructed with the Chinese remainder theorem, so that the
+    result does not overflow.
+
+    Args:
+        A (array): a np.int64, square array
+
+    Returns:
+        int: the permanent of matrix A
+    """
+    cdef int i, j, n = A.shape[0]
+    cdef vector[long long] mat
+
+    for i in range(n):
+        for j in range(n):
+            mat.push_back(A[i, j])
+
+    # Exposes a c function to python
+    return int(permanent_int(mat).decode())
+
+
+def perm_real(double [:, :] A, quad=True, fsum=False, glynn=False):
+    """Returns the hafnian of a real matrix A via the C++ hafnian library.
+
+    Args:
+        A (array): a np.float64, square array
+        quad (bool): If ``True``, the input matrix is cast to a ``long double``
+            matrix internally for a quadruple precision hafnian computation.
+        fsum (bool): If ``True``, ``fsum`` method is used for summation.
+        glynn (bool): If ``True``, Glynn's formula is used instead of Ryser's formula.
+            The ``fsum`` keyword argument is then ignored.
+
+
+    Returns:
+        np.float64: the hafnian of matrix A
+    """
+    cdef int i, j, n = A.shape[0]
+    cdef vector[double] mat
+
+    for i in range(n):
+        for j in range(n):
+            mat.push_back(A[i, j])
+		
+    if glynn:
+        if quad:
+            return permanent_glynn_quad(mat)
+        return permanent_glynn(mat)
+
+    if fsum:
+        return permanent_fsum(mat)
+
+    # Exposes a c function to python
+    if quad:
+        return permanent_quad(mat)
+
+    return permanent(mat)
+
+
+# ==============================================================================
+# Batch hafnian
+
+def hermite_multidimensional(double complex[:, :] A, double complex[:] d, int resolution, ren=False):
+    cdef int i, j, n = A.shape[0]
+    cdef vector[double complex] R_mat, y_mat
+	
+    cdef int renorm = 0
+
+    if ren:
+        renorm = 1
+
+    for i in range(n):
+        for j in range(n):
+            R_mat.push_back(A[i, j])
+
+
+    for i in range(n):
+        y_mat.push_back(d[i])
+
+    return hermite_multidimensional_cpp(R_mat, y_mat, resolution, renorm)
@@ -95,7 +95,7 @@ import numpy as np
 from scipy.optimize import root_scalar
 from scipy.special import factorial as fac
 
-from ._hafnian import hafnian, hafnian_repeated, reduction
+from ._hafnian import hafnian_auto
 from ._hermite_multidimensional import hermite_multidimensional, hafnian_batched
 
 
@@ -322,23 +322,15 @@ def density_matrix_element(mu, cov, i, j, include_prefactor=True, tol=1e-10, hba
     rpt = i + j
     beta = Beta(mu, hbar=hbar)
     A = Amat(cov, hbar=hbar)
+    # the algorithm is chosen by the C++ library from the estimated time of each one
     if np.linalg.norm(beta) < tol:
         # no displacement
-        if np.prod([k + 1 for k in rpt]) ** (1 / len(rpt)) < 3:
-            A_rpt = reduction(A, rpt)
-            haf = hafnian(A_rpt)
-        else:
-            haf = hafnian_repeated(A, rpt)
+        haf = hafnian_auto(A, rpt)
     else:
         # replace the diagonal of A with gamma
         # gamma = X @ np.linalg.inv(Q).conj() @ beta
         gamma = beta.conj() - A @ beta
-        if np.prod([k + 1 for k in rpt]) ** (1 / len(rpt)) < 3:
-            A_rpt = reduction(A, rpt)
-            np.fill_diagonal(A_rpt, reduction(gamma, rpt))
-            haf = hafnian(A_rpt, loop=True)
-        else:
-            haf = hafnian_repeated(A, rpt, mu=gamma, loop=True)
+        haf = hafnian_auto(A, rpt, mu=gamma, loop=True)
 
     if include_prefactor:
         haf *= prefactor(mu, cov, hbar=2)
@@ -457,24 +449,15 @@ def pure_state_amplitude(mu, cov, i, include_prefactor=True, tol=1e-10, hbar=2,
     B = A[0:N, 0:N]
     alpha = beta[0:N]
 
+    # the algorithm is chosen by the C++ library from the estimated time of each one
     if np.linalg.norm(alpha) < tol:
         # no displacement
-        if np.prod([k + 1 for k in rpt]) ** (1 / len(rpt)) < 3:
-            B_rpt = reduction(B, rpt)
-            haf = hafnian(B_rpt)
-        else:
-            haf = hafnian_repeated(B, rpt)
+        haf = hafnian_auto(B, rpt)
     else:
         # replace the diagonal of A with gamma
         # gamma = X @ np.linalg.inv(Q).conj() @ beta
         zeta = alpha - B @ (alpha.conj())
-
-        if np.prod([k + 1 for k in rpt]) ** (1 / len(rpt)) < 3:
-            B_rpt = reduction(B, rpt)
-            np.fill_diagonal(B_rpt, reduction(zeta, rpt))
-            haf = hafnian(B_rpt, loop=True)
-        else:
-            haf = hafnian_repeated(B, rpt, mu=zeta, loop=True)
+        haf = hafnian_auto(B, rpt, mu=zeta, loop=True)
 
     if include_prefactor:
         pref = np.exp(-0.5 * (np.linalg.norm(alpha) ** 2 - alpha.conj() @ B @ alpha.conj()))
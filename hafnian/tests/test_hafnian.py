@@ -132,6 +132,34 @@ class TestHafnianWrapper:
         expected = haf_int(np.int64(A))
         assert np.allclose(haf, expected)
 
+    def test_int_exact(self):
+        """Check the hafnian of an integer matrix whose hafnian exceeds
+        the range of 64-bit integers, haf(cJ) = (n-1)!! c^(n/2).
+        """
+        n = 16
+        c = 10 ** 9
+        A = np.full([n, n], c, dtype=np.int64)
+        haf = hafnian(A)
+        assert isinstance(haf, int)
+        assert haf == int(fac(n, exact=True) // (fac(n // 2, exact=True) * 2 ** (n // 2))) * c ** (n // 2)
+
+    def test_adaptive(self):
+        """Check the adaptive hafnian against the hafnian, and that a zero
+        tolerance forces the double-double computation.
+        """
+        A = np.random.random([8, 8])
+        A += A.T
+        haf, precision, _ = hafnian(A, adaptive=True, return_precision=True)
+        assert precision == "double"
+        assert np.allclose(haf, hafnian(A))
+
+        haf, precision, _ = hafnian(A, adaptive=True, rtol=0, return_precision=True)
+        assert precision == "double-double"
+        assert np.allclose(haf, hafnian(A))
+
+        with pytest.raises(ValueError):
+            hafnian(A, loop=True, adaptive=True)
+
     def test_int_wrapper_loop(self):
         """Check hafnian(A, loop=True)=haf_real(A, loop=True) for a random
         integer matrix.
@@ -209,10 +237,7 @@ class TestHafnian:
 
 
 class TestLoopHafnian:
-    """Various loop Hafnian consistency checks.
-    The loop hafnian is currently only defined for
-    the trace algorithm.
-    """
+    """Various loop Hafnian consistency checks."""
 
     def test_2x2(self, random_matrix):
         """Check 2x2 loop hafnian"""
@@ -268,3 +293,11 @@ class TestLoopHafnian:
         haf = hafnian(A, loop=True)
         expected = T[n]
         assert np.allclose(haf, expected)
+
+    @pytest.mark.parametrize("n", [6, 7, 10])
+    def test_recursive_vs_eigen(self, n, random_matrix):
+        """Check the recursive loop hafnian against the eigenvalue loop hafnian"""
+        A = random_matrix(n)
+        haf = hafnian(A, loop=True, recursive=True)
+        expected = hafnian(A, loop=True, recursive=False)
+        assert np.allclose(haf, expected)
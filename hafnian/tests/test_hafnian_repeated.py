@@ -18,7 +18,7 @@ from math import factorial as fac
 import pytest
 
 import numpy as np
-from hafnian import hafnian_repeated
+from hafnian import hafnian_auto, hafnian_repeated
 from hafnian.lib.libhaf import haf_rpt_complex, haf_rpt_real
 
 
@@ -230,3 +230,33 @@ class TestHafnianRepeated:
         haf = hafnian_repeated(A, rpt)
         expected = np.prod(x) * fac(2 * n) / (fac(n) * (2 ** n))
         assert np.allclose(haf, expected)
+
+
+@pytest.mark.parametrize("dtype", [np.complex128, np.float64])
+class TestHafnianAuto:
+    """Tests for the hafnian with automatic algorithm selection"""
+
+    @pytest.mark.parametrize("rpt", [[1, 1, 1, 1, 1, 1], [3, 0, 2, 1, 2, 0], [5, 5, 4, 0, 2, 0]])
+    def test_agrees_with_repeated(self, rpt, dtype):
+        """Check that the chosen algorithm agrees with hafnian_repeated"""
+        A = np.random.rand(6, 6) + 1j * np.random.rand(6, 6)
+
+        if not np.iscomplex(dtype()):
+            A = A.real
+
+        A = dtype(A + A.T)
+        mu = dtype(np.diag(A)) + 1
+        assert np.allclose(hafnian_auto(A, rpt), hafnian_repeated(A, rpt))
+        assert np.allclose(
+            hafnian_auto(A, rpt, mu=mu, loop=True), hafnian_repeated(A, rpt, mu=mu, loop=True)
+        )
+
+    def test_decision(self, dtype):
+        """Check that the decision is returned for a graph that is a cycle"""
+        n = 16
+        A = np.roll(np.identity(n), 1, axis=1)
+        A = dtype(A + A.T)
+        haf, name, time = hafnian_auto(A, return_decision=True)
+        assert np.allclose(haf, 2)
+        assert isinstance(name, str)
+        assert time >= 0
@@ -18,7 +18,7 @@ import pytest
 import numpy as np
 from scipy.special import factorial as fac
 
-from hafnian import perm, perm_real, perm_complex, permanent_repeated
+from hafnian import perm, perm_real, perm_complex, perm_int, permanent_repeated, hafnian_repeated
 
 
 class TestPermanentWrapper:
@@ -86,6 +86,16 @@ class TestPermanentWrapper:
         expected = perm_complex(A)
         assert np.allclose(p, expected)
 
+    @pytest.mark.parametrize("dtype", [np.float64, np.complex128])
+    def test_glynn(self, random_matrix):
+        """Check that Glynn's formula agrees with Ryser's formula
+        for a random matrix.
+        """
+        A = random_matrix(7)
+        expected = perm(A)
+        assert np.allclose(perm(A, glynn=True), expected)
+        assert np.allclose(perm(A, quad=False, glynn=True), expected)
+
     @pytest.mark.parametrize("dtype", [np.float64])
     def test_complex_no_imag(self, random_matrix):
         """Check perm(A)=perm_real(A) for a complex random matrix
@@ -96,6 +106,37 @@ class TestPermanentWrapper:
         expected = perm_real(A.real)
         assert np.allclose(p, expected)
 
+    def test_int_exact(self):
+        """Check perm(A)=perm_int(A)=n! c^n for an integer matrix whose
+        permanent exceeds the range of 64-bit integers.
+        """
+        n = 12
+        c = 10 ** 9
+        A = np.full([n, n], c, dtype=np.int64)
+        p = perm(A)
+        assert p == perm_int(A)
+        assert p == int(fac(n, exact=True)) * c ** n
+
+        A[0, :] *= -1
+        assert perm(A) == -int(fac(n, exact=True)) * c ** n
+
+    def test_adaptive(self):
+        """Check that the adaptive permanent of a well-conditioned matrix is computed
+        in double precision, and that of the matrix of ones, whose Ryser terms cancel,
+        in double-double precision.
+        """
+        A = np.random.random([6, 6])
+        p, precision, _ = perm(A, adaptive=True, return_precision=True)
+        assert precision == "double"
+        assert np.allclose(p, perm(A))
+
+        n = 16
+        A = np.ones([n, n])
+        p, precision, err = perm(A, adaptive=True, return_precision=True)
+        assert precision == "double-double"
+        assert err > 1e-10
+        assert p == fac(n, exact=True)
+
 
 class TestPermanentRepeated:
     """Tests for the repeated permanent"""
@@ -128,6 +169,18 @@ class TestPermanentRepeated:
         )
         assert np.allclose(p, exp)
 
+    @pytest.mark.parametrize("rpt", [[2, 1, 2], [1, 0, 3], [4, 4, 4]])
+    def test_expanded(self, rpt, random_matrix):
+        """Check the repeated permanent against the hafnian of the block matrix,
+        whichever method is used internally"""
+        A = random_matrix(3)
+        O = np.zeros([3, 3])
+        B = np.vstack([np.hstack([O, A]), np.hstack([A.T, O])])
+
+        p = permanent_repeated(A, rpt)
+        expected = hafnian_repeated(B, rpt * 2, loop=False)
+        assert np.allclose(p, expected)
+
     @pytest.mark.parametrize("n", [6, 8, 10, 15, 20])
     def test_ones(self, n):
         """Check all ones matrix has perm(J_n)=n!"""
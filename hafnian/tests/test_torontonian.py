@@ -110,3 +110,13 @@ def test_torontonian_vacuum():
 def test_torontononian_analytical_mats(l, nbar):
     """Checks the correct value of the torontonian for the analytical family described by gen_omats"""
     assert np.allclose(torontonian_analytical(l, nbar), tor(gen_omats(l, nbar)))
+
+
+@pytest.mark.parametrize("nbar", [0.5, 1.0, 2.0])
+def test_torontonian_adaptive(nbar):
+    """Checks that the adaptive torontonian agrees with the torontonian, and reports its precision"""
+    Omat = gen_omats(2, nbar)
+    tor_val, precision, err = tor(Omat, adaptive=True, return_precision=True)
+    assert precision in ("double", "double-double")
+    assert err >= 0
+    assert np.allclose(tor_val, tor(Omat))
@@ -113,8 +113,19 @@ if BUILD_EXT:
                          "src/torontonian.hpp",
                          "src/permanent.hpp",
                          "src/hermite_multidimensional.hpp",
+                         "src/workspace.hpp",
+                         "src/shard.hpp",
+                         "src/checkpoint.hpp",
+                         "src/components.hpp",
+                         "src/lowrank_hafnian.hpp",
+                         "src/sparse_hafnian.hpp",
+                         "src/modular_hafnian.hpp",
+                         "src/double_double.hpp",
+                         "src/dispatch.hpp",
+                         "src/adaptive.hpp",
                          "src/stdafx.h",
-                         "src/fsum.hpp"],
+                         "src/fsum.hpp",
+                         "src/truncated_product.hpp"],
                 include_dirs=C_INCLUDE_PATH,
                 library_dirs=['/usr/lib', '/usr/local/lib'] + LD_LIBRARY_PATH,
                 libraries=libraries,
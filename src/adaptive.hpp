@@ -0,0 +1,286 @@
+// Copyright 2019 Xanadu Quantum Technologies Inc.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+/**
+ * @file
+ * Contains functions computing the hafnian, permanent and Torontonian in
+ * double precision, and recomputing them in double-double precision only
+ * when the double precision result may be inaccurate.
+ *
+ * These quantities are sums of many terms of alternating sign, and lose
+ * accuracy when the terms cancel. The rounding error of a sum
+ * \f$s=\sum_i t_i\f$, whose terms are computed with relative errors of
+ * order \f$n\epsilon\f$, is bounded by about \f$n\epsilon\sum_i|t_i|\f$, so
+ * its relative error is estimated by
+ * \f[
+ *     n\epsilon\frac{\sum_i|t_i|}{|s|},
+ * \f]
+ * where \f$\epsilon\f$ is the machine epsilon of double precision. The
+ * magnitude \f$\sum_i|t_i|\f$ is accumulated alongside the sum at the cost
+ * of one absolute value per term.
+ */
+#pragma once
+#include <stdafx.h>
+#include <limits>
+#include <double_double.hpp>
+#include <eigenvalue_hafnian.hpp>
+#include <recursive_hafnian.hpp>
+#include <permanent.hpp>
+#include <torontonian.hpp>
+#include <dispatch.hpp>
+
+namespace hafnian {
+
+/**
+ * Precision and estimated error of a computation performed by one of the
+ * adaptive functions.
+ */
+struct adaptive_report {
+    /// `double_precision` if the double precision result was returned, and
+    /// `extended_precision` if it was recomputed in double-double precision
+    dispatch_precision precision;
+    /// estimated relative error of the double precision result
+    double estimated_error;
+};
+
+/**
+ * Returns the estimated relative error of a sum computed in double precision.
+ *
+ * @param n size of the matrix, bounding the relative error of each term in units of \f$\epsilon\f$
+ * @param sum absolute value of the sum
+ * @param magnitude sum of the absolute values of the terms
+ * @return the estimated relative error, which is infinite if the sum vanishes
+ *      but its terms do not
+ */
+inline double adaptive_error(int n, double sum, double magnitude) {
+    if (magnitude == 0)
+        return 0.0;
+    if (sum == 0)
+        return std::numeric_limits<double>::infinity();
+
+    return std::max(n, 1) * std::numeric_limits<double>::epsilon() * magnitude / sum;
+}
+
+/**
+ * Returns the value computed in double precision by `low`, unless its
+ * estimated relative error exceeds `tol`, in which case the value computed by
+ * `high` is returned.
+ *
+ * @param n size of the matrix
+ * @param low function returning the double precision value, and setting the
+ *      magnitude of its terms
+ * @param high function returning the value in double-double precision
+ * @param tol largest acceptable estimated relative error
+ * @param report if not null, on exit contains the precision used and the estimated error
+ * @return the value
+ */
+template <typename T, typename F, typename G>
+inline T adaptive(int n, F low, G high, double tol, adaptive_report *report) {
+    double magnitude = 0.0;
+    T value = low(magnitude);
+    double err = adaptive_error(n, std::abs(value), magnitude);
+    bool escalate = !(err <= tol);
+
+    if (report != nullptr) {
+        report->precision = escalate ? extended_precision : double_precision;
+        report->estimated_error = err;
+    }
+
+    return escalate ? high() : value;
+}
+
+/**
+ * Converts a matrix to double-double precision.
+ */
+inline std::vector<double_double> to_double_double(std::vector<double> &mat) {
+    return std::vector<double_double>(mat.begin(), mat.end());
+}
+
+/**
+ * Converts a complex matrix to complex double-double precision.
+ */
+inline std::vector<std::complex<double_double>> to_double_double(std::vector<std::complex<double>> &mat) {
+    std::vector<std::complex<double_double>> matdd(mat.size());
+    for (std::size_t i = 0; i < mat.size(); i++)
+        matdd[i] = std::complex<double_double>(mat[i].real(), mat[i].imag());
+    return matdd;
+}
+
+/**
+ * Returns the hafnian of a matrix, computed in double precision using the
+ * eigenvalue hafnian (see hafnian()), and recomputed in double-double
+ * precision using the recursive algorithm (see hafnian_recursive()) if the
+ * estimated relative error of the former exceeds `tol`.
+ *
+ * This is a wrapper for Python integration; it returns sensible values for
+ * empty and non-even matrices.
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an
+ *      \f$n\times n\f$ row-ordered symmetric matrix.
+ * @param tol largest acceptable estimated relative error of the double precision result
+ * @param report if not null, on exit contains the precision used and the estimated error
+ * @return the hafnian
+ */
+std::complex<double> hafnian_adaptive(std::vector<std::complex<double>> &mat, double tol = 1e-10,
+                                      adaptive_report *report = nullptr) {
+    int n = std::sqrt(static_cast<double>(mat.size()));
+
+    if (report != nullptr)
+        *report = adaptive_report{double_precision, 0.0};
+    if (n == 0)
+        return 1.0;
+    if (n % 2 != 0)
+        return 0.0;
+
+    return adaptive<std::complex<double>>(n, [&](double &magnitude) {
+        return do_chunk(mat, n, 0, 1ULL << (n / 2), eigensolver, binary_order, nullptr, &magnitude);
+    }, [&]() {
+        std::vector<std::complex<double_double>> matdd = to_double_double(mat);
+        return to_complex_double(hafnian_recursive(matdd));
+    }, tol, report);
+}
+
+/**
+ * Returns the hafnian of a matrix, computed in double precision using the
+ * eigenvalue hafnian (see hafnian()), and recomputed in double-double
+ * precision using the recursive algorithm (see hafnian_recursive()) if the
+ * estimated relative error of the former exceeds `tol`.
+ *
+ * This is a wrapper for Python integration; it returns sensible values for
+ * empty and non-even matrices.
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an
+ *      \f$n\times n\f$ row-ordered symmetric matrix.
+ * @param tol largest acceptable estimated relative error of the double precision result
+ * @param report if not null, on exit contains the precision used and the estimated error
+ * @return the hafnian
+ */
+double hafnian_adaptive(std::vector<double> &mat, double tol = 1e-10, adaptive_report *report = nullptr) {
+    int n = std::sqrt(static_cast<double>(mat.size()));
+
+    if (report != nullptr)
+        *report = adaptive_report{double_precision, 0.0};
+    if (n == 0)
+        return 1.0;
+    if (n % 2 != 0)
+        return 0.0;
+
+    return adaptive<double>(n, [&](double &magnitude) {
+        return do_chunk(mat, n, 0, 1ULL << (n / 2), eigensolver, binary_order, nullptr, &magnitude);
+    }, [&]() {
+        std::vector<double_double> matdd = to_double_double(mat);
+        return static_cast<double>(hafnian_recursive(matdd));
+    }, tol, report);
+}
+
+/**
+ * Returns the permanent of a matrix, computed in double precision using
+ * Ryser's formula (see permanent()), and recomputed in double-double
+ * precision if the estimated relative error of the former exceeds `tol`.
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an
+ *      \f$n\times n\f$ row-ordered matrix.
+ * @param tol largest acceptable estimated relative error of the double precision result
+ * @param report if not null, on exit contains the precision used and the estimated error
+ * @return the permanent
+ */
+std::complex<double> permanent_adaptive(std::vector<std::complex<double>> &mat, double tol = 1e-10,
+                                        adaptive_report *report = nullptr) {
+    int n = std::sqrt(static_cast<double>(mat.size()));
+
+    if (report != nullptr)
+        *report = adaptive_report{double_precision, 0.0};
+    if (n == 0)
+        return 1.0;
+
+    return adaptive<std::complex<double>>(n, [&](double &magnitude) {
+        return permanent_chunk(mat, n, 0, (1LL << n) - 1, &magnitude);
+    }, [&]() {
+        std::vector<std::complex<double_double>> matdd = to_double_double(mat);
+        return to_complex_double(permanent(matdd));
+    }, tol, report);
+}
+
+/**
+ * Returns the permanent of a matrix, computed in double precision using
+ * Ryser's formula (see permanent()), and recomputed in double-double
+ * precision if the estimated relative error of the former exceeds `tol`.
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an
+ *      \f$n\times n\f$ row-ordered matrix.
+ * @param tol largest acceptable estimated relative error of the double precision result
+ * @param report if not null, on exit contains the precision used and the estimated error
+ * @return the permanent
+ */
+double permanent_adaptive(std::vector<double> &mat, double tol = 1e-10, adaptive_report *report = nullptr) {
+    int n = std::sqrt(static_cast<double>(mat.size()));
+
+    if (report != nullptr)
+        *report = adaptive_report{double_precision, 0.0};
+    if (n == 0)
+        return 1.0;
+
+    return adaptive<double>(n, [&](double &magnitude) {
+        return permanent_chunk(mat, n, 0, (1LL << n) - 1, &magnitude);
+    }, [&]() {
+        std::vector<double_double> matdd = to_double_double(mat);
+        return static_cast<double>(permanent(matdd));
+    }, tol, report);
+}
+
+/**
+ * Returns the Torontonian of a matrix, computed in double precision (see
+ * torontonian()), and recomputed in double-double precision if the
+ * estimated relative error of the former exceeds `tol`.
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an
+ *      \f$n\times n\f$ row-ordered symmetric matrix.
+ * @param tol largest acceptable estimated relative error of the double precision result
+ * @param report if not null, on exit contains the precision used and the estimated error
+ * @return the Torontonian
+ */
+std::complex<double> torontonian_adaptive(std::vector<std::complex<double>> &mat, double tol = 1e-10,
+                                          adaptive_report *report = nullptr) {
+    int n = std::sqrt(static_cast<double>(mat.size()));
+
+    return adaptive<std::complex<double>>(n, [&](double &magnitude) {
+        return torontonian_chunk(mat, n, 0, 1ULL << (n / 2), nullptr, &magnitude);
+    }, [&]() {
+        std::vector<std::complex<double_double>> matdd = to_double_double(mat);
+        return to_complex_double(torontonian(matdd));
+    }, tol, report);
+}
+
+/**
+ * Returns the Torontonian of a matrix, computed in double precision (see
+ * torontonian()), and recomputed in double-double precision if the
+ * estimated relative error of the former exceeds `tol`.
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an
+ *      \f$n\times n\f$ row-ordered symmetric matrix.
+ * @param tol largest acceptable estimated relative error of the double precision result
+ * @param report if not null, on exit contains the precision used and the estimated error
+ * @return the Torontonian
+ */
+double torontonian_adaptive(std::vector<double> &mat, double tol = 1e-10, adaptive_report *report = nullptr) {
+    int n = std::sqrt(static_cast<double>(mat.size()));
+
+    return adaptive<double>(n, [&](double &magnitude) {
+        return torontonian_chunk(mat, n, 0, 1ULL << (n / 2), nullptr, &magnitude);
+    }, [&]() {
+        std::vector<double_double> matdd = to_double_double(mat);
+        return static_cast<double>(torontonian(matdd));
+    }, tol, report);
+}
+
+}
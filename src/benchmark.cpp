@@ -0,0 +1,780 @@
+// Copyright 2019 Xanadu Quantum Technologies Inc.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+/**
+ * @file
+ * Benchmarks comparing the algorithms provided by the Hafnian C++ library.
+ *
+ * Usage: `./benchmark-cpp [name] [nmax]`, where `name` selects a single
+ * benchmark (all benchmarks are run if omitted), and `nmax` is the largest
+ * matrix dimension considered.
+ */
+#include <iostream>
+#include <iomanip>
+#include <complex>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <string>
+#include <cstdlib>
+#include <algorithm>
+#include <numeric>
+#include <new>
+#include <cstddef>
+#include <cstdint>
+#include <hafnian.hpp>
+
+
+// Live and peak bytes allocated through operator new. The size of each
+// block is stored in a header in front of it.
+static std::size_t live_bytes = 0;
+static std::size_t peak_bytes = 0;
+
+void *operator new(std::size_t size) {
+    const std::size_t header = alignof(std::max_align_t);
+    char *p = static_cast<char *>(std::malloc(size + header));
+    if (!p)
+        throw std::bad_alloc();
+
+    *reinterpret_cast<std::size_t *>(p) = size;
+    #pragma omp atomic
+    live_bytes += size;
+    // a race may only underestimate the peak of concurrent allocations
+    peak_bytes = std::max(peak_bytes, live_bytes);
+    return p + header;
+}
+
+void operator delete(void *p) noexcept {
+    if (!p)
+        return;
+
+    // integer arithmetic keeps the compiler from flagging the access to the header
+    std::size_t *q = reinterpret_cast<std::size_t *>(reinterpret_cast<std::uintptr_t>(p) - alignof(std::max_align_t));
+    #pragma omp atomic
+    live_bytes -= *q;
+    std::free(q);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+    operator delete(p);
+}
+
+
+/**
+ * Returns a random complex symmetric matrix of size \f$n\times n\f$.
+ */
+std::vector<std::complex<double>> random_symmetric(int n, unsigned int seed) {
+    std::vector<std::complex<double>> mat(n * n, 0.0);
+    std::default_random_engine generator(seed);
+    std::normal_distribution<double> distribution(0.0, 1.0 / std::sqrt(static_cast<double>(n)));
+
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j <= i; j++) {
+            mat[i * n + j] = std::complex<double>(distribution(generator), distribution(generator));
+            mat[j * n + i] = mat[i * n + j];
+        }
+    }
+
+    return mat;
+}
+
+
+/**
+ * Returns the wall time in seconds taken to evaluate `f`.
+ */
+template <typename F>
+double timeit(F f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+
+/**
+ * Compares the eigensolver and La Budde power trace algorithms
+ * in the eigenvalue hafnian.
+ */
+void bench_powtrace(int nmax) {
+    std::cout << "powtrace: eigensolver vs La Budde" << std::endl;
+    std::cout << std::setw(5) << "Size" << std::setw(15) << "Time(eigen)"
+              << std::setw(15) << "Time(labudde)" << std::setw(15) << "Speedup"
+              << std::setw(15) << "RelDiff" << std::endl;
+
+    for (int n = 4; n <= nmax; n += 4) {
+        std::vector<std::complex<double>> mat = random_symmetric(n, n);
+        std::complex<double> h1, h2;
+
+        double t1 = timeit([&]() { h1 = hafnian::hafnian(mat, hafnian::eigensolver); });
+        double t2 = timeit([&]() { h2 = hafnian::hafnian(mat, hafnian::labudde); });
+
+        std::cout << std::setw(5) << n << std::setw(15) << t1 << std::setw(15) << t2
+                  << std::setw(15) << t1 / t2 << std::setw(15) << std::abs(h1 - h2) / std::abs(h1) << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+
+/**
+ * Returns the ratio of the largest to the mean per-thread time.
+ */
+double imbalance(const std::vector<double> &times) {
+    double mean = std::accumulate(times.begin(), times.end(), 0.0) / times.size();
+    return *std::max_element(times.begin(), times.end()) / mean;
+}
+
+
+/**
+ * Compares the per-thread busy times of the eigenvalue hafnian when
+ * the subsets are split into ranges of equal length and of equal estimated cost.
+ */
+void bench_schedule(int nmax) {
+#ifdef _OPENMP
+    int nthreads = omp_get_max_threads();
+#else
+    int nthreads = 1;
+#endif
+
+    std::cout << "schedule: equal-length vs cost-balanced ranges, " << nthreads << " threads" << std::endl;
+    std::cout << std::setw(5) << "Size" << std::setw(15) << "Time(equal)" << std::setw(15) << "Max/mean"
+              << std::setw(15) << "Time(cost)" << std::setw(15) << "Max/mean" << std::endl;
+
+    for (int n = 8; n <= nmax; n += 4) {
+        std::vector<std::complex<double>> mat = random_symmetric(n, n);
+        unsigned long long int x = 1ULL << (n / 2);
+        std::vector<double> equal_times(nthreads, 0.0), cost_times;
+
+        double t1 = timeit([&]() {
+            #pragma omp parallel for schedule(static, 1)
+            for (int ii = 0; ii < nthreads; ii++) {
+                auto start = std::chrono::steady_clock::now();
+                hafnian::workspace<std::complex<double>> ws(n, hafnian::labudde);
+                std::complex<double> localsum = 0.0;
+
+                for (unsigned long long int k = ii * x / nthreads; k < (ii + 1) * x / nthreads; k++)
+                    localsum += hafnian::hafnian_term(mat, n, k, ws, hafnian::labudde);
+
+                equal_times[ii] = elapsed_seconds(start);
+            }
+        });
+        double t2 = timeit([&]() { hafnian::hafnian(mat, hafnian::labudde, hafnian::binary_order, &cost_times); });
+
+        std::cout << std::setw(5) << n << std::setw(15) << t1 << std::setw(15) << imbalance(equal_times)
+                  << std::setw(15) << t2 << std::setw(15) << imbalance(cost_times) << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+
+/**
+ * Compares the eigenvalue hafnian and loop hafnian when the subsets are
+ * visited in binary order and in Gray order.
+ */
+void bench_gray(int nmax) {
+    std::cout << "gray: binary vs Gray order subset enumeration (La Budde power traces)" << std::endl;
+    std::cout << std::setw(5) << "Size" << std::setw(15) << "Haf(binary)" << std::setw(15) << "Haf(gray)"
+              << std::setw(15) << "Loop(binary)" << std::setw(15) << "Loop(gray)" << std::endl;
+
+    for (int n = 8; n <= nmax; n += 4) {
+        std::vector<std::complex<double>> mat = random_symmetric(n, n);
+
+        double t1 = timeit([&]() { hafnian::hafnian(mat, hafnian::labudde, hafnian::binary_order); });
+        double t2 = timeit([&]() { hafnian::hafnian(mat, hafnian::labudde, hafnian::gray_order); });
+        double t3 = timeit([&]() { hafnian::loop_hafnian(mat, hafnian::labudde, hafnian::binary_order); });
+        double t4 = timeit([&]() { hafnian::loop_hafnian(mat, hafnian::labudde, hafnian::gray_order); });
+
+        std::cout << std::setw(5) << n << std::setw(15) << t1 << std::setw(15) << t2
+                  << std::setw(15) << t3 << std::setw(15) << t4 << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+
+/**
+ * Compares the eigenvalue hafnian and the low rank hafnian of random
+ * complex symmetric matrices of rank `r`, to locate the size at which
+ * the low rank algorithm becomes faster.
+ */
+void bench_lowrank(int nmax) {
+    std::cout << "lowrank: eigenvalue hafnian vs low rank hafnian" << std::endl;
+    std::cout << std::setw(5) << "Size" << std::setw(5) << "Rank" << std::setw(15) << "Time(eigen)"
+              << std::setw(15) << "Time(lowrank)" << std::setw(15) << "Speedup" << std::setw(15) << "Preferred"
+              << std::setw(15) << "RelDiff" << std::endl;
+
+    for (int r = 1; r <= 4; r++) {
+        for (int n = 4; n <= nmax; n += 4) {
+            std::vector<std::complex<double>> V = random_symmetric(n, n);
+            std::vector<std::complex<double>> mat(n * n, 0.0);
+
+            // keep the first r columns of a random matrix, and form V V^T
+            for (int i = 0; i < n; i++) {
+                for (int j = 0; j < n; j++) {
+                    for (int k = 0; k < r; k++) {
+                        mat[i * n + j] += V[i * n + k] * V[j * n + k];
+                    }
+                }
+            }
+
+            std::complex<double> h1, h2;
+
+            double t1 = timeit([&]() { h1 = hafnian::hafnian(mat); });
+            double t2 = timeit([&]() { h2 = hafnian::hafnian_lowrank(mat); });
+
+            std::cout << std::setw(5) << n << std::setw(5) << r << std::setw(15) << t1 << std::setw(15) << t2
+                      << std::setw(15) << t1 / t2 << std::setw(15) << hafnian::lowrank_preferred(n, r)
+                      << std::setw(15) << std::abs(h1 - h2) / std::abs(h1) << std::endl;
+        }
+    }
+    std::cout << std::endl;
+}
+
+
+/**
+ * Compares the eigenvalue hafnian and the path decomposition hafnian of the
+ * adjacency matrices of square grids, whose hafnians count domino tilings.
+ * The eigenvalue hafnian is only timed for grids with at most `nmax` vertices.
+ */
+void bench_sparse(int nmax) {
+    std::cout << "sparse: eigenvalue hafnian vs path decomposition hafnian on L x L grids" << std::endl;
+    std::cout << std::setw(5) << "Size" << std::setw(7) << "Width" << std::setw(15) << "Time(eigen)"
+              << std::setw(15) << "Time(sparse)" << std::setw(25) << "Hafnian" << std::endl;
+
+    for (int L = 2; L <= 16; L += 2) {
+        int n = L * L;
+        std::vector<double> mat(n * n, 0.0);
+
+        for (int v = 0; v < n; v++) {
+            if ((v + 1) % L != 0)
+                mat[v * n + v + 1] = mat[(v + 1) * n + v] = 1.0;
+            if (v + L < n)
+                mat[v * n + v + L] = mat[(v + L) * n + v] = 1.0;
+        }
+
+        std::vector<std::vector<int>> adj = hafnian::sparse_neighbours(mat, n);
+        int w = hafnian::sparse_width(adj, hafnian::sparse_ordering(adj));
+        double h;
+
+        double t1 = (n <= nmax) ? timeit([&]() { hafnian::hafnian(mat, hafnian::labudde); }) : 0.0;
+        double t2 = timeit([&]() { h = hafnian::hafnian_sparse(mat); });
+
+        std::cout << std::setw(5) << n << std::setw(7) << w << std::setw(15) << t1
+                  << std::setw(15) << t2 << std::setw(25) << std::setprecision(17) << h
+                  << std::setprecision(6) << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+
+/**
+ * Returns the double-double nearest to \f$m2^{-e}\f$, where \f$m\f$ is an
+ * integer given by its decimal representation.
+ */
+hafnian::double_double scaled_decimal(const std::string &m, int e) {
+    hafnian::double_double x = 0;
+    bool negative = m[0] == '-';
+
+    for (std::size_t i = negative ? 1 : 0; i < m.size(); i++)
+        x = x * 10 + (m[i] - '0');
+
+    x = hafnian::double_double(std::ldexp(x.hi, -e), std::ldexp(x.lo, -e));
+    return negative ? -x : x;
+}
+
+
+/**
+ * Returns the relative error of `value` with respect to `exact`, evaluated in double-double.
+ */
+template <typename T>
+double relative_error(T value, hafnian::double_double exact) {
+    long double hi = static_cast<long double>(value);
+    hafnian::double_double v(hi);
+    v += hafnian::double_double(static_cast<double>(value - static_cast<T>(hi)));
+    return std::abs(static_cast<double>((v - exact) / exact));
+}
+
+
+/**
+ * Compares the time and accuracy of the permanent, the recursive hafnian
+ * and the repeated hafnian evaluated in double, long double, `__float128`
+ * (where supported by the compiler) and double-double precision. The
+ * permanent is also evaluated with Glynn's formula, and the repeated
+ * hafnian in Gray order.
+ *
+ * The matrices have random entries \f$k/2^{10}\f$ with integer \f$|k|\leq 2^{10}\f$,
+ * so that the exact results are obtained from the modular integer engine.
+ */
+void bench_precision(int nmax) {
+    std::cout << "precision: double vs long double vs float128 vs double-double" << std::endl;
+    std::cout << std::setw(12) << "Kernel" << std::setw(5) << "Size" << std::setw(13) << "Precision"
+              << std::setw(15) << "Time" << std::setw(15) << "RelError" << std::endl;
+
+    std::default_random_engine generator(1);
+    std::uniform_int_distribution<long long int> distribution(-1024, 1024);
+
+    auto report = [](const char *kernel, int n, const char *precision, double t, double err) {
+        std::cout << std::setw(12) << kernel << std::setw(5) << n << std::setw(13) << precision
+                  << std::setw(15) << t << std::setw(15) << err << std::endl;
+    };
+
+    for (int n = 8; n <= std::min(nmax, 24); n += 4) {
+        std::vector<long long int> K(n * n);
+        for (auto &k : K)
+            k = distribution(generator);
+
+        hafnian::double_double exact = scaled_decimal(hafnian::permanent_int(K), 10 * n);
+
+        std::vector<double> md(K.size());
+        for (std::size_t i = 0; i < K.size(); i++)
+            md[i] = std::ldexp(static_cast<double>(K[i]), -10);
+
+        std::vector<long double> ml(md.begin(), md.end());
+        std::vector<qp> mq(md.begin(), md.end());
+        std::vector<hafnian::double_double> mdd(md.begin(), md.end());
+
+        double pd, t = timeit([&]() { pd = hafnian::permanent(md); });
+        report("permanent", n, "double", t, relative_error(pd, exact));
+        long double pl;
+        t = timeit([&]() { pl = hafnian::permanent(ml); });
+        report("permanent", n, "long double", t, relative_error(pl, exact));
+        qp pq;
+        t = timeit([&]() { pq = hafnian::permanent(mq); });
+        report("permanent", n, "float128", t, relative_error(pq, exact));
+        hafnian::double_double pdd;
+        t = timeit([&]() { pdd = hafnian::permanent(mdd); });
+        report("permanent", n, "dd", t, relative_error(pdd, exact));
+
+        t = timeit([&]() { pd = hafnian::permanent_glynn(md); });
+        report("glynn", n, "double", t, relative_error(pd, exact));
+        t = timeit([&]() { pl = hafnian::permanent_glynn(ml); });
+        report("glynn", n, "long double", t, relative_error(pl, exact));
+        t = timeit([&]() { pdd = hafnian::permanent_glynn(mdd); });
+        report("glynn", n, "dd", t, relative_error(pdd, exact));
+    }
+
+    for (int n = 8; n <= nmax + 8; n += 8) {
+        std::vector<long long int> K(n * n);
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j <= i; j++)
+                K[i * n + j] = K[j * n + i] = distribution(generator);
+        }
+
+        hafnian::double_double exact = scaled_decimal(hafnian::hafnian_int(K), 5 * n);
+
+        std::vector<double> md(K.size());
+        for (std::size_t i = 0; i < K.size(); i++)
+            md[i] = std::ldexp(static_cast<double>(K[i]), -10);
+
+        std::vector<long double> ml(md.begin(), md.end());
+        std::vector<qp> mq(md.begin(), md.end());
+        std::vector<hafnian::double_double> mdd(md.begin(), md.end());
+
+        double hd, t = timeit([&]() { hd = hafnian::hafnian_recursive(md); });
+        report("recursive", n, "double", t, relative_error(hd, exact));
+        long double hl;
+        t = timeit([&]() { hl = hafnian::hafnian_recursive(ml); });
+        report("recursive", n, "long double", t, relative_error(hl, exact));
+        qp hq;
+        t = timeit([&]() { hq = hafnian::hafnian_recursive(mq); });
+        report("recursive", n, "float128", t, relative_error(hq, exact));
+        hafnian::double_double hdd;
+        t = timeit([&]() { hdd = hafnian::hafnian_recursive(mdd); });
+        report("recursive", n, "dd", t, relative_error(hdd, exact));
+    }
+
+    for (int r = 2; r <= 6; r += 2) {
+        int m = 4;
+        std::vector<int> rpt(m, r);
+        std::vector<long long int> K(m * m);
+        for (int i = 0; i < m; i++) {
+            for (int j = 0; j <= i; j++)
+                K[i * m + j] = K[j * m + i] = distribution(generator);
+        }
+
+        std::vector<long long int> Kx = hafnian::expand_repeated(K, rpt);
+        hafnian::double_double exact = scaled_decimal(hafnian::hafnian_int(Kx), 5 * m * r);
+
+        std::vector<double> md(K.size());
+        for (std::size_t i = 0; i < K.size(); i++)
+            md[i] = std::ldexp(static_cast<double>(K[i]), -10);
+
+        std::vector<long double> ml(md.begin(), md.end());
+        std::vector<hafnian::double_double> mdd(md.begin(), md.end());
+
+        double hd, t = timeit([&]() { hd = hafnian::hafnian_rpt(md, rpt); });
+        report("repeated", m * r, "double", t, relative_error(hd, exact));
+        long double hl;
+        t = timeit([&]() { hl = hafnian::hafnian_rpt(ml, rpt); });
+        report("repeated", m * r, "long double", t, relative_error(hl, exact));
+        hafnian::double_double hdd;
+        t = timeit([&]() { hdd = hafnian::hafnian_rpt(mdd, rpt); });
+        report("repeated", m * r, "dd", t, relative_error(hdd, exact));
+
+        t = timeit([&]() { hd = hafnian::hafnian_rpt(md, rpt, hafnian::gray_order); });
+        report("rpt_gray", m * r, "double", t, relative_error(hd, exact));
+        t = timeit([&]() { hl = hafnian::hafnian_rpt(ml, rpt, hafnian::gray_order); });
+        report("rpt_gray", m * r, "long double", t, relative_error(hl, exact));
+    }
+    std::cout << std::endl;
+}
+
+
+/**
+ * Compares the eigenvalue loop hafnian and the recursive loop hafnian, the
+ * latter in double and long double precision.
+ */
+void bench_loop(int nmax) {
+    std::cout << "loop: eigenvalue vs recursive loop hafnian" << std::endl;
+    std::cout << std::setw(5) << "Size" << std::setw(15) << "Time(eigen)" << std::setw(15) << "Time(rec)"
+              << std::setw(15) << "Time(rec,ld)" << std::setw(15) << "RelDiff" << std::endl;
+
+    for (int n = 8; n <= nmax; n += 4) {
+        std::vector<std::complex<double>> mat = random_symmetric(n, n);
+        std::vector<std::complex<long double>> matq(mat.begin(), mat.end());
+        std::complex<double> h1, h2;
+        std::complex<long double> h3;
+
+        double t1 = timeit([&]() { h1 = hafnian::loop_hafnian(mat); });
+        double t2 = timeit([&]() { h2 = hafnian::loop_hafnian_recursive(mat); });
+        double t3 = timeit([&]() { h3 = hafnian::loop_hafnian_recursive(matq); });
+
+        std::cout << std::setw(5) << n << std::setw(15) << t1 << std::setw(15) << t2 << std::setw(15) << t3
+                  << std::setw(15) << std::abs(h1 - std::complex<double>(h3)) / std::abs(h3) << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+
+/**
+ * Compares the per-term cost of the loop hafnian when the loop corrections are
+ * obtained by one matrix-vector product per power, as with the eigensolver,
+ * and from the same La Budde decomposition as the power traces. Both variants
+ * compute the power traces with La Budde's algorithm, and are timed on the
+ * same random sample of subsets, so that sizes up to 48 are covered
+ * regardless of `nmax`.
+ */
+void bench_loopterm(int) {
+    int samples = 2000;
+
+    std::cout << "loopterm: matrix-vector vs bordered La Budde loop corrections, "
+              << samples << " terms" << std::endl;
+    std::cout << std::setw(5) << "Size" << std::setw(15) << "Time(matvec)" << std::setw(15) << "Time(bordered)"
+              << std::setw(15) << "Speedup" << std::setw(15) << "RelDiff" << std::endl;
+
+    for (int n = 20; n <= 48; n += 4) {
+        int m = n / 2;
+        std::vector<std::complex<double>> mat = random_symmetric(n, n);
+        std::vector<std::complex<double>> C(n, 0.0), D(n, 0.0);
+        hafnian::loop_diagonals(mat, n, C, D);
+
+        std::default_random_engine generator(n);
+        std::uniform_int_distribution<unsigned long long int> distribution(0, (1ULL << m) - 1);
+        std::vector<unsigned long long int> xs(samples);
+        for (auto &x : xs)
+            x = distribution(generator);
+
+        hafnian::workspace<std::complex<double>> ws(n, hafnian::labudde);
+        std::complex<double> h1 = 0.0, h2 = 0.0;
+
+        double t1 = timeit([&]() {
+            for (unsigned long long int x : xs) {
+                std::complex<double> *B = ws.B.data();
+                std::complex<double> *B2 = ws.B2.data();
+
+                dec2bin(ws.dst.data(), x, m);
+                Byte sum = find2(ws.dst.data(), m, ws.pos.data());
+
+                for (int i = 0; i < sum; i++) {
+                    for (int j = 0; j < sum; j++)
+                        B[i * sum + j] = B2[i * sum + j] = mat[ws.pos[i] * n + (ws.pos[j] ^ 1)];
+                    ws.C1[i] = C[ws.pos[i]];
+                    ws.D1[i] = D[ws.pos[i]];
+                }
+
+                std::fill(ws.traces.begin(), ws.traces.end(), 0.0);
+                if (sum != 0)
+                    hafnian::powtrace(B2, sum, m, ws.traces.data(), ws, hafnian::labudde);
+
+                hafnian::loop_hafnian_factors(B, sum, sum, m, ws.C1.data(), ws.D1.data(), ws.tmp.data(),
+                                              ws.traces.data(), ws.factors.data());
+                h1 += hafnian::hafnian_summand(ws.factors.data(), n, sum, ws.comb.data());
+            }
+        });
+        double t2 = timeit([&]() {
+            for (unsigned long long int x : xs)
+                h2 += hafnian::loop_hafnian_term(mat, C, D, n, x, ws, hafnian::labudde);
+        });
+
+        std::cout << std::setw(5) << n << std::setw(15) << t1 << std::setw(15) << t2
+                  << std::setw(15) << t1 / t2 << std::setw(15) << std::abs(h1 - h2) / std::abs(h1) << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+
+/**
+ * The original recursive hafnian kernel: both children are OpenMP tasks at
+ * every level, and every call allocates and copies the polynomials of its
+ * children.
+ */
+template <typename T>
+T copying_recursive_chunk(std::vector<T> b, int s, int w, std::vector<T> g, int n) {
+    if (s == 0)
+        return static_cast<T>(w) * g[n];
+
+    std::vector<T> c((s - 2) * (s - 3) / 2 * (n + 1), static_cast<T>(0));
+    T h1, h2;
+    int u, v, j, k, i = 0;
+
+    for (j = 1; j < s - 2; j++) {
+        for (k = 0; k < j; k++) {
+            for (u = 0; u < n + 1; u++)
+                c[(n + 1) * i + u] = b[(n + 1) * ((j + 1) * (j + 2) / 2 + k + 2) + u];
+            i += 1;
+        }
+    }
+
+    #pragma omp task shared(h1)
+    h1 = copying_recursive_chunk(c, s - 2, -w, g, n);
+
+    std::vector<T> e(g);
+
+    for (u = 0; u < n; u++) {
+        for (v = 0; v < n - u; v++) {
+            e[u + v + 1] += g[u] * b[v];
+
+            for (j = 1; j < s - 2; j++) {
+                for (k = 0; k < j; k++) {
+                    c[(n + 1) * (j * (j - 1) / 2 + k) + u + v + 1] +=
+                        b[(n + 1) * ((j + 1) * (j + 2) / 2) + u] * b[(n + 1) * ((k + 1) * (k + 2) / 2 + 1) + v]
+                        + b[(n + 1) * (k + 1) * (k + 2) / 2 + u] * b[(n + 1) * ((j + 1) * (j + 2) / 2 + 1) + v];
+                }
+            }
+        }
+    }
+
+    #pragma omp task shared(h2)
+    h2 = copying_recursive_chunk(c, s - 2, w, e, n);
+
+    #pragma omp taskwait
+    return h1 + h2;
+}
+
+
+/**
+ * Returns the hafnian of `mat` using copying_recursive_chunk().
+ */
+template <typename T>
+T copying_hafnian_recursive(std::vector<T> &mat) {
+    int n = std::sqrt(static_cast<double>(mat.size())) / 2;
+    std::vector<T> z(n * (2 * n - 1) * (n + 1), static_cast<T>(0));
+    std::vector<T> g(n + 1, static_cast<T>(0));
+    g[0] = 1;
+
+    for (int j = 1; j < 2 * n; j++) {
+        for (int k = 0; k < j; k++)
+            z[(n + 1) * (j * (j - 1) / 2 + k)] = mat[2 * j * n + k];
+    }
+
+    T result;
+    #pragma omp parallel
+    #pragma omp single nowait
+    result = copying_recursive_chunk(z, 2 * n, 1, g, n);
+    return result;
+}
+
+
+/**
+ * Compares the throughput, in leaves of the recursion per second, and the
+ * peak heap usage of the recursive hafnian with per-level workspaces and
+ * of the original kernel, which copies its polynomials at every call.
+ */
+void bench_recursive(int nmax) {
+    std::cout << "recursive: copying vs preallocated recursion" << std::endl;
+    std::cout << std::setw(5) << "Size" << std::setw(15) << "Leaves/s(copy)" << std::setw(15) << "Peak MB(copy)"
+              << std::setw(15) << "Leaves/s(ws)" << std::setw(15) << "Peak MB(ws)" << std::setw(15) << "RelDiff" << std::endl;
+
+    for (int n = 8; n <= nmax; n += 4) {
+        std::vector<std::complex<double>> mat = random_symmetric(n, n);
+        std::complex<double> h1, h2;
+        double leaves = std::ldexp(1.0, n / 2);
+
+        peak_bytes = live_bytes;
+        std::size_t base = live_bytes;
+        double t1 = timeit([&]() { h1 = copying_hafnian_recursive(mat); });
+        double m1 = (peak_bytes - base) / 1048576.0;
+
+        peak_bytes = live_bytes;
+        base = live_bytes;
+        double t2 = timeit([&]() { h2 = hafnian::hafnian_recursive(mat); });
+        double m2 = (peak_bytes - base) / 1048576.0;
+
+        std::cout << std::setw(5) << n << std::setw(15) << leaves / t1 << std::setw(15) << m1
+                  << std::setw(15) << leaves / t2 << std::setw(15) << m2
+                  << std::setw(15) << std::abs(h1 - h2) / std::abs(h1) << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+
+/**
+ * Compares the recursive hafnian parallelised with OpenMP tasks at every
+ * level (the previous kernel), run sequentially (cutoff depth zero), and
+ * split into subtrees at the cutoff depth chosen from the number of
+ * threads, for the moderate sizes 24 to 40 where the task overhead matters.
+ */
+void bench_cutoff(int) {
+#ifdef _OPENMP
+    int nthreads = omp_get_max_threads();
+#else
+    int nthreads = 1;
+#endif
+
+    std::cout << "cutoff: recursive hafnian with tasks at every level vs subtrees below a cutoff, "
+              << nthreads << " threads" << std::endl;
+    std::cout << std::setw(5) << "Size" << std::setw(15) << "Time(tasks)" << std::setw(15) << "Time(serial)"
+              << std::setw(15) << "Time(cutoff)" << std::setw(8) << "Depth" << std::setw(15) << "Speedup" << std::endl;
+
+    for (int n = 24; n <= 40; n += 4) {
+        std::vector<std::complex<double>> mat = random_symmetric(n, n);
+        std::complex<double> h;
+
+        double t1 = timeit([&]() { h = copying_hafnian_recursive(mat); });
+        double t2 = timeit([&]() { h = hafnian::hafnian_recursive(mat, 0); });
+        double t3 = timeit([&]() { h = hafnian::hafnian_recursive(mat); });
+
+        std::cout << std::setw(5) << n << std::setw(15) << t1 << std::setw(15) << t2 << std::setw(15) << t3
+                  << std::setw(8) << hafnian::recursive_cutoff(n / 2, nthreads) << std::setw(15) << t2 / t3 << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+
+/**
+ * Compares the recursive hafnian in double, complex double and
+ * double-double precision with the scalar, AVX2 and AVX-512 truncated
+ * polynomial products, for the instruction sets supported by the processor.
+ */
+void bench_simd(int nmax) {
+    hafnian::simd_level detected = hafnian::detect_simd();
+    const char *names[] = {"scalar", "avx2", "avx512"};
+
+    std::cout << "simd: truncated polynomial products in the recursive hafnian" << std::endl;
+    std::cout << std::setw(5) << "Size" << std::setw(10) << "Kernel" << std::setw(15) << "Time(real)"
+              << std::setw(15) << "Time(complex)" << std::setw(15) << "Time(dd)" << std::endl;
+
+    for (int n = 16; n <= nmax + 8; n += 8) {
+        std::vector<std::complex<double>> mat = random_symmetric(n, n);
+        std::vector<double> matr(n * n);
+        for (int i = 0; i < n * n; i++)
+            matr[i] = std::real(mat[i]);
+        std::vector<hafnian::double_double> matdd(matr.begin(), matr.end());
+
+        for (int level = hafnian::simd_none; level <= detected; level++) {
+            hafnian::simd_support() = static_cast<hafnian::simd_level>(level);
+
+            double t1 = timeit([&]() { hafnian::hafnian_recursive(matr); });
+            double t2 = timeit([&]() { hafnian::hafnian_recursive(mat); });
+            double t3 = timeit([&]() { hafnian::hafnian_recursive(matdd); });
+
+            std::cout << std::setw(5) << n << std::setw(10) << names[level] << std::setw(15) << t1
+                      << std::setw(15) << t2 << std::setw(15) << t3 << std::endl;
+        }
+    }
+
+    hafnian::simd_support() = detected;
+    std::cout << std::endl;
+}
+
+
+/**
+ * Compares the repeated hafnian of many photon number patterns of the same
+ * matrix computed one at a time and in a single batch.
+ */
+void bench_rpt_batch(int nmax) {
+    std::cout << "rpt_batch: repeated hafnians of many repetition vectors" << std::endl;
+    std::cout << std::setw(5) << "Modes" << std::setw(10) << "Vectors" << std::setw(15) << "Time(single)"
+              << std::setw(15) << "Time(batch)" << std::setw(15) << "Speedup" << std::endl;
+
+    std::default_random_engine generator(1);
+    std::poisson_distribution<int> photons(1.5);
+
+    for (int n = 4; n <= std::min(nmax, 12); n += 4) {
+        std::vector<std::complex<double>> matd = random_symmetric(n, n);
+        std::vector<std::complex<long double>> mat(matd.begin(), matd.end());
+        std::vector<std::vector<int>> rpts(1000, std::vector<int>(n));
+
+        for (auto &rpt : rpts) {
+            int s = 0;
+            for (auto &r : rpt) {
+                r = photons(generator);
+                s += r;
+            }
+            if (s % 2 == 1)
+                rpt[0] += 1;
+        }
+
+        double t1 = timeit([&]() {
+            for (auto &rpt : rpts)
+                hafnian::hafnian_rpt(mat, rpt);
+        });
+        double t2 = timeit([&]() { hafnian::hafnian_rpt_batch(mat, rpts); });
+
+        std::cout << std::setw(5) << n << std::setw(10) << rpts.size() << std::setw(15) << t1
+                  << std::setw(15) << t2 << std::setw(15) << t1 / t2 << std::endl;
+    }
+    std::cout << std::endl;
+}
+
+
+int main(int argc, char *argv[]) {
+    std::string name = (argc > 1) ? argv[1] : "all";
+    int nmax = (argc > 2) ? std::atoi(argv[2]) : 24;
+
+    if (name == "all" || name == "powtrace")
+        bench_powtrace(nmax);
+
+    if (name == "all" || name == "schedule")
+        bench_schedule(nmax);
+
+    if (name == "all" || name == "gray")
+        bench_gray(nmax);
+
+    if (name == "all" || name == "lowrank")
+        bench_lowrank(nmax);
+
+    if (name == "all" || name == "sparse")
+        bench_sparse(nmax);
+
+    if (name == "all" || name == "precision")
+        bench_precision(nmax);
+
+    if (name == "all" || name == "loop")
+        bench_loop(nmax);
+
+    if (name == "all" || name == "loopterm")
+        bench_loopterm(nmax);
+
+    if (name == "all" || name == "recursive")
+        bench_recursive(nmax);
+
+    if (name == "all" || name == "cutoff")
+        bench_cutoff(nmax);
+
+    if (name == "all" || name == "simd")
+        bench_simd(nmax);
+
+    if (name == "all" || name == "rpt_batch")
+        bench_rpt_batch(nmax);
+
+    return 0;
+};
@@ -0,0 +1,332 @@
+// Copyright 2019 Xanadu Quantum Technologies Inc.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+/**
+ * @file
+ * Checkpointed versions of the exact hafnian, loop hafnian, Torontonian
+ * and permanent, for long running computations that may be interrupted.
+ *
+ * The terms are split into blocks, which are computed in turn. The partial
+ * sum of every completed block is appended to a checkpoint file, and calling
+ * the same function again with the same checkpoint file resumes the
+ * computation, skipping the blocks that were already completed. The
+ * functions of the main interface are unaffected, and perform no
+ * checkpointing.
+ */
+#pragma once
+#include <stdafx.h>
+#include <shard.hpp>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <limits>
+
+namespace hafnian {
+
+/**
+ * Returns a 64 bit FNV-1a hash of the entries of matrix `mat`, used to
+ * check that a checkpoint file belongs to the same matrix.
+ *
+ * @param mat vector representing the flattened matrix
+ * @return the hash of the matrix
+ */
+template <typename T>
+inline unsigned long long int matrix_fingerprint(std::vector<T> &mat) {
+    unsigned long long int hash = 14695981039346656037ULL;
+
+    for (auto &x : mat) {
+        double parts[2] = {static_cast<double>(std::real(x)), static_cast<double>(std::imag(x))};
+        unsigned char bytes[sizeof(parts)];
+        std::memcpy(bytes, parts, sizeof(parts));
+
+        for (unsigned char b : bytes) {
+            hash ^= b;
+            hash *= 1099511628211ULL;
+        }
+    }
+
+    return hash;
+}
+
+
+/**
+ * Converts the real and imaginary parts read from a checkpoint file to a real number.
+ *
+ * @param re real part
+ * @param im imaginary part, ignored
+ * @param x on exit, the value
+ */
+template <typename T>
+inline void checkpoint_value(long double re, long double im, T &x) {
+    x = static_cast<T>(re);
+}
+
+
+/**
+ * Converts the real and imaginary parts read from a checkpoint file to a complex number.
+ *
+ * @param re real part
+ * @param im imaginary part
+ * @param x on exit, the value
+ */
+template <typename T>
+inline void checkpoint_value(long double re, long double im, std::complex<T> &x) {
+    x = std::complex<T>(static_cast<T>(re), static_cast<T>(im));
+}
+
+
+/**
+ * Returns the sum of the partial sums of `nblocks` blocks, using the
+ * checkpoint file `filename` to record the blocks that are completed.
+ *
+ * The file starts with the line `header` identifying the computation,
+ * followed by one line per completed block, containing the index of the
+ * block and the real and imaginary parts of its partial sum as hexadecimal
+ * floating point numbers. Each line is flushed as soon as its block is
+ * completed. If the file already exists, the blocks it records are not
+ * computed again; a final line that was only partially written when the
+ * computation was interrupted is discarded.
+ *
+ * The partial sums are combined in block order using compensated_sum(),
+ * so that the result does not depend on whether or where the computation
+ * was interrupted.
+ *
+ * @param filename path of the checkpoint file
+ * @param header line identifying the computation
+ * @param nblocks number of blocks
+ * @param block function returning the partial sum of the block with a given index
+ * @return the sum of all blocks, or NaN if the checkpoint file belongs to
+ *      a different computation or cannot be written
+ */
+template <typename T, typename F>
+inline T checkpointed_sum(const std::string &filename, const std::string &header, int nblocks, F block) {
+    T nan = static_cast<T>(std::numeric_limits<double>::quiet_NaN());
+    std::vector<T> partial(nblocks, static_cast<T>(0.0));
+    std::vector<char> done(nblocks, 0);
+    std::vector<std::string> completed;
+
+    std::ifstream in(filename);
+    std::string line;
+
+    if (in && std::getline(in, line) && !in.eof()) {
+        if (line != header)
+            return nan;
+
+        while (std::getline(in, line)) {
+            // an unterminated last line was being written when the computation stopped
+            if (in.eof())
+                break;
+
+            std::istringstream fields(line);
+            int k;
+            std::string re, im;
+
+            if (!(fields >> k >> re >> im) || k < 0 || k >= nblocks || done[k])
+                continue;
+
+            checkpoint_value(std::strtold(re.c_str(), nullptr), std::strtold(im.c_str(), nullptr), partial[k]);
+            done[k] = 1;
+            completed.push_back(line);
+        }
+    }
+    in.close();
+
+    // rewrite the completed blocks, so that new blocks are appended after a complete line
+    std::string tmpname = filename + ".tmp";
+    FILE *out = std::fopen(tmpname.c_str(), "w");
+
+    if (out == nullptr)
+        return nan;
+
+    std::fprintf(out, "%s\n", header.c_str());
+    for (auto &l : completed)
+        std::fprintf(out, "%s\n", l.c_str());
+
+    if (std::fclose(out) != 0 || std::rename(tmpname.c_str(), filename.c_str()) != 0)
+        return nan;
+
+    out = std::fopen(filename.c_str(), "a");
+
+    if (out == nullptr)
+        return nan;
+
+    for (int k = 0; k < nblocks; k++) {
+        if (done[k])
+            continue;
+
+        partial[k] = block(k);
+
+        std::fprintf(out, "%d %La %La\n", k, static_cast<long double>(std::real(partial[k])),
+                     static_cast<long double>(std::imag(partial[k])));
+        std::fflush(out);
+    }
+
+    std::fclose(out);
+
+    return compensated_sum(partial);
+}
+
+
+/**
+ * Returns the header line of the checkpoint file of a computation.
+ *
+ * @param algorithm name of the algorithm
+ * @param mat vector representing the flattened matrix
+ * @param nblocks number of blocks
+ * @param order order in which the subsets are visited
+ * @return the header line
+ */
+template <typename T>
+inline std::string checkpoint_header(const std::string &algorithm, std::vector<T> &mat, int nblocks,
+                                     subset_order order = binary_order) {
+    std::ostringstream header;
+    header << algorithm << " size=" << mat.size() << " blocks=" << nblocks
+           << " order=" << static_cast<int>(order) << " fingerprint=" << std::hex << matrix_fingerprint(mat);
+    return header.str();
+}
+
+
+/**
+ * Returns the hafnian of a matrix, computed as in hafnian() in `nblocks`
+ * blocks of equal estimated cost, and checkpointed in the file `filename`
+ * (see checkpointed_sum()). If the computation is interrupted, calling this
+ * function again with the same arguments resumes it.
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an \f$n\times n\f$
+ *       row-ordered symmetric matrix of even size.
+ * @param filename path of the checkpoint file
+ * @param nblocks number of blocks
+ * @param method algorithm used to compute the power traces
+ * @param order order in which the subsets are visited
+ * @return hafnian of the input matrix
+ */
+template <typename T>
+inline T hafnian_checkpoint(std::vector<T> &mat, const std::string &filename, int nblocks = 256,
+                            powtrace_algorithm method = eigensolver, subset_order order = binary_order) {
+    int n = std::sqrt(static_cast<double>(mat.size()));
+    assert(n % 2 == 0);
+
+    std::vector<unsigned long long int> bounds = balanced_bounds(0, 1ULL << (n / 2), n / 2, nblocks, order == gray_order);
+
+    return checkpointed_sum<T>(filename, checkpoint_header("hafnian", mat, nblocks, order), nblocks, [&](int k) {
+        return do_chunk(mat, n, bounds[k], bounds[k + 1] - bounds[k], method, order);
+    });
+}
+
+
+/**
+ * Returns the loop hafnian of a matrix, computed as in loop_hafnian() in
+ * `nblocks` blocks of equal estimated cost, and checkpointed in the file
+ * `filename` (see checkpointed_sum()). If the computation is interrupted,
+ * calling this function again with the same arguments resumes it.
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an \f$n\times n\f$
+ *       row-ordered symmetric matrix of even size.
+ * @param filename path of the checkpoint file
+ * @param nblocks number of blocks
+ * @param method algorithm used to compute the power traces
+ * @param order order in which the subsets are visited
+ * @return loop hafnian of the input matrix
+ */
+template <typename T>
+inline T loop_hafnian_checkpoint(std::vector<T> &mat, const std::string &filename, int nblocks = 256,
+                                 powtrace_algorithm method = eigensolver, subset_order order = binary_order) {
+    int n = std::sqrt(static_cast<double>(mat.size()));
+    assert(n % 2 == 0);
+
+    std::vector<T> D(n, 0.0), C(n, 0.0);
+    loop_diagonals(mat, n, C, D);
+
+    std::vector<unsigned long long int> bounds = balanced_bounds(0, 1ULL << (n / 2), n / 2, nblocks, order == gray_order);
+
+    return checkpointed_sum<T>(filename, checkpoint_header("loop_hafnian", mat, nblocks, order), nblocks, [&](int k) {
+        return do_chunk_loops(mat, C, D, n, bounds[k], bounds[k + 1] - bounds[k], method, order);
+    });
+}
+
+
+/**
+ * Returns the hafnian of a matrix, computed as in hafnian_recursive() in
+ * `nblocks` blocks of equal length, and checkpointed in the file `filename`
+ * (see checkpointed_sum()). If the computation is interrupted, calling this
+ * function again with the same arguments resumes it.
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an \f$n\times n\f$
+ *       row-ordered symmetric matrix of even size.
+ * @param filename path of the checkpoint file
+ * @param nblocks number of blocks
+ * @return hafnian of the input matrix
+ */
+template <typename T>
+inline T hafnian_recursive_checkpoint(std::vector<T> &mat, const std::string &filename, int nblocks = 256) {
+    int n = std::sqrt(static_cast<double>(mat.size()));
+    assert(n % 2 == 0);
+
+    return checkpointed_sum<T>(filename, checkpoint_header("hafnian_recursive", mat, nblocks), nblocks, [&](int k) {
+        unsigned long long int X, chunksize;
+        shard_range(k, nblocks, 1ULL << (n / 2), X, chunksize);
+        return do_chunk_recursive(mat, n, X, chunksize);
+    });
+}
+
+
+/**
+ * Returns the Torontonian of a matrix, computed as in torontonian() in
+ * `nblocks` blocks of equal estimated cost, and checkpointed in the file
+ * `filename` (see checkpointed_sum()). If the computation is interrupted,
+ * calling this function again with the same arguments resumes it.
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an \f$n\times n\f$
+ *       row-ordered symmetric matrix.
+ * @param filename path of the checkpoint file
+ * @param nblocks number of blocks
+ * @return Torontonian of the input matrix
+ */
+template <typename T>
+inline T torontonian_checkpoint(std::vector<T> &mat, const std::string &filename, int nblocks = 256) {
+    int n = std::sqrt(static_cast<double>(mat.size()));
+
+    std::vector<unsigned long long int> bounds = balanced_bounds(0, 1ULL << (n / 2), n / 2, nblocks);
+
+    return checkpointed_sum<T>(filename, checkpoint_header("torontonian", mat, nblocks), nblocks, [&](int k) {
+        return torontonian_chunk(mat, n, bounds[k], bounds[k + 1] - bounds[k]);
+    });
+}
+
+
+/**
+ * Returns the permanent of a matrix, computed as in permanent() in
+ * `nblocks` blocks of equal length, and checkpointed in the file
+ * `filename` (see checkpointed_sum()). If the computation is interrupted,
+ * calling this function again with the same arguments resumes it.
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an \f$n\times n\f$
+ *       row-ordered matrix.
+ * @param filename path of the checkpoint file
+ * @param nblocks number of blocks
+ * @return permanent of the input matrix
+ */
+template <typename T>
+inline T permanent_checkpoint(std::vector<T> &mat, const std::string &filename, int nblocks = 256) {
+    int n = std::sqrt(static_cast<double>(mat.size()));
+
+    return checkpointed_sum<T>(filename, checkpoint_header("permanent", mat, nblocks), nblocks, [&](int k) {
+        unsigned long long int X, chunksize;
+        shard_range(k, nblocks, (1ULL << n) - 1, X, chunksize);
+        return permanent_chunk(mat, n, static_cast<llint>(X), static_cast<llint>(chunksize));
+    });
+}
+
+}
@@ -0,0 +1,283 @@
+// Copyright 2019 Xanadu Quantum Technologies Inc.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+/**
+ * @file
+ * Factorises the hafnian and loop hafnian of a matrix over the connected
+ * components of the graph defined by its nonzero entries.
+ *
+ * Every perfect matching of a graph is the union of perfect matchings of its
+ * connected components, so the hafnian of a matrix whose rows and columns
+ * can be permuted into block diagonal form is the product of the hafnians
+ * of the blocks. This replaces a single sum over \f$2^{n/2}\f$ terms by
+ * several much smaller ones.
+ *
+ * Similarly, the hafnian of a matrix of the form
+ * \f$\begin{bmatrix} 0 & B\\ B^T & 0 \end{bmatrix}\f$, up to a permutation,
+ * is the permanent of \f$B\f$, which is cheaper to compute using Ryser's formula.
+ */
+#pragma once
+#include <stdafx.h>
+
+namespace hafnian {
+
+/**
+ * Returns the connected components of the graph whose edges are the
+ * nonzero off-diagonal entries of the matrix `mat`.
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an \f$n\times n\f$
+ *       row-ordered matrix.
+ * @param n size of the matrix
+ * @return the components, each given by its vertices in increasing order
+ */
+template <typename T>
+inline std::vector<std::vector<int>> connected_components(std::vector<T> &mat, int n) {
+    std::vector<int> label(n, -1);
+    std::vector<std::vector<int>> components;
+    std::vector<int> stack;
+
+    for (int root = 0; root < n; root++) {
+        if (label[root] != -1)
+            continue;
+
+        int c = components.size();
+        components.push_back(std::vector<int>());
+        label[root] = c;
+        stack.push_back(root);
+
+        while (!stack.empty()) {
+            int i = stack.back();
+            stack.pop_back();
+            components[c].push_back(i);
+
+            for (int j = 0; j < n; j++) {
+                if (label[j] == -1 && (mat[i * n + j] != static_cast<T>(0.0) || mat[j * n + i] != static_cast<T>(0.0))) {
+                    label[j] = c;
+                    stack.push_back(j);
+                }
+            }
+        }
+
+        std::sort(components[c].begin(), components[c].end());
+    }
+
+    return components;
+}
+
+
+/**
+ * Returns the submatrix of `mat` with the rows and columns `idx`.
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an \f$n\times n\f$
+ *       row-ordered matrix.
+ * @param n size of the matrix
+ * @param idx rows and columns to keep
+ * @return the flattened submatrix
+ */
+template <typename T>
+inline std::vector<T> submatrix(std::vector<T> &mat, int n, const std::vector<int> &idx) {
+    int k = idx.size();
+    std::vector<T> sub(k * k);
+
+    for (int i = 0; i < k; i++) {
+        for (int j = 0; j < k; j++) {
+            sub[i * k + j] = mat[idx[i] * n + idx[j]];
+        }
+    }
+
+    return sub;
+}
+
+
+/**
+ * Returns the submatrix of `mat` with the rows `rows` and the columns `cols`.
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an \f$n\times n\f$
+ *       row-ordered matrix.
+ * @param n size of the matrix
+ * @param rows rows to keep
+ * @param cols columns to keep
+ * @return the flattened submatrix, of size `rows.size()` by `cols.size()`
+ */
+template <typename T>
+inline std::vector<T> submatrix(std::vector<T> &mat, int n, const std::vector<int> &rows, const std::vector<int> &cols) {
+    int r = rows.size();
+    int c = cols.size();
+    std::vector<T> sub(r * c);
+
+    for (int i = 0; i < r; i++) {
+        for (int j = 0; j < c; j++) {
+            sub[i * c + j] = mat[rows[i] * n + cols[j]];
+        }
+    }
+
+    return sub;
+}
+
+
+/**
+ * Splits the vertices of the graph whose edges are the nonzero off-diagonal
+ * entries of the matrix `mat` into two sets, such that every edge joins a
+ * vertex of each set, if the graph is bipartite.
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an \f$n\times n\f$
+ *       row-ordered matrix.
+ * @param n size of the matrix
+ * @param left on exit, the vertices of the first set in increasing order
+ * @param right on exit, the vertices of the second set in increasing order
+ * @return whether the graph is bipartite
+ */
+template <typename T>
+inline bool bipartition(std::vector<T> &mat, int n, std::vector<int> &left, std::vector<int> &right) {
+    std::vector<int> colour(n, -1);
+    std::vector<int> stack;
+
+    for (int root = 0; root < n; root++) {
+        if (colour[root] != -1)
+            continue;
+
+        colour[root] = 0;
+        stack.push_back(root);
+
+        while (!stack.empty()) {
+            int i = stack.back();
+            stack.pop_back();
+
+            for (int j = 0; j < n; j++) {
+                if (j == i || (mat[i * n + j] == static_cast<T>(0.0) && mat[j * n + i] == static_cast<T>(0.0)))
+                    continue;
+
+                if (colour[j] == -1) {
+                    colour[j] = 1 - colour[i];
+                    stack.push_back(j);
+                }
+                else if (colour[j] == colour[i]) {
+                    return false;
+                }
+            }
+        }
+    }
+
+    left.clear();
+    right.clear();
+
+    for (int i = 0; i < n; i++) {
+        if (colour[i] == 0)
+            left.push_back(i);
+        else
+            right.push_back(i);
+    }
+
+    return true;
+}
+
+
+/**
+ * Returns the hafnian of the matrix `mat`. If the graph defined by its
+ * nonzero off-diagonal entries is bipartite (see bipartition()), this is the
+ * permanent of the block of `mat` joining the two sets of vertices, computed
+ * by the function `perm`; it vanishes if the sets have different sizes.
+ * Otherwise, the hafnian is computed by the function `haf`.
+ *
+ * The diagonal entries of `mat` do not contribute to the hafnian, and are ignored.
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an \f$n\times n\f$
+ *       row-ordered symmetric matrix of even size.
+ * @param haf function returning the hafnian of a matrix
+ * @param perm function returning the permanent of a matrix
+ * @return hafnian of the input matrix
+ */
+template <typename T, typename F, typename G>
+inline T bipartite_hafnian(std::vector<T> &mat, F haf, G perm) {
+    int n = std::sqrt(static_cast<double>(mat.size()));
+    std::vector<int> left, right;
+
+    if (!bipartition(mat, n, left, right))
+        return haf(mat);
+
+    if (left.size() != right.size())
+        return static_cast<T>(0.0);
+
+    std::vector<T> block = submatrix(mat, n, left, right);
+    return perm(block);
+}
+
+
+/**
+ * Returns the hafnian of the matrix `mat` as the product of the hafnians of
+ * its connected components (see connected_components()), each computed by
+ * the function `haf`. If any component has an odd number of vertices,
+ * the hafnian vanishes and no hafnian is computed.
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an \f$n\times n\f$
+ *       row-ordered symmetric matrix.
+ * @param haf function returning the hafnian of a matrix of even size
+ * @return hafnian of the input matrix
+ */
+template <typename T, typename F>
+inline T factorised_hafnian(std::vector<T> &mat, F haf) {
+    int n = std::sqrt(static_cast<double>(mat.size()));
+    std::vector<std::vector<int>> components = connected_components(mat, n);
+
+    for (auto &c : components) {
+        if (c.size() % 2 != 0)
+            return static_cast<T>(0.0);
+    }
+
+    if (components.size() == 1)
+        return haf(mat);
+
+    T result = static_cast<T>(1.0);
+
+    for (auto &c : components) {
+        std::vector<T> sub = submatrix(mat, n, c);
+        result *= haf(sub);
+    }
+
+    return result;
+}
+
+
+/**
+ * Returns the loop hafnian of the matrix `mat` as the product of the loop
+ * hafnians of its connected components (see connected_components()), each
+ * computed by the function `lhaf`. Unlike the hafnian, components with an
+ * odd number of vertices may be matched using the loops on the diagonal.
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an \f$n\times n\f$
+ *       row-ordered symmetric matrix.
+ * @param lhaf function returning the loop hafnian of a matrix of any size
+ * @return loop hafnian of the input matrix
+ */
+template <typename T, typename F>
+inline T factorised_loop_hafnian(std::vector<T> &mat, F lhaf) {
+    int n = std::sqrt(static_cast<double>(mat.size()));
+    std::vector<std::vector<int>> components = connected_components(mat, n);
+
+    if (components.size() == 1)
+        return lhaf(mat);
+
+    T result = static_cast<T>(1.0);
+
+    for (auto &c : components) {
+        std::vector<T> sub = submatrix(mat, n, c);
+        result *= lhaf(sub);
+
+        if (result == static_cast<T>(0.0))
+            break;
+    }
+
+    return result;
+}
+
+}
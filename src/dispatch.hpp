@@ -0,0 +1,499 @@
+// Copyright 2019 Xanadu Quantum Technologies Inc.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+/**
+ * @file
+ * Chooses the algorithm used to compute the hafnian or loop hafnian of a
+ * matrix with repeated rows and columns, by estimating the time each
+ * applicable algorithm would take on this host.
+ *
+ * The time of each algorithm is modelled as a number of operations, which
+ * depends on the size of the matrix, its repetitions, and the rank and the
+ * width of the path decomposition of its graph, multiplied by a number of
+ * seconds per operation. These constants are measured once per process, by
+ * timing every algorithm on a small input (see measure_dispatch_calibration()).
+ */
+#pragma once
+#include <stdafx.h>
+#include <limits>
+#include <random>
+#include <eigenvalue_hafnian.hpp>
+#include <recursive_hafnian.hpp>
+#include <repeated_hafnian.hpp>
+#include <lowrank_hafnian.hpp>
+#include <sparse_hafnian.hpp>
+
+namespace hafnian {
+
+/**
+ * Algorithms that can be chosen by hafnian_dispatch().
+ */
+enum dispatch_algorithm {
+    /// the result is 0 or 1, and nothing needs to be computed
+    trivial_algorithm,
+    /// hafnian() or loop_hafnian(), in double precision
+    eigen_algorithm,
+    /// hafnian_recursive() or loop_hafnian_recursive(), in extended precision
+    recursive_algorithm,
+    /// hafnian_rpt() or loop_hafnian_rpt(), in extended precision
+    repeated_algorithm,
+    /// hafnian_lowrank(), in extended precision
+    lowrank_algorithm,
+    /// hafnian_sparse(), in extended precision
+    sparse_algorithm,
+    /// number of algorithms
+    num_dispatch_algorithms
+};
+
+
+/**
+ * Precision requested from hafnian_dispatch().
+ */
+enum dispatch_precision {
+    /// any algorithm may be chosen
+    double_precision,
+    /// only algorithms evaluated in extended (long double) precision may be chosen
+    extended_precision
+};
+
+
+/**
+ * Returns the name of a dispatched algorithm, for logging.
+ *
+ * @param algorithm the algorithm
+ * @return the name of the algorithm
+ */
+inline const char *dispatch_name(dispatch_algorithm algorithm) {
+    switch (algorithm) {
+    case trivial_algorithm:
+        return "trivial";
+    case eigen_algorithm:
+        return "eigen";
+    case recursive_algorithm:
+        return "recursive";
+    case repeated_algorithm:
+        return "repeated";
+    case lowrank_algorithm:
+        return "lowrank";
+    case sparse_algorithm:
+        return "sparse";
+    default:
+        return "unknown";
+    }
+}
+
+
+/**
+ * Seconds per modelled operation of each algorithm on this host.
+ */
+struct dispatch_calibration {
+    double eigen;
+    double loop_eigen;
+    double recursive;
+    double repeated;
+    double loop_repeated;
+    double lowrank;
+    double sparse;
+};
+
+
+/**
+ * The algorithm chosen by hafnian_dispatch(), and the quantities the choice was based on.
+ */
+struct dispatch_decision {
+    /// the chosen algorithm
+    dispatch_algorithm algorithm;
+    /// estimated time of the chosen algorithm, in seconds
+    double estimated_time;
+    /// estimated time of every algorithm, in seconds, or infinity if it is not applicable
+    std::vector<double> estimated_times;
+    /// size of the matrix after expanding the repeated rows and columns
+    int size;
+    /// numerical rank of the matrix, or -1 if it was not computed
+    int rank;
+    /// width of the path decomposition of its graph, or -1 if it was not computed
+    int width;
+    /// whether the real and imaginary parts of all entries are integers
+    bool integral;
+};
+
+
+/**
+ * Returns whether the real and imaginary parts of all entries of `mat` are integers.
+ *
+ * @param mat vector representing the flattened matrix
+ * @return whether the matrix is integral
+ */
+template <typename T>
+inline bool is_integral(std::vector<T> &mat) {
+    for (auto &x : mat) {
+        double re = static_cast<double>(std::real(x));
+        double im = static_cast<double>(std::imag(x));
+
+        if (re != std::round(re) || im != std::round(im))
+            return false;
+    }
+
+    return true;
+}
+
+
+/**
+ * Returns the matrix obtained by repeating every row and column `i` of `mat`
+ * `rpt[i]` times. The diagonal entries are repeated as well, so that the
+ * diagonal of the result contains the loops of the loop hafnian.
+ *
+ * @param mat a flattened vector of size \f$N^2\f$, representing an
+ *      \f$N\times N\f$ row-ordered symmetric matrix.
+ * @param rpt a vector of \f$N\f$ integers, representing the number of
+ *      times each row/column in `mat` is repeated.
+ * @return the flattened matrix of size \f$n=\sum_i \text{rpt}_i\f$
+ */
+template <typename T>
+inline std::vector<T> expand_repeated(std::vector<T> &mat, std::vector<int> &rpt) {
+    int N = rpt.size();
+    std::vector<int> rows;
+
+    for (int i = 0; i < N; i++) {
+        for (int k = 0; k < rpt[i]; k++)
+            rows.push_back(i);
+    }
+
+    int n = rows.size();
+    std::vector<T> big(n * n);
+
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            big[i * n + j] = mat[rows[i] * N + rows[j]];
+        }
+    }
+
+    return big;
+}
+
+
+/**
+ * Returns the number of seconds per modelled operation of each algorithm,
+ * measured by timing every algorithm on a small random input.
+ *
+ * @return the measured constants
+ */
+inline dispatch_calibration measure_dispatch_calibration() {
+    std::default_random_engine generator(20);
+    std::normal_distribution<double> distribution(0.0, 1.0);
+
+    auto random_matrix = [&](int n) {
+        std::vector<double> mat(n * n);
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j <= i; j++) {
+                mat[i * n + j] = mat[j * n + i] = distribution(generator) / std::sqrt(static_cast<double>(n));
+            }
+        }
+        return mat;
+    };
+
+    auto seconds = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    // the smallest time that is considered, to avoid dividing by a zero duration
+    const double eps = 1e-12;
+    dispatch_calibration c;
+
+    std::vector<double> mat = random_matrix(20);
+    auto start = std::chrono::steady_clock::now();
+    hafnian(mat);
+    c.eigen = std::max(seconds(start), eps) / (std::pow(2.0, 10) * std::pow(11.0, 3));
+
+    start = std::chrono::steady_clock::now();
+    loop_hafnian(mat);
+    c.loop_eigen = std::max(seconds(start), eps) / (std::pow(2.0, 10) * std::pow(11.0, 3));
+
+    std::vector<long double> matq(mat.begin(), mat.end());
+    start = std::chrono::steady_clock::now();
+    hafnian_recursive(matq);
+    c.recursive = std::max(seconds(start), eps) / (std::pow(2.0, 10) * std::pow(11.0, 2));
+
+    std::vector<double> small = random_matrix(5);
+    std::vector<long double> smallq(small.begin(), small.end());
+    std::vector<long double> mu(5, 0.5);
+    std::vector<int> rpt(5, 9);
+    double steps = std::pow(10.0, 5) / 2;
+
+    start = std::chrono::steady_clock::now();
+    hafnian_rpt(smallq, rpt);
+    c.repeated = std::max(seconds(start), eps) / (steps * 6);
+
+    start = std::chrono::steady_clock::now();
+    loop_hafnian_rpt(smallq, mu, rpt);
+    c.loop_repeated = std::max(seconds(start), eps) / (steps * (5 + 45));
+
+    std::vector<long double> V(24 * 3), M(9);
+    for (auto &v : V)
+        v = distribution(generator);
+    for (int k = 0; k < 3; k++) {
+        for (int l = 0; l <= k; l++)
+            M[k * 3 + l] = M[l * 3 + k] = distribution(generator);
+    }
+    start = std::chrono::steady_clock::now();
+    hafnian_lowrank(V, M, 24, 3);
+    c.lowrank = std::max(seconds(start), eps) / lowrank_cost(24, 3);
+
+    // a 10 x 10 grid has a path decomposition of width 11
+    int L = 10, n = L * L;
+    std::vector<long double> grid(n * n, 0.0);
+    for (int v = 0; v < n; v++) {
+        if ((v + 1) % L != 0)
+            grid[v * n + v + 1] = grid[(v + 1) * n + v] = 1.0;
+        if (v + L < n)
+            grid[v * n + v + L] = grid[(v + L) * n + v] = 1.0;
+    }
+    start = std::chrono::steady_clock::now();
+    hafnian_sparse(grid);
+    c.sparse = std::max(seconds(start), eps) / (n * 12 * std::pow(2.0, 11));
+
+    return c;
+}
+
+
+/**
+ * Returns the constants used by hafnian_dispatch(). They are measured by
+ * measure_dispatch_calibration() the first time this function is called,
+ * and may be overwritten by the caller.
+ *
+ * @return reference to the constants
+ */
+inline dispatch_calibration &dispatch_constants() {
+    static dispatch_calibration constants = measure_dispatch_calibration();
+    return constants;
+}
+
+
+/**
+ * Chooses the algorithm with the smallest estimated time for computing
+ * the hafnian or loop hafnian of the matrix `mat` with its rows and
+ * columns repeated `rpt` times.
+ *
+ * For integral matrices, the algorithms that only add and multiply
+ * entries (hafnian_recursive(), loop_hafnian_recursive() and hafnian_sparse()) are preferred if they
+ * are applicable, since they are exact in extended precision as long as
+ * the partial sums do not exceed \f$2^{64}\f$.
+ *
+ * @param mat a flattened vector of size \f$N^2\f$, representing an
+ *      \f$N\times N\f$ row-ordered symmetric matrix. For the loop hafnian,
+ *      the diagonal contains the loops.
+ * @param rpt a vector of \f$N\f$ integers, representing the number of
+ *      times each row/column in `mat` is repeated.
+ * @param loop whether the loop hafnian is computed
+ * @param precision the requested precision
+ * @return the chosen algorithm, with its estimated time
+ */
+template <typename T>
+inline dispatch_decision hafnian_dispatch(std::vector<T> &mat, std::vector<int> &rpt, bool loop = false,
+                                          dispatch_precision precision = double_precision) {
+    const double inf = std::numeric_limits<double>::infinity();
+    // matrices expanded beyond this size are only handled by the repeated hafnian
+    const int max_expanded = 512;
+
+    int N = rpt.size();
+    int n = std::accumulate(rpt.begin(), rpt.end(), 0);
+
+    dispatch_decision d;
+    d.algorithm = trivial_algorithm;
+    d.estimated_time = 0.0;
+    d.estimated_times.assign(num_dispatch_algorithms, inf);
+    d.size = n;
+    d.rank = -1;
+    d.width = -1;
+    d.integral = is_integral(mat);
+
+    if (n == 0 || (!loop && n % 2 != 0)) {
+        d.estimated_times[trivial_algorithm] = 0.0;
+        return d;
+    }
+
+    dispatch_calibration &c = dispatch_constants();
+    std::vector<double> &t = d.estimated_times;
+    double m = std::ceil(0.5 * n);
+
+    double steps = 0.5;
+    for (auto r : rpt)
+        steps *= r + 1;
+
+    t[repeated_algorithm] = loop ? c.loop_repeated * steps * (N + n) : c.repeated * steps * (N + 1);
+
+    if (n <= max_expanded) {
+        if (precision == double_precision)
+            t[eigen_algorithm] = (loop ? c.loop_eigen : c.eigen) * std::pow(2.0, m) * std::pow(m + 1, 3);
+
+        t[recursive_algorithm] = c.recursive * std::pow(2.0, m) * std::pow(m + 1, 2);
+
+        if (!loop) {
+            // the rank of the expanded matrix is that of the rows and columns that are repeated
+            std::vector<int> idx;
+            for (int i = 0; i < N; i++) {
+                if (rpt[i] > 0)
+                    idx.push_back(i);
+            }
+            std::vector<T> sub(idx.size() * idx.size());
+            for (std::size_t i = 0; i < idx.size(); i++) {
+                for (std::size_t j = 0; j < idx.size(); j++)
+                    sub[i * idx.size() + j] = mat[idx[i] * N + idx[j]];
+            }
+            std::vector<T> V, M;
+            d.rank = lowrank_factors(sub, idx.size(), 1e-12, V, M);
+
+            if (d.rank < n && (d.rank - 1) * std::log2(n + 1.0) <= 26)
+                t[lowrank_algorithm] = c.lowrank * lowrank_cost(n, d.rank);
+
+            std::vector<T> big = expand_repeated(mat, rpt);
+            std::vector<std::vector<int>> adj = sparse_neighbours(big, n);
+            d.width = sparse_width(adj, sparse_ordering(adj));
+
+            if (d.width <= 24)
+                t[sparse_algorithm] = c.sparse * n * (d.width + 1) * std::pow(2.0, d.width);
+        }
+    }
+
+    if (d.integral && (t[recursive_algorithm] < inf || t[sparse_algorithm] < inf)) {
+        t[eigen_algorithm] = inf;
+        t[repeated_algorithm] = inf;
+        t[lowrank_algorithm] = inf;
+    }
+
+    d.algorithm = repeated_algorithm;
+    for (int a = eigen_algorithm; a < num_dispatch_algorithms; a++) {
+        if (t[a] < t[d.algorithm])
+            d.algorithm = static_cast<dispatch_algorithm>(a);
+    }
+    d.estimated_time = t[d.algorithm];
+
+    return d;
+}
+
+
+/**
+ * Returns the hafnian or loop hafnian of the matrix `mat` with its rows
+ * and columns repeated `rpt` times, computed using the algorithm chosen by
+ * hafnian_dispatch(). The algorithms evaluated in extended precision are
+ * evaluated with entries of type `Q`.
+ *
+ * @param d the chosen algorithm
+ * @param mat a flattened vector of size \f$N^2\f$, representing an
+ *      \f$N\times N\f$ row-ordered symmetric matrix. For the loop hafnian,
+ *      the diagonal contains the loops.
+ * @param rpt a vector of \f$N\f$ integers, representing the number of
+ *      times each row/column in `mat` is repeated.
+ * @param loop whether the loop hafnian is computed
+ * @return the hafnian or loop hafnian
+ */
+template <typename T, typename Q>
+inline T hafnian_dispatched(const dispatch_decision &d, std::vector<T> &mat, std::vector<int> &rpt, bool loop) {
+    int N = rpt.size();
+
+    if (d.algorithm == trivial_algorithm)
+        return static_cast<T>(d.size == 0 ? 1.0 : 0.0);
+
+    if (d.algorithm == repeated_algorithm) {
+        std::vector<Q> matq(mat.begin(), mat.end());
+
+        if (!loop)
+            return static_cast<T>(hafnian_rpt(matq, rpt));
+
+        std::vector<Q> mu(N);
+        for (int i = 0; i < N; i++)
+            mu[i] = matq[i * N + i];
+
+        return static_cast<T>(loop_hafnian_rpt(matq, mu, rpt));
+    }
+
+    std::vector<T> big = expand_repeated(mat, rpt);
+
+    if (d.algorithm == eigen_algorithm)
+        return loop ? loop_hafnian_padded(big) : hafnian(big);
+
+    std::vector<Q> bigq(big.begin(), big.end());
+
+    if (d.algorithm == recursive_algorithm)
+        return static_cast<T>(loop ? loop_hafnian_recursive(bigq) : hafnian_recursive(bigq));
+
+    if (d.algorithm == lowrank_algorithm)
+        return static_cast<T>(hafnian_lowrank(bigq));
+
+    return static_cast<T>(hafnian_sparse(bigq));
+}
+
+
+/**
+ * Returns the hafnian or loop hafnian of a matrix with repeated rows and
+ * columns, using the algorithm with the smallest estimated time on this
+ * host (see hafnian_dispatch()).
+ *
+ * This is a wrapper around the templated functions `hafnian::hafnian_dispatch` and
+ * `hafnian::hafnian_dispatched` for Python integration. It accepts and returns complex
+ * double numeric types; algorithms evaluated in extended precision use the
+ * type `complex<long double>`.
+ *
+ * @param mat a flattened vector of size \f$N^2\f$, representing an
+ *      \f$N\times N\f$ row-ordered symmetric matrix. For the loop hafnian,
+ *      the diagonal contains the loops.
+ * @param rpt a vector of \f$N\f$ integers, representing the number of
+ *      times each row/column in `mat` is repeated.
+ * @param loop whether the loop hafnian is computed
+ * @param precision the requested precision
+ * @param decision if not null, the chosen algorithm is stored here
+ * @return the hafnian or loop hafnian
+ */
+std::complex<double> hafnian_auto(std::vector<std::complex<double>> &mat, std::vector<int> &rpt, bool loop = false,
+                                  dispatch_precision precision = double_precision,
+                                  dispatch_decision *decision = nullptr) {
+    dispatch_decision d = hafnian_dispatch(mat, rpt, loop, precision);
+
+    if (decision != nullptr)
+        *decision = d;
+
+    return hafnian_dispatched<std::complex<double>, std::complex<long double>>(d, mat, rpt, loop);
+}
+
+
+/**
+ * Returns the hafnian or loop hafnian of a matrix with repeated rows and
+ * columns, using the algorithm with the smallest estimated time on this
+ * host (see hafnian_dispatch()).
+ *
+ * This is a wrapper around the templated functions `hafnian::hafnian_dispatch` and
+ * `hafnian::hafnian_dispatched` for Python integration. It accepts and returns
+ * double numeric types; algorithms evaluated in extended precision use the
+ * type `long double`.
+ *
+ * @param mat a flattened vector of size \f$N^2\f$, representing an
+ *      \f$N\times N\f$ row-ordered symmetric matrix. For the loop hafnian,
+ *      the diagonal contains the loops.
+ * @param rpt a vector of \f$N\f$ integers, representing the number of
+ *      times each row/column in `mat` is repeated.
+ * @param loop whether the loop hafnian is computed
+ * @param precision the requested precision
+ * @param decision if not null, the chosen algorithm is stored here
+ * @return the hafnian or loop hafnian
+ */
+double hafnian_auto(std::vector<double> &mat, std::vector<int> &rpt, bool loop = false,
+                    dispatch_precision precision = double_precision, dispatch_decision *decision = nullptr) {
+    dispatch_decision d = hafnian_dispatch(mat, rpt, loop, precision);
+
+    if (decision != nullptr)
+        *decision = d;
+
+    return hafnian_dispatched<double, long double>(d, mat, rpt, loop);
+}
+
+}
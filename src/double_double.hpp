@@ -0,0 +1,267 @@
+// Copyright 2019 Xanadu Quantum Technologies Inc.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+/**
+ * @file
+ * Contains a double-double floating point type, representing a number as
+ * the unevaluated sum of two doubles.
+ *
+ * A double-double has a 106-bit mantissa, more than the 64 bits of the x87
+ * `long double` and close to the 113 bits of `__float128`, but is computed
+ * with a handful of ordinary double precision operations per arithmetic
+ * operation. Unlike `__float128`, which is emulated in software, it is
+ * therefore only a few times slower than `double`, and loops over
+ * double-doubles can be vectorized by the compiler.
+ *
+ * The templated kernels accept `double_double` and
+ * `std::complex<double_double>` wherever they accept `long double`. The
+ * error-free transformations used below rely on IEEE rounding of every
+ * operation, and are invalidated by `-ffast-math`.
+ *
+ * The algorithms are those of the QD library,
+ * *Library for double-double and quad-double arithmetic*
+ * (Hida, Li and Bailey, 2007).
+ */
+#pragma once
+#include <stdafx.h>
+#include <limits>
+#include <Eigen/Core>
+
+namespace hafnian {
+
+/**
+ * Returns \f$s=\text{fl}(a+b)\f$ and its rounding error \f$e=a+b-s\f$.
+ */
+inline double two_sum(double a, double b, double &e) {
+    double s = a + b;
+    double bb = s - a;
+    e = (a - (s - bb)) + (b - bb);
+    return s;
+}
+
+/**
+ * Returns \f$s=\text{fl}(a+b)\f$ and its rounding error, assuming \f$|a|\geq|b|\f$.
+ */
+inline double quick_two_sum(double a, double b, double &e) {
+    double s = a + b;
+    e = b - (s - a);
+    return s;
+}
+
+/**
+ * Returns \f$p=\text{fl}(ab)\f$ and its rounding error \f$e=ab-p\f$.
+ */
+inline double two_prod(double a, double b, double &e) {
+    double p = a * b;
+#ifdef FP_FAST_FMA
+    e = std::fma(a, b, -p);
+#else
+    // Dekker's algorithm, splitting each factor into two 26-bit halves
+    const double split = 134217729.0;
+    double t = split * a;
+    double ahi = t - (t - a), alo = a - ahi;
+    t = split * b;
+    double bhi = t - (t - b), blo = b - bhi;
+    e = ((ahi * bhi - p) + ahi * blo + alo * bhi) + alo * blo;
+#endif
+    return p;
+}
+
+/**
+ * Double-double floating point number, the unevaluated sum \f$hi+lo\f$
+ * of two doubles with \f$|lo|\leq\frac{1}{2}\text{ulp}(hi)\f$.
+ */
+struct double_double {
+    /// leading part
+    double hi;
+    /// trailing part
+    double lo;
+
+    double_double() : hi(0.0), lo(0.0) {}
+    double_double(double x) : hi(x), lo(0.0) {}
+    double_double(int x) : hi(x), lo(0.0) {}
+    double_double(long double x) : hi(static_cast<double>(x)), lo(static_cast<double>(x - static_cast<long double>(hi))) {}
+    double_double(double h, double l) : hi(h), lo(l) {}
+
+    explicit operator double() const { return hi + lo; }
+    explicit operator long double() const { return static_cast<long double>(hi) + lo; }
+
+    double_double operator-() const { return double_double(-hi, -lo); }
+
+    double_double &operator+=(const double_double &b) {
+        double s2, t1, t2;
+        double s1 = two_sum(hi, b.hi, s2);
+        t1 = two_sum(lo, b.lo, t2);
+        s2 += t1;
+        s1 = quick_two_sum(s1, s2, s2);
+        s2 += t2;
+        hi = quick_two_sum(s1, s2, lo);
+        return *this;
+    }
+
+    double_double &operator-=(const double_double &b) { return *this += -b; }
+
+    double_double &operator*=(const double_double &b) {
+        double p2;
+        double p1 = two_prod(hi, b.hi, p2);
+        p2 += hi * b.lo + lo * b.hi;
+        hi = quick_two_sum(p1, p2, lo);
+        return *this;
+    }
+
+    double_double &operator/=(const double_double &b) {
+        double_double r = *this;
+        double q1 = hi / b.hi;
+        r -= double_double(q1) * b;
+        double q2 = r.hi / b.hi;
+        r -= double_double(q2) * b;
+        double q3 = r.hi / b.hi;
+
+        double e;
+        q1 = quick_two_sum(q1, q2, e);
+        *this = double_double(q1, e) + double_double(q3);
+        return *this;
+    }
+
+    friend double_double operator+(double_double a, const double_double &b) { return a += b; }
+    friend double_double operator-(double_double a, const double_double &b) { return a -= b; }
+    friend double_double operator*(double_double a, const double_double &b) { return a *= b; }
+    friend double_double operator/(double_double a, const double_double &b) { return a /= b; }
+
+    friend bool operator==(const double_double &a, const double_double &b) { return a.hi == b.hi && a.lo == b.lo; }
+    friend bool operator!=(const double_double &a, const double_double &b) { return !(a == b); }
+    friend bool operator<(const double_double &a, const double_double &b) {
+        return a.hi < b.hi || (a.hi == b.hi && a.lo < b.lo);
+    }
+    friend bool operator>(const double_double &a, const double_double &b) { return b < a; }
+    friend bool operator<=(const double_double &a, const double_double &b) { return !(b < a); }
+    friend bool operator>=(const double_double &a, const double_double &b) { return !(a < b); }
+
+    // the functions below are only found by argument-dependent lookup, so that
+    // they do not hide the standard functions for the built-in types
+
+    /// Returns the absolute value of a double-double.
+    friend double_double abs(const double_double &a) { return a.hi < 0 ? -a : a; }
+
+    /// Returns the square root of a double-double, by one Newton step from
+    /// the double precision square root.
+    friend double_double sqrt(const double_double &a) {
+        if (a.hi <= 0)
+            return double_double(std::sqrt(a.hi));
+
+        double x = std::sqrt(a.hi);
+        double e;
+        double p = two_prod(x, x, e);
+        double_double r = a - double_double(p, e);
+        return double_double(x) + double_double(r.hi / (2 * x));
+    }
+
+    /// Returns \f$a^k\f$ for an integer \f$k\f$, by repeated squaring.
+    friend double_double pow(double_double a, int k) {
+        double_double r = 1;
+        bool invert = k < 0;
+        unsigned int e = invert ? 0u - static_cast<unsigned int>(k) : static_cast<unsigned int>(k);
+
+        while (e > 0) {
+            if (e & 1)
+                r *= a;
+            a *= a;
+            e >>= 1;
+        }
+
+        return invert ? double_double(1) / r : r;
+    }
+
+    /// Returns \f$z^k\f$ for a complex double-double and an integer \f$k\geq 0\f$.
+    friend std::complex<double_double> pow(std::complex<double_double> z, int k) {
+        std::complex<double_double> r = double_double(1);
+
+        while (k > 0) {
+            if (k & 1)
+                r *= z;
+            z *= z;
+            k >>= 1;
+        }
+
+        return r;
+    }
+
+    friend bool isfinite(const double_double &a) { return std::isfinite(a.hi); }
+    friend bool isnan(const double_double &a) { return std::isnan(a.hi); }
+    friend bool isinf(const double_double &a) { return std::isinf(a.hi); }
+};
+
+/**
+ * The real type of the scalar coefficients that multiply entries of type
+ * `T` in the kernels: `long double` for the built-in types, so that the
+ * coefficients are at least as accurate as the entries, and `double_double`
+ * for double-doubles.
+ */
+template <typename T>
+struct coefficient {
+    typedef long double type;
+};
+
+template <>
+struct coefficient<double_double> {
+    typedef double_double type;
+};
+
+template <>
+struct coefficient<std::complex<double_double>> {
+    typedef double_double type;
+};
+
+/**
+ * Converts a complex double-double to a complex double.
+ */
+inline std::complex<double> to_complex_double(const std::complex<double_double> &z) {
+    return std::complex<double>(static_cast<double>(z.real()), static_cast<double>(z.imag()));
+}
+
+}
+
+namespace Eigen {
+
+/**
+ * Allows Eigen matrices, and their decompositions, of double-doubles.
+ */
+template <>
+struct NumTraits<hafnian::double_double> : GenericNumTraits<hafnian::double_double> {
+    typedef hafnian::double_double Real;
+    typedef hafnian::double_double NonInteger;
+    typedef hafnian::double_double Nested;
+    typedef hafnian::double_double Literal;
+
+    enum {
+        IsComplex = 0,
+        IsInteger = 0,
+        IsSigned = 1,
+        RequireInitialization = 1,
+        ReadCost = 2,
+        AddCost = 20,
+        MulCost = 10
+    };
+
+    static inline Real epsilon() { return std::ldexp(1.0, -104); }
+    static inline Real dummy_precision() { return 1e-28; }
+    static inline Real highest() { return std::numeric_limits<double>::max(); }
+    static inline Real lowest() { return -std::numeric_limits<double>::max(); }
+    static inline int digits10() { return 31; }
+    static inline int digits() { return 106; }
+    static inline int max_digits10() { return 33; }
+    static inline Real infinity() { return std::numeric_limits<double>::infinity(); }
+    static inline Real quiet_NaN() { return std::numeric_limits<double>::quiet_NaN(); }
+};
+
+}
@@ -19,20 +19,318 @@
  */
 #pragma once
 #include <stdafx.h>
+#include <workspace.hpp>
+#include <components.hpp>
+#include <lowrank_hafnian.hpp>
+#include <sparse_hafnian.hpp>
+#include <permanent.hpp>
 
-#ifdef LAPACKE
-#define EIGEN_SUPERLU_SUPPORT
-#define EIGEN_USE_BLAS
-#define EIGEN_USE_LAPACKE
+namespace hafnian {
 
-#define LAPACK_COMPLEX_CUSTOM
-#define lapack_complex_float std::complex<float>
-#define lapack_complex_double std::complex<double>
-#endif
+/**
+ * Returns the complex conjugate of a real number, i.e., the number itself.
+ *
+ * @param x a real number
+ * @return the number `x`
+ */
+template <typename T>
+inline T conjugate(const T &x) {
+    return x;
+}
 
-#include <Eigen/Eigenvalues>
+/**
+ * Returns the complex conjugate of a complex number.
+ *
+ * @param x a complex number
+ * @return the complex conjugate of `x`
+ */
+template <typename T>
+inline std::complex<T> conjugate(const std::complex<T> &x) {
+    return std::conj(x);
+}
 
-namespace hafnian {
+/**
+ * Stores the real part of a complex number in a real variable.
+ *
+ * @param z a complex number
+ * @param out the real part of `z`
+ */
+template <typename T>
+inline void cast_complex(const std::complex<T> &z, T &out) {
+    out = std::real(z);
+}
+
+/**
+ * Stores a complex number in a complex variable.
+ *
+ * @param z a complex number
+ * @param out the number `z`
+ */
+template <typename T>
+inline void cast_complex(const std::complex<T> &z, std::complex<T> &out) {
+    out = z;
+}
+
+/**
+ * Reduces a matrix \f$z\f$ of dimensions \f$n\times n\f$ in place to upper
+ * Hessenberg form using Householder reflections. The resulting matrix is
+ * unitarily similar to \f$z\f$; entries below the first subdiagonal
+ * are left unspecified.
+ *
+ * @param z a flattened vector of size \f$n^2\f$, representing an
+ *       \f$n\times n\f$ row-ordered matrix. It is overwritten with
+ *       its Hessenberg form.
+ * @param n size of the matrix `z`.
+ * @param v scratch array of length at least \f$n\f$.
+ */
+template <typename T>
+inline void hessenberg(T *z, int n, T *v) {
+    typedef typename Eigen::NumTraits<T>::Real real_t;
+    int i, j, k;
+
+    for (k = 0; k < n - 2; k++) {
+        int len = n - k - 1;
+        real_t alpha = 0.0;
+
+        for (i = 0; i < len; i++) {
+            alpha += std::norm(z[(k + 1 + i) * n + k]);
+        }
+
+        if (alpha == 0.0) {
+            continue;
+        }
+
+        alpha = std::sqrt(alpha);
+        T x0 = z[(k + 1) * n + k];
+        real_t absx0 = std::abs(x0);
+        T phase = (absx0 == 0.0) ? static_cast<T>(1.0) : x0 / absx0;
+        real_t beta = 1.0 / (alpha * (alpha + absx0));
+
+        v[0] = x0 + phase * alpha;
+        for (i = 1; i < len; i++) {
+            v[i] = z[(k + 1 + i) * n + k];
+        }
+
+        // apply the reflection I - beta v v^H from the left
+        for (j = k; j < n; j++) {
+            T s = 0.0;
+            for (i = 0; i < len; i++) {
+                s += conjugate(v[i]) * z[(k + 1 + i) * n + j];
+            }
+            s *= beta;
+            for (i = 0; i < len; i++) {
+                z[(k + 1 + i) * n + j] -= v[i] * s;
+            }
+        }
+
+        // apply the reflection I - beta v v^H from the right
+        for (i = 0; i < n; i++) {
+            T s = 0.0;
+            for (j = 0; j < len; j++) {
+                s += z[i * n + k + 1 + j] * v[j];
+            }
+            s *= beta;
+            for (j = 0; j < len; j++) {
+                z[i * n + k + 1 + j] -= s * conjugate(v[j]);
+            }
+        }
+    }
+}
+
+/**
+ * Given an upper Hessenberg matrix \f$h\f$ of dimensions \f$n\times n\f$,
+ * computes the characteristic polynomials of all of its leading principal
+ * submatrices using La Budde's recursion.
+ *
+ * On exit, `c[i * (n + 1) + k]` contains the coefficient of \f$x^k\f$
+ * in the (monic) characteristic polynomial of the leading \f$i\times i\f$
+ * submatrix; the characteristic polynomial of \f$h\f$ itself is
+ * therefore stored in `c + n * (n + 1)`.
+ *
+ * @param h a flattened vector of size \f$n^2\f$, representing an
+ *       \f$n\times n\f$ row-ordered upper Hessenberg matrix.
+ * @param n size of the matrix `h`.
+ * @param c array of length at least \f$(n+1)^2\f$.
+ */
+template <typename T>
+inline void charpoly_labudde(const T *h, int n, T *c) {
+    int i, k, r;
+    int ld = n + 1;
+
+    std::fill(c, c + ld * ld, static_cast<T>(0.0));
+    c[0] = 1.0;
+
+    for (i = 1; i <= n; i++) {
+        T hii = h[(i - 1) * n + (i - 1)];
+
+        for (k = 0; k < i; k++) {
+            c[i * ld + k + 1] += c[(i - 1) * ld + k];
+            c[i * ld + k] -= hii * c[(i - 1) * ld + k];
+        }
+
+        T prod = 1.0;
+        for (r = 1; r < i; r++) {
+            prod *= h[(i - r) * n + (i - r - 1)];
+            T coeff = h[(i - r - 1) * n + (i - 1)] * prod;
+
+            for (k = 0; k <= i - r - 1; k++) {
+                c[i * ld + k] -= coeff * c[(i - r - 1) * ld + k];
+            }
+        }
+    }
+}
+
+/**
+ * Given the coefficients of the monic characteristic polynomial of a matrix
+ * \f$z\f$ of dimensions \f$n\times n\f$, calculates
+ * \f$Tr(z^j)~\forall~1\leq j\leq l\f$ using Newton's identities.
+ *
+ * @param a array of length \f$n+1\f$ where `a[k]` is the coefficient of
+ *       \f$x^k\f$ in the characteristic polynomial.
+ * @param n size of the matrix.
+ * @param l maximum matrix power when calculating the power trace.
+ * @param traces array of length at least \f$l\f$ in which the power traces
+ *       are stored.
+ */
+template <typename T>
+inline void powtrace_from_charpoly(const T *a, int n, int l, T *traces) {
+    for (int k = 1; k <= l; k++) {
+        T sum = (k <= n) ? static_cast<T>(k) * a[n - k] : static_cast<T>(0.0);
+
+        for (int i = 1; i < k && i <= n; i++) {
+            sum += a[n - i] * traces[k - i - 1];
+        }
+
+        traces[k - 1] = -sum;
+    }
+}
+
+/**
+ * Given a matrix \f$z\f$ of dimensions \f$n\times n\f$, it calculates
+ * \f$Tr(z^j)~\forall~1\leq j\leq l\f$ via a Hessenberg reduction followed by
+ * La Budde's characteristic polynomial recursion and Newton's identities.
+ *
+ * Unlike powtrace(), this requires a fixed \f$O(n^3)\f$ number of operations
+ * and performs no heap allocations.
+ *
+ * @param z a flattened vector of size \f$n^2\f$, representing an
+ *       \f$n\times n\f$ row-ordered matrix. It is overwritten.
+ * @param n size of the matrix `z`.
+ * @param l maximum matrix power when calculating the power trace.
+ * @param traces array of length at least \f$l\f$ in which the power traces
+ *       are stored.
+ * @param scratch scratch array of length at least \f$n + (n+1)^2\f$.
+ */
+template <typename T>
+inline void powtrace_labudde(T *z, int n, int l, T *traces, T *scratch) {
+    T *c = scratch + n;
+
+    hessenberg(z, n, scratch);
+    charpoly_labudde(z, n, c);
+    powtrace_from_charpoly(c + n * (n + 1), n, l, traces);
+}
+
+/**
+ * Given a matrix \f$z\f$ of dimensions \f$n\times n\f$, it calculates
+ * \f$Tr(z^j)~\forall~1\leq j\leq l\f$ via a Hessenberg reduction followed by
+ * La Budde's characteristic polynomial recursion and Newton's identities.
+ *
+ * @param z a flattened vector of size \f$n^2\f$, representing an
+ *       \f$n\times n\f$ row-ordered matrix.
+ * @param n size of the matrix `z`.
+ * @param l maximum matrix power when calculating the power trace.
+ * @return a vector containing the power traces of matrix `z` to power
+ *       \f$1\leq j \leq l\f$.
+ */
+template <typename T>
+inline std::vector<T> powtrace_labudde(std::vector<T> &z, int n, int l) {
+    std::vector<T> h(z.begin(), z.begin() + n * n);
+    std::vector<T> traces(l, 0.0);
+    std::vector<T> scratch(n + (n + 1) * (n + 1), 0.0);
+
+    powtrace_labudde(h.data(), n, l, traces.data(), scratch.data());
+
+    return traces;
+}
+
+/**
+ * Given the coefficients of the monic characteristic polynomial \f$p\f$ of a
+ * matrix \f$z\f$ of dimensions \f$n\times n\f$, and those of the characteristic
+ * polynomial \f$e\f$ of the bordered matrix
+ * \f$\begin{pmatrix}0 & c^T\\ d & z\end{pmatrix}\f$, calculates
+ * \f$c^T z^j d~\forall~0\leq j< l\f$.
+ *
+ * Since \f$e(x) = x p(x) - c^T\text{adj}(x-z)d\f$, these are the coefficients
+ * of the expansion of \f$(x p(x) - e(x))/p(x)\f$ in powers of \f$1/x\f$.
+ *
+ * @param a array of length \f$n+1\f$ where `a[k]` is the coefficient of
+ *       \f$x^k\f$ in \f$p\f$.
+ * @param e array of length \f$n+2\f$ where `e[k]` is the coefficient of
+ *       \f$x^k\f$ in \f$e\f$.
+ * @param n size of the matrix.
+ * @param l number of powers to calculate.
+ * @param loops array of length at least \f$l\f$ in which \f$c^T z^j d\f$
+ *       is stored at index \f$j\f$.
+ */
+template <typename T>
+inline void loops_from_charpoly(const T *a, const T *e, int n, int l, T *loops) {
+    for (int k = 0; k < l; k++) {
+        T sum = 0.0;
+
+        if (k < n) {
+            int j = n - 1 - k;
+            sum = (j > 0) ? a[j - 1] - e[j] : -e[j];
+        }
+
+        for (int t = std::max(0, k - n); t < k; t++) {
+            sum -= a[n - k + t] * loops[t];
+        }
+
+        loops[k] = sum;
+    }
+}
+
+/**
+ * Given a matrix \f$z\f$ of dimensions \f$n\times n\f$ and two vectors
+ * \f$c,d\f$, calculates \f$Tr(z^j)~\forall~1\leq j\leq l\f$ and
+ * \f$c^T z^j d~\forall~0\leq j< l\f$ from a single Hessenberg reduction and
+ * La Budde recursion, without any matrix-vector products.
+ *
+ * The input is the bordered matrix \f$\begin{pmatrix}0 & c^T\\ d & z\end{pmatrix}\f$.
+ * Its Hessenberg reduction leaves the border in the first row and column, so
+ * after reversing the order of the rows and columns of its transpose, the
+ * characteristic polynomial of \f$z\f$ and that of the bordered matrix are
+ * the last two computed by charpoly_labudde().
+ *
+ * @param z a flattened vector of size \f$(n+1)^2\f$, representing the
+ *       \f$(n+1)\times (n+1)\f$ row-ordered bordered matrix. It is overwritten.
+ * @param n size of the matrix \f$z\f$ without its border.
+ * @param l maximum matrix power.
+ * @param traces array of length at least \f$l\f$ in which the power traces
+ *       are stored.
+ * @param loops array of length at least \f$l\f$ in which \f$c^T z^j d\f$
+ *       is stored at index \f$j\f$.
+ * @param scratch scratch array of length at least \f$n + 1 + (n+2)^2\f$.
+ */
+template <typename T>
+inline void loop_powtrace_labudde(T *z, int n, int l, T *traces, T *loops, T *scratch) {
+    int nb = n + 1;
+    T *c = scratch + nb;
+
+    hessenberg(z, nb, scratch);
+
+    // the flip along the anti-diagonal keeps the matrix upper Hessenberg,
+    // and moves the border to the last row and column
+    for (int i = 0; i < nb; i++) {
+        for (int j = 0; i + j < nb - 1; j++) {
+            std::swap(z[i * nb + j], z[(nb - 1 - j) * nb + (nb - 1 - i)]);
+        }
+    }
+
+    charpoly_labudde(z, nb, c);
+    powtrace_from_charpoly(c + n * (nb + 1), n, l, traces);
+    loops_from_charpoly(c + n * (nb + 1), c + nb * (nb + 1), n, l, loops);
+}
 
 /**
  * Given a complex matrix \f$z\f$ of dimensions \f$n\times n\f$, it calculates
@@ -120,204 +418,684 @@ inline vec_double powtrace(vec_double &z, int n, int l) {
 
 
 /**
- * Calculates the partial sum \f$X,X+1,\dots,X+\text{chunksize}\f$ using
- * the Cygan and Pilipczuk formula for the hafnian of matrix `mat`.
+ * Given a matrix \f$z\f$ of dimensions \f$n\times n\f$, it calculates
+ * \f$Tr(z^j)~\forall~1\leq j\leq l\f$ using the preallocated memory of
+ * the workspace `ws`, without performing any heap allocations.
  *
- * Note that if `X=0` and `chunksize=pow(2.0, n/2)`, then the full hafnian is calculated.
+ * @param z a flattened array of size \f$n^2\f$, representing an
+ *       \f$n\times n\f$ row-ordered matrix. It may be overwritten.
+ * @param n size of the matrix `z`. This must not exceed the size the workspace
+ *       was allocated for, and must be even if `method` is `eigensolver`.
+ * @param l maximum matrix power when calculating the power trace.
+ * @param traces array of length at least \f$l\f$ in which the power traces
+ *       are stored.
+ * @param ws workspace of the calling thread
+ * @param method algorithm used to compute the power traces
+ */
+template <typename T>
+inline void powtrace(T *z, int n, int l, T *traces, workspace<T> &ws, powtrace_algorithm method) {
+    typedef typename workspace<T>::matrix_t matrix_t;
+    typedef typename workspace<T>::real_t real_t;
+
+    if (method == labudde) {
+        powtrace_labudde(z, n, l, traces, ws.scratch.data());
+        return;
+    }
+
+    matrix_t &A = ws.matrices[n / 2];
+    A = Eigen::Map<matrix_t, Eigen::Unaligned>(z, n, n);
+
+    typename workspace<T>::solver_t &solver = ws.solvers[n / 2];
+    solver.compute(A, false);
+
+    std::complex<real_t> sum;
+    int i, j;
+
+    for (j = 0; j < n; j++) {
+        ws.eigvals[j] = solver.eigenvalues()(j);
+        ws.pvals[j] = ws.eigvals[j];
+    }
+
+    for (i = 0; i < l; i++) {
+        sum = 0.0;
+        for (j = 0; j < n; j++) {
+            sum += ws.pvals[j];
+        }
+        cast_complex(sum, traces[i]);
+        for (j = 0; j < n; j++) {
+            ws.pvals[j] = ws.pvals[j] * ws.eigvals[j];
+        }
+    }
+}
+
+
+/**
+ * Given the coefficients \f$f_i\f$, \f$1\leq i\leq n/2\f$, calculates the
+ * coefficient of \f$x^{n/2}\f$ in \f$\exp(\sum_i f_i x^i)\f$, which is the
+ * contribution of a single subset to the Cygan and Pilipczuk formula.
  *
- * This function uses OpenMP (if available) to parallelize the reduction.
+ * @param factors array of length \f$n/2\f$ containing the coefficients \f$f_i\f$
+ * @param n size of the matrix
+ * @param sum size of the submatrix corresponding to the subset
+ * @param comb scratch array of length at least \f$n+2\f$
+ * @return the signed summand of the subset
+ */
+template <typename T>
+inline T hafnian_summand(const T *factors, int n, Byte sum, T *comb) {
+    Byte m = n / 2;
+    int i, j, k;
+    T powfactor;
+
+    char cnt = 1;
+    Byte cntindex = 0;
+
+    std::fill(comb, comb + 2 * (m + 1), static_cast<T>(0.0));
+    comb[0] = 1.0;
+
+    for (i = 1; i <= n / 2; i++) {
+        powfactor = 1.0;
+
+        cnt = -cnt;
+        cntindex = (1 + cnt) / 2;
+        for (j = 0; j < n / 2 + 1; j++) {
+            comb[(m + 1) * (1 - cntindex) + j] = comb[(m + 1) * cntindex + j];
+        }
+        for (j = 1; j <= (n / (2 * i)); j++) {
+            powfactor = powfactor * factors[i - 1] / (1.0 * j);
+            for (k = i * j + 1; k <= n / 2 + 1; k++) {
+                comb[(m + 1) * (1 - cntindex) + k - 1] += comb[(m + 1) * cntindex + k - i * j - 1] * powfactor;
+            }
+        }
+    }
+
+    if (((sum / 2) % 2) == (n / 2 % 2)) {
+        return comb[(m + 1) * (1 - cntindex) + n / 2];
+    }
+    return -comb[(m + 1) * (1 - cntindex) + n / 2];
+}
+
+
+/**
+ * Calculates the term \f$x\f$ of the Cygan and Pilipczuk formula for the
+ * hafnian of matrix `mat`, using the preallocated memory of the workspace `ws`.
  *
  * @param mat vector representing the flattened matrix
  * @param n size of the matrix
- * @param X initial index of the partial sum
- * @param chunksize length of the partial sum
- * @return the partial sum for hafnian
+ * @param x index of the term, representing a subset of the rows of `mat`
+ * @param ws workspace of the calling thread
+ * @param method algorithm used to compute the power traces
+ * @return the term of the partial sum for hafnian
  */
 template <typename T>
-inline T do_chunk(std::vector<T> &mat, int n, unsigned long long int X, unsigned long long int chunksize) {
-    // This function calculates adds parts X to X+chunksize of Cygan and Pilipczuk formula for the
-    // Hafnian of matrix mat
+inline T hafnian_term(std::vector<T> &mat, int n, unsigned long long int x, workspace<T> &ws,
+                      powtrace_algorithm method = eigensolver) {
+    Byte m = n / 2;
+    int i, j;
 
-    T res = 0.0;
+    Byte *pos = ws.pos.data();
+    T *B = ws.B.data();
+    T *traces = ws.traces.data();
+    T *factors = ws.factors.data();
 
-    #pragma omp parallel for
-    for (unsigned long long int x = X; x < X + chunksize; x++) {
-        T summand = 0.0;
+    dec2bin(ws.dst.data(), x, m);
+    Byte sum = find2(ws.dst.data(), m, pos);
 
-        Byte m = n / 2;
-        int i, j, k;
-        T factor, powfactor;
+    for (i = 0; i < sum; i++) {
+        for (j = 0; j < sum; j++) {
+            B[i * sum + j] = mat[pos[i] * n + ((pos[j]) ^ 1)];
+        }
+    }
 
-        char* dst = new char[m];
-        Byte* pos = new Byte[n];
-        dec2bin(dst, x, m);
-        Byte sum = find2(dst, m, pos);
-        delete [] dst;
+    std::fill(traces, traces + m, static_cast<T>(0.0));
+    if (sum != 0) {
+        powtrace(B, sum, m, traces, ws, method);
+    }
 
-        std::vector<T> B(sum * sum, 0.0);
+    for (i = 1; i <= m; i++) {
+        factors[i - 1] = traces[i - 1] / (2.0 * i);
+    }
 
-        for (i = 0; i < sum; i++) {
-            for (j = 0; j < sum; j++) {
-                B[i * sum + j] = mat[pos[i] * n + ((pos[j]) ^ 1)];
+    return hafnian_summand(factors, n, sum, ws.comb.data());
+}
+
+
+/**
+ * Calculates the coefficients of the exponentiated polynomial of a term of
+ * the loop hafnian, given the power traces of its submatrix `B`.
+ *
+ * @param B flattened submatrix of size `sum`, stored with leading dimension `ld`
+ * @param ld leading dimension of `B`
+ * @param sum size of the submatrix
+ * @param m half of the size of the matrix
+ * @param C1 elements of ``C`` selected by the subset; overwritten on exit
+ * @param D1 elements of ``D`` selected by the subset
+ * @param tmp_c1 scratch vector of length `sum`
+ * @param traces power traces of the submatrix
+ * @param factors on exit, the \f$m\f$ coefficients of the polynomial
+ */
+template <typename T>
+inline void loop_hafnian_factors(const T *B, int ld, Byte sum, Byte m, T *C1, const T *D1, T *tmp_c1,
+                                 const T *traces, T *factors) {
+    int i, j, k;
+
+    for (i = 1; i <= m; i++) {
+        T tmpn = 0.0;
+
+        for (j = 0; j < sum; j++) {
+            tmpn += C1[j] * D1[j];
+        }
+
+        factors[i - 1] = traces[i - 1] / (2.0 * i) + 0.5 * tmpn;
+
+        for (j = 0; j < sum; j++) {
+            T tmp = 0.0;
+
+            for (k = 0; k < sum; k++) {
+                tmp += C1[k] * B[k * ld + j];
             }
+
+            tmp_c1[j] = tmp;
         }
-        delete [] pos;
 
-        std::vector<T> traces(m, 0.0);
-        if (sum != 0) {
-            traces = powtrace(B, sum, m);
+        for (j = 0; j < sum; j++) {
+            C1[j] = tmp_c1[j];
         }
+    }
+}
 
-        char cnt = 1;
-        Byte cntindex = 0;
 
-        std::vector<T> comb(2 * (m + 1), 0.0);
-        comb[0] = 1.0;
+/**
+ * Calculates the coefficients of the exponentiated polynomial of a term of
+ * the loop hafnian, given the bordered submatrix `B` expected by
+ * loop_powtrace_labudde(). The power traces and the loop corrections
+ * are all obtained from a single decomposition of `B`, and the coefficients
+ * are stored in `ws.factors`.
+ *
+ * @param B flattened bordered submatrix of size `sum + 1`; overwritten on exit
+ * @param sum size of the submatrix without its border
+ * @param m half of the size of the matrix
+ * @param ws workspace of the calling thread
+ */
+template <typename T>
+inline void loop_hafnian_factors_labudde(T *B, Byte sum, Byte m, workspace<T> &ws) {
+    T *traces = ws.traces.data();
+    T *loops = ws.tmp.data();
+    T *factors = ws.factors.data();
+
+    std::fill(traces, traces + m, static_cast<T>(0.0));
+    std::fill(loops, loops + m, static_cast<T>(0.0));
+    if (sum != 0) {
+        loop_powtrace_labudde(B, sum, m, traces, loops, ws.scratch.data());
+    }
+
+    for (int i = 1; i <= m; i++) {
+        factors[i - 1] = traces[i - 1] / (2.0 * i) + 0.5 * loops[i - 1];
+    }
+}
 
-        for (i = 1; i <= n / 2; i++) {
-            factor = traces[i - 1] / (2.0 * i);
-            powfactor = 1.0;
 
-            cnt = -cnt;
-            cntindex = (1 + cnt) / 2;
-            for (j = 0; j < n / 2 + 1; j++) {
-                comb[(m + 1) * (1 - cntindex) + j] = comb[(m + 1) * cntindex + j];
-            }
-            for (j = 1; j <= (n / (2 * i)); j++) {
-                powfactor = powfactor * factor / (1.0 * j);
-                for (k = i * j + 1; k <= n / 2 + 1; k++) {
-                    comb[(m + 1) * (1 - cntindex) + k - 1] += comb[(m + 1) * cntindex + k - i * j - 1] * powfactor;
-                }
+/**
+ * Calculates the term \f$x\f$ of the Cygan and Pilipczuk formula for the
+ * loop hafnian of matrix `mat`, using the preallocated memory of the workspace `ws`.
+ *
+ * With `method=labudde`, the power traces and the loop corrections are
+ * obtained from a single decomposition of the submatrix (see
+ * loop_powtrace_labudde()); otherwise the loop corrections require one
+ * matrix-vector product per power.
+ *
+ * @param mat vector representing the flattened matrix
+ * @param C contains the diagonal elements of matrix ``z``
+ * @param D the diagonal elements of matrix ``z``, with every consecutive pair
+ *      swapped (i.e., ``C[0]==D[1]``, ``C[1]==D[0]``, ``C[2]==D[3]``,
+ *      ``C[3]==D[2]``, etc.).
+ * @param n size of the matrix
+ * @param x index of the term, representing a subset of the rows of `mat`
+ * @param ws workspace of the calling thread
+ * @param method algorithm used to compute the power traces
+ * @return the term of the partial sum for the loop hafnian
+ */
+template <typename T>
+inline T loop_hafnian_term(std::vector<T> &mat, std::vector<T> &C, std::vector<T> &D, int n, unsigned long long int x,
+                           workspace<T> &ws, powtrace_algorithm method = eigensolver) {
+    Byte m = n / 2;
+    int i, j;
+
+    Byte *pos = ws.pos.data();
+    T *B = ws.B.data();
+    T *B_powtrace = ws.B2.data();
+    T *C1 = ws.C1.data();
+    T *D1 = ws.D1.data();
+    T *tmp_c1 = ws.tmp.data();
+    T *traces = ws.traces.data();
+    T *factors = ws.factors.data();
+
+    dec2bin(ws.dst.data(), x, m);
+    Byte sum = find2(ws.dst.data(), m, pos);
+
+    if (method == labudde) {
+        // gather the submatrix bordered by the selected elements of C and D
+        B_powtrace[0] = 0.0;
+        for (i = 0; i < sum; i++) {
+            B_powtrace[i + 1] = C[pos[i]];
+            B_powtrace[(i + 1) * (sum + 1)] = D[pos[i]];
+            for (j = 0; j < sum; j++) {
+                B_powtrace[(i + 1) * (sum + 1) + j + 1] = mat[pos[i] * n + ((pos[j]) ^ 1)];
             }
         }
-        if (((sum / 2) % 2) == (n / 2 % 2)) {
-            summand = comb[(m + 1) * (1 - cntindex) + n / 2];
-        }
-        else {
-            summand = -comb[(m + 1) * (1 - cntindex) + n / 2];
+
+        loop_hafnian_factors_labudde(B_powtrace, sum, m, ws);
+        return hafnian_summand(factors, n, sum, ws.comb.data());
+    }
+
+    for (i = 0; i < sum; i++) {
+        for (j = 0; j < sum; j++) {
+            B[i * sum + j] = mat[pos[i] * n + ((pos[j]) ^ 1)];
+            B_powtrace[i * sum + j] = mat[pos[i] * n + ((pos[j]) ^ 1)];
         }
-        #pragma omp critical
-        res += summand;
+        C1[i] = C[pos[i]];
+        D1[i] = D[pos[i]];
+    }
+
+    std::fill(traces, traces + m, static_cast<T>(0.0));
+    if (sum != 0) {
+        powtrace(B_powtrace, sum, m, traces, ws, method);
     }
 
-    return res;
+    loop_hafnian_factors(B, sum, sum, m, C1, D1, tmp_c1, traces, factors);
+
+    return hafnian_summand(factors, n, sum, ws.comb.data());
 }
 
+
 /**
- * Calculates the partial sum \f$X,X+1,\dots,X+\text{chunksize}\f$ using
- * the Cygan and Pilipczuk formula for the loop hafnian of matrix `mat`.
+ * Gathers the two rows and columns in slot `k` of the Gray order submatrix
+ * of the workspace `ws`. This submatrix is stored in `ws.B` with leading
+ * dimension `n`, the rows/columns \f$2k,2k+1\f$ holding the pair `ws.order[k]`.
  *
- * Note that if `X=0` and `chunksize=pow(2.0, n/2)`, then the full loop hafnian is calculated.
+ * @param mat vector representing the flattened matrix
+ * @param n size of the matrix
+ * @param k slot to gather
+ * @param ws workspace of the calling thread
+ */
+template <typename T>
+inline void gray_fill_slot(std::vector<T> &mat, int n, int k, workspace<T> &ws) {
+    Byte *pos = ws.pos.data();
+    T *B = ws.B.data();
+    int sum = 2 * ws.pairs;
+
+    for (int r = 2 * k; r < 2 * k + 2; r++) {
+        for (int i = 0; i < sum; i++) {
+            B[r * n + i] = mat[pos[r] * n + ((pos[i]) ^ 1)];
+            B[i * n + r] = mat[pos[i] * n + ((pos[r]) ^ 1)];
+        }
+    }
+}
+
+
+/**
+ * Adds the pair `p` of rows/columns to the Gray order submatrix of the
+ * workspace `ws` if it is absent, and removes it otherwise, in \f$O(\text{sum})\f$
+ * operations.
  *
- * This function uses OpenMP (if available) to parallelize the reduction.
+ * A removed pair is replaced by the pair in the last slot, so the submatrix
+ * differs from the one gathered by hafnian_term() by a simultaneous permutation
+ * of its rows and columns, which leaves its power traces unchanged.
+ *
+ * @param mat vector representing the flattened matrix
+ * @param n size of the matrix
+ * @param p pair to toggle
+ * @param ws workspace of the calling thread
+ */
+template <typename T>
+inline void gray_toggle(std::vector<T> &mat, int n, int p, workspace<T> &ws) {
+    Byte *pos = ws.pos.data();
+    int k = ws.slot[p];
+
+    if (k < 0) {
+        k = ws.pairs++;
+        ws.order[k] = p;
+        ws.slot[p] = k;
+        pos[2 * k] = 2 * p;
+        pos[2 * k + 1] = 2 * p + 1;
+        gray_fill_slot(mat, n, k, ws);
+        return;
+    }
+
+    int last = --ws.pairs;
+    ws.slot[p] = -1;
+
+    if (k != last) {
+        int q = ws.order[last];
+        ws.order[k] = q;
+        ws.slot[q] = k;
+        pos[2 * k] = pos[2 * last];
+        pos[2 * k + 1] = pos[2 * last + 1];
+        gray_fill_slot(mat, n, k, ws);
+    }
+}
+
+
+/**
+ * Moves the Gray order submatrix of the workspace `ws` to the subset
+ * visited at index \f$x\f$, i.e. the subset gray_code(x). If `x` directly
+ * follows the previous index, a single pair is toggled; otherwise the
+ * submatrix is gathered from scratch.
  *
  * @param mat vector representing the flattened matrix
+ * @param n size of the matrix
+ * @param x index of the subset
+ * @param next whether the previous index visited was \f$x-1\f$
+ * @param ws workspace of the calling thread
+ */
+template <typename T>
+inline void gray_seek(std::vector<T> &mat, int n, unsigned long long int x, bool next, workspace<T> &ws) {
+    int m = n / 2;
+
+    if (next) {
+        gray_toggle(mat, n, m - 1 - trailing_zeros(x), ws);
+        return;
+    }
+
+    unsigned long long int g = gray_code(x);
+    std::fill(ws.slot.begin(), ws.slot.end(), -1);
+    ws.pairs = 0;
+
+    // as in dec2bin(), the most significant bit corresponds to the first pair
+    for (int i = 0; i < m; i++) {
+        if ((g >> (m - 1 - i)) & 1ULL)
+            gray_toggle(mat, n, i, ws);
+    }
+}
+
+
+/**
+ * Calculates the term of the Cygan and Pilipczuk formula for the hafnian
+ * corresponding to the current Gray order submatrix of the workspace `ws`
+ * (see gray_seek()).
+ *
+ * @param n size of the matrix
+ * @param ws workspace of the calling thread
+ * @param method algorithm used to compute the power traces
+ * @return the term of the partial sum for hafnian
+ */
+template <typename T>
+inline T gray_hafnian_term(int n, workspace<T> &ws, powtrace_algorithm method = eigensolver) {
+    Byte m = n / 2;
+    Byte sum = 2 * ws.pairs;
+    int i, j;
+
+    T *B = ws.B.data();
+    T *B_powtrace = ws.B2.data();
+    T *traces = ws.traces.data();
+    T *factors = ws.factors.data();
+
+    // powtrace() overwrites its input, so operate on a compact copy
+    for (i = 0; i < sum; i++) {
+        for (j = 0; j < sum; j++) {
+            B_powtrace[i * sum + j] = B[i * n + j];
+        }
+    }
+
+    std::fill(traces, traces + m, static_cast<T>(0.0));
+    if (sum != 0) {
+        powtrace(B_powtrace, sum, m, traces, ws, method);
+    }
+
+    for (i = 1; i <= m; i++) {
+        factors[i - 1] = traces[i - 1] / (2.0 * i);
+    }
+
+    return hafnian_summand(factors, n, sum, ws.comb.data());
+}
+
+
+/**
+ * Calculates the term of the Cygan and Pilipczuk formula for the loop hafnian
+ * corresponding to the current Gray order submatrix of the workspace `ws`
+ * (see gray_seek()). As in loop_hafnian_term(), `method=labudde` obtains the
+ * power traces and the loop corrections from a single decomposition.
+ *
  * @param C contains the diagonal elements of matrix ``z``
  * @param D the diagonal elements of matrix ``z``, with every consecutive pair
  *      swapped (i.e., ``C[0]==D[1]``, ``C[1]==D[0]``, ``C[2]==D[3]``,
  *      ``C[3]==D[2]``, etc.).
  * @param n size of the matrix
+ * @param ws workspace of the calling thread
+ * @param method algorithm used to compute the power traces
+ * @return the term of the partial sum for the loop hafnian
+ */
+template <typename T>
+inline T gray_loop_hafnian_term(std::vector<T> &C, std::vector<T> &D, int n, workspace<T> &ws,
+                                powtrace_algorithm method = eigensolver) {
+    Byte m = n / 2;
+    Byte sum = 2 * ws.pairs;
+    int i, j;
+
+    Byte *pos = ws.pos.data();
+    T *B = ws.B.data();
+    T *B_powtrace = ws.B2.data();
+    T *C1 = ws.C1.data();
+    T *D1 = ws.D1.data();
+    T *traces = ws.traces.data();
+    T *factors = ws.factors.data();
+
+    if (method == labudde) {
+        B_powtrace[0] = 0.0;
+        for (i = 0; i < sum; i++) {
+            B_powtrace[i + 1] = C[pos[i]];
+            B_powtrace[(i + 1) * (sum + 1)] = D[pos[i]];
+            for (j = 0; j < sum; j++) {
+                B_powtrace[(i + 1) * (sum + 1) + j + 1] = B[i * n + j];
+            }
+        }
+
+        loop_hafnian_factors_labudde(B_powtrace, sum, m, ws);
+        return hafnian_summand(factors, n, sum, ws.comb.data());
+    }
+
+    for (i = 0; i < sum; i++) {
+        for (j = 0; j < sum; j++) {
+            B_powtrace[i * sum + j] = B[i * n + j];
+        }
+        C1[i] = C[pos[i]];
+        D1[i] = D[pos[i]];
+    }
+
+    std::fill(traces, traces + m, static_cast<T>(0.0));
+    if (sum != 0) {
+        powtrace(B_powtrace, sum, m, traces, ws, method);
+    }
+
+    loop_hafnian_factors(B, n, sum, m, C1, D1, ws.tmp.data(), traces, factors);
+
+    return hafnian_summand(factors, n, sum, ws.comb.data());
+}
+
+
+/**
+ * Calculates the partial sum \f$X,X+1,\dots,X+\text{chunksize}-1\f$ using
+ * the Cygan and Pilipczuk formula for the hafnian of matrix `mat`.
+ *
+ * Note that if `X=0` and `chunksize=pow(2.0, n/2)`, then the full hafnian is calculated.
+ *
+ * This function uses OpenMP (if available) to parallelize the reduction.
+ * The terms are split into one contiguous range per thread of equal
+ * estimated cost (see balanced_bounds()), since the cost of a term grows
+ * with the cube of the size of its submatrix. Each thread allocates a single
+ * workspace, so that no heap allocations are performed per term. The partial
+ * sums of the threads are then combined in a fixed tree order, so that the
+ * result is reproducible for a given number of threads.
+ *
+ * With `order=gray_order`, index \f$x\f$ stands for the subset gray_code(x),
+ * and each thread updates its submatrix in place as it walks its range.
+ * The full sum is the same in both orders, but partial sums are only
+ * consistent with other partial sums computed in the same order.
+ *
+ * @param mat vector representing the flattened matrix
+ * @param n size of the matrix
  * @param X initial index of the partial sum
  * @param chunksize length of the partial sum
- * @return the partial sum for the loop hafnian
+ * @param method algorithm used to compute the power traces
+ * @param order order in which the subsets are visited
+ * @param times if not null, on exit contains the wall time in seconds
+ *      spent by each thread on its range of terms
+ * @param magnitude if not null, on exit contains the sum of the absolute
+ *      values of the terms, used to estimate the rounding error (see hafnian_adaptive())
+ * @return the partial sum for hafnian
  */
 template <typename T>
-inline T do_chunk_loops(std::vector<T> &mat, std::vector<T> &C, std::vector<T> &D, int n, unsigned long long int X, unsigned long long int chunksize) {
+inline T do_chunk(std::vector<T> &mat, int n, unsigned long long int X, unsigned long long int chunksize,
+                  powtrace_algorithm method = eigensolver, subset_order order = binary_order,
+                  std::vector<double> *times = nullptr, double *magnitude = nullptr) {
+    // This function calculates adds parts X to X+chunksize of Cygan and Pilipczuk formula for the
+    // Hafnian of matrix mat
+
+#ifdef _OPENMP
+    int nthreads = omp_get_max_threads();
+#else
+    int nthreads = 1;
+#endif
 
-    T res = 0.0;
+    std::vector<unsigned long long int> bounds = balanced_bounds(X, chunksize, n / 2, nthreads, order == gray_order);
+    std::vector<T> partial(nthreads, static_cast<T>(0.0));
+    std::vector<double> partialabs(nthreads, 0.0);
 
-    #pragma omp parallel for
-    for (unsigned long long int x = X * chunksize; x < (X + 1)*chunksize; x++) {
-        T summand = 0.0;
+    if (times != nullptr)
+        times->assign(nthreads, 0.0);
 
-        Byte m = n / 2;
-        int i, j, k;
-        T factor, powfactor;
+    #pragma omp parallel for num_threads(nthreads) schedule(static, 1)
+    for (int ii = 0; ii < nthreads; ii++) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 
-        char* dst = new char[m];
-        Byte* pos = new Byte[n];
-        dec2bin(dst, x, m);
-        Byte sum = find2(dst, m, pos);
-        delete [] dst;
+        workspace<T> ws(n, method);
+        T localsum = 0.0;
+        double localabs = 0.0;
 
-        std::vector<T> B(sum * sum, 0.0), B_powtrace(sum * sum, 0.0);
-        std::vector<T> C1(sum, 0.0), D1(sum, 0.0);
+        for (unsigned long long int x = bounds[ii]; x < bounds[ii + 1]; x++) {
+            T term;
 
-        for (i = 0; i < sum; i++) {
-            for (j = 0; j < sum; j++) {
-                B[i * sum + j] = mat[pos[i] * n + ((pos[j]) ^ 1)];
-                B_powtrace[i * sum + j] = mat[pos[i] * n + ((pos[j]) ^ 1)];
+            if (order == gray_order) {
+                gray_seek(mat, n, x, x != bounds[ii], ws);
+                term = gray_hafnian_term(n, ws, method);
+            }
+            else {
+                term = hafnian_term(mat, n, x, ws, method);
             }
-            C1[i] = C[pos[i]];
-            D1[i] = D[pos[i]];
-        }
-        delete [] pos;
 
-        std::vector<T> traces(m, 0.0);
-        if (sum != 0) {
-            traces = powtrace(B, sum, m);
+            localsum += term;
+            if (magnitude != nullptr)
+                localabs += std::abs(term);
         }
 
-        char cnt = 1;
-        Byte cntindex = 0;
+        partial[ii] = localsum;
+        partialabs[ii] = localabs;
 
-        std::vector<T> comb(2 * (m + 1), 0.0);
-        comb[0] = 1.0;
+        if (times != nullptr)
+            (*times)[ii] = elapsed_seconds(start);
+    }
 
-        for (i = 1; i <= n / 2; i++) {
-            factor = traces[i - 1] / (2.0 * i);
-            T tmpn = 0.0;
+    if (magnitude != nullptr)
+        *magnitude = tree_reduce(partialabs);
 
-            for (int i = 0; i < sum; i++) {
-                tmpn += C1[i] * D1[i];
-            }
+    return tree_reduce(partial);
+}
+
+/**
+ * Calculates the partial sum \f$X,X+1,\dots,X+\text{chunksize}-1\f$ using
+ * the Cygan and Pilipczuk formula for the loop hafnian of matrix `mat`.
+ *
+ * Note that if `X=0` and `chunksize=pow(2.0, n/2)`, then the full loop hafnian is calculated.
+ *
+ * This function uses OpenMP (if available) to parallelize the reduction.
+ * The terms are split into one contiguous range per thread of equal
+ * estimated cost (see balanced_bounds()), since the cost of a term grows
+ * with the cube of the size of its submatrix. Each thread allocates a single
+ * workspace, so that no heap allocations are performed per term. The partial
+ * sums of the threads are then combined in a fixed tree order, so that the
+ * result is reproducible for a given number of threads.
+ *
+ * With `order=gray_order`, index \f$x\f$ stands for the subset gray_code(x),
+ * and each thread updates its submatrix in place as it walks its range.
+ * The full sum is the same in both orders, but partial sums are only
+ * consistent with other partial sums computed in the same order.
+ *
+ * @param mat vector representing the flattened matrix
+ * @param C contains the diagonal elements of matrix ``z``
+ * @param D the diagonal elements of matrix ``z``, with every consecutive pair
+ *      swapped (i.e., ``C[0]==D[1]``, ``C[1]==D[0]``, ``C[2]==D[3]``,
+ *      ``C[3]==D[2]``, etc.).
+ * @param n size of the matrix
+ * @param X initial index of the partial sum
+ * @param chunksize length of the partial sum
+ * @param method algorithm used to compute the power traces
+ * @param order order in which the subsets are visited
+ * @param times if not null, on exit contains the wall time in seconds
+ *      spent by each thread on its range of terms
+ * @return the partial sum for the loop hafnian
+ */
+template <typename T>
+inline T do_chunk_loops(std::vector<T> &mat, std::vector<T> &C, std::vector<T> &D, int n, unsigned long long int X, unsigned long long int chunksize,
+                        powtrace_algorithm method = eigensolver, subset_order order = binary_order,
+                  std::vector<double> *times = nullptr) {
+
+#ifdef _OPENMP
+    int nthreads = omp_get_max_threads();
+#else
+    int nthreads = 1;
+#endif
 
-            factor += 0.5 * tmpn;
-            std::vector<T> tmp_c1(sum, 0.0);
+    std::vector<unsigned long long int> bounds = balanced_bounds(X, chunksize, n / 2, nthreads, order == gray_order);
+    std::vector<T> partial(nthreads, static_cast<T>(0.0));
 
-            T tmp = 0.0;
+    if (times != nullptr)
+        times->assign(nthreads, 0.0);
 
-            for (int i = 0; i < sum; i++) {
-                tmp = 0.0;
+    #pragma omp parallel for num_threads(nthreads) schedule(static, 1)
+    for (int ii = 0; ii < nthreads; ii++) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 
-                for (int j = 0; j < sum; j++) {
-                    tmp += C1[j] * B[j * sum + i];
-                }
+        workspace<T> ws(n, method);
+        T localsum = 0.0;
 
-                tmp_c1[i] = tmp;
+        for (unsigned long long int x = bounds[ii]; x < bounds[ii + 1]; x++) {
+            if (order == gray_order) {
+                gray_seek(mat, n, x, x != bounds[ii], ws);
+                localsum += gray_loop_hafnian_term(C, D, n, ws, method);
             }
-
-            for (int i = 0; i < sum; i++) {
-                C1[i] = tmp_c1[i];
+            else {
+                localsum += loop_hafnian_term(mat, C, D, n, x, ws, method);
             }
+        }
 
-            powfactor = 1.0;
+        partial[ii] = localsum;
 
-            cnt = -cnt;
-            cntindex = (1 + cnt) / 2;
-            for (j = 0; j < n / 2 + 1; j++) {
-                comb[(m + 1) * (1 - cntindex) + j] = comb[(m + 1) * cntindex + j];
-            }
+        if (times != nullptr)
+            (*times)[ii] = elapsed_seconds(start);
+    }
 
-            for (j = 1; j <= (n / (2 * i)); j++) {
-                powfactor = powfactor * factor / (1.0 * j);
-                for (k = i * j + 1; k <= n / 2 + 1; k++) {
-                    comb[(m + 1) * (1 - cntindex) + k - 1] = comb[(m + 1) * (1 - cntindex) + k - 1] + comb[(m + 1) * cntindex + k - i * j - 1] * powfactor;
-                }
-            }
-        }
+    return tree_reduce(partial);
+}
 
-        if (((sum / 2) % 2) == (n / 2 % 2)) {
-            summand = comb[(m + 1) * (1 - cntindex) + n / 2];
-        }
-        else {
-            summand = -comb[(m + 1) * (1 - cntindex) + n / 2];
-        }
-        #pragma omp critical
-        res += summand;
+
+/**
+ * Extracts the diagonal vectors used by do_chunk_loops() from the matrix `mat`.
+ *
+ * @param mat vector representing the flattened matrix
+ * @param n size of the matrix
+ * @param C on exit, the diagonal elements of `mat`, with every consecutive
+ *      pair swapped
+ * @param D on exit, the diagonal elements of `mat`
+ */
+template <typename T>
+inline void loop_diagonals(std::vector<T> &mat, int n, std::vector<T> &C, std::vector<T> &D) {
+    for (int i = 0; i < n; i++) {
+        D[i] = mat[i * n + i];
     }
 
-    return res;
+    for (int i = 0; i < n; i += 2) {
+        C[i] = D[i + 1];
+        C[i + 1] = D[i];
+    }
 }
 
 
@@ -328,10 +1106,15 @@ inline T do_chunk_loops(std::vector<T> &mat, std::vector<T> &C, std::vector<T> &
 *
 * @param mat a flattened vector of size \f$n^2\f$, representing an \f$n\times n\f$
 *       row-ordered symmetric matrix.
+* @param method algorithm used to compute the power traces
+* @param order order in which the subsets are visited
+* @param times if not null, on exit contains the wall time in seconds
+*      spent by each thread
 * @return hafnian of the input matrix
 */
 template <typename T>
-inline T hafnian(std::vector<T> &mat) {
+inline T hafnian(std::vector<T> &mat, powtrace_algorithm method = eigensolver, subset_order order = binary_order,
+                 std::vector<double> *times = nullptr) {
     int n = std::sqrt(static_cast<double>(mat.size()));
     assert(n % 2 == 0);
 
@@ -345,7 +1128,7 @@ inline T hafnian(std::vector<T> &mat) {
     unsigned long long int rank = 0;
 
     T haf;
-    haf = do_chunk(mat, n, rank, chunksize);
+    haf = do_chunk(mat, n, rank, chunksize, method, order, times);
     return  haf;
 }
 
@@ -357,10 +1140,15 @@ inline T hafnian(std::vector<T> &mat) {
 *
 * @param mat a flattened vector of size \f$n^2\f$, representing an \f$n\times n\f$
 *       row-ordered symmetric matrix.
+* @param method algorithm used to compute the power traces
+* @param order order in which the subsets are visited
+* @param times if not null, on exit contains the wall time in seconds
+*      spent by each thread
 * @return hafnian of the input matrix
 */
 template <typename T>
-inline T loop_hafnian(std::vector<T> &mat) {
+inline T loop_hafnian(std::vector<T> &mat, powtrace_algorithm method = eigensolver, subset_order order = binary_order,
+                      std::vector<double> *times = nullptr) {
     int n = std::sqrt(static_cast<double>(mat.size()));
     assert(n % 2 == 0);
 
@@ -371,22 +1159,48 @@ inline T loop_hafnian(std::vector<T> &mat) {
     workers = std::min(workers, pow1);
 
     std::vector<T> D(n, 0.0), C(n, 0.0);
+    loop_diagonals(mat, n, C, D);
 
     unsigned long long int chunksize = pow1;
     unsigned long long int rank = 0;
 
-    for (int i = 0; i < n; i++) {
-        D[i] = mat[i * n + i];
-    }
+    T haf;
+    haf = do_chunk_loops(mat, C, D, n, rank, chunksize, method, order, times);
+    return  haf;
+}
 
-    for (int i = 0; i < n; i += 2) {
-        C[i] = D[i + 1];
-        C[i + 1] = D[i];
+
+/**
+* Returns the loop hafnian of a matrix of any size, using loop_hafnian().
+*
+* A matrix of odd size is padded with an extra row and column which
+* are zero except for a unit diagonal entry, which leaves the loop
+* hafnian unchanged.
+*
+* @param mat a flattened vector of size \f$n^2\f$, representing an \f$n\times n\f$
+*       row-ordered symmetric matrix, with \f$n>0\f$.
+* @param method algorithm used to compute the power traces
+* @param order order in which the subsets are visited
+* @return loop hafnian of the input matrix
+*/
+template <typename T>
+inline T loop_hafnian_padded(std::vector<T> &mat, powtrace_algorithm method = eigensolver,
+                             subset_order order = binary_order) {
+    int n = std::sqrt(static_cast<double>(mat.size()));
+
+    if (n % 2 == 0)
+        return loop_hafnian(mat, method, order);
+
+    std::vector<T> matq2((n + 1) * (n + 1), static_cast<T>(0.0));
+
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            matq2[i * (n + 1) + j] = mat[i * n + j];
+        }
     }
+    matq2[(n + 1) * (n + 1) - 1] = static_cast<T>(1.0);
 
-    T haf;
-    haf = do_chunk_loops(mat, C, D, n, rank, chunksize);
-    return  haf;
+    return loop_hafnian(matq2, method, order);
 }
 
 
@@ -399,11 +1213,22 @@ inline T loop_hafnian(std::vector<T> &mat) {
 * integration. It accepts and returns complex double numeric types, and
 * returns sensible values for empty and non-even matrices.
 *
+* The hafnian is factorised over the connected components of the matrix
+* (see factorised_hafnian()), so that block diagonal matrices, up to a
+* permutation, only require the hafnians of their blocks. The hafnian of a
+* component whose graph has a narrow path decomposition is computed by dynamic
+* programming (see sparse_hafnian()), that of a component whose graph is
+* bipartite as a permanent (see bipartite_hafnian()), and that of a component
+* of low numerical rank in polynomial time (see lowrank_hafnian()).
+*
 * @param mat a flattened vector of size \f$n^2\f$, representing an \f$n\times n\f$
 *       row-ordered symmetric matrix.
+* @param method algorithm used to compute the power traces
+* @param order order in which the subsets are visited
 * @return hafnian of the input matrix
 */
-std::complex<double> hafnian_eigen(std::vector<std::complex<double>> &mat) {
+std::complex<double> hafnian_eigen(std::vector<std::complex<double>> &mat, powtrace_algorithm method = eigensolver,
+                                   subset_order order = binary_order) {
     std::vector<std::complex<double>> matq(mat.begin(), mat.end());
     int n = std::sqrt(static_cast<double>(mat.size()));
     std::complex<double> haf;
@@ -413,7 +1238,13 @@ std::complex<double> hafnian_eigen(std::vector<std::complex<double>> &mat) {
     else if (n % 2 != 0)
         haf = std::complex<double>(0.0, 0.0);
     else
-        haf = hafnian(matq);
+        haf = factorised_hafnian(matq, [&](std::vector<std::complex<double>> &sub) {
+            return sparse_hafnian(sub, [&](std::vector<std::complex<double>> &a) {
+                return bipartite_hafnian(a, [&](std::vector<std::complex<double>> &b) {
+                    return lowrank_hafnian(b, [&](std::vector<std::complex<double>> &c) { return hafnian(c, method, order); });
+                }, [](std::vector<std::complex<double>> &b) { return permanent(b); });
+            });
+        });
 
     return haf;
 }
@@ -428,11 +1259,22 @@ std::complex<double> hafnian_eigen(std::vector<std::complex<double>> &mat) {
 * integration. It accepts and returns double numeric types, and
 * returns sensible values for empty and non-even matrices.
 *
+* The hafnian is factorised over the connected components of the matrix
+* (see factorised_hafnian()), so that block diagonal matrices, up to a
+* permutation, only require the hafnians of their blocks. The hafnian of a
+* component whose graph has a narrow path decomposition is computed by dynamic
+* programming (see sparse_hafnian()), that of a component whose graph is
+* bipartite as a permanent (see bipartite_hafnian()), and that of a component
+* of low numerical rank in polynomial time (see lowrank_hafnian()).
+*
 * @param mat a flattened vector of size \f$n^2\f$, representing an \f$n\times n\f$
 *       row-ordered symmetric matrix.
+* @param method algorithm used to compute the power traces
+* @param order order in which the subsets are visited
 * @return hafnian of the input matrix
 */
-double hafnian_eigen(std::vector<double> &mat) {
+double hafnian_eigen(std::vector<double> &mat, powtrace_algorithm method = eigensolver,
+                     subset_order order = binary_order) {
     std::vector<double> matq(mat.begin(), mat.end());
     int n = std::sqrt(static_cast<double>(mat.size()));
     double haf;
@@ -442,7 +1284,13 @@ double hafnian_eigen(std::vector<double> &mat) {
     else if (n % 2 != 0)
         haf = 0.0;
     else
-        haf = static_cast<double>(hafnian(matq));
+        haf = factorised_hafnian(matq, [&](std::vector<double> &sub) {
+            return sparse_hafnian(sub, [&](std::vector<double> &a) {
+                return bipartite_hafnian(a, [&](std::vector<double> &b) {
+                    return lowrank_hafnian(b, [&](std::vector<double> &c) { return hafnian(c, method, order); });
+                }, [](std::vector<double> &b) { return permanent(b); });
+            });
+        });
 
     return haf;
 }
@@ -457,31 +1305,27 @@ double hafnian_eigen(std::vector<double> &mat) {
 * integration. It accepts and returns complex double numeric types, and
 * returns sensible values for empty and non-even matrices.
 *
+* The loop hafnian is factorised over the connected components of the matrix
+* (see factorised_loop_hafnian()).
+*
 * @param mat a flattened vector of size \f$n^2\f$, representing an \f$n\times n\f$
 *       row-ordered symmetric matrix.
+* @param method algorithm used to compute the power traces
+* @param order order in which the subsets are visited
 * @return loop hafnian of the input matrix
 */
-std::complex<double> loop_hafnian_eigen(std::vector<std::complex<double>> &mat) {
+std::complex<double> loop_hafnian_eigen(std::vector<std::complex<double>> &mat, powtrace_algorithm method = eigensolver,
+                                        subset_order order = binary_order) {
     std::vector<std::complex<double>> matq(mat.begin(), mat.end());
     int n = std::sqrt(static_cast<double>(mat.size()));
     std::complex<double> haf;
-    std::vector<std::complex<double>> matq2((n + 1) * (n + 1), std::complex<double>(0.0, 0.0));
 
     if (n == 0)
         haf = std::complex<double>(1.0, 0.0);
-    else if (n % 2 != 0) {
-        for (int i = 0; i < n; i++) {
-            for (int j = 0; j < n; j++) {
-                matq2[i * (n + 1) + j] = matq[i * n + j];
-            }
-        }
-        matq2[(n + 1) * (n + 1) - 1] = std::complex<double>(1.0, 0.0);
-
-
-        haf = loop_hafnian(matq2);
-    }
     else
-        haf = loop_hafnian(matq);
+        haf = factorised_loop_hafnian(matq, [&](std::vector<std::complex<double>> &sub) {
+            return loop_hafnian_padded(sub, method, order);
+        });
 
     return haf;
 }
@@ -496,31 +1340,27 @@ std::complex<double> loop_hafnian_eigen(std::vector<std::complex<double>> &mat)
 * integration. It accepts and returns double numeric types, and
 * returns sensible values for empty and non-even matrices.
 *
+* The loop hafnian is factorised over the connected components of the matrix
+* (see factorised_loop_hafnian()).
+*
 * @param mat a flattened vector of size \f$n^2\f$, representing an \f$n\times n\f$
 *       row-ordered symmetric matrix.
+* @param method algorithm used to compute the power traces
+* @param order order in which the subsets are visited
 * @return loop hafnian of the input matrix
 */
-double loop_hafnian_eigen(std::vector<double> &mat) {
+double loop_hafnian_eigen(std::vector<double> &mat, powtrace_algorithm method = eigensolver,
+                          subset_order order = binary_order) {
     std::vector<double> matq(mat.begin(), mat.end());
     int n = std::sqrt(static_cast<double>(mat.size()));
     double haf;
-    std::vector<double> matq2((n + 1) * (n + 1), 0.0);
 
     if (n == 0)
         haf = 1.0;
-    else if (n % 2 != 0) {
-        for (int i = 0; i < n; i++) {
-            for (int j = 0; j < n; j++) {
-                matq2[i * (n + 1) + j] = mat[i * n + j];
-            }
-        }
-        matq2[(n + 1) * (n + 1) - 1] = 1.0;
-
-
-        haf = loop_hafnian(matq2);
-    }
     else
-        haf = static_cast<double>(loop_hafnian(matq));
+        haf = factorised_loop_hafnian(matq, [&](std::vector<double> &sub) {
+            return loop_hafnian_padded(sub, method, order);
+        });
 
     return haf;
 }
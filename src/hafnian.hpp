@@ -13,13 +13,21 @@
 // limitations under the License.
 #pragma once
 #include <version.hpp>
+#include <double_double.hpp>
 #include <eigenvalue_hafnian.hpp>
 #include <recursive_hafnian.hpp>
 #include <repeated_hafnian.hpp>
+#include <lowrank_hafnian.hpp>
+#include <sparse_hafnian.hpp>
+#include <modular_hafnian.hpp>
 #include <hafnian_approx.hpp>
 #include <torontonian.hpp>
 #include <permanent.hpp>
 #include <hermite_multidimensional.hpp>
+#include <shard.hpp>
+#include <checkpoint.hpp>
+#include <dispatch.hpp>
+#include <adaptive.hpp>
 
 /**
  * @namespace hafnian
@@ -0,0 +1,423 @@
+// Copyright 2019 Xanadu Quantum Technologies Inc.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+/**
+ * @file
+ * Contains functions for computing the hafnian of a matrix of low rank
+ * in time polynomial in its size, following the approach of Barvinok
+ * for the permanent of low rank matrices.
+ *
+ * If the \f$n\times n\f$ symmetric matrix \f$A\f$ has rank \f$r\f$, it
+ * can be written \f$A=VMV^T\f$, with \f$V\f$ of size \f$n\times r\f$ and
+ * \f$M\f$ symmetric of size \f$r\times r\f$. Expanding every entry of
+ * \f$A\f$ in the hafnian over the columns of \f$V\f$ gives
+ *
+ * \f[
+ *      \text{haf}(A) = \sum_{|\alpha|=n} c_\alpha\, \alpha!\, g_\alpha,
+ * \f]
+ *
+ * where the sum is over the multi-indices \f$\alpha\f$ of length \f$r\f$,
+ * \f$c_\alpha\f$ is the coefficient of \f$t^\alpha\f$ in
+ * \f$\prod_{i=1}^n \sum_k V_{ik}t_k\f$, and \f$g_\alpha\f$ is the coefficient
+ * of \f$t^\alpha\f$ in \f$(t^TMt/2)^{n/2}/(n/2)!\f$, so that \f$\alpha!\,g_\alpha\f$
+ * is the hafnian of \f$M\f$ with its rows and columns repeated \f$\alpha\f$ times.
+ * Both polynomials are built one factor at a time, in
+ * \f$O(n r^2 (n+1)^{r-1})\f$ operations.
+ */
+#pragma once
+#include <stdafx.h>
+#include <Eigen/QR>
+
+namespace hafnian {
+
+/**
+ * Returns the multi-index \f$\alpha\f$ of a monomial of degree `d` in `r`
+ * variables stored at position `idx` of a dense polynomial, in which the
+ * first \f$r-1\f$ exponents are the digits of `idx` in base \f$n+1\f$ and the
+ * last exponent is implied by the degree.
+ *
+ * @param idx position of the monomial
+ * @param n largest degree of the polynomial
+ * @param r number of variables
+ * @param d degree of the monomial
+ * @param alpha array of length \f$r\f$ in which the exponents are stored
+ * @return whether the monomial has degree `d`, i.e. whether the implied last
+ *      exponent is nonnegative
+ */
+inline bool lowrank_exponents(long long int idx, int n, int r, int d, int *alpha) {
+    int s = 0;
+
+    for (int k = 0; k < r - 1; k++) {
+        alpha[k] = idx % (n + 1);
+        idx /= n + 1;
+        s += alpha[k];
+    }
+
+    alpha[r - 1] = d - s;
+
+    return s <= d;
+}
+
+
+/**
+ * Multiplies in place the homogeneous polynomial `poly` of degree `d` in `r`
+ * variables by the linear form \f$\sum_k v_k t_k\f$.
+ *
+ * @param poly dense polynomial of size \f$(n+1)^{r-1}\f$ (see lowrank_exponents())
+ * @param n largest degree of the polynomial
+ * @param r number of variables
+ * @param d degree of the polynomial
+ * @param v array of length \f$r\f$ containing the coefficients of the linear form
+ * @param alpha scratch array of length \f$r\f$
+ */
+template <typename T>
+inline void lowrank_multiply_linear(std::vector<T> &poly, int n, int r, int d, const T *v, int *alpha) {
+    std::vector<long long int> stride(r, 0);
+    for (int k = 0; k < r - 1; k++)
+        stride[k] = (k == 0) ? 1 : stride[k - 1] * (n + 1);
+
+    // the terms of the product only read monomials at lower positions,
+    // so that it can be formed in place by visiting positions in decreasing order
+    for (long long int idx = poly.size() - 1; idx >= 0; idx--) {
+        if (!lowrank_exponents(idx, n, r, d + 1, alpha))
+            continue;
+
+        T val = static_cast<T>(0.0);
+
+        for (int k = 0; k < r; k++) {
+            if (alpha[k] > 0)
+                val += v[k] * poly[idx - stride[k]];
+        }
+
+        poly[idx] = val;
+    }
+}
+
+
+/**
+ * Multiplies in place the homogeneous polynomial `poly` of degree `d` in `r`
+ * variables by the quadratic form \f$t^TMt/2\f$.
+ *
+ * @param poly dense polynomial of size \f$(n+1)^{r-1}\f$ (see lowrank_exponents())
+ * @param n largest degree of the polynomial
+ * @param r number of variables
+ * @param d degree of the polynomial
+ * @param M a flattened vector of size \f$r^2\f$, representing an \f$r\times r\f$
+ *      row-ordered symmetric matrix
+ * @param scale factor by which the product is multiplied
+ * @param alpha scratch array of length \f$r\f$
+ */
+template <typename T>
+inline void lowrank_multiply_quadratic(std::vector<T> &poly, int n, int r, int d, std::vector<T> &M,
+                                       const T &scale, int *alpha) {
+    std::vector<long long int> stride(r, 0);
+    for (int k = 0; k < r - 1; k++)
+        stride[k] = (k == 0) ? 1 : stride[k - 1] * (n + 1);
+
+    for (long long int idx = poly.size() - 1; idx >= 0; idx--) {
+        if (!lowrank_exponents(idx, n, r, d + 2, alpha))
+            continue;
+
+        T val = static_cast<T>(0.0);
+
+        for (int k = 0; k < r; k++) {
+            if (alpha[k] >= 2)
+                val += static_cast<T>(0.5) * M[k * r + k] * poly[idx - 2 * stride[k]];
+
+            if (alpha[k] == 0)
+                continue;
+
+            for (int l = k + 1; l < r; l++) {
+                if (alpha[l] > 0)
+                    val += M[k * r + l] * poly[idx - stride[k] - stride[l]];
+            }
+        }
+
+        poly[idx] = scale * val;
+    }
+}
+
+
+/**
+ * Returns the hafnian of the matrix \f$A=VMV^T\f$ of rank at most \f$r\f$,
+ * given its factors.
+ *
+ * @param V a flattened vector of size \f$nr\f$, representing an \f$n\times r\f$
+ *      row-ordered matrix
+ * @param M a flattened vector of size \f$r^2\f$, representing an \f$r\times r\f$
+ *      row-ordered symmetric matrix
+ * @param n size of the matrix \f$A\f$, which must be even
+ * @param r number of columns of \f$V\f$
+ * @return hafnian of \f$VMV^T\f$
+ */
+template <typename T>
+inline T hafnian_lowrank(std::vector<T> &V, std::vector<T> &M, int n, int r) {
+    assert(n % 2 == 0);
+    assert(static_cast<int>(V.size()) == n * r && static_cast<int>(M.size()) == r * r);
+
+    if (n == 0)
+        return static_cast<T>(1.0);
+    if (r == 0)
+        return static_cast<T>(0.0);
+
+    long long int size = 1;
+    for (int k = 0; k < r - 1; k++)
+        size *= n + 1;
+
+    std::vector<T> c(size, static_cast<T>(0.0));
+    std::vector<T> g(size, static_cast<T>(0.0));
+    std::vector<int> alpha(r);
+
+    c[0] = static_cast<T>(1.0);
+    for (int i = 0; i < n; i++)
+        lowrank_multiply_linear(c, n, r, i, &V[i * r], alpha.data());
+
+    g[0] = static_cast<T>(1.0);
+    for (int j = 0; j < n / 2; j++)
+        lowrank_multiply_quadratic(g, n, r, 2 * j, M, static_cast<T>(1.0 / (j + 1)), alpha.data());
+
+    std::vector<double> factorial(n + 1, 1.0);
+    for (int i = 1; i <= n; i++)
+        factorial[i] = factorial[i - 1] * i;
+
+    T haf = static_cast<T>(0.0);
+
+    for (long long int idx = 0; idx < size; idx++) {
+        if (!lowrank_exponents(idx, n, r, n, alpha.data()))
+            continue;
+
+        double weight = 1.0;
+        for (int k = 0; k < r; k++)
+            weight *= factorial[alpha[k]];
+
+        haf += c[idx] * g[idx] * static_cast<T>(weight);
+    }
+
+    return haf;
+}
+
+
+/**
+ * Computes factors \f$V\f$ and \f$M\f$ such that \f$A=VMV^T\f$, where the
+ * columns of \f$V\f$ are an orthonormal basis of the numerical range of the
+ * symmetric matrix \f$A\f$, found using a QR decomposition with column pivoting.
+ * Since \f$A\f$ is symmetric, \f$A=VV^\dagger A \bar{V}V^T\f$, so that
+ * \f$M=V^\dagger A\bar{V}\f$.
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an \f$n\times n\f$
+ *       row-ordered symmetric matrix.
+ * @param n size of the matrix
+ * @param tol relative tolerance below which the pivots of the decomposition
+ *      are considered to vanish
+ * @param V on exit, a flattened vector of size \f$nr\f$, representing the
+ *      \f$n\times r\f$ row-ordered factor \f$V\f$
+ * @param M on exit, a flattened vector of size \f$r^2\f$, representing the
+ *      \f$r\times r\f$ row-ordered factor \f$M\f$
+ * @return the numerical rank \f$r\f$ of the matrix
+ */
+template <typename T>
+inline int lowrank_factors(std::vector<T> &mat, int n, double tol, std::vector<T> &V, std::vector<T> &M) {
+    typedef Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> matrix_t;
+
+    // the matrix is symmetric, so its row-ordered and column-ordered forms agree
+    matrix_t A = Eigen::Map<matrix_t, Eigen::Unaligned>(mat.data(), n, n);
+
+    Eigen::ColPivHouseholderQR<matrix_t> qr(A);
+    qr.setThreshold(tol);
+    int r = qr.rank();
+
+    matrix_t Q = qr.householderQ() * matrix_t::Identity(n, r);
+    matrix_t B = Q.adjoint() * A * Q.conjugate();
+
+    V.resize(n * r);
+    M.resize(r * r);
+
+    for (int i = 0; i < n; i++) {
+        for (int k = 0; k < r; k++) {
+            V[i * r + k] = Q(i, k);
+        }
+    }
+
+    for (int k = 0; k < r; k++) {
+        for (int l = 0; l < r; l++) {
+            M[k * r + l] = static_cast<T>(0.5) * (B(k, l) + B(l, k));
+        }
+    }
+
+    return r;
+}
+
+
+/**
+ * Returns the hafnian of a matrix of low numerical rank, computed from the
+ * factors returned by lowrank_factors(). The number of operations is
+ * polynomial in the size \f$n\f$ of the matrix for a fixed rank \f$r\f$, but
+ * grows as \f$(n+1)^{r-1}\f$.
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an \f$n\times n\f$
+ *       row-ordered symmetric matrix of even size.
+ * @param tol relative tolerance used to determine the rank of the matrix
+ * @return hafnian of the input matrix
+ */
+template <typename T>
+inline T hafnian_lowrank(std::vector<T> &mat, double tol = 1e-12) {
+    int n = std::sqrt(static_cast<double>(mat.size()));
+    assert(n % 2 == 0);
+
+    if (n == 0)
+        return static_cast<T>(1.0);
+
+    std::vector<T> V, M;
+    int r = lowrank_factors(mat, n, tol, V, M);
+
+    return hafnian_lowrank(V, M, n, r);
+}
+
+
+/**
+ * Returns the estimated number of operations of hafnian_lowrank() for a
+ * matrix of size \f$n\f$ and rank \f$r\f$.
+ *
+ * @param n size of the matrix
+ * @param r rank of the matrix
+ * @return the estimated number of operations
+ */
+inline double lowrank_cost(int n, int r) {
+    return (1.5 * n + 0.25 * n * r) * r * std::pow(n + 1.0, r - 1);
+}
+
+
+/**
+ * Returns the estimated number of operations of hafnian() for a matrix of size \f$n\f$,
+ * dominated by the power traces of the \f$2^{n/2}\f$ submatrices. The constant
+ * factor is chosen so that the estimate is comparable to lowrank_cost(), as measured
+ * by the `lowrank` benchmark.
+ *
+ * @param n size of the matrix
+ * @return the estimated number of operations
+ */
+inline double eigen_hafnian_cost(int n) {
+    return 10.0 * std::pow(2.0, 0.5 * n) * std::pow(0.5 * n + 1.0, 3);
+}
+
+
+/**
+ * Returns whether hafnian_lowrank() is expected to be faster than hafnian()
+ * for a matrix of size \f$n\f$ and rank \f$r\f$.
+ *
+ * @param n size of the matrix
+ * @param r rank of the matrix
+ * @return whether the low rank algorithm should be used
+ */
+inline bool lowrank_preferred(int n, int r) {
+    // the dense polynomials require (n+1)^(r-1) entries each
+    if ((r - 1) * std::log2(n + 1.0) > 26)
+        return false;
+
+    return lowrank_cost(n, r) < eigen_hafnian_cost(n);
+}
+
+
+/**
+ * Returns the hafnian of the matrix `mat`. If its numerical rank is low enough
+ * that hafnian_lowrank() is expected to be faster (see lowrank_preferred()),
+ * it is used; otherwise, the hafnian is computed by the function `haf`.
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an \f$n\times n\f$
+ *       row-ordered symmetric matrix of even size.
+ * @param haf function returning the hafnian of a matrix
+ * @param tol relative tolerance used to determine the rank of the matrix
+ * @return hafnian of the input matrix
+ */
+template <typename T, typename F>
+inline T lowrank_hafnian(std::vector<T> &mat, F haf, double tol = 1e-12) {
+    int n = std::sqrt(static_cast<double>(mat.size()));
+
+    // a matrix of size n has rank at most n, so only larger matrices can benefit
+    if (n < 2 || !lowrank_preferred(n, 1))
+        return haf(mat);
+
+    std::vector<T> V, M;
+    int r = lowrank_factors(mat, n, tol, V, M);
+
+    if (r < n && lowrank_preferred(n, r))
+        return hafnian_lowrank(V, M, n, r);
+
+    return haf(mat);
+}
+
+
+/**
+ * Returns the hafnian of a matrix of low numerical rank, using hafnian_lowrank().
+ *
+ * This is a wrapper around the templated function `hafnian::hafnian_lowrank` for Python
+ * integration. It accepts and returns complex double numeric types, and
+ * returns sensible values for empty and non-even matrices.
+ *
+ * In addition, this wrapper function automatically casts all matrices
+ * to type `complex<long double>`, allowing for greater precision than supported
+ * by Python and NumPy.
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an
+ *      \f$n\times n\f$ row-ordered symmetric matrix.
+ * @param tol relative tolerance used to determine the rank of the matrix
+ * @return hafnian of the input matrix
+ */
+std::complex<double> hafnian_lowrank_quad(std::vector<std::complex<double>> &mat, double tol = 1e-12) {
+    std::vector<std::complex<long double>> matq(mat.begin(), mat.end());
+    int n = std::sqrt(static_cast<double>(mat.size()));
+    std::complex<long double> haf;
+
+    if (n == 0)
+        haf = std::complex<long double>(1.0, 0.0);
+    else if (n % 2 != 0)
+        haf = std::complex<long double>(0.0, 0.0);
+    else
+        haf = hafnian_lowrank(matq, tol);
+
+    return static_cast<std::complex<double>>(haf);
+}
+
+
+/**
+ * Returns the hafnian of a matrix of low numerical rank, using hafnian_lowrank().
+ *
+ * This is a wrapper around the templated function `hafnian::hafnian_lowrank` for Python
+ * integration. It accepts and returns double numeric types, and
+ * returns sensible values for empty and non-even matrices.
+ *
+ * In addition, this wrapper function automatically casts all matrices
+ * to type `long double`, allowing for greater precision than supported
+ * by Python and NumPy.
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an
+ *      \f$n\times n\f$ row-ordered symmetric matrix.
+ * @param tol relative tolerance used to determine the rank of the matrix
+ * @return hafnian of the input matrix
+ */
+double hafnian_lowrank_quad(std::vector<double> &mat, double tol = 1e-12) {
+    std::vector<long double> matq(mat.begin(), mat.end());
+    int n = std::sqrt(static_cast<double>(mat.size()));
+    long double haf;
+
+    if (n == 0)
+        haf = 1.0;
+    else if (n % 2 != 0)
+        haf = 0.0;
+    else
+        haf = hafnian_lowrank(matq, tol);
+
+    return static_cast<double>(haf);
+}
+
+}
@@ -0,0 +1,698 @@
+// Copyright 2019 Xanadu Quantum Technologies Inc.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+/**
+ * @file
+ * Contains functions for computing the exact hafnian and permanent of
+ * integer matrices by modular arithmetic.
+ *
+ * The recursive hafnian algorithm and Ryser's formula for the permanent
+ * only add and multiply matrix entries, so they can be evaluated modulo a
+ * prime \f$p\f$ without any rounding. The result is computed modulo
+ * several primes just below \f$2^{62}\f$, in parallel, and the integer is
+ * reconstructed with the Chinese remainder theorem. Enough primes are used
+ * for their product to exceed twice a bound on the absolute value of the
+ * result, so that the result is exact and its sign is recovered.
+ *
+ * Products modulo \f$p\f$ use Montgomery multiplication with 128-bit
+ * intermediate integers, which are supported by GCC and Clang.
+ */
+#pragma once
+#include <stdafx.h>
+#include <string>
+
+namespace hafnian {
+
+/// Unsigned 128-bit integer used for products of residues
+typedef unsigned __int128 uint128;
+
+/**
+ * Arithmetic modulo an odd prime \f$p<2^{62}\f$ in Montgomery form, where a
+ * residue \f$a\f$ is stored as \f$aR \bmod p\f$ with \f$R=2^{64}\f$.
+ */
+struct montgomery {
+    /// The prime modulus
+    unsigned long long int p;
+    /// \f$-p^{-1} \bmod R\f$
+    unsigned long long int pinv;
+    /// \f$R^2 \bmod p\f$
+    unsigned long long int r2;
+
+    explicit montgomery(unsigned long long int prime) : p(prime) {
+        // Newton iteration for the inverse of p modulo 2^64; p*p = 1 mod 8,
+        // and every iteration doubles the number of correct bits
+        unsigned long long int inv = p;
+        for (int i = 0; i < 5; i++)
+            inv *= 2 - p * inv;
+
+        pinv = 0 - inv;
+
+        uint128 r = (static_cast<uint128>(1) << 64) % p;
+        r2 = static_cast<unsigned long long int>((r * r) % p);
+    }
+
+    /**
+     * Returns \f$tR^{-1} \bmod p\f$, for \f$t<2p^2\f$.
+     */
+    inline unsigned long long int reduce(uint128 t) const {
+        unsigned long long int m = static_cast<unsigned long long int>(t) * pinv;
+        unsigned long long int u = static_cast<unsigned long long int>((t + static_cast<uint128>(m) * p) >> 64);
+        return u >= p ? u - p : u;
+    }
+
+    inline unsigned long long int mul(unsigned long long int a, unsigned long long int b) const {
+        return reduce(static_cast<uint128>(a) * b);
+    }
+
+    inline unsigned long long int add(unsigned long long int a, unsigned long long int b) const {
+        unsigned long long int s = a + b;
+        return s >= p ? s - p : s;
+    }
+
+    inline unsigned long long int sub(unsigned long long int a, unsigned long long int b) const {
+        return a >= b ? a - b : a + p - b;
+    }
+
+    /**
+     * Returns the Montgomery form of the integer `a`.
+     */
+    inline unsigned long long int from_integer(long long int a) const {
+        long long int r = a % static_cast<long long int>(p);
+        if (r < 0)
+            r += static_cast<long long int>(p);
+        return mul(static_cast<unsigned long long int>(r), r2);
+    }
+
+    /**
+     * Returns the residue in \f$[0,p)\f$ of a number in Montgomery form.
+     */
+    inline unsigned long long int to_residue(unsigned long long int a) const {
+        return reduce(a);
+    }
+};
+
+/**
+ * Returns \f$ab \bmod p\f$.
+ */
+inline unsigned long long int mulmod(unsigned long long int a, unsigned long long int b, unsigned long long int p) {
+    return static_cast<unsigned long long int>((static_cast<uint128>(a) * b) % p);
+}
+
+/**
+ * Returns \f$a^e \bmod p\f$.
+ */
+inline unsigned long long int powmod(unsigned long long int a, unsigned long long int e, unsigned long long int p) {
+    unsigned long long int r = 1 % p;
+    a %= p;
+
+    while (e > 0) {
+        if (e & 1)
+            r = mulmod(r, a, p);
+        a = mulmod(a, a, p);
+        e >>= 1;
+    }
+
+    return r;
+}
+
+/**
+ * Returns true if `n` is prime, using the Miller-Rabin test with a set of
+ * bases that is deterministic for all 64-bit integers.
+ *
+ * @param n integer to test
+ * @return whether `n` is prime
+ */
+inline bool is_prime(unsigned long long int n) {
+    static const unsigned long long int bases[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37};
+
+    if (n < 2)
+        return false;
+
+    for (unsigned long long int a : bases) {
+        if (n % a == 0)
+            return n == a;
+    }
+
+    unsigned long long int d = n - 1;
+    int s = 0;
+    while ((d & 1) == 0) {
+        d >>= 1;
+        s++;
+    }
+
+    for (unsigned long long int a : bases) {
+        unsigned long long int x = powmod(a, d, n);
+        if (x == 1 || x == n - 1)
+            continue;
+
+        bool composite = true;
+        for (int i = 1; i < s && composite; i++) {
+            x = mulmod(x, x, n);
+            if (x == n - 1)
+                composite = false;
+        }
+
+        if (composite)
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * Returns the `k` largest primes below \f$2^{62}\f$, in decreasing order.
+ *
+ * @param k number of primes
+ * @return the primes
+ */
+inline std::vector<unsigned long long int> modular_primes(int k) {
+    std::vector<unsigned long long int> primes;
+    unsigned long long int q = (1ULL << 62) - 1;
+
+    while (static_cast<int>(primes.size()) < k) {
+        if (is_prime(q))
+            primes.push_back(q);
+        q -= 2;
+    }
+
+    return primes;
+}
+
+/**
+ * Returns the number of primes below \f$2^{62}\f$ whose product exceeds
+ * twice an integer of at most `bits` bits, so that the integer and its
+ * sign are determined by its residues.
+ *
+ * @param bits base-2 logarithm of a bound on the absolute value of the integer
+ * @return number of primes
+ */
+inline int modular_primes_needed(long double bits) {
+    // every prime exceeds 2^61, and two bits are added for the sign and
+    // the rounding of the bound
+    return std::max(1, static_cast<int>(std::ceil((bits + 2) / 61)));
+}
+
+/**
+ * Recursive hafnian solver modulo a prime, in Montgomery form.
+ *
+ * This is recursive_chunk() with the additions and multiplications
+ * carried out modulo the prime of `m`.
+ *
+ * This function uses OpenMP tasks (if available) to parallelize the reduction,
+ * and should be called from within a parallel region.
+ *
+ * @param b
+ * @param s
+ * @param w
+ * @param g
+ * @param n
+ * @param m the modular arithmetic
+ * @return the hafnian modulo the prime, in Montgomery form
+ */
+inline unsigned long long int modular_recursive_chunk(std::vector<unsigned long long int> b, int s, int w,
+                                                      std::vector<unsigned long long int> g, int n, montgomery m) {
+    if (s == 0) {
+        return w > 0 ? g[n] : m.sub(0, g[n]);
+    }
+
+    std::vector<unsigned long long int> c((s - 2) * (s - 3) / 2 * (n + 1), 0);
+    unsigned long long int h1, h2;
+    int u, v, j, k, i = 0;
+
+    for (j = 1; j < s - 2; j++) {
+        for (k = 0; k < j; k++) {
+            for (u = 0; u < n + 1; u++) {
+                c[(n + 1) * i + u] = b[(n + 1) * ((j + 1) * (j + 2) / 2 + k + 2) + u];
+            }
+            i += 1;
+        }
+    }
+
+    #pragma omp task shared(h1)
+    h1 = modular_recursive_chunk(c, s - 2, -w, g, n, m);
+
+    std::vector<unsigned long long int> e = g;
+
+    for (u = 0; u < n; u++) {
+        for (v = 0; v < n - u; v++) {
+            e[u + v + 1] = m.add(e[u + v + 1], m.mul(g[u], b[v]));
+
+            for (j = 1; j < s - 2; j++) {
+                for (k = 0; k < j; k++) {
+                    // both products are accumulated before a single reduction
+                    uint128 t = static_cast<uint128>(b[(n + 1) * ((j + 1) * (j + 2) / 2) + u])
+                                    * b[(n + 1) * ((k + 1) * (k + 2) / 2 + 1) + v]
+                                + static_cast<uint128>(b[(n + 1) * (k + 1) * (k + 2) / 2 + u])
+                                    * b[(n + 1) * ((j + 1) * (j + 2) / 2 + 1) + v];
+                    unsigned long long int &cc = c[(n + 1) * (j * (j - 1) / 2 + k) + u + v + 1];
+                    cc = m.add(cc, m.reduce(t));
+                }
+            }
+        }
+    }
+
+    #pragma omp task shared(h2)
+    h2 = modular_recursive_chunk(c, s - 2, w, e, n, m);
+
+    #pragma omp taskwait
+
+    return m.add(h1, h2);
+}
+
+/**
+ * Returns the hafnian of an integer matrix modulo a prime, using the
+ * recursive algorithm (see hafnian_recursive()).
+ *
+ * This function uses OpenMP tasks (if available) to parallelize the reduction,
+ * and should be called from within a parallel region.
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an
+ *      \f$n\times n\f$ row-ordered symmetric matrix, with \f$n\f$ even.
+ * @param m the modular arithmetic
+ * @return the hafnian modulo the prime, in \f$[0,p)\f$
+ */
+inline unsigned long long int hafnian_modular(std::vector<long long int> &mat, montgomery m) {
+    int n = std::sqrt(static_cast<double>(mat.size())) / 2;
+
+    std::vector<unsigned long long int> z(n * (2 * n - 1) * (n + 1), 0);
+    std::vector<unsigned long long int> g(n + 1, 0);
+
+    g[0] = m.from_integer(1);
+
+    for (int j = 1; j < 2 * n; j++) {
+        for (int k = 0; k < j; k++) {
+            z[(n + 1) * (j * (j - 1) / 2 + k)] = m.from_integer(mat[2 * j * n + k]);
+        }
+    }
+
+    return m.to_residue(modular_recursive_chunk(z, 2 * n, 1, g, n, m));
+}
+
+/**
+ * Returns the terms \f$X,X+1,\dots,X+\text{chunksize}-1\f$ of Ryser's
+ * formula for the permanent of an integer matrix modulo a prime, where term
+ * \f$k\f$ corresponds to the subset of rows given by the Gray code of
+ * \f$k+1\f$ (see permanent_chunk()).
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an
+ *      \f$n\times n\f$ row-ordered matrix.
+ * @param n size of the matrix
+ * @param X initial index of the partial sum
+ * @param chunksize length of the partial sum
+ * @param m the modular arithmetic
+ * @return the partial sum modulo the prime, in Montgomery form
+ */
+inline unsigned long long int permanent_modular_chunk(std::vector<unsigned long long int> &mat, int n,
+                                                      unsigned long long int X, unsigned long long int chunksize,
+                                                      montgomery m) {
+    std::vector<unsigned long long int> rowsum(n, 0);
+    unsigned long long int total = 0;
+
+    if (chunksize == 0)
+        return total;
+
+    unsigned long long int subset = (X + 1) ^ ((X + 1) >> 1);
+    int size = 0;
+
+    for (int i = 0; i < n; i++) {
+        if ((subset >> i) & 1) {
+            size++;
+            for (int j = 0; j < n; j++)
+                rowsum[j] = m.add(rowsum[j], mat[i * n + j]);
+        }
+    }
+
+    for (unsigned long long int k = X; k < X + chunksize; k++) {
+        if (k > X) {
+            // the Gray code of k+1 differs from that of k in the lowest set bit of k+1
+            int i = __builtin_ctzll(k + 1);
+            subset ^= 1ULL << i;
+
+            if ((subset >> i) & 1) {
+                size++;
+                for (int j = 0; j < n; j++)
+                    rowsum[j] = m.add(rowsum[j], mat[i * n + j]);
+            }
+            else {
+                size--;
+                for (int j = 0; j < n; j++)
+                    rowsum[j] = m.sub(rowsum[j], mat[i * n + j]);
+            }
+        }
+
+        unsigned long long int prod = rowsum[0];
+        for (int j = 1; j < n; j++)
+            prod = m.mul(prod, rowsum[j]);
+
+        total = (n - size) % 2 == 0 ? m.add(total, prod) : m.sub(total, prod);
+    }
+
+    return total;
+}
+
+/**
+ * Returns the base-2 logarithm of a bound on the absolute value of the
+ * hafnian of an integer matrix, using \f$|\text{haf}(A)|^2\leq\text{per}(|A|)\f$
+ * and bounding the permanent by the product of the row sums.
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an
+ *      \f$n\times n\f$ row-ordered symmetric matrix.
+ * @return the logarithm of the bound, or `-INFINITY` if a row of the matrix is zero
+ */
+inline long double hafnian_bound_bits(std::vector<long long int> &mat) {
+    int n = std::sqrt(static_cast<double>(mat.size()));
+    long double bits = 0;
+
+    for (int i = 0; i < n; i++) {
+        long double rowsum = 0;
+        for (int j = 0; j < n; j++) {
+            if (i != j)
+                rowsum += std::fabs(static_cast<long double>(mat[i * n + j]));
+        }
+        if (rowsum == 0)
+            return -INFINITY;
+        bits += std::log2(rowsum) / 2;
+    }
+
+    return bits;
+}
+
+/**
+ * Returns the base-2 logarithm of a bound on the absolute value of the
+ * permanent of an integer matrix, the smaller of the products of the row
+ * sums and of the column sums of its absolute values.
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an
+ *      \f$n\times n\f$ row-ordered matrix.
+ * @return the logarithm of the bound, or `-INFINITY` if a row or column of the matrix is zero
+ */
+inline long double permanent_bound_bits(std::vector<long long int> &mat) {
+    int n = std::sqrt(static_cast<double>(mat.size()));
+    long double rowbits = 0, colbits = 0;
+
+    for (int i = 0; i < n; i++) {
+        long double rowsum = 0, colsum = 0;
+        for (int j = 0; j < n; j++) {
+            rowsum += std::fabs(static_cast<long double>(mat[i * n + j]));
+            colsum += std::fabs(static_cast<long double>(mat[j * n + i]));
+        }
+        if (rowsum == 0 || colsum == 0)
+            return -INFINITY;
+        rowbits += std::log2(rowsum);
+        colbits += std::log2(colsum);
+    }
+
+    return std::min(rowbits, colbits);
+}
+
+/**
+ * Sets \f$x\f$ to \f$xm+a\f$, where \f$x\f$ is a non-negative integer
+ * stored as little-endian base-\f$2^{32}\f$ digits.
+ *
+ * @param x the digits of the integer
+ * @param m multiplier, smaller than \f$2^{63}\f$
+ * @param a addend, smaller than \f$2^{63}\f$
+ */
+inline void bigint_muladd(std::vector<unsigned int> &x, unsigned long long int m, unsigned long long int a) {
+    unsigned long long int carry = a;
+
+    for (std::size_t i = 0; i < x.size(); i++) {
+        uint128 t = static_cast<uint128>(x[i]) * m + carry;
+        x[i] = static_cast<unsigned int>(t);
+        carry = static_cast<unsigned long long int>(t >> 32);
+    }
+
+    while (carry > 0) {
+        x.push_back(static_cast<unsigned int>(carry));
+        carry >>= 32;
+    }
+}
+
+/**
+ * Compares two non-negative integers stored as little-endian
+ * base-\f$2^{32}\f$ digits without leading zeros.
+ *
+ * @return -1, 0 or 1 if `x` is smaller than, equal to or larger than `y`
+ */
+inline int bigint_compare(const std::vector<unsigned int> &x, const std::vector<unsigned int> &y) {
+    if (x.size() != y.size())
+        return x.size() < y.size() ? -1 : 1;
+
+    for (std::size_t i = x.size(); i-- > 0;) {
+        if (x[i] != y[i])
+            return x[i] < y[i] ? -1 : 1;
+    }
+
+    return 0;
+}
+
+/**
+ * Returns \f$x-y\f$ for non-negative integers \f$x\geq y\f$ stored as
+ * little-endian base-\f$2^{32}\f$ digits.
+ */
+inline std::vector<unsigned int> bigint_subtract(const std::vector<unsigned int> &x, const std::vector<unsigned int> &y) {
+    std::vector<unsigned int> r(x.size());
+    long long int borrow = 0;
+
+    for (std::size_t i = 0; i < x.size(); i++) {
+        long long int t = static_cast<long long int>(x[i]) - borrow - (i < y.size() ? y[i] : 0);
+        borrow = t < 0;
+        r[i] = static_cast<unsigned int>(t + (borrow << 32));
+    }
+
+    while (!r.empty() && r.back() == 0)
+        r.pop_back();
+
+    return r;
+}
+
+/**
+ * Returns the decimal representation of a non-negative integer stored as
+ * little-endian base-\f$2^{32}\f$ digits.
+ */
+inline std::string bigint_decimal(std::vector<unsigned int> x) {
+    std::vector<unsigned int> chunks;
+
+    while (!x.empty()) {
+        unsigned long long int rem = 0;
+        for (std::size_t i = x.size(); i-- > 0;) {
+            unsigned long long int cur = (rem << 32) | x[i];
+            x[i] = static_cast<unsigned int>(cur / 1000000000ULL);
+            rem = cur % 1000000000ULL;
+        }
+        chunks.push_back(static_cast<unsigned int>(rem));
+
+        while (!x.empty() && x.back() == 0)
+            x.pop_back();
+    }
+
+    if (chunks.empty())
+        return "0";
+
+    std::string s = std::to_string(chunks.back());
+    for (std::size_t i = chunks.size() - 1; i-- > 0;) {
+        std::string c = std::to_string(chunks[i]);
+        s += std::string(9 - c.size(), '0') + c;
+    }
+
+    return s;
+}
+
+/**
+ * Returns the integer of smallest absolute value with the given residues,
+ * reconstructed with the Chinese remainder theorem using Garner's algorithm.
+ *
+ * @param residues the residues of the integer modulo each prime
+ * @param primes the distinct primes, each smaller than \f$2^{62}\f$
+ * @return the decimal representation of the integer
+ */
+inline std::string crt_reconstruct(const std::vector<unsigned long long int> &residues,
+                                   const std::vector<unsigned long long int> &primes) {
+    std::size_t k = primes.size();
+    std::vector<unsigned long long int> v(k);
+
+    // mixed-radix digits, x = v_0 + v_1 p_0 + v_2 p_0 p_1 + ...
+    for (std::size_t i = 0; i < k; i++) {
+        unsigned long long int p = primes[i];
+        unsigned long long int t = 0, prod = 1;
+
+        for (std::size_t j = 0; j < i; j++) {
+            t = (t + mulmod(v[j], prod, p)) % p;
+            prod = mulmod(prod, primes[j] % p, p);
+        }
+
+        unsigned long long int r = residues[i] % p;
+        v[i] = mulmod(r >= t ? r - t : r + p - t, powmod(prod, p - 2, p), p);
+    }
+
+    std::vector<unsigned int> x, P(1, 1);
+
+    for (std::size_t i = k; i-- > 0;) {
+        bigint_muladd(x, primes[i], v[i]);
+        bigint_muladd(P, primes[i], 0);
+    }
+
+    while (!x.empty() && x.back() == 0)
+        x.pop_back();
+
+    std::vector<unsigned int> twice = x;
+    bigint_muladd(twice, 2, 0);
+
+    if (bigint_compare(twice, P) > 0)
+        return "-" + bigint_decimal(bigint_subtract(P, x));
+
+    return bigint_decimal(x);
+}
+
+/**
+ * Returns the residues of the hafnian of an integer matrix modulo each prime,
+ * computed in parallel.
+ *
+ * This function uses OpenMP (if available) to compute the residues as
+ * concurrent tasks, each of which is parallelized as in hafnian_recursive().
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an
+ *      \f$n\times n\f$ row-ordered symmetric matrix, with \f$n\f$ even.
+ * @param primes the primes, each smaller than \f$2^{62}\f$
+ * @return the residues
+ */
+inline std::vector<unsigned long long int> hafnian_residues(std::vector<long long int> &mat,
+                                                           const std::vector<unsigned long long int> &primes) {
+    int k = primes.size();
+    std::vector<unsigned long long int> residues(k, 0);
+
+    #pragma omp parallel
+    #pragma omp single nowait
+    for (int i = 0; i < k; i++) {
+        #pragma omp task shared(mat, primes, residues)
+        residues[i] = hafnian_modular(mat, montgomery(primes[i]));
+    }
+
+    return residues;
+}
+
+/**
+ * Returns the residues of the permanent of an integer matrix modulo each
+ * prime, using Ryser's formula with Gray code ordering.
+ *
+ * This function uses OpenMP (if available) to parallelize over the primes
+ * and over chunks of the Gray code for every prime.
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an
+ *      \f$n\times n\f$ row-ordered matrix, with \f$1\leq n\leq 63\f$.
+ * @param primes the primes, each smaller than \f$2^{62}\f$
+ * @return the residues
+ */
+inline std::vector<unsigned long long int> permanent_residues(std::vector<long long int> &mat,
+                                                             const std::vector<unsigned long long int> &primes) {
+    int n = std::sqrt(static_cast<double>(mat.size()));
+    int k = primes.size();
+
+#ifdef _OPENMP
+    int nchunks = omp_get_max_threads();
+#else
+    int nchunks = 1;
+#endif
+
+    unsigned long long int terms = (1ULL << n) - 1;
+    std::vector<unsigned long long int> partial(k * nchunks, 0);
+
+    #pragma omp parallel for schedule(dynamic)
+    for (int t = 0; t < k * nchunks; t++) {
+        int i = t / nchunks, c = t % nchunks;
+        montgomery m(primes[i]);
+
+        std::vector<unsigned long long int> matm(mat.size());
+        for (std::size_t j = 0; j < mat.size(); j++)
+            matm[j] = m.from_integer(mat[j]);
+
+        unsigned long long int lo = c * (terms / nchunks) + std::min<unsigned long long int>(c, terms % nchunks);
+        unsigned long long int hi = (c + 1) * (terms / nchunks) + std::min<unsigned long long int>(c + 1, terms % nchunks);
+
+        partial[t] = permanent_modular_chunk(matm, n, lo, hi - lo, m);
+    }
+
+    std::vector<unsigned long long int> residues(k, 0);
+
+    for (int i = 0; i < k; i++) {
+        montgomery m(primes[i]);
+        unsigned long long int total = 0;
+        for (int c = 0; c < nchunks; c++)
+            total = m.add(total, partial[i * nchunks + c]);
+        residues[i] = m.to_residue(total);
+    }
+
+    return residues;
+}
+
+/**
+ * Returns the exact hafnian of an integer matrix.
+ *
+ * The hafnian is computed modulo as many primes as are needed to determine
+ * it (see hafnian_bound_bits()), in parallel, using the recursive algorithm
+ * described in *Counting perfect matchings as fast as Ryser*
+ * :cite:`bjorklund2012counting`, and reconstructed with the Chinese remainder
+ * theorem. Unlike hafnian_recursive(), the result cannot overflow.
+ *
+ * This is a wrapper for Python integration; it returns sensible values for
+ * empty and non-even matrices.
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an
+ *      \f$n\times n\f$ row-ordered symmetric matrix.
+ * @return the decimal representation of the hafnian
+ */
+std::string hafnian_int(std::vector<long long int> &mat) {
+    int n = std::sqrt(static_cast<double>(mat.size()));
+
+    if (n == 0)
+        return "1";
+    if (n % 2 != 0)
+        return "0";
+
+    long double bits = hafnian_bound_bits(mat);
+    if (bits == -INFINITY)
+        return "0";
+
+    std::vector<unsigned long long int> primes = modular_primes(modular_primes_needed(bits));
+    return crt_reconstruct(hafnian_residues(mat, primes), primes);
+}
+
+/**
+ * Returns the exact permanent of an integer matrix.
+ *
+ * The permanent is computed modulo as many primes as are needed to determine
+ * it (see permanent_bound_bits()), in parallel, using Ryser's formula with
+ * Gray code ordering, and reconstructed with the Chinese remainder theorem.
+ *
+ * This is a wrapper for Python integration; it returns sensible values for
+ * empty matrices.
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an
+ *      \f$n\times n\f$ row-ordered matrix, with \f$n\leq 63\f$.
+ * @return the decimal representation of the permanent
+ */
+std::string permanent_int(std::vector<long long int> &mat) {
+    int n = std::sqrt(static_cast<double>(mat.size()));
+
+    if (n == 0)
+        return "1";
+
+    long double bits = permanent_bound_bits(mat);
+    if (bits == -INFINITY)
+        return "0";
+
+    std::vector<unsigned long long int> primes = modular_primes(modular_primes_needed(bits));
+    return crt_reconstruct(permanent_residues(mat, primes), primes);
+}
+
+}
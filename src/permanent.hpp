@@ -16,6 +16,7 @@
 #include <numeric>
 #include <random>
 #include "fsum.hpp"
+#include "double_double.hpp"
 
 typedef unsigned long long int ullint;
 typedef long long int llint;
@@ -89,24 +90,42 @@ std::vector<int> dec2bin(llint &k, int &n) {
 namespace hafnian {
 
 /**
- * Returns the permanent of an matrix.
- *
- * \rst
- *
- * Returns the permanent of a matrix using Ryser's algorithm with Gray code ordering.
+ * Returns the absolute value of a term as a double, used to estimate the
+ * rounding error of a sum of terms.
+ */
+template <typename T>
+inline double abs_double(const T &x) {
+    using std::abs;
+    return static_cast<double>(abs(x));
+}
+
+/**
+ * Returns the absolute value of a quadruple precision term as a double.
+ */
+inline double abs_double(const qp &x) {
+    return std::fabs(static_cast<double>(x));
+}
+
+/**
+ * Calculates the partial sum \f$X,X+1,\dots,X+\text{chunksize}-1\f$ of
+ * Ryser's formula for the permanent of matrix `mat`, where term \f$k\f$
+ * corresponds to the subset of rows given by the Gray code of \f$k+1\f$.
  *
- * \endrst
+ * Note that if `X=0` and `chunksize=pow(2,n)-1`, then the full permanent is calculated.
  *
+ * This function uses OpenMP (if available) to parallelize the reduction.
  *
  * @param mat  a flattened vector of size \f$n^2\f$, representing an
  *      \f$n\times n\f$ row-ordered symmetric matrix.
- * @return permanent of the input matrix
+ * @param n size of the matrix
+ * @param X initial index of the partial sum
+ * @param chunksize length of the partial sum
+ * @param magnitude if not null, on exit contains the sum of the absolute
+ *      values of the terms, used to estimate the rounding error (see permanent_adaptive())
+ * @return the partial sum for the permanent
  */
 template <typename T>
-inline T permanent(std::vector<T> &mat) {
-    int n = std::sqrt(static_cast<double>(mat.size()));
-    llint x = static_cast<llint>(pow(2,n) - 1) ;
-
+inline T permanent_chunk(std::vector<T> &mat, int n, llint X, llint chunksize, double *magnitude = nullptr) {
 #ifdef _OPENMP
     int nthreads = omp_get_max_threads();
     omp_set_num_threads(nthreads);
@@ -115,20 +134,22 @@ inline T permanent(std::vector<T> &mat) {
 #endif
 
     std::vector<T> tot(nthreads, static_cast<T>(0));
+    std::vector<double> abstot(nthreads, 0.0);
 
     std::vector<llint> threadbound_low(nthreads);
     std::vector<llint> threadbound_hi(nthreads);
 
     for (int i=0; i < nthreads; i++) {
 
-        threadbound_low[i] = i*x/nthreads;
-        threadbound_hi[i] = (i+1)*x/nthreads;
+        threadbound_low[i] = X + i*(chunksize/nthreads) + std::min<llint>(i, chunksize % nthreads);
+        threadbound_hi[i] = X + (i+1)*(chunksize/nthreads) + std::min<llint>(i+1, chunksize % nthreads);
     }
-    threadbound_hi[nthreads-1] = x;
+    threadbound_hi[nthreads-1] = X + chunksize;
 
     #pragma omp parallel for shared(tot)
     for (int ii = 0; ii < nthreads; ii++) {
         T permtmp = static_cast<T>(0);
+        double abstmp = 0.0;
         int cntr = 0;
         std::vector<int> chitmp(n, 0);
         std::vector<T> tmp(n, static_cast<T>(0));
@@ -174,14 +195,183 @@ inline T permanent(std::vector<T> &mat) {
             else
                 permtmp -= rowsumprod;
 
+            if (magnitude != nullptr)
+                abstmp += abs_double(rowsumprod);
+
         }
         tot[ii] = permtmp;
+        abstot[ii] = abstmp;
     }
 
+    if (magnitude != nullptr)
+        *magnitude = std::accumulate(abstot.begin(), abstot.end(), 0.0);
+
     return static_cast<T>(std::accumulate(tot.begin(), tot.end(), static_cast<T>(0)));
 }
 
 
+/**
+ * Returns the permanent of an matrix.
+ *
+ * \rst
+ *
+ * Returns the permanent of a matrix using Ryser's algorithm with Gray code ordering.
+ *
+ * \endrst
+ *
+ *
+ * @param mat  a flattened vector of size \f$n^2\f$, representing an
+ *      \f$n\times n\f$ row-ordered symmetric matrix.
+ * @return permanent of the input matrix
+ */
+template <typename T>
+inline T permanent(std::vector<T> &mat) {
+    int n = std::sqrt(static_cast<double>(mat.size()));
+    llint x = static_cast<llint>(pow(2,n) - 1) ;
+
+    return permanent_chunk(mat, n, 0, x);
+}
+
+
+/**
+ * Calculates the partial sum \f$X,X+1,\dots,X+\text{chunksize}-1\f$ of
+ * Glynn's formula for the permanent of matrix `mat`,
+ *
+ * \f[
+ *     \text{perm}(A) = \frac{1}{2^{n-1}} \sum_{\delta} \left(\prod_{k=0}^{n-1}\delta_k\right)
+ *         \prod_{j=0}^{n-1} \sum_{i=0}^{n-1} \delta_i a_{ij},
+ * \f]
+ *
+ * where \f$\delta_0=1\f$ and \f$\delta_i=-1\f$, \f$i\geq 1\f$, if and only
+ * if bit \f$i-1\f$ of the Gray code of the index of the term is set.
+ *
+ * Note that if `X=0` and `chunksize=pow(2,n-1)`, then the full permanent is calculated.
+ *
+ * Consecutive terms differ in the sign of a single row, so that the column
+ * sums are updated by twice that row, which is exact in floating point. The
+ * column sums stay of the size of the entries, whereas those of Ryser's
+ * formula grow with the number of rows of the subset, so that the terms
+ * cancel less and the result is more accurate.
+ *
+ * This function uses OpenMP (if available) to parallelize the reduction,
+ * splitting the terms between the threads as permanent_chunk() does.
+ *
+ * @param mat  a flattened vector of size \f$n^2\f$, representing an
+ *      \f$n\times n\f$ row-ordered matrix.
+ * @param n size of the matrix
+ * @param X initial index of the partial sum
+ * @param chunksize length of the partial sum
+ * @param magnitude if not null, on exit contains the sum of the absolute
+ *      values of the terms, divided by \f$2^{n-1}\f$
+ * @return the partial sum for the permanent
+ */
+template <typename T>
+inline T permanent_glynn_chunk(std::vector<T> &mat, int n, llint X, llint chunksize, double *magnitude = nullptr) {
+#ifdef _OPENMP
+    int nthreads = omp_get_max_threads();
+    omp_set_num_threads(nthreads);
+#else
+    int nthreads = 1;
+#endif
+
+    std::vector<T> tot(nthreads, static_cast<T>(0));
+    std::vector<double> abstot(nthreads, 0.0);
+
+    std::vector<llint> threadbound_low(nthreads);
+    std::vector<llint> threadbound_hi(nthreads);
+
+    for (int i=0; i < nthreads; i++) {
+
+        threadbound_low[i] = X + i*(chunksize/nthreads) + std::min<llint>(i, chunksize % nthreads);
+        threadbound_hi[i] = X + (i+1)*(chunksize/nthreads) + std::min<llint>(i+1, chunksize % nthreads);
+    }
+    threadbound_hi[nthreads-1] = X + chunksize;
+
+    #pragma omp parallel for shared(tot)
+    for (int ii = 0; ii < nthreads; ii++) {
+        T permtmp = static_cast<T>(0);
+        double abstmp = 0.0;
+        std::vector<T> tmp(n, static_cast<T>(0));
+
+        for (llint k = threadbound_low[ii]; k < threadbound_hi[ii]; k++) {
+            T rowsumprod = static_cast<T>(1);
+            ullint kg = gray_code(k);
+
+            if ( k == threadbound_low[ii] ) {
+                for (int j = 0; j < n; j++) {
+                    T localsum = mat[j];
+                    for (int id = 1; id < n; id++) {
+                        if ((kg >> (id - 1)) & 1ULL)
+                            localsum -= mat[id*n+j];
+                        else
+                            localsum += mat[id*n+j];
+                    }
+                    tmp[j] = localsum;
+                    rowsumprod *= tmp[j];
+                }
+            }
+            else {
+                // row pos changes sign, and was positive if its bit is now set
+                int pos = trailing_zeros(k) + 1;
+                bool neg = (kg >> (pos - 1)) & 1ULL;
+
+                for (int j = 0; j < n; j++) {
+                    T delta = mat[pos*n+j] + mat[pos*n+j];
+                    if (neg)
+                        tmp[j] -= delta;
+                    else
+                        tmp[j] += delta;
+
+                    rowsumprod *= tmp[j];
+                }
+            }
+
+            if (popcount(kg) % 2 == 0)
+                permtmp += rowsumprod;
+            else
+                permtmp -= rowsumprod;
+
+            if (magnitude != nullptr)
+                abstmp += abs_double(rowsumprod);
+        }
+        tot[ii] = permtmp;
+        abstot[ii] = abstmp;
+    }
+
+    double scale = std::ldexp(1.0, 1 - n);
+
+    if (magnitude != nullptr)
+        *magnitude = scale * std::accumulate(abstot.begin(), abstot.end(), 0.0);
+
+    return static_cast<T>(scale) * std::accumulate(tot.begin(), tot.end(), static_cast<T>(0));
+}
+
+
+/**
+ * Returns the permanent of an matrix.
+ *
+ * \rst
+ *
+ * Returns the permanent of a matrix using Glynn's formula with Gray code ordering,
+ * which has \f$2^{n-1}\f$ terms, half as many as Ryser's formula.
+ *
+ * \endrst
+ *
+ *
+ * @param mat  a flattened vector of size \f$n^2\f$, representing an
+ *      \f$n\times n\f$ row-ordered matrix.
+ * @return permanent of the input matrix
+ */
+template <typename T>
+inline T permanent_glynn(std::vector<T> &mat) {
+    int n = std::sqrt(static_cast<double>(mat.size()));
+
+    if (n == 0)
+        return static_cast<T>(1);
+
+    return permanent_glynn_chunk(mat, n, 0, 1LL << (n - 1));
+}
+
 
 /**
  * Returns the permanent of an matrix using fsum.
@@ -316,15 +506,65 @@ std::complex<double> permanent_quad(std::vector<std::complex<double>> &mat) {
  * returns sensible values for empty and non-even matrices.
  *
  * In addition, this wrapper function automatically casts all matrices
- * to type `long double`, allowing for greater precision than supported
- * by Python and NumPy.
+ * to type `double_double`, allowing for greater precision than supported
+ * by Python and NumPy, at a fraction of the cost of `__float128`.
  *
  * @param mat vector representing the flattened matrix
  * @return the permanent
  */
 double permanent_quad(std::vector<double> &mat) {
-    std::vector<qp> matq(mat.begin(), mat.end());
-    qp perm = permanent(matq);
+    std::vector<double_double> matq(mat.begin(), mat.end());
+    double_double perm = permanent(matq);
+    return static_cast<double>(perm);
+}
+
+
+
+/**
+ * \rst
+ *
+ * Returns the permanent of a matrix using Glynn's formula with Gray code ordering
+ *
+ * \endrst
+ *
+ *
+ * This is a wrapper around the templated function `hafnian::permanent_glynn` for Python
+ * integration. It accepts and returns complex double numeric types.
+ *
+ * In addition, this wrapper function automatically casts all matrices
+ * to type `complex<long double>`, allowing for greater precision than supported
+ * by Python and NumPy.
+ *
+ * @param mat vector representing the flattened matrix
+ * @return the permanent
+ */
+std::complex<double> permanent_glynn_quad(std::vector<std::complex<double>> &mat) {
+    std::vector<std::complex<long double>> matq(mat.begin(), mat.end());
+    std::complex<long double> perm = permanent_glynn(matq);
+    return static_cast<std::complex<double>>(perm);
+}
+
+/**
+ * \rst
+ *
+ * Returns the permanent of a matrix using Glynn's formula with Gray code ordering
+ *
+ * \endrst
+ *
+ *
+ * This is a wrapper around the templated function `hafnian::permanent_glynn` for Python
+ * integration. It accepts and returns double numeric types.
+ *
+ * In addition, this wrapper function automatically casts all matrices
+ * to type `double_double`, allowing for greater precision than supported
+ * by Python and NumPy, at a fraction of the cost of `__float128`.
+ *
+ * @param mat vector representing the flattened matrix
+ * @return the permanent
+ */
+double permanent_glynn_quad(std::vector<double> &mat) {
+    std::vector<double_double> matq(mat.begin(), mat.end());
+    double_double perm = permanent_glynn(matq);
     return static_cast<double>(perm);
 }
 
@@ -22,31 +22,392 @@
  */
 #pragma once
 #include <stdafx.h>
+#include <components.hpp>
+#include <sparse_hafnian.hpp>
+#include <permanent.hpp>
+#include <truncated_product.hpp>
 
 
 namespace hafnian {
 
+/**
+ * Preallocated memory for recursive_chunk().
+ *
+ * A call of recursive_chunk() with \f$s=2k+2\f$ remaining vertices writes
+ * the polynomials passed to its second child into level \f$k\f$, which
+ * holds the \f$k(2k-1)\f$ polynomials of the paths between the remaining
+ * \f$2k\f$ vertices, and the generating function. Only one call per level
+ * is active at any time, so the recursion performs no heap allocations; in
+ * total, \f$O(n^3)\f$ polynomials are stored for a matrix of size \f$2n\f$.
+ *
+ * The workspace also records the nodes on the path from the root of the
+ * recursion to the node last reached by recursive_seek().
+ *
+ * A workspace must not be shared between threads.
+ */
+template <typename T>
+class recursive_workspace {
+public:
+    /**
+     * Allocates the levels \f$0\leq k<\f$ `levels` for polynomials of degree `n`.
+     *
+     * @param levels number of levels
+     * @param n degree of the polynomials
+     */
+    recursive_workspace(int levels, int n)
+        : b(levels), g(levels), path_b(levels + 1, nullptr), path_g(levels + 1, nullptr) {
+        for (int k = 0; k < levels; k++) {
+            b[k].assign(k * (2 * k - 1) * (n + 1), static_cast<T>(0));
+            g[k].assign(n + 1, static_cast<T>(0));
+        }
+    }
+
+    /// path polynomials of each level
+    std::vector<std::vector<T>> b;
+    /// generating function of each level
+    std::vector<std::vector<T>> g;
+    /// path polynomials of the nodes reached by recursive_seek(), by depth
+    std::vector<const T *> path_b;
+    /// generating functions of the nodes reached by recursive_seek(), by depth
+    std::vector<const T *> path_g;
+};
+
+
+/**
+ * Contracts the last two of the `s` remaining vertices of a node of the
+ * recursion of recursive_chunk(), and stores the polynomials of its second
+ * child in `c` and `e`.
+ *
+ * Since the polynomials of the pairs \f$(j,k)\f$, \f$j>k\f$, are stored at
+ * index \f$j(j-1)/2+k\f$, those of the first \f$s-2\f$ vertices are a prefix
+ * of `b`, so that the first child reads `b` and `g` unchanged.
+ *
+ * @param b polynomials of the paths between the remaining vertices
+ * @param g generating function of the closed cycles
+ * @param s number of remaining vertices
+ * @param n degree of the polynomials
+ * @param c on exit, the polynomials of the paths between the first \f$s-2\f$ vertices
+ * @param e on exit, the generating function of the second child
+ */
+template <typename T>
+inline void contract_pair(const T *b, const T *g, int s, int n, T *c, T *e) {
+    int np = n + 1;
+    int a = s - 2;
+    int k = a / 2;
+    const T *ba = b + np * (a * (a - 1) / 2);
+    const T *bb = b + np * ((a + 1) * a / 2);
+
+    std::copy(b, b + np * k * (2 * k - 1), c);
+    std::copy(g, g + np, e);
+    add_truncated_product(e, g, bb + np * a, n);
+
+    for (int j = 1; j < a; j++) {
+        for (int i = 0; i < j; i++) {
+            add_truncated_products(c + np * (j * (j - 1) / 2 + i), ba + np * j, bb + np * i, ba + np * i, bb + np * j, n);
+        }
+    }
+}
+
+
 /**
  * Recursive hafnian solver.
  *
  * Modified with permission from https://github.com/eklotek/Hafnian.
  *
- * This function uses OpenMP (if available) to parallelize the reduction.
+ * The last two of the `s` remaining vertices are contracted at each step
+ * (see contract_pair()). The first child reads the polynomials of its
+ * parent in place, and those of the second child are written to level
+ * \f$s/2-1\f$ of `ws`. The recursion is sequential; hafnian_recursive()
+ * distributes its subtrees between threads.
  *
- * @param b
- * @param s
- * @param w
- * @param g
- * @param n
+ * @param b polynomials of the paths between the remaining vertices
+ * @param s number of remaining vertices
+ * @param w sign of the term
+ * @param g generating function of the closed cycles
+ * @param n degree of the polynomials
+ * @param ws workspace with at least \f$s/2\f$ levels
  * @return the hafnian
  */
 template <typename T>
-inline T recursive_chunk(std::vector<T> b, int s, int w, std::vector<T> g, int n) {
+inline T recursive_chunk(const T *b, int s, int w, const T *g, int n, recursive_workspace<T> &ws) {
+    if (s == 0) {
+        return static_cast<T>(w) * g[n];
+    }
+
+    int k = s / 2 - 1;
+    T *c = ws.b[k].data();
+    T *e = ws.g[k].data();
+
+    T h1 = recursive_chunk(b, s - 2, -w, g, n, ws);
+
+    contract_pair(b, g, s, n, c, e);
+    T h2 = recursive_chunk(c, s - 2, w, e, n, ws);
+
+    return h1 + h2;
+}
+
+
+/**
+ * Moves `ws` to the node at depth `depth` of the recursion of
+ * recursive_chunk() whose path from the root is given by the bits of `x`,
+ * most significant first: a zero bit selects the first child, and a one
+ * the second. The node is stored in `ws.path_b[depth]` and `ws.path_g[depth]`.
+ *
+ * `ws.path_b[0]` and `ws.path_g[0]` must point to the polynomials of the
+ * root, and the nodes at depths up to `from` must be those reached by the
+ * previous call, so that only the nodes below `from` are recomputed.
+ *
+ * @param x path from the root
+ * @param depth depth of the node
+ * @param from depth up to which the path is unchanged
+ * @param n number of pairs of vertices of the matrix
+ * @param ws workspace with \f$n\f$ levels
+ * @return sign of the node
+ */
+template <typename T>
+inline int recursive_seek(unsigned long long int x, int depth, int from, int n, recursive_workspace<T> &ws) {
+    for (int i = from; i < depth; i++) {
+        if ((x >> (depth - 1 - i)) & 1ULL) {
+            int k = n - i - 1;
+            contract_pair(ws.path_b[i], ws.path_g[i], 2 * (n - i), n, ws.b[k].data(), ws.g[k].data());
+            ws.path_b[i + 1] = ws.b[k].data();
+            ws.path_g[i + 1] = ws.g[k].data();
+        }
+        else {
+            ws.path_b[i + 1] = ws.path_b[i];
+            ws.path_g[i + 1] = ws.path_g[i];
+        }
+    }
+
+    int zeros = depth - popcount(x);
+    return (zeros % 2 == 0) ? 1 : -1;
+}
+
+
+/**
+ * Returns the polynomials of the paths between the vertices at the root of
+ * the recursion of recursive_chunk(): the polynomial of the pair
+ * \f$(j,k)\f$, \f$j>k\f$, is the constant `mat[j][k]`, stored at index
+ * \f$j(j-1)/2+k\f$.
+ *
+ * @param mat a flattened vector of size \f$4n^2\f$, representing a
+ *      \f$2n\times 2n\f$ row-ordered symmetric matrix
+ * @param n number of pairs of vertices of the matrix
+ * @return the polynomials of degree \f$n\f$ of all pairs of vertices
+ */
+template <typename T>
+inline std::vector<T> recursive_polynomials(std::vector<T> &mat, int n) {
+    std::vector<T> z(n * (2 * n - 1) * (n + 1), static_cast<T>(0));
+
+    #pragma omp parallel for
+    for (int j = 1; j < 2 * n; j++) {
+        for (int k = 0; k < j; k++) {
+            z[(n + 1) * (j * (j - 1) / 2 + k)] = mat[2 * j * n + k];
+        }
+    }
+
+    return z;
+}
+
+
+/**
+ * Returns the depth at which hafnian_recursive() splits the recursion
+ * into independent subtrees, so that each of `nthreads` threads receives
+ * at least eight of them. Below this depth the recursion runs sequentially.
+ *
+ * @param n number of pairs of vertices of the matrix
+ * @param nthreads number of threads
+ * @return the cutoff depth
+ */
+inline int recursive_cutoff(int n, int nthreads) {
+    int depth = 3;
+    while ((1LL << depth) < 8LL * nthreads)
+        depth++;
+
+    return std::min(depth, n);
+}
+
+
+/**
+ * Returns the hafnian of an matrix.
+ *
+ * \rst
+ *
+ * Returns the hafnian of a matrix using the recursive algorithm described in
+ * *Counting perfect matchings as fast as Ryser* :cite:`bjorklund2012counting`,
+ * where it is labelled as 'Algorithm 2'.
+ *
+ * \endrst
+ *
+ * Modified with permission from https://github.com/eklotek/Hafnian.
+ *
+ * The \f$2^d\f$ subtrees of the recursion at the cutoff depth \f$d\f$ all
+ * have the same size, and are handed out to the OpenMP threads one at a
+ * time, so that threads which finish early pick up the remaining ones.
+ * Each thread descends to its next subtree with recursive_seek(),
+ * reusing the part of the path it shares with its previous subtree, and
+ * runs the recursion below the cutoff sequentially. The results of the
+ * subtrees are summed with tree_reduce(), so that the result does not
+ * depend on the number of threads.
+ *
+ * @param mat  a flattened vector of size \f$n^2\f$, representing an
+ *      \f$n\times n\f$ row-ordered symmetric matrix.
+ * @param cutoff depth at which the recursion is split between threads;
+ *      if negative, it is chosen from the number of threads by recursive_cutoff()
+ * @return hafnian of the input matrix
+ */
+template <typename T>
+inline T hafnian_recursive(std::vector<T> &mat, int cutoff = -1) {
+    int n = std::sqrt(static_cast<double>(mat.size())) / 2;
+
+    std::vector<T> z = recursive_polynomials(mat, n);
+    std::vector<T> g(n + 1, static_cast<T>(0));
+
+    g[0] = 1;
+
+#ifdef _OPENMP
+    int nthreads = omp_get_max_threads();
+#else
+    int nthreads = 1;
+#endif
+
+    int depth = (cutoff < 0) ? recursive_cutoff(n, nthreads) : std::min(cutoff, n);
+    long long int subtrees = 1LL << depth;
+    std::vector<T> partial(subtrees, static_cast<T>(0));
+
+    #pragma omp parallel
+    {
+        recursive_workspace<T> ws(n, n);
+        ws.path_b[0] = z.data();
+        ws.path_g[0] = g.data();
+        long long int previous = -1;
+
+        #pragma omp for schedule(dynamic, 1)
+        for (long long int x = 0; x < subtrees; x++) {
+            // the path is unchanged above the highest bit in which x
+            // differs from the previous subtree of this thread
+            int from = 0;
+            if (previous >= 0)
+                from = depth - bit_length(x ^ previous);
+
+            int w = recursive_seek(x, depth, from, n, ws);
+            partial[x] = recursive_chunk(ws.path_b[depth], 2 * (n - depth), w, ws.path_g[depth], n, ws);
+            previous = x;
+        }
+    }
+
+    return tree_reduce(partial);
+}
+
+
+/**
+ * Calculates the partial sum of the leaves \f$X,X+1,\dots,X+\text{chunksize}-1\f$
+ * of the recursion of recursive_chunk() for the hafnian of matrix `mat`.
+ *
+ * Note that if `X=0` and `chunksize=pow(2.0, n/2)`, then the full hafnian
+ * is calculated.
+ *
+ * Leaf \f$x\f$ is reached from the root by the bits of \f$x\f$, most
+ * significant first, as in recursive_seek(); a one bit contracts the last
+ * two remaining vertices. The leaves are visited in this order, which is
+ * the order of the recursion, so that the leaves of a range share the
+ * nodes of the longest possible paths. The polynomials of the first leaf of
+ * a range are built from the root in \f$n/2\f$ contractions, that is in
+ * polynomial time, and each subsequent leaf \f$x\f$ recomputes only the
+ * \f$1+\text{trailing_zeros}(x)\f$ deepest levels of its path, which
+ * amortises to two contractions per leaf. Contrary to do_chunk(), the Gray
+ * order brings no savings here: a change of any bit of the path invalidates
+ * every node below it.
+ *
+ * This function uses OpenMP (if available) to parallelize the reduction.
+ * The leaves are split into one contiguous range of equal length per thread,
+ * since all leaves are reached at the same depth. Each thread allocates a
+ * single recursive_workspace, so that no heap allocations are performed per
+ * leaf, and sums its leaves with pairwise_sum(). The partial sums of the
+ * threads are then combined in a fixed tree order, so that the result is
+ * reproducible for a given number of threads.
+ *
+ * @param mat vector representing the flattened matrix
+ * @param n size of the matrix
+ * @param X initial index of the partial sum
+ * @param chunksize length of the partial sum
+ * @return the partial sum for the hafnian
+ */
+template <typename T>
+inline T do_chunk_recursive(std::vector<T> &mat, int n, unsigned long long int X, unsigned long long int chunksize) {
+    int m = n / 2;
+
+    std::vector<T> z = recursive_polynomials(mat, m);
+    std::vector<T> g(m + 1, static_cast<T>(0));
+
+    g[0] = 1;
+
+#ifdef _OPENMP
+    int nthreads = omp_get_max_threads();
+#else
+    int nthreads = 1;
+#endif
+
+    unsigned long long int len = chunksize / nthreads;
+    unsigned long long int rem = chunksize % nthreads;
+    std::vector<T> partial(nthreads, static_cast<T>(0.0));
+
+    #pragma omp parallel for num_threads(nthreads) schedule(static, 1)
+    for (int ii = 0; ii < nthreads; ii++) {
+        unsigned long long int first = X + ii * len + std::min<unsigned long long int>(ii, rem);
+        unsigned long long int last = first + len + (static_cast<unsigned long long int>(ii) < rem ? 1 : 0);
+
+        recursive_workspace<T> ws(m, m);
+        ws.path_b[0] = z.data();
+        ws.path_g[0] = g.data();
+        pairwise_sum<T> localsum;
+
+        for (unsigned long long int x = first; x < last; x++) {
+            // consecutive leaves share their paths above the lowest
+            // set bit of x
+            int from = (x == first) ? 0 : m - 1 - trailing_zeros(x);
+            int w = recursive_seek(x, m, from, m, ws);
+
+            localsum.add(static_cast<T>(w) * ws.path_g[m][m]);
+        }
+
+        partial[ii] = localsum.result();
+    }
+
+    return tree_reduce(partial);
+}
+
+
+/**
+ * Recursive loop hafnian solver.
+ *
+ * Extends recursive_chunk() to the loop hafnian. In addition to the
+ * polynomials `b` of the paths between the remaining vertices, the
+ * polynomials `d` of the paths from each remaining vertex to a loop are
+ * carried through the recursion. When the pair of vertices 0 and 1 is
+ * contracted, the paths from a vertex \f$j\f$ through the pair to a loop
+ * are added to \f$d_j\f$, and the path closed by the loops at both ends,
+ * \f$xd_0d_1\f$, is added to the generating function `g` alongside the
+ * cycle \f$xb_{10}\f$.
+ *
+ * This function uses OpenMP (if available) to parallelize the reduction.
+ *
+ * @param b polynomials of the paths between the remaining vertices
+ * @param d polynomials of the paths from the remaining vertices to a loop
+ * @param s number of remaining vertices
+ * @param w sign of the term
+ * @param g generating function of the closed cycles and paths
+ * @param n degree of the polynomials
+ * @return the loop hafnian
+ */
+template <typename T>
+inline T loop_recursive_chunk(std::vector<T> b, std::vector<T> d, int s, int w, std::vector<T> g, int n) {
     if (s == 0) {
         return static_cast<T>(w) * g[n];
     }
 
-    std::vector<T> c((s - 2) * (s - 3) / 2 * (n + 1), 0.0);
+    std::vector<T> c((s - 2) * (s - 3) / 2 * (n + 1), static_cast<T>(0));
+    std::vector<T> f((s - 2) * (n + 1), static_cast<T>(0));
     T h, h1, h2;
     int u, v, j, k, i = 0;
 
@@ -59,15 +420,35 @@ inline T recursive_chunk(std::vector<T> b, int s, int w, std::vector<T> g, int n
         }
     }
 
+    for (j = 0; j < s - 2; j++) {
+        for (u = 0; u < n + 1; u++) {
+            f[(n + 1) * j + u] = d[(n + 1) * (j + 2) + u];
+        }
+    }
+
     #pragma omp task shared(h1)
-    h1 = recursive_chunk(c, s - 2, -w, g, n);
+    h1 = loop_recursive_chunk(c, f, s - 2, -w, g, n);
+
+    // the cycle and the loop-terminated path closed by the pair
+    std::vector<T> p(b.begin(), b.begin() + n + 1);
+    for (u = 0; u < n; u++) {
+        for (v = 0; v < n - u; v++) {
+            p[u + v] += d[u] * d[n + 1 + v];
+        }
+    }
 
-    std::vector<T> e(n + 1, 0);
+    std::vector<T> e(n + 1, static_cast<T>(0));
     e = g;
 
     for (u = 0; u < n; u++) {
         for (v = 0; v < n - u; v++) {
-            e[u + v + 1] += g[u] * b[v];
+            e[u + v + 1] += g[u] * p[v];
+
+            for (j = 0; j < s - 2; j++) {
+                f[(n + 1) * j + u + v + 1] +=
+                    b[(n + 1) * ((j + 1) * (j + 2) / 2) + u] * d[n + 1 + v]
+                    + b[(n + 1) * ((j + 1) * (j + 2) / 2 + 1) + u] * d[v];
+            }
 
             for (j = 1; j < s - 2; j++) {
                 for (k = 0; k < j; k++) {
@@ -82,7 +463,7 @@ inline T recursive_chunk(std::vector<T> b, int s, int w, std::vector<T> g, int n
     }
 
     #pragma omp task shared(h2)
-    h2 = recursive_chunk(c, s - 2, w, e, n);
+    h2 = loop_recursive_chunk(c, f, s - 2, w, e, n);
 
     #pragma omp taskwait
     h = h1 + h2;
@@ -91,43 +472,54 @@ inline T recursive_chunk(std::vector<T> b, int s, int w, std::vector<T> g, int n
 }
 
 /**
- * Returns the hafnian of an matrix.
+ * Returns the loop hafnian of a matrix.
  *
  * \rst
  *
- * Returns the hafnian of a matrix using the recursive algorithm described in
+ * Returns the loop hafnian of a matrix using the recursive algorithm described in
  * *Counting perfect matchings as fast as Ryser* :cite:`bjorklund2012counting`,
- * where it is labelled as 'Algorithm 2'.
+ * where it is labelled as 'Algorithm 2', extended to the loop hafnian by
+ * carrying the diagonal through the polynomial recursion (see loop_recursive_chunk()).
  *
  * \endrst
  *
- * Modified with permission from https://github.com/eklotek/Hafnian.
+ * Matrices of odd size are padded with a vertex that is only matched to
+ * its loop, of weight one.
  *
  * @param mat  a flattened vector of size \f$n^2\f$, representing an
  *      \f$n\times n\f$ row-ordered symmetric matrix.
- * @return hafnian of the input matrix
+ * @return loop hafnian of the input matrix
  */
 template <typename T>
-inline T hafnian_recursive(std::vector<T> &mat) {
-    int n = std::sqrt(static_cast<double>(mat.size())) / 2;
+inline T loop_hafnian_recursive(std::vector<T> &mat) {
+    int size = std::sqrt(static_cast<double>(mat.size()));
+    int n = (size + 1) / 2;
 
-    std::vector<T> z(n * (2 * n - 1) * (n + 1), 0);
-    std::vector<T> g(n + 1, 0);
+    std::vector<T> z(n * (2 * n - 1) * (n + 1), static_cast<T>(0));
+    std::vector<T> d(2 * n * (n + 1), static_cast<T>(0));
+    std::vector<T> g(n + 1, static_cast<T>(0));
 
     g[0] = 1;
 
     #pragma omp parallel for
-    for (int j = 1; j < 2 * n; j++) {
+    for (int j = 1; j < size; j++) {
         for (int k = 0; k < j; k++) {
-            z[(n + 1) * (j * (j - 1) / 2 + k)] = mat[2 * j * n + k];
+            z[(n + 1) * (j * (j - 1) / 2 + k)] = mat[j * size + k];
         }
     }
 
+    for (int j = 0; j < size; j++) {
+        d[(n + 1) * j] = mat[j * size + j];
+    }
+
+    if (size % 2 != 0)
+        d[(n + 1) * size] = 1;
+
     T result;
 
     #pragma omp parallel
     #pragma omp single nowait
-    result = recursive_chunk(z, 2 * n, 1, g, n);
+    result = loop_recursive_chunk(z, d, 2 * n, 1, g, n);
 
     return result;
 }
@@ -150,7 +542,11 @@ inline T hafnian_recursive(std::vector<T> &mat) {
  *
  * In addition, this wrapper function automatically casts all matrices
  * to type `complex<long double>`, allowing for greater precision than supported
- * by Python and NumPy.
+ * by Python and NumPy. The hafnian is factorised over the connected
+ * components of the matrix (see factorised_hafnian()). The hafnian of a
+ * component whose graph has a narrow path decomposition is computed by
+ * dynamic programming (see sparse_hafnian()), and that of a component whose
+ * graph is bipartite as a permanent (see bipartite_hafnian()).
  *
  * @param mat vector representing the flattened matrix
  * @return the hafnian
@@ -165,7 +561,12 @@ std::complex<double> hafnian_recursive_quad(std::vector<std::complex<double>> &m
     else if (n % 2 != 0)
         haf = std::complex<double>(0.0, 0.0);
     else
-        haf = hafnian_recursive(matq);
+        haf = factorised_hafnian(matq, [](std::vector<std::complex<long double>> &sub) {
+            return sparse_hafnian(sub, [](std::vector<std::complex<long double>> &a) {
+                return bipartite_hafnian(a, [](std::vector<std::complex<long double>> &b) { return hafnian_recursive(b); },
+                                         [](std::vector<std::complex<long double>> &b) { return permanent(b); });
+            });
+        });
 
     return static_cast<std::complex<double>>(haf);
 }
@@ -188,7 +589,11 @@ std::complex<double> hafnian_recursive_quad(std::vector<std::complex<double>> &m
  *
  * In addition, this wrapper function automatically casts all matrices
  * to type `long double`, allowing for greater precision than supported
- * by Python and NumPy.
+ * by Python and NumPy. The hafnian is factorised over the connected
+ * components of the matrix (see factorised_hafnian()). The hafnian of a
+ * component whose graph has a narrow path decomposition is computed by
+ * dynamic programming (see sparse_hafnian()), and that of a component whose
+ * graph is bipartite as a permanent (see bipartite_hafnian()).
  *
  * @param mat vector representing the flattened matrix
  * @return the hafnian
@@ -203,7 +608,86 @@ double hafnian_recursive_quad(std::vector<double> &mat) {
     else if (n % 2 != 0)
         haf = 0.0;
     else
-        haf = hafnian_recursive(matq);
+        haf = factorised_hafnian(matq, [](std::vector<long double> &sub) {
+            return sparse_hafnian(sub, [](std::vector<long double> &a) {
+                return bipartite_hafnian(a, [](std::vector<long double> &b) { return hafnian_recursive(b); },
+                                         [](std::vector<long double> &b) { return permanent(b); });
+            });
+        });
+
+    return static_cast<double>(haf);
+}
+
+
+/**
+ * \rst
+ *
+ * Returns the loop hafnian of a matrix using the recursive algorithm described in
+ * *Counting perfect matchings as fast as Ryser* :cite:`bjorklund2012counting`,
+ * where it is labelled as 'Algorithm 2', extended to the loop hafnian.
+ *
+ * \endrst
+ *
+ * This is a wrapper around the templated function `hafnian::loop_hafnian_recursive` for Python
+ * integration. It accepts and returns complex double numeric types, and
+ * returns sensible values for empty and odd matrices.
+ *
+ * In addition, this wrapper function automatically casts all matrices
+ * to type `complex<long double>`, allowing for greater precision than supported
+ * by Python and NumPy. The loop hafnian is factorised over the connected
+ * components of the matrix (see factorised_loop_hafnian()).
+ *
+ * @param mat vector representing the flattened matrix
+ * @return the loop hafnian
+ */
+std::complex<double> loop_hafnian_recursive_quad(std::vector<std::complex<double>> &mat) {
+    std::vector<std::complex<long double>> matq(mat.begin(), mat.end());
+    int n = std::sqrt(static_cast<double>(mat.size()));
+    std::complex<long double> haf;
+
+    if (n == 0)
+        haf = std::complex<double>(1.0, 0.0);
+    else
+        haf = factorised_loop_hafnian(matq, [](std::vector<std::complex<long double>> &sub) {
+            return loop_hafnian_recursive(sub);
+        });
+
+    return static_cast<std::complex<double>>(haf);
+}
+
+
+/**
+ * \rst
+ *
+ * Returns the loop hafnian of a matrix using the recursive algorithm described in
+ * *Counting perfect matchings as fast as Ryser* :cite:`bjorklund2012counting`,
+ * where it is labelled as 'Algorithm 2', extended to the loop hafnian.
+ *
+ * \endrst
+ *
+ * This is a wrapper around the templated function `hafnian::loop_hafnian_recursive` for Python
+ * integration. It accepts and returns double numeric types, and
+ * returns sensible values for empty and odd matrices.
+ *
+ * In addition, this wrapper function automatically casts all matrices
+ * to type `long double`, allowing for greater precision than supported
+ * by Python and NumPy. The loop hafnian is factorised over the connected
+ * components of the matrix (see factorised_loop_hafnian()).
+ *
+ * @param mat vector representing the flattened matrix
+ * @return the loop hafnian
+ */
+double loop_hafnian_recursive_quad(std::vector<double> &mat) {
+    std::vector<long double> matq(mat.begin(), mat.end());
+    int n = std::sqrt(static_cast<double>(mat.size()));
+    long double haf;
+
+    if (n == 0)
+        haf = 1.0;
+    else
+        haf = factorised_loop_hafnian(matq, [](std::vector<long double> &sub) {
+            return loop_hafnian_recursive(sub);
+        });
 
     return static_cast<double>(haf);
 }
@@ -21,33 +21,171 @@
  */
 #pragma once
 #include <stdafx.h>
+#include <double_double.hpp>
+#include <workspace.hpp>
+#include <map>
 
 namespace hafnian {
 
 /**
- * Returns the hafnian of a matrix using the algorithm
- * described in *From moments of sum to moments of product*,
- * [doi:10.1016/j.jmva.2007.01.013](https://dx.doi.org/10.1016/j.jmva.2007.01.013>).
+ * Returns the number of steps of the mixed-radix counter walked by
+ * hafnian_rpt() and loop_hafnian_rpt(). Digit \f$j\f$ of the counter runs
+ * from \f$0\f$ to `rpt[j]`, and by symmetry only the first half of the
+ * \f$\prod_j(\text{rpt}_j+1)\f$ values are visited.
  *
- * Note that this algorithm, while generally slower than others, can be significantly more
- * efficient in the cases where the matrix has repeated rows and columns.
+ * @param rpt a vector of integers, representing the number of
+ *      times each row/column in `mat` is repeated
+ * @return the number of steps
+ */
+inline unsigned long long int rpt_steps(std::vector<int> &rpt) {
+    unsigned long long int steps = 1;
+
+    for (auto i : rpt) {
+        steps *= i + 1;
+    }
+
+    return steps / 2;
+}
+
+
+/**
+ * Returns the digits of step `X` of the mixed-radix counter of
+ * hafnian_rpt(), least significant first: digit \f$j\f$ has radix
+ * \f$\text{rpt}_j+1\f$.
+ *
+ * @param X index of the step
+ * @param rpt a vector of integers, representing the number of
+ *      times each row/column in `mat` is repeated
+ * @return the digits of `X`
+ */
+inline std::vector<int> rpt_digits(unsigned long long int X, std::vector<int> &rpt) {
+    std::vector<int> x(rpt.size(), 0);
+
+    for (std::size_t j = 0; j < rpt.size(); j++) {
+        x[j] = X % (rpt[j] + 1);
+        X /= rpt[j] + 1;
+    }
+
+    return x;
+}
+
+
+/**
+ * Returns the digits of step `X` of the mixed-radix counter of
+ * hafnian_rpt() in reflected Gray order, least significant first.
+ *
+ * Digit \f$j\f$ of the Gray code runs up from \f$0\f$ to
+ * \f$\text{rpt}_j\f$ and back down, reversing its direction whenever the
+ * higher digits change, so that consecutive steps differ in a single digit
+ * by \f$\pm 1\f$. It is the digit \f$a_j\f$ of `X` if the number
+ * \f$h_j=\lfloor X/\prod_{k\leq j}(\text{rpt}_k+1)\rfloor\f$ of changes of the
+ * higher digits is even, and \f$\text{rpt}_j-a_j\f$ otherwise. As in the
+ * binary order, the map \f$x\mapsto\text{rpt}-x\f$ takes the first half
+ * of the steps to the second half, so that only the first half is visited.
+ *
+ * @param X index of the step
+ * @param rpt a vector of integers, representing the number of
+ *      times each row/column in `mat` is repeated
+ * @param dir on exit, the direction \f$\pm 1\f$ in which each digit moves next
+ * @return the digits of the Gray code of `X`
+ */
+inline std::vector<int> rpt_gray_digits(unsigned long long int X, std::vector<int> &rpt, std::vector<int> &dir) {
+    std::vector<int> x = rpt_digits(X, rpt);
+    dir.assign(rpt.size(), 1);
+
+    for (std::size_t j = 0; j < rpt.size(); j++) {
+        X /= rpt[j] + 1;
+
+        if (X % 2 == 1) {
+            dir[j] = -1;
+            x[j] = rpt[j] - x[j];
+        }
+    }
+
+    return x;
+}
+
+
+/**
+ * Advances the mixed-radix counter `a` of hafnian_rpt() by one step, and
+ * returns the digit of the reflected Gray code which changes at this step,
+ * by `dir[j]` (see rpt_gray_digits()). The directions of the lower digits,
+ * which wrap around in the counter but stay fixed in the Gray code, are
+ * reversed.
+ *
+ * @param a digits of the counter, updated in place
+ * @param dir directions of the digits of the Gray code, updated in place
+ * @param rpt a vector of integers, representing the number of
+ *      times each row/column in `mat` is repeated
+ * @return the digit which changes
+ */
+inline int rpt_gray_next(std::vector<int> &a, std::vector<int> &dir, std::vector<int> &rpt) {
+    int j = 0;
+
+    while (a[j] == rpt[j]) {
+        a[j] = 0;
+        dir[j] = -dir[j];
+        j++;
+    }
+
+    a[j] += 1;
+    return j;
+}
+
+
+/**
+ * Returns the number of chunks into which hafnian_rpt() and
+ * loop_hafnian_rpt() split `steps` steps: at most 512, and each of at
+ * least 256 steps. The number of chunks does not depend on the number of
+ * threads, so that neither does the result.
+ *
+ * @param steps number of steps
+ * @return the number of chunks
+ */
+inline unsigned long long int rpt_chunks(unsigned long long int steps) {
+    return std::max(1ULL, std::min(512ULL, steps / 256));
+}
+
+
+/**
+ * Calculates the partial sum of the steps \f$X,X+1,\dots,X+\text{chunksize}-1\f$
+ * of the mixed-radix counter of hafnian_rpt() for the hafnian of matrix `mat`.
+ *
+ * The prefactor \f$p\f$ and the quadratic form \f$q\f$ of step \f$X\f$ are
+ * computed directly from the digits of \f$X\f$ (see rpt_digits()), in
+ * \f$O(n^2+s)\f$ operations, and then updated at each subsequent step.
+ *
+ * In binary order, a digit which wraps around from \f$\text{rpt}_j\f$ to
+ * zero moves \f$q\f$ by a multiple \f$\text{rpt}_j\f$ of a row of `mat`.
+ * With `order=gray_order`, the steps follow the reflected Gray code of
+ * rpt_gray_digits() instead, so that every step changes a single digit by
+ * \f$\pm 1\f$, and updates \f$q\f$ by a single row of `mat` and \f$p\f$
+ * by the ratio of two consecutive binomial coefficients. The full sum is
+ * the same in both orders, but partial sums are only consistent with
+ * other partial sums computed in the same order.
  *
  * @param mat a flattened vector of size \f$n^2\f$, representing an
  *      \f$n\times n\f$ row-ordered symmetric matrix.
  * @param rpt a vector of integers, representing the number of
- *      times each row/column in `mat` is repeated. For example,
- *      `mat = [1]` and `rpt = [6]` represents a \f$6\times 6\f$ matrix of all ones.
- * @return hafnian of the input matrix
+ *      times each row/column in `mat` is repeated
+ * @param X initial index of the partial sum
+ * @param chunksize length of the partial sum
+ * @param order order in which the steps are visited
+ * @return the partial sum for the hafnian
  */
 template <typename T>
-inline T hafnian_rpt(std::vector<T> &mat, std::vector<int> &rpt) {
+inline T hafnian_rpt_chunk(std::vector<T> &mat, std::vector<int> &rpt, unsigned long long int X,
+                           unsigned long long int chunksize, subset_order order = binary_order) {
     int n = std::sqrt(static_cast<double>(mat.size()));
     assert(static_cast<int>(rpt.size()) == n);
 
-    long double p = 2;
-    T y = 0.0, q = 0.0;
+    typedef typename coefficient<T>::type R;
+
+    R p = 2;
+    T y = static_cast<T>(0.0), q = static_cast<T>(0.0);
 
-    std::vector<int> x(n, 0.0);
+    std::vector<int> a = rpt_digits(X, rpt), dir;
+    std::vector<int> x = (order == gray_order) ? rpt_gray_digits(X, rpt, dir) : a;
     int s = std::accumulate(rpt.begin(), rpt.end(), 0);
     int s2 = s / 2;
 
@@ -55,37 +193,62 @@ inline T hafnian_rpt(std::vector<T> &mat, std::vector<int> &rpt) {
         p /= i + 1;
     }
 
+    // signed binomial coefficients of the digits
+    for (int j = 0; j < n; j++) {
+        for (int t = 1; t <= x[j]; t++) {
+            p *= -static_cast<R>(rpt[j] + 1 - t) / t;
+        }
+    }
+
     std::vector<long double> nu2(n);
     std::transform(rpt.begin(), rpt.end(), nu2.begin(),
                    std::bind(std::multiplies<long double>(), std::placeholders::_1, 0.5L));
 
     for (int i = 0; i < n; i++) {
         for (int j = 0; j < n; j++) {
-            q += 0.5L * nu2[j] * mat[i * n + j] * nu2[i];
+            q += static_cast<R>(0.5L * (nu2[j] - x[j]) * (nu2[i] - x[i])) * mat[i * n + j];
         }
     }
 
-    unsigned long long int steps = 1;
+    for (unsigned long long int i = 0; i < chunksize; i++) {
+        y += p * pow(q, s2);
 
-    for (auto i : rpt) {
-        steps *= i + 1;
-    }
+        if (order == gray_order) {
+            if (i + 1 == chunksize)
+                break;
+
+            int j = rpt_gray_next(a, dir, rpt);
+
+            if (dir[j] > 0) {
+                x[j] += 1;
+                p *= -static_cast<R>(rpt[j] + 1 - x[j]) / x[j];
 
-    steps /= 2;
+                for (int k = 0; k < n; k++) {
+                    q -= mat[k * n + j] * static_cast<R>(nu2[k] - x[k]);
+                }
+            }
+            else {
+                x[j] -= 1;
+                p *= -static_cast<R>(x[j] + 1) / (rpt[j] - x[j]);
 
-    for (unsigned long long int i = 0; i < steps; i++) {
-        y += static_cast<long double>(p) * pow(q, s2);
+                for (int k = 0; k < n; k++) {
+                    q += mat[k * n + j] * static_cast<R>(nu2[k] - x[k]);
+                }
+            }
+            q -= static_cast<R>(0.5L) * mat[j * n + j];
+            continue;
+        }
 
         for (int j = 0; j < n; j++) {
 
             if (x[j] < rpt[j]) {
                 x[j] += 1;
-                p *= -static_cast<long double>(rpt[j] + 1 - x[j]) / x[j];
+                p *= -static_cast<R>(rpt[j] + 1 - x[j]) / x[j];
 
                 for (int k = 0; k < n; k++) {
-                    q -= mat[k * n + j] * (nu2[k] - x[k]);
+                    q -= mat[k * n + j] * static_cast<R>(nu2[k] - x[k]);
                 }
-                q -= 0.5L * mat[j * n + j];
+                q -= static_cast<R>(0.5L) * mat[j * n + j];
                 break;
             }
             else {
@@ -94,9 +257,9 @@ inline T hafnian_rpt(std::vector<T> &mat, std::vector<int> &rpt) {
                     p *= -1;
                 }
                 for (int k = 0; k < n; k++) {
-                    q += (1.0L * rpt[j]) * mat[k * n + j] * (nu2[k] - x[k]);
+                    q += static_cast<R>(rpt[j] * (nu2[k] - x[k])) * mat[k * n + j];
                 }
-                q -= 0.5L * rpt[j] * rpt[j] * mat[j * n + j];
+                q -= static_cast<R>(0.5L * rpt[j] * rpt[j]) * mat[j * n + j];
             }
         }
     }
@@ -106,61 +269,106 @@ inline T hafnian_rpt(std::vector<T> &mat, std::vector<int> &rpt) {
 
 
 /**
- * Returns the loop hafnian of a matrix using the algorithm
+ * Returns the hafnian of a matrix using the algorithm
  * described in *From moments of sum to moments of product*,
  * [doi:10.1016/j.jmva.2007.01.013](https://dx.doi.org/10.1016/j.jmva.2007.01.013>).
  *
  * Note that this algorithm, while generally slower than others, can be significantly more
  * efficient in the cases where the matrix has repeated rows and columns.
  *
+ * This function uses OpenMP (if available) to parallelize the reduction.
+ * The steps of the mixed-radix counter are split into rpt_chunks() chunks
+ * of equal length, which are computed by hafnian_rpt_chunk() and handed out
+ * to the threads one at a time. The partial sums of the chunks are then
+ * combined in chunk order using compensated_sum(), so that the result does
+ * not depend on the number of threads.
+ *
  * @param mat a flattened vector of size \f$n^2\f$, representing an
  *      \f$n\times n\f$ row-ordered symmetric matrix.
- * @param mu a vector of length \f$n\f$ representing the vector of means/displacement.
  * @param rpt a vector of integers, representing the number of
  *      times each row/column in `mat` is repeated. For example,
  *      `mat = [1]` and `rpt = [6]` represents a \f$6\times 6\f$ matrix of all ones.
- * @return loop hafnian of the input matrix
+ * @param order order in which the steps are visited (see hafnian_rpt_chunk())
+ * @return hafnian of the input matrix
  */
 template <typename T>
-inline T loop_hafnian_rpt(std::vector<T> &mat, std::vector<T> &mu, std::vector<int> &rpt) {
+inline T hafnian_rpt(std::vector<T> &mat, std::vector<int> &rpt, subset_order order = binary_order) {
+    unsigned long long int steps = rpt_steps(rpt);
+    long long int nchunks = rpt_chunks(steps);
+    unsigned long long int len = steps / nchunks;
+    unsigned long long int rem = steps % nchunks;
+    std::vector<T> partial(nchunks, static_cast<T>(0.0));
+
+    #pragma omp parallel for schedule(dynamic, 1) if (nchunks > 1)
+    for (long long int c = 0; c < nchunks; c++) {
+        unsigned long long int X = c * len + std::min<unsigned long long int>(c, rem);
+        unsigned long long int chunksize = len + (static_cast<unsigned long long int>(c) < rem ? 1 : 0);
+
+        partial[c] = hafnian_rpt_chunk(mat, rpt, X, chunksize, order);
+    }
+
+    return compensated_sum(partial);
+}
+
+
+/**
+ * Calculates the partial sum of the steps \f$X,X+1,\dots,X+\text{chunksize}-1\f$
+ * of the mixed-radix counter of loop_hafnian_rpt() for the loop hafnian of
+ * matrix `mat`.
+ *
+ * The prefactor \f$p\f$ and the forms \f$q\f$ and \f$q_1\f$ of step \f$X\f$
+ * are computed directly from the digits of \f$X\f$ (see rpt_digits()), in
+ * \f$O(n^2+s)\f$ operations, and then updated at each subsequent step.
+ *
+ * With `order=gray_order`, the steps follow the reflected Gray code of
+ * rpt_gray_digits(), as in hafnian_rpt_chunk().
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an
+ *      \f$n\times n\f$ row-ordered symmetric matrix.
+ * @param mu a vector of length \f$n\f$ representing the vector of means/displacement.
+ * @param rpt a vector of integers, representing the number of
+ *      times each row/column in `mat` is repeated
+ * @param X initial index of the partial sum
+ * @param chunksize length of the partial sum
+ * @param order order in which the steps are visited
+ * @return the partial sum for the loop hafnian
+ */
+template <typename T>
+inline T loop_hafnian_rpt_chunk(std::vector<T> &mat, std::vector<T> &mu, std::vector<int> &rpt,
+                                unsigned long long int X, unsigned long long int chunksize,
+                                subset_order order = binary_order) {
     int n = std::sqrt(static_cast<double>(mat.size()));
     assert(static_cast<int>(rpt.size()) == n);
 
     long long int p = 2;
     T y = 0.0L, q = 0.0L, q1 = 0.0L;
 
-    std::vector<int> x(n, 0.0);
+    std::vector<int> a = rpt_digits(X, rpt), dir;
+    std::vector<int> x = (order == gray_order) ? rpt_gray_digits(X, rpt, dir) : a;
     int s = std::accumulate(rpt.begin(), rpt.end(), 0);
     int s1 = std::floor(0.5 * s) + 1;
     std::vector<T> z1(s1, 1.0L);
     std::vector<T> z2(s1, 1.0L);
 
-    // diagonal of matrix mat
-    // std::vector<T> mu(n);
-    // for (int i=0; i<n; i++) {
-    //     mu[i] = mat[i*n+i];
-    // }
+    // signed binomial coefficients of the digits
+    for (int j = 0; j < n; j++) {
+        for (int t = 1; t <= x[j]; t++) {
+            p = -std::round(p * static_cast<long double>(rpt[j] + 1 - t) / t);
+        }
+    }
 
     std::vector<long double> nu2(n);
     std::transform(rpt.begin(), rpt.end(), nu2.begin(),
                    std::bind(std::multiplies<long double>(), std::placeholders::_1, 0.5L));
 
     for (int i = 0; i < n; i++) {
-        q1 += nu2[i] * mu[i];
+        q1 += (nu2[i] - x[i]) * mu[i];
         for (int j = 0; j < n; j++) {
-            q += 0.5L * nu2[j] * mat[i * n + j] * nu2[i];
+            q += 0.5L * (nu2[j] - x[j]) * mat[i * n + j] * (nu2[i] - x[i]);
         }
     }
 
-    unsigned long long int steps = 1;
-
-    for (auto i : rpt) {
-        steps *= i + 1;
-    }
-
-    steps /= 2;
-
-    for (unsigned long long int i = 0; i < steps; i++) {
+    for (unsigned long long int i = 0; i < chunksize; i++) {
         for (int j = 1; j < s1; j++) {
             z1[j] = z1[j - 1] * q / (1.0L * j);
         }
@@ -185,6 +393,34 @@ inline T loop_hafnian_rpt(std::vector<T> &mat, std::vector<T> &mu, std::vector<i
 
         y += static_cast<long double>(p) * z1z2prod;
 
+        if (order == gray_order) {
+            if (i + 1 == chunksize)
+                break;
+
+            int j = rpt_gray_next(a, dir, rpt);
+
+            if (dir[j] > 0) {
+                x[j] += 1;
+                p = -std::round(p * static_cast<long double>(rpt[j] + 1 - x[j]) / x[j]);
+
+                for (int k = 0; k < n; k++) {
+                    q -= mat[k * n + j] * (nu2[k] - x[k]);
+                }
+                q1 -= mu[j];
+            }
+            else {
+                x[j] -= 1;
+                p = -std::round(p * static_cast<long double>(x[j] + 1) / (rpt[j] - x[j]));
+
+                for (int k = 0; k < n; k++) {
+                    q += mat[k * n + j] * (nu2[k] - x[k]);
+                }
+                q1 += mu[j];
+            }
+            q -= 0.5L * mat[j * n + j];
+            continue;
+        }
+
         for (int j = 0; j < n; j++) {
 
             if (x[j] < rpt[j]) {
@@ -215,6 +451,241 @@ inline T loop_hafnian_rpt(std::vector<T> &mat, std::vector<T> &mu, std::vector<i
     return y;
 }
 
+
+/**
+ * Returns the loop hafnian of a matrix using the algorithm
+ * described in *From moments of sum to moments of product*,
+ * [doi:10.1016/j.jmva.2007.01.013](https://dx.doi.org/10.1016/j.jmva.2007.01.013>).
+ *
+ * Note that this algorithm, while generally slower than others, can be significantly more
+ * efficient in the cases where the matrix has repeated rows and columns.
+ *
+ * This function uses OpenMP (if available) to parallelize the reduction,
+ * in the same way as hafnian_rpt(), with the chunks computed by
+ * loop_hafnian_rpt_chunk().
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an
+ *      \f$n\times n\f$ row-ordered symmetric matrix.
+ * @param mu a vector of length \f$n\f$ representing the vector of means/displacement.
+ * @param rpt a vector of integers, representing the number of
+ *      times each row/column in `mat` is repeated. For example,
+ *      `mat = [1]` and `rpt = [6]` represents a \f$6\times 6\f$ matrix of all ones.
+ * @param order order in which the steps are visited (see hafnian_rpt_chunk())
+ * @return loop hafnian of the input matrix
+ */
+template <typename T>
+inline T loop_hafnian_rpt(std::vector<T> &mat, std::vector<T> &mu, std::vector<int> &rpt,
+                          subset_order order = binary_order) {
+    unsigned long long int steps = rpt_steps(rpt);
+    long long int nchunks = rpt_chunks(steps);
+    unsigned long long int len = steps / nchunks;
+    unsigned long long int rem = steps % nchunks;
+    std::vector<T> partial(nchunks, static_cast<T>(0.0));
+
+    #pragma omp parallel for schedule(dynamic, 1) if (nchunks > 1)
+    for (long long int c = 0; c < nchunks; c++) {
+        unsigned long long int X = c * len + std::min<unsigned long long int>(c, rem);
+        unsigned long long int chunksize = len + (static_cast<unsigned long long int>(c) < rem ? 1 : 0);
+
+        partial[c] = loop_hafnian_rpt_chunk(mat, mu, rpt, X, chunksize, order);
+    }
+
+    return compensated_sum(partial);
+}
+
+
+/**
+ * Computes the repeated hafnians, or loop hafnians if `mu` is not null, of
+ * the matrix `mat` for every repetition vector of `rpts`; see
+ * hafnian_rpt_batch() and loop_hafnian_rpt_batch().
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an
+ *      \f$n\times n\f$ row-ordered symmetric matrix.
+ * @param mu if not null, the vector of means/displacement
+ * @param rpts the repetition vectors, each of length \f$n\f$
+ * @param order order in which the steps are visited (see hafnian_rpt_chunk())
+ * @return the (loop) hafnian for each repetition vector
+ */
+template <typename T>
+inline std::vector<T> rpt_batch(std::vector<T> &mat, std::vector<T> *mu, std::vector<std::vector<int>> &rpts,
+                                subset_order order) {
+    int n = std::sqrt(static_cast<double>(mat.size()));
+
+    // distinct repetition vectors, and for each of them the rows and
+    // columns it repeats at least once, and the repetitions of those
+    std::map<std::vector<int>, int> distinct;
+    std::map<std::vector<int>, int> supports;
+    std::vector<int> which(rpts.size());
+    std::vector<std::vector<int>> reduced;
+    std::vector<int> support_of;
+    std::vector<std::vector<int>> support_rows;
+
+    for (std::size_t i = 0; i < rpts.size(); i++) {
+        assert(static_cast<int>(rpts[i].size()) == n);
+        auto found = distinct.insert(std::make_pair(rpts[i], static_cast<int>(reduced.size())));
+        which[i] = found.first->second;
+
+        if (!found.second)
+            continue;
+
+        std::vector<int> rows, r;
+        for (int j = 0; j < n; j++) {
+            if (rpts[i][j] > 0) {
+                rows.push_back(j);
+                r.push_back(rpts[i][j]);
+            }
+        }
+
+        auto support = supports.insert(std::make_pair(rows, static_cast<int>(support_rows.size())));
+        if (support.second)
+            support_rows.push_back(rows);
+
+        reduced.push_back(r);
+        support_of.push_back(support.first->second);
+    }
+
+    // submatrices shared by the repetition vectors with the same support
+    std::vector<std::vector<T>> submat(support_rows.size()), submu(support_rows.size());
+
+    for (std::size_t k = 0; k < support_rows.size(); k++) {
+        std::vector<int> &rows = support_rows[k];
+        int m = rows.size();
+
+        submat[k].resize(m * m);
+        for (int i = 0; i < m; i++) {
+            for (int j = 0; j < m; j++)
+                submat[k][i * m + j] = mat[rows[i] * n + rows[j]];
+        }
+
+        if (mu != nullptr) {
+            for (int i = 0; i < m; i++)
+                submu[k].push_back((*mu)[rows[i]]);
+        }
+    }
+
+    // the chunks of all distinct repetition vectors, as in hafnian_rpt(),
+    // with the most expensive chunks first
+    std::vector<T> result(reduced.size(), static_cast<T>(0.0));
+    std::vector<std::size_t> first(reduced.size() + 1, 0);
+    std::vector<int> task_rpt;
+    std::vector<unsigned long long int> task_start, task_length;
+
+    for (std::size_t u = 0; u < reduced.size(); u++) {
+        int s = std::accumulate(reduced[u].begin(), reduced[u].end(), 0);
+        first[u + 1] = first[u];
+
+        if (s == 0)
+            result[u] = static_cast<T>(1.0);
+
+        if (s == 0 || (mu == nullptr && s % 2 == 1))
+            continue;
+
+        unsigned long long int steps = rpt_steps(reduced[u]);
+        unsigned long long int nchunks = rpt_chunks(steps);
+        unsigned long long int len = steps / nchunks;
+        unsigned long long int rem = steps % nchunks;
+
+        for (unsigned long long int c = 0; c < nchunks; c++) {
+            task_rpt.push_back(u);
+            task_start.push_back(c * len + std::min(c, rem));
+            task_length.push_back(len + (c < rem ? 1 : 0));
+        }
+        first[u + 1] = task_rpt.size();
+    }
+
+    long long int ntasks = task_rpt.size();
+    std::vector<long long int> schedule(ntasks);
+    std::iota(schedule.begin(), schedule.end(), 0);
+    std::stable_sort(schedule.begin(), schedule.end(), [&](long long int a, long long int b) {
+        return task_length[a] * reduced[task_rpt[a]].size() > task_length[b] * reduced[task_rpt[b]].size();
+    });
+
+    std::vector<T> partial(ntasks, static_cast<T>(0.0));
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (long long int i = 0; i < ntasks; i++) {
+        long long int t = schedule[i];
+        int u = task_rpt[t];
+        int k = support_of[u];
+
+        if (mu == nullptr)
+            partial[t] = hafnian_rpt_chunk(submat[k], reduced[u], task_start[t], task_length[t], order);
+        else
+            partial[t] = loop_hafnian_rpt_chunk(submat[k], submu[k], reduced[u], task_start[t], task_length[t], order);
+    }
+
+    for (std::size_t u = 0; u < reduced.size(); u++) {
+        if (first[u + 1] > first[u]) {
+            std::vector<T> chunks(partial.begin() + first[u], partial.begin() + first[u + 1]);
+            result[u] = compensated_sum(chunks);
+        }
+    }
+
+    std::vector<T> haf(rpts.size());
+    for (std::size_t i = 0; i < rpts.size(); i++)
+        haf[i] = result[which[i]];
+
+    return haf;
+}
+
+
+/**
+ * Returns the hafnians of a matrix with its rows and columns repeated
+ * according to each of the repetition vectors `rpts`, computed as in
+ * hafnian_rpt().
+ *
+ * The repetition vectors are computed together, sharing the work that does
+ * not depend on the number of repetitions: repeated vectors are computed
+ * once, and the rows and columns that are repeated zero times are removed,
+ * so that the vectors with the same nonzero entries share a submatrix and
+ * the updates of each step only involve the rows that are repeated. The
+ * quadratic form \f$q\f$ depends on every entry of the repetition vector at
+ * every step, so that no further state is common to different vectors.
+ *
+ * This function uses OpenMP (if available) to parallelize the reduction.
+ * The chunks of all repetition vectors (see rpt_chunks()) form a single
+ * pool of tasks, which are handed out to the threads one at a time, the
+ * longest first. The chunks of each vector are combined as in
+ * hafnian_rpt(), so that the result does not depend on the number of
+ * threads, nor on the other repetition vectors.
+ *
+ * A repetition vector with no repetitions has hafnian \f$1\f$, and one
+ * with an odd number of repetitions has hafnian \f$0\f$.
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an
+ *      \f$n\times n\f$ row-ordered symmetric matrix.
+ * @param rpts the repetition vectors, each a vector of \f$n\f$ integers
+ *      representing the number of times each row/column in `mat` is repeated
+ * @param order order in which the steps are visited (see hafnian_rpt_chunk())
+ * @return the hafnian for each repetition vector
+ */
+template <typename T>
+inline std::vector<T> hafnian_rpt_batch(std::vector<T> &mat, std::vector<std::vector<int>> &rpts,
+                                        subset_order order = binary_order) {
+    return rpt_batch(mat, static_cast<std::vector<T> *>(nullptr), rpts, order);
+}
+
+
+/**
+ * Returns the loop hafnians of a matrix with its rows and columns repeated
+ * according to each of the repetition vectors `rpts`, computed as in
+ * loop_hafnian_rpt(), sharing work between the vectors as in
+ * hafnian_rpt_batch().
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an
+ *      \f$n\times n\f$ row-ordered symmetric matrix.
+ * @param mu a vector of length \f$n\f$ representing the vector of means/displacement.
+ * @param rpts the repetition vectors, each a vector of \f$n\f$ integers
+ *      representing the number of times each row/column in `mat` is repeated
+ * @param order order in which the steps are visited (see hafnian_rpt_chunk())
+ * @return the loop hafnian for each repetition vector
+ */
+template <typename T>
+inline std::vector<T> loop_hafnian_rpt_batch(std::vector<T> &mat, std::vector<T> &mu, std::vector<std::vector<int>> &rpts,
+                                             subset_order order = binary_order) {
+    return rpt_batch(mat, &mu, rpts, order);
+}
+
 /**
  * Returns the hafnian of a matrix using the algorithm
  * described in *From moments of sum to moments of product*,
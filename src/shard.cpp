@@ -0,0 +1,203 @@
+// Copyright 2019 Xanadu Quantum Technologies Inc.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+/**
+ * @file
+ * Command line driver for sharded computations, allowing a single large
+ * hafnian, loop hafnian, Torontonian or permanent to be spread over
+ * independent jobs (for instance, the tasks of a cluster job array).
+ *
+ * Usage:
+ *
+ *     ./shard-cpp run <algorithm> <k> <K> <matrix file> <output file>
+ *     ./shard-cpp merge <output file> [<output file> ...]
+ *
+ * where `algorithm` is one of `hafnian`, `hafnian_recursive`, `loop_hafnian`,
+ * `torontonian` or `permanent`. The `run` command computes shard `k` of `K`
+ * and writes its partial sum to the output file; the `merge` command checks that the
+ * given files contain all `K` shards of the same computation, and prints
+ * their sum.
+ *
+ * The matrix file contains the size \f$n\f$ of the matrix, followed by its
+ * \f$n^2\f$ entries in row-major order, each given by its real and
+ * imaginary parts separated by whitespace. Partial sums are stored as
+ * hexadecimal floating point numbers, so that merging them is exact.
+ */
+#include <iostream>
+#include <fstream>
+#include <complex>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <hafnian.hpp>
+
+
+/**
+ * Reads a complex matrix from the file `filename`.
+ */
+bool read_matrix(const std::string &filename, std::vector<std::complex<double>> &mat) {
+    std::ifstream in(filename);
+    int n;
+
+    if (!(in >> n) || n < 0)
+        return false;
+
+    mat.assign(n * n, 0.0);
+
+    for (int i = 0; i < n * n; i++) {
+        double re, im;
+        if (!(in >> re >> im))
+            return false;
+        mat[i] = std::complex<double>(re, im);
+    }
+
+    return true;
+}
+
+
+/**
+ * Computes shard `k` of `nshards` of the given algorithm.
+ */
+bool run_shard(const std::string &algorithm, std::vector<std::complex<double>> &mat, int k, int nshards,
+               std::complex<double> &partial) {
+    int n = std::sqrt(static_cast<double>(mat.size()));
+    bool even = (n % 2 == 0);
+
+    if (algorithm == "hafnian" && even)
+        partial = hafnian::hafnian_shard(mat, k, nshards, hafnian::labudde);
+    else if (algorithm == "hafnian_recursive" && even)
+        partial = hafnian::hafnian_recursive_shard(mat, k, nshards);
+    else if (algorithm == "loop_hafnian" && even)
+        partial = hafnian::loop_hafnian_shard(mat, k, nshards, hafnian::labudde);
+    else if (algorithm == "torontonian" && even)
+        partial = hafnian::torontonian_shard(mat, k, nshards);
+    else if (algorithm == "permanent")
+        partial = hafnian::permanent_shard(mat, k, nshards);
+    else
+        return false;
+
+    return true;
+}
+
+
+int run(int argc, char *argv[]) {
+    if (argc != 7) {
+        std::cerr << "usage: " << argv[0] << " run <algorithm> <k> <K> <matrix file> <output file>" << std::endl;
+        return 1;
+    }
+
+    std::string algorithm = argv[2];
+    int k = std::atoi(argv[3]);
+    int nshards = std::atoi(argv[4]);
+    std::vector<std::complex<double>> mat;
+
+    if (nshards < 1 || k < 0 || k >= nshards) {
+        std::cerr << "invalid shard " << k << " of " << nshards << std::endl;
+        return 1;
+    }
+
+    if (!read_matrix(argv[5], mat)) {
+        std::cerr << "could not read matrix from " << argv[5] << std::endl;
+        return 1;
+    }
+
+    std::complex<double> partial;
+
+    if (!run_shard(algorithm, mat, k, nshards, partial)) {
+        std::cerr << "unknown algorithm " << algorithm << ", or matrix of odd size" << std::endl;
+        return 1;
+    }
+
+    FILE *out = std::fopen(argv[6], "w");
+
+    if (out == nullptr) {
+        std::cerr << "could not open " << argv[6] << std::endl;
+        return 1;
+    }
+
+    std::fprintf(out, "%s %d %d %a %a\n", algorithm.c_str(), k, nshards, std::real(partial), std::imag(partial));
+    std::fclose(out);
+
+    return 0;
+}
+
+
+int merge(int argc, char *argv[]) {
+    std::string algorithm;
+    int nshards = 0;
+    std::vector<std::complex<double>> partial;
+    std::vector<bool> found;
+
+    for (int i = 2; i < argc; i++) {
+        std::ifstream in(argv[i]);
+        std::string name, re, im;
+        int k, K;
+
+        if (!(in >> name >> k >> K >> re >> im) || K < 1) {
+            std::cerr << "could not read partial sum from " << argv[i] << std::endl;
+            return 1;
+        }
+
+        if (i == 2) {
+            algorithm = name;
+            nshards = K;
+            partial.assign(nshards, 0.0);
+            found.assign(nshards, false);
+        }
+
+        if (name != algorithm || K != nshards || k < 0 || k >= nshards || found[k]) {
+            std::cerr << argv[i] << " does not belong to the same computation, or repeats a shard" << std::endl;
+            return 1;
+        }
+
+        partial[k] = std::complex<double>(std::strtod(re.c_str(), nullptr), std::strtod(im.c_str(), nullptr));
+        found[k] = true;
+    }
+
+    if (nshards == 0) {
+        std::cerr << "usage: " << argv[0] << " merge <output file> [<output file> ...]" << std::endl;
+        return 1;
+    }
+
+    for (int k = 0; k < nshards; k++) {
+        if (!found[k]) {
+            std::cerr << "missing shard " << k << " of " << nshards << std::endl;
+            return 1;
+        }
+    }
+
+    // sum the shards in a fixed order, so that the result does not
+    // depend on the order of the files
+    std::complex<double> result = tree_reduce(partial);
+
+    std::cout << std::setprecision(17) << result << std::endl;
+
+    return 0;
+}
+
+
+int main(int argc, char *argv[]) {
+    std::string command = (argc > 1) ? argv[1] : "";
+
+    if (command == "run")
+        return run(argc, argv);
+
+    if (command == "merge")
+        return merge(argc, argv);
+
+    std::cerr << "usage: " << argv[0] << " run <algorithm> <k> <K> <matrix file> <output file>" << std::endl;
+    std::cerr << "       " << argv[0] << " merge <output file> [<output file> ...]" << std::endl;
+
+    return 1;
+};
@@ -0,0 +1,195 @@
+// Copyright 2019 Xanadu Quantum Technologies Inc.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+/**
+ * @file
+ * Splits the exact hafnian, loop hafnian, Torontonian and permanent into
+ * independent shards. Shard \f$k\f$ of \f$K\f$ returns a partial sum,
+ * and the sum of the partial sums of all \f$K\f$ shards is the full result,
+ * so that a single large computation may be spread over separate processes.
+ */
+#pragma once
+#include <stdafx.h>
+#include <eigenvalue_hafnian.hpp>
+#include <recursive_hafnian.hpp>
+#include <torontonian.hpp>
+#include <permanent.hpp>
+
+namespace hafnian {
+
+/**
+ * Returns the range of terms of shard `k` of `nshards`, when `terms`
+ * terms of equal cost are split into contiguous ranges of equal length.
+ *
+ * @param k index of the shard, \f$0\leq k<\text{nshards}\f$
+ * @param nshards number of shards
+ * @param terms total number of terms
+ * @param X on exit, the initial index of the shard
+ * @param chunksize on exit, the number of terms of the shard
+ */
+inline void shard_range(int k, int nshards, unsigned long long int terms,
+                        unsigned long long int &X, unsigned long long int &chunksize) {
+    assert(0 <= k && k < nshards);
+
+    unsigned long long int len = terms / nshards;
+    unsigned long long int rem = terms % nshards;
+
+    X = k * len + std::min<unsigned long long int>(k, rem);
+    chunksize = len + (static_cast<unsigned long long int>(k) < rem ? 1 : 0);
+}
+
+
+/**
+ * Returns the range of subsets of shard `k` of `nshards`, when the
+ * \f$2^m\f$ subsets of `m` pairs of rows/columns are split into contiguous
+ * ranges of equal estimated cost (see balanced_bounds()).
+ *
+ * @param k index of the shard, \f$0\leq k<\text{nshards}\f$
+ * @param nshards number of shards
+ * @param m total number of pairs
+ * @param gray whether subset indices are Gray encoded
+ * @param X on exit, the initial index of the shard
+ * @param chunksize on exit, the number of subsets of the shard
+ */
+inline void balanced_shard_range(int k, int nshards, int m, bool gray,
+                                 unsigned long long int &X, unsigned long long int &chunksize) {
+    assert(0 <= k && k < nshards);
+
+    std::vector<unsigned long long int> bounds = balanced_bounds(0, 1ULL << m, m, nshards, gray);
+
+    X = bounds[k];
+    chunksize = bounds[k + 1] - bounds[k];
+}
+
+
+/**
+ * Returns the partial sum of shard `k` of `nshards` of the hafnian of
+ * a matrix, computed using do_chunk().
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an \f$n\times n\f$
+ *       row-ordered symmetric matrix of even size.
+ * @param k index of the shard, \f$0\leq k<\text{nshards}\f$
+ * @param nshards number of shards
+ * @param method algorithm used to compute the power traces
+ * @param order order in which the subsets are visited; all shards
+ *      must use the same order
+ * @return the partial sum of the shard
+ */
+template <typename T>
+inline T hafnian_shard(std::vector<T> &mat, int k, int nshards, powtrace_algorithm method = eigensolver,
+                       subset_order order = binary_order) {
+    int n = std::sqrt(static_cast<double>(mat.size()));
+    assert(n % 2 == 0);
+
+    unsigned long long int X, chunksize;
+    balanced_shard_range(k, nshards, n / 2, order == gray_order, X, chunksize);
+
+    return do_chunk(mat, n, X, chunksize, method, order);
+}
+
+
+/**
+ * Returns the partial sum of shard `k` of `nshards` of the loop hafnian of
+ * a matrix, computed using do_chunk_loops().
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an \f$n\times n\f$
+ *       row-ordered symmetric matrix of even size.
+ * @param k index of the shard, \f$0\leq k<\text{nshards}\f$
+ * @param nshards number of shards
+ * @param method algorithm used to compute the power traces
+ * @param order order in which the subsets are visited; all shards
+ *      must use the same order
+ * @return the partial sum of the shard
+ */
+template <typename T>
+inline T loop_hafnian_shard(std::vector<T> &mat, int k, int nshards, powtrace_algorithm method = eigensolver,
+                            subset_order order = binary_order) {
+    int n = std::sqrt(static_cast<double>(mat.size()));
+    assert(n % 2 == 0);
+
+    std::vector<T> D(n, 0.0), C(n, 0.0);
+    loop_diagonals(mat, n, C, D);
+
+    unsigned long long int X, chunksize;
+    balanced_shard_range(k, nshards, n / 2, order == gray_order, X, chunksize);
+
+    return do_chunk_loops(mat, C, D, n, X, chunksize, method, order);
+}
+
+
+/**
+ * Returns the partial sum of shard `k` of `nshards` of the hafnian of
+ * a matrix, computed using do_chunk_recursive(). All the leaves of the
+ * recursion have the same depth, so the shards have equal length.
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an \f$n\times n\f$
+ *       row-ordered symmetric matrix of even size.
+ * @param k index of the shard, \f$0\leq k<\text{nshards}\f$
+ * @param nshards number of shards
+ * @return the partial sum of the shard
+ */
+template <typename T>
+inline T hafnian_recursive_shard(std::vector<T> &mat, int k, int nshards) {
+    int n = std::sqrt(static_cast<double>(mat.size()));
+    assert(n % 2 == 0);
+
+    unsigned long long int X, chunksize;
+    shard_range(k, nshards, 1ULL << (n / 2), X, chunksize);
+
+    return do_chunk_recursive(mat, n, X, chunksize);
+}
+
+
+/**
+ * Returns the partial sum of shard `k` of `nshards` of the Torontonian of
+ * a matrix, computed using torontonian_chunk().
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an \f$n\times n\f$
+ *       row-ordered symmetric matrix.
+ * @param k index of the shard, \f$0\leq k<\text{nshards}\f$
+ * @param nshards number of shards
+ * @return the partial sum of the shard
+ */
+template <typename T>
+inline T torontonian_shard(std::vector<T> &mat, int k, int nshards) {
+    int n = std::sqrt(static_cast<double>(mat.size()));
+
+    unsigned long long int X, chunksize;
+    balanced_shard_range(k, nshards, n / 2, false, X, chunksize);
+
+    return torontonian_chunk(mat, n, X, chunksize);
+}
+
+
+/**
+ * Returns the partial sum of shard `k` of `nshards` of the permanent of
+ * a matrix, computed using permanent_chunk(). All the terms of Ryser's
+ * formula have the same cost, so the shards have equal length.
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an \f$n\times n\f$
+ *       row-ordered matrix.
+ * @param k index of the shard, \f$0\leq k<\text{nshards}\f$
+ * @param nshards number of shards
+ * @return the partial sum of the shard
+ */
+template <typename T>
+inline T permanent_shard(std::vector<T> &mat, int k, int nshards) {
+    int n = std::sqrt(static_cast<double>(mat.size()));
+
+    unsigned long long int X, chunksize;
+    shard_range(k, nshards, (1ULL << n) - 1, X, chunksize);
+
+    return permanent_chunk(mat, n, static_cast<llint>(X), static_cast<llint>(chunksize));
+}
+
+}
@@ -0,0 +1,387 @@
+// Copyright 2019 Xanadu Quantum Technologies Inc.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+/**
+ * @file
+ * Contains functions for computing the hafnian of a sparse matrix by
+ * dynamic programming over a path decomposition of its graph.
+ *
+ * The vertices of the graph defined by the nonzero off-diagonal entries of
+ * the matrix are visited in a fixed order. Each vertex is either matched to
+ * one of the earlier vertices that are still unmatched, or left unmatched
+ * to be matched to a later neighbour. An unmatched vertex all of whose
+ * neighbours have been visited can no longer be matched. The unmatched
+ * vertices are therefore always among the *frontier*, the visited vertices
+ * with a neighbour that has not been visited yet, and the weighted sum of
+ * partial matchings is stored for every subset of the frontier.
+ *
+ * If the frontier never exceeds \f$w\f$ vertices, the hafnian is computed
+ * in \f$O(nw2^w)\f$ operations, where \f$w\f$ is the width of the path
+ * decomposition given by the vertex order (see sparse_width()).
+ * For lattice-like graphs, \f$w\f$ grows as the square root of \f$n\f$.
+ */
+#pragma once
+#include <stdafx.h>
+
+namespace hafnian {
+
+/**
+ * Returns the neighbours of every vertex of the graph whose edges are the
+ * nonzero off-diagonal entries of the matrix `mat`.
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an \f$n\times n\f$
+ *       row-ordered symmetric matrix.
+ * @param n size of the matrix
+ * @return the neighbours of each vertex, in increasing order
+ */
+template <typename T>
+inline std::vector<std::vector<int>> sparse_neighbours(std::vector<T> &mat, int n) {
+    std::vector<std::vector<int>> adj(n);
+
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            if (i != j && mat[i * n + j] != static_cast<T>(0.0))
+                adj[i].push_back(j);
+        }
+    }
+
+    return adj;
+}
+
+
+/**
+ * Returns an order of the vertices of a graph with a small frontier,
+ * found greedily: starting from a vertex of smallest degree, the next vertex
+ * is the one whose visit increases the size of the frontier the least,
+ * preferring vertices with the most visited neighbours.
+ *
+ * @param adj the neighbours of each vertex (see sparse_neighbours())
+ * @return the vertices in the order they should be visited
+ */
+inline std::vector<int> sparse_ordering(const std::vector<std::vector<int>> &adj) {
+    int n = adj.size();
+    std::vector<int> order;
+    std::vector<char> visited(n, 0);
+    // number of neighbours of each vertex that have not been visited
+    std::vector<int> remaining(n);
+    // number of neighbours of each vertex that have been visited
+    std::vector<int> seen(n, 0);
+
+    for (int i = 0; i < n; i++)
+        remaining[i] = adj[i].size();
+
+    order.reserve(n);
+
+    for (int step = 0; step < n; step++) {
+        int best = -1;
+        int best_delta = 0;
+
+        for (int v = 0; v < n; v++) {
+            if (visited[v])
+                continue;
+
+            // v joins the frontier if it has neighbours left to visit, while its
+            // neighbours in the frontier leave it if v was their last one
+            int delta = (remaining[v] > 0) ? 1 : 0;
+            for (int u : adj[v]) {
+                if (visited[u] && remaining[u] == 1)
+                    delta--;
+            }
+
+            bool better;
+            if (best == -1)
+                better = true;
+            else if (delta != best_delta)
+                better = delta < best_delta;
+            else if (seen[v] != seen[best])
+                better = seen[v] > seen[best];
+            else
+                better = adj[v].size() < adj[best].size();
+
+            if (better) {
+                best = v;
+                best_delta = delta;
+            }
+        }
+
+        visited[best] = 1;
+        order.push_back(best);
+
+        for (int u : adj[best]) {
+            remaining[u]--;
+            seen[u]++;
+        }
+    }
+
+    return order;
+}
+
+
+/**
+ * Returns, for every vertex, the position in the order `order` of its
+ * last visited neighbour, or \f$-1\f$ if it has no neighbours.
+ *
+ * @param adj the neighbours of each vertex (see sparse_neighbours())
+ * @param order the order in which the vertices are visited
+ * @return the position of the last neighbour of each vertex
+ */
+inline std::vector<int> sparse_last_neighbour(const std::vector<std::vector<int>> &adj, const std::vector<int> &order) {
+    int n = adj.size();
+    std::vector<int> position(n), last(n, -1);
+
+    for (int p = 0; p < n; p++)
+        position[order[p]] = p;
+
+    for (int v = 0; v < n; v++) {
+        for (int u : adj[v])
+            last[v] = std::max(last[v], position[u]);
+    }
+
+    return last;
+}
+
+
+/**
+ * Returns the width of the path decomposition given by visiting the
+ * vertices of a graph in the order `order`, i.e. the largest number of
+ * vertices in the frontier just after a vertex is visited, before the
+ * earlier vertices whose last neighbour it is leave the frontier. This is
+ * the number of bits needed to label the subsets of the frontier in
+ * hafnian_sparse(); for a path, it is 2.
+ *
+ * @param adj the neighbours of each vertex (see sparse_neighbours())
+ * @param order the order in which the vertices are visited
+ * @return the width of the path decomposition
+ */
+inline int sparse_width(const std::vector<std::vector<int>> &adj, const std::vector<int> &order) {
+    int n = adj.size();
+    std::vector<int> last = sparse_last_neighbour(adj, order);
+    std::vector<int> position(n);
+    int frontier = 0, width = 0;
+
+    for (int p = 0; p < n; p++)
+        position[order[p]] = p;
+
+    for (int p = 0; p < n; p++) {
+        int v = order[p];
+
+        if (last[v] > p)
+            frontier++;
+
+        width = std::max(width, frontier);
+
+        // earlier vertices whose last neighbour is v leave the frontier
+        for (int u : adj[v]) {
+            if (last[u] == p && position[u] < p)
+                frontier--;
+        }
+    }
+
+    return width;
+}
+
+
+/**
+ * Returns the hafnian of a sparse matrix, using dynamic programming over
+ * the path decomposition given by visiting the vertices of its graph in the
+ * order `order`. The diagonal entries of the matrix are ignored.
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an \f$n\times n\f$
+ *       row-ordered symmetric matrix.
+ * @param adj the neighbours of each vertex (see sparse_neighbours())
+ * @param order the order in which the vertices are visited
+ * @return hafnian of the input matrix
+ */
+template <typename T>
+inline T hafnian_sparse(std::vector<T> &mat, const std::vector<std::vector<int>> &adj, const std::vector<int> &order) {
+    int n = adj.size();
+
+    if (n % 2 != 0)
+        return static_cast<T>(0.0);
+
+    std::vector<int> last = sparse_last_neighbour(adj, order);
+    int w = sparse_width(adj, order);
+
+    // the frontier vertices are stored in slots, and the partial matchings
+    // in which the vertex of a slot is unmatched have the bit of the slot set
+    std::vector<int> slot(n, -1);
+    std::vector<int> vertex(w, -1);
+    std::vector<T> sums(1ULL << w, static_cast<T>(0.0));
+    std::vector<T> next(1ULL << w, static_cast<T>(0.0));
+    unsigned long long int used = 1;
+
+    sums[0] = static_cast<T>(1.0);
+
+    for (int p = 0; p < n; p++) {
+        int v = order[p];
+        int sv = -1;
+
+        if (last[v] > p) {
+            sv = std::find(vertex.begin(), vertex.end(), -1) - vertex.begin();
+            vertex[sv] = v;
+            slot[v] = sv;
+            used = std::max(used, 1ULL << (sv + 1));
+        }
+
+        std::fill(next.begin(), next.begin() + used, static_cast<T>(0.0));
+
+        for (unsigned long long int mask = 0; mask < used; mask++) {
+            if (sums[mask] == static_cast<T>(0.0))
+                continue;
+
+            // match v to an unmatched earlier neighbour
+            for (int s = 0; s < w; s++) {
+                if (!(mask >> s & 1ULL))
+                    continue;
+
+                T a = mat[vertex[s] * n + v];
+                if (a != static_cast<T>(0.0))
+                    next[mask ^ (1ULL << s)] += sums[mask] * a;
+            }
+
+            // leave v unmatched, to be matched to a later neighbour
+            if (sv >= 0)
+                next[mask | (1ULL << sv)] += sums[mask];
+        }
+
+        std::swap(sums, next);
+
+        // neighbours of v whose neighbours have all been visited can no longer be matched
+        for (int u : adj[v]) {
+            if (last[u] != p || slot[u] < 0)
+                continue;
+
+            unsigned long long int bit = 1ULL << slot[u];
+            for (unsigned long long int mask = 0; mask < used; mask++) {
+                if (mask & bit)
+                    sums[mask] = static_cast<T>(0.0);
+            }
+
+            vertex[slot[u]] = -1;
+            slot[u] = -1;
+        }
+    }
+
+    return sums[0];
+}
+
+
+/**
+ * Returns the hafnian of a sparse matrix, using dynamic programming over
+ * the path decomposition found by sparse_ordering(). The number of
+ * operations grows exponentially with the width of the decomposition
+ * (see sparse_width()), rather than with the size of the matrix.
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an \f$n\times n\f$
+ *       row-ordered symmetric matrix.
+ * @return hafnian of the input matrix
+ */
+template <typename T>
+inline T hafnian_sparse(std::vector<T> &mat) {
+    int n = std::sqrt(static_cast<double>(mat.size()));
+    std::vector<std::vector<int>> adj = sparse_neighbours(mat, n);
+    std::vector<int> order = sparse_ordering(adj);
+
+    return hafnian_sparse(mat, adj, order);
+}
+
+
+/**
+ * Returns the hafnian of the matrix `mat`. If the path decomposition of its
+ * graph found by sparse_ordering() is narrow enough, the hafnian is computed
+ * by hafnian_sparse(); otherwise, it is computed by the function `haf`.
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an \f$n\times n\f$
+ *       row-ordered symmetric matrix of even size.
+ * @param haf function returning the hafnian of a matrix
+ * @param maxwidth largest width for which hafnian_sparse() is used, which
+ *      bounds its memory use to \f$2^{\text{maxwidth}+1}\f$ entries
+ * @return hafnian of the input matrix
+ */
+template <typename T, typename F>
+inline T sparse_hafnian(std::vector<T> &mat, F haf, int maxwidth = 20) {
+    int n = std::sqrt(static_cast<double>(mat.size()));
+    std::vector<std::vector<int>> adj = sparse_neighbours(mat, n);
+    std::vector<int> order = sparse_ordering(adj);
+    int w = sparse_width(adj, order);
+
+    // the other algorithms visit 2^(n/2) subsets
+    if (w > maxwidth || w >= n / 2)
+        return haf(mat);
+
+    return hafnian_sparse(mat, adj, order);
+}
+
+
+/**
+ * Returns the hafnian of a sparse matrix, using hafnian_sparse().
+ *
+ * This is a wrapper around the templated function `hafnian::hafnian_sparse` for Python
+ * integration. It accepts and returns complex double numeric types, and
+ * returns sensible values for empty and non-even matrices.
+ *
+ * In addition, this wrapper function automatically casts all matrices
+ * to type `complex<long double>`, allowing for greater precision than supported
+ * by Python and NumPy.
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an
+ *      \f$n\times n\f$ row-ordered symmetric matrix.
+ * @return hafnian of the input matrix
+ */
+std::complex<double> hafnian_sparse_quad(std::vector<std::complex<double>> &mat) {
+    std::vector<std::complex<long double>> matq(mat.begin(), mat.end());
+    int n = std::sqrt(static_cast<double>(mat.size()));
+    std::complex<long double> haf;
+
+    if (n == 0)
+        haf = std::complex<long double>(1.0, 0.0);
+    else if (n % 2 != 0)
+        haf = std::complex<long double>(0.0, 0.0);
+    else
+        haf = hafnian_sparse(matq);
+
+    return static_cast<std::complex<double>>(haf);
+}
+
+
+/**
+ * Returns the hafnian of a sparse matrix, using hafnian_sparse().
+ *
+ * This is a wrapper around the templated function `hafnian::hafnian_sparse` for Python
+ * integration. It accepts and returns double numeric types, and
+ * returns sensible values for empty and non-even matrices.
+ *
+ * In addition, this wrapper function automatically casts all matrices
+ * to type `long double`, allowing for greater precision than supported
+ * by Python and NumPy.
+ *
+ * @param mat a flattened vector of size \f$n^2\f$, representing an
+ *      \f$n\times n\f$ row-ordered symmetric matrix.
+ * @return hafnian of the input matrix
+ */
+double hafnian_sparse_quad(std::vector<double> &mat) {
+    std::vector<long double> matq(mat.begin(), mat.end());
+    int n = std::sqrt(static_cast<double>(mat.size()));
+    long double haf;
+
+    if (n == 0)
+        haf = 1.0;
+    else if (n % 2 != 0)
+        haf = 0.0;
+    else
+        haf = hafnian_sparse(matq);
+
+    return static_cast<double>(haf);
+}
+
+}
@@ -15,9 +15,11 @@
 #include <iomanip>
 #include <iostream>
 #include <vector>
+#include <algorithm>
 #include <numeric>
 #include <complex>
 #include <assert.h>
+#include <chrono>
 
 #define SC_STACK  128        // 2098 bit / 53 = min 40 long doubles
 
@@ -70,3 +72,302 @@ inline Byte find2(char* dst, Byte len, Byte* pos) {
     }
     return 2 * j;
 }
+
+
+/**
+ * Sums the entries of the vector `partial` pairwise in a fixed binary tree
+ * order. The result therefore only depends on the entries and their
+ * position in the vector, and not on the order in which they were computed.
+ *
+ * @param partial vector of partial sums. It is overwritten.
+ * @return the sum of all entries of `partial`
+ */
+template <typename T>
+inline T tree_reduce(std::vector<T> &partial) {
+    std::size_t len = partial.size();
+
+    if (len == 0)
+        return static_cast<T>(0.0);
+
+    for (std::size_t stride = 1; stride < len; stride *= 2) {
+        for (std::size_t i = 0; i + stride < len; i += 2 * stride) {
+            partial[i] += partial[i + stride];
+        }
+    }
+
+    return partial[0];
+}
+
+
+/**
+ * Sums the entries of the vector `partial` in order using Neumaier's
+ * compensated summation, which carries the rounding error of each
+ * addition forward so that the result is accurate to nearly the working
+ * precision, independently of the number of entries.
+ *
+ * @param partial vector of partial sums
+ * @return the sum of all entries of `partial`
+ */
+template <typename T>
+inline T compensated_sum(const std::vector<T> &partial) {
+    using std::abs;
+    T sum = static_cast<T>(0.0);
+    T comp = static_cast<T>(0.0);
+
+    for (const T &x : partial) {
+        T t = sum + x;
+
+        if (abs(sum) >= abs(x))
+            comp += (sum - t) + x;
+        else
+            comp += (x - t) + sum;
+
+        sum = t;
+    }
+
+    return sum + comp;
+}
+
+
+/**
+ * Sums the entries of the complex vector `partial` in order, applying
+ * Neumaier's compensated summation to the real and imaginary parts.
+ *
+ * @param partial vector of complex partial sums
+ * @return the sum of all entries of `partial`
+ */
+template <typename T>
+inline std::complex<T> compensated_sum(const std::vector<std::complex<T>> &partial) {
+    std::vector<T> re(partial.size()), im(partial.size());
+
+    for (std::size_t i = 0; i < partial.size(); i++) {
+        re[i] = std::real(partial[i]);
+        im[i] = std::imag(partial[i]);
+    }
+
+    return std::complex<T>(compensated_sum(re), compensated_sum(im));
+}
+
+
+/**
+ * Returns the number of ones in the binary representation of `x`.
+ *
+ * @param x unsigned integer
+ * @return the number of ones in `x`
+ */
+inline int popcount(unsigned long long int x) {
+    int cnt = 0;
+    while (x != 0) {
+        x &= x - 1;
+        cnt++;
+    }
+    return cnt;
+}
+
+
+/**
+ * Returns the reflected binary Gray code of `x`.
+ *
+ * Consecutive values of `x` are mapped to values differing in a single bit,
+ * namely bit trailing_zeros() of `x + 1`.
+ *
+ * @param x integer
+ * @return the Gray code of `x`
+ */
+inline unsigned long long int gray_code(unsigned long long int x) {
+    return x ^ (x >> 1);
+}
+
+
+/**
+ * Returns the number of trailing zero bits of the nonzero integer `x`.
+ *
+ * @param x nonzero integer
+ * @return the index of the lowest set bit of `x`
+ */
+inline int trailing_zeros(unsigned long long int x) {
+    int cnt = 0;
+    while ((x & 1ULL) == 0) {
+        x >>= 1;
+        cnt++;
+    }
+    return cnt;
+}
+
+
+/**
+ * Returns the number of bits of the binary representation of `x`, that is
+ * one more than the index of its highest set bit, or zero if \f$x=0\f$.
+ *
+ * @param x integer
+ * @return the bit length of `x`
+ */
+inline int bit_length(unsigned long long int x) {
+    int cnt = 0;
+    while (x != 0) {
+        x >>= 1;
+        cnt++;
+    }
+    return cnt;
+}
+
+
+/**
+ * Accumulates a sequence of terms by pairwise summation: the sums of
+ * consecutive blocks of \f$1, 2, 4, \dots\f$ terms are combined as the
+ * digits of a binary counter, so that the rounding error grows with the
+ * logarithm of the number of terms, while only one partial sum per power
+ * of two is stored.
+ */
+template <typename T>
+class pairwise_sum {
+public:
+    /**
+     * Adds the term `x`.
+     */
+    void add(T x) {
+        std::size_t k = 0;
+
+        for (; k < full.size() && full[k]; k++) {
+            x = sums[k] + x;
+            full[k] = false;
+        }
+
+        if (k == sums.size()) {
+            sums.push_back(x);
+            full.push_back(true);
+        }
+        else {
+            sums[k] = x;
+            full[k] = true;
+        }
+    }
+
+    /**
+     * Returns the sum of the terms added so far.
+     */
+    T result() const {
+        T sum = static_cast<T>(0.0);
+
+        for (std::size_t k = 0; k < sums.size(); k++) {
+            if (full[k])
+                sum += sums[k];
+        }
+
+        return sum;
+    }
+
+private:
+    /// sums of the blocks of \f$2^k\f$ terms
+    std::vector<T> sums;
+    /// whether the block of \f$2^k\f$ terms is complete
+    std::vector<bool> full;
+};
+
+
+/**
+ * Returns the estimated cost of processing a subset containing `k` of the
+ * `m` pairs of rows/columns of a matrix in the subset enumeration kernels.
+ * This is dominated by the \f$O(k^3)\f$ linear algebra performed
+ * on the \f$2k\times 2k\f$ submatrix.
+ *
+ * @param k number of pairs in the subset
+ * @param m total number of pairs
+ * @return the estimated cost, in arbitrary units
+ */
+inline double subset_cost(int k, int m) {
+    return 8.0 * k * k * k + static_cast<double>(m) * m;
+}
+
+
+/**
+ * Returns the estimated cost (see subset_cost()) of processing all the
+ * subsets \f$0,1,\dots,y-1\f$, where the binary representation of a subset
+ * index (or of its Gray code, if `gray` is true) marks which of the `m`
+ * pairs it contains.
+ *
+ * The range is decomposed into aligned blocks of length \f$2^b\f$, whose
+ * costs are computed in closed form, so that this requires \f$O(m^2)\f$
+ * operations rather than \f$O(y)\f$. The Gray code maps such a block onto
+ * another aligned block, so the same decomposition applies in both cases.
+ *
+ * @param y number of subsets
+ * @param m total number of pairs
+ * @param gray whether subset indices are Gray encoded
+ * @return the estimated cost of the subsets
+ */
+inline double subset_prefix_cost(unsigned long long int y, int m, bool gray = false) {
+    double total = 0.0;
+
+    for (int b = 63; b >= 0; b--) {
+        if (((y >> b) & 1ULL) == 0)
+            continue;
+
+        // the block of subsets sharing the bits of y above b, with bit b unset
+        unsigned long long int high = (b == 63) ? 0 : ((y >> (b + 1)) << 1);
+        int c = popcount(gray ? gray_code(high) : high);
+        double binom = 1.0;
+
+        for (int k = 0; k <= b; k++) {
+            total += binom * subset_cost(c + k, m);
+            binom = binom * (b - k) / (k + 1);
+        }
+    }
+
+    return total;
+}
+
+
+/**
+ * Splits the subsets \f$X,X+1,\dots,X+\text{chunksize}-1\f$ into `nparts`
+ * contiguous ranges of approximately equal estimated cost (see subset_cost()).
+ *
+ * Since the cost of a subset grows with the number of pairs it contains,
+ * this balances the work between threads far better than ranges of equal
+ * length, while remaining deterministic.
+ *
+ * @param X initial subset index
+ * @param chunksize number of subsets
+ * @param m total number of pairs
+ * @param nparts number of ranges
+ * @param gray whether subset indices are Gray encoded
+ * @return vector `bounds` of length `nparts + 1`, such that range \f$i\f$
+ *      contains the subsets `bounds[i]` to `bounds[i + 1] - 1`.
+ */
+inline std::vector<unsigned long long int> balanced_bounds(unsigned long long int X, unsigned long long int chunksize,
+        int m, int nparts, bool gray = false) {
+    std::vector<unsigned long long int> bounds(nparts + 1, X);
+    double start = subset_prefix_cost(X, m, gray);
+    double total = subset_prefix_cost(X + chunksize, m, gray) - start;
+
+    bounds[nparts] = X + chunksize;
+
+    for (int i = 1; i < nparts; i++) {
+        double target = start + total * i / nparts;
+        unsigned long long int lo = bounds[i - 1];
+        unsigned long long int hi = X + chunksize;
+
+        while (lo < hi) {
+            unsigned long long int mid = lo + (hi - lo) / 2;
+            if (subset_prefix_cost(mid, m, gray) < target)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+
+        bounds[i] = lo;
+    }
+
+    return bounds;
+}
+
+
+/**
+ * Returns the wall time in seconds elapsed since `start`.
+ *
+ * @param start starting time point
+ * @return the elapsed time in seconds
+ */
+inline double elapsed_seconds(const std::chrono::steady_clock::time_point &start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
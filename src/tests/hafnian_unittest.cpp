@@ -12,15 +12,55 @@
 // WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 // See the License for the specific language governing permissions and
 // limitations under the License.
+#define EIGEN_RUNTIME_NO_MALLOC
 #include "gtest/gtest.h"
 #include <random>
 #include <iostream>
+#include <cstdlib>
+#include <new>
+#include <fstream>
+#include <string>
 #include <hafnian.hpp>
 #include <math.h>
 
 const double tol = 1.0e-10f;
 const double tol2 = 1.0e-7f;
 
+// Counts the calls to operator new while count_allocations is true. Heap
+// allocations performed by Eigen bypass operator new, and are instead caught
+// by Eigen::internal::set_is_malloc_allowed(false).
+static bool count_allocations = false;
+static long long int allocations = 0;
+
+void *operator new(std::size_t size) {
+    if (count_allocations)
+        allocations++;
+    void *p = std::malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void *operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void operator delete[](void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept {
+    std::free(p);
+}
+
 
 namespace permanent {
 TEST(PermanentRealFsum, CompleteGraph) {
@@ -116,6 +156,51 @@ TEST(PermanentComplex, Random) {
 
 }
 
+
+// Check Glynn's formula against Ryser's formula, and that its chunks add up
+// to the permanent.
+TEST(PermanentGlynn, Random) {
+    std::vector<double> empty;
+    std::vector<double> ones(16, 1.0);
+
+    EXPECT_EQ(1.0, hafnian::permanent_glynn(empty));
+    EXPECT_NEAR(24, hafnian::permanent_glynn(ones), tol);
+    EXPECT_NEAR(24, hafnian::permanent_glynn_quad(ones), tol);
+
+    std::default_random_engine generator;
+    generator.seed(20);
+    std::normal_distribution<double> distribution(0.0, 1.0);
+
+    for (int n = 1; n <= 10; n++) {
+        std::vector<std::complex<double>> mat(n * n);
+        for (auto &m : mat)
+            m = std::complex<double>(distribution(generator), distribution(generator));
+
+        std::vector<double> matr(n * n);
+        for (int i = 0; i < n * n; i++)
+            matr[i] = std::real(mat[i]);
+
+        std::complex<double> expected = hafnian::permanent_quad(mat);
+        std::complex<double> perm = hafnian::permanent_glynn(mat);
+        EXPECT_NEAR(std::real(expected), std::real(perm), tol);
+        EXPECT_NEAR(std::imag(expected), std::imag(perm), tol);
+
+        perm = hafnian::permanent_glynn_quad(mat);
+        EXPECT_NEAR(std::real(expected), std::real(perm), tol);
+        EXPECT_NEAR(std::imag(expected), std::imag(perm), tol);
+
+        double expectedr = hafnian::permanent_quad(matr);
+        EXPECT_NEAR(expectedr, hafnian::permanent_glynn(matr), tol);
+        EXPECT_NEAR(expectedr, hafnian::permanent_glynn_quad(matr), tol);
+
+        llint terms = 1LL << (n - 1);
+        double sum = 0.0;
+        for (llint X = 0; X < terms; X += 3)
+            sum += hafnian::permanent_glynn_chunk(matr, n, X, std::min<llint>(3, terms - X));
+        EXPECT_NEAR(expectedr, sum, tol);
+    }
+}
+
 }
 
 namespace recursive_real {
@@ -271,6 +356,196 @@ TEST(HafianRecursiveDoubleComplex, Empty) {
     EXPECT_NEAR(0, im, tol);
 }
 
+
+// Check that the recursion performs no heap allocations once its workspace is allocated,
+// and that it agrees with the parallel recursive hafnian and the eigenvalue hafnian.
+TEST(HafianRecursiveDoubleComplex, NoAllocations) {
+    int n = 10;
+    std::vector<std::complex<double>> mat(4 * n * n, 0.0);
+
+    std::default_random_engine generator;
+    generator.seed(20);
+    std::normal_distribution<double> distribution(0.0, 0.2);
+
+    for (int i = 0; i < 2 * n; i++) {
+        for (int j = 0; j <= i; j++) {
+            mat[i * 2 * n + j] = std::complex<double>(distribution(generator), distribution(generator));
+            mat[j * 2 * n + i] = mat[i * 2 * n + j];
+        }
+    }
+
+    std::vector<std::complex<double>> z(n * (2 * n - 1) * (n + 1), 0.0);
+    std::vector<std::complex<double>> g(n + 1, 0.0);
+    g[0] = 1.0;
+
+    for (int j = 1; j < 2 * n; j++) {
+        for (int k = 0; k < j; k++)
+            z[(n + 1) * (j * (j - 1) / 2 + k)] = mat[2 * j * n + k];
+    }
+
+    hafnian::recursive_workspace<std::complex<double>> ws(n, n);
+
+    allocations = 0;
+    count_allocations = true;
+    std::complex<double> haf = hafnian::recursive_chunk(z.data(), 2 * n, 1, g.data(), n, ws);
+    count_allocations = false;
+
+    EXPECT_EQ(0, allocations);
+
+    std::complex<double> expected = hafnian::hafnian(mat);
+    std::complex<double> haf_parallel = hafnian::hafnian_recursive(mat);
+
+    EXPECT_NEAR(std::real(expected), std::real(haf), tol);
+    EXPECT_NEAR(std::imag(expected), std::imag(haf), tol);
+    EXPECT_NEAR(std::real(expected), std::real(haf_parallel), tol);
+    EXPECT_NEAR(std::imag(expected), std::imag(haf_parallel), tol);
+}
+
+
+// Check that the recursive hafnian does not depend on the cutoff depth, nor on the number of threads.
+TEST(HafianRecursiveDoubleComplex, Cutoff) {
+    int n = 16;
+    std::vector<std::complex<double>> mat(n * n, 0.0);
+
+    std::default_random_engine generator;
+    generator.seed(20);
+    std::normal_distribution<double> distribution(0.0, 0.2);
+
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j <= i; j++) {
+            mat[i * n + j] = std::complex<double>(distribution(generator), distribution(generator));
+            mat[j * n + i] = mat[i * n + j];
+        }
+    }
+
+    std::complex<double> expected = hafnian::hafnian(mat);
+
+    for (int cutoff = 0; cutoff <= n / 2 + 1; cutoff++) {
+        std::complex<double> haf = hafnian::hafnian_recursive(mat, cutoff);
+        EXPECT_NEAR(std::real(expected), std::real(haf), tol);
+        EXPECT_NEAR(std::imag(expected), std::imag(haf), tol);
+    }
+
+    EXPECT_EQ(0, hafnian::recursive_cutoff(0, 64));
+    EXPECT_EQ(3, hafnian::recursive_cutoff(n / 2, 1));
+    EXPECT_EQ(6, hafnian::recursive_cutoff(n / 2, 8));
+
+#ifdef _OPENMP
+    int nthreads = omp_get_max_threads();
+    omp_set_num_threads(1);
+    std::complex<double> serial = hafnian::hafnian_recursive(mat, 6);
+    omp_set_num_threads(3);
+    std::complex<double> parallel = hafnian::hafnian_recursive(mat, 6);
+    omp_set_num_threads(nthreads);
+
+    EXPECT_EQ(serial, parallel);
+#endif
+}
+
+
+// Check that the leaves of the recursion can be summed from any starting leaf.
+TEST(HafianRecursiveDoubleComplex, Chunk) {
+    int n = 14;
+    std::vector<std::complex<double>> mat(n * n, 0.0);
+
+    std::default_random_engine generator;
+    generator.seed(20);
+    std::normal_distribution<double> distribution(0.0, 0.2);
+
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j <= i; j++) {
+            mat[i * n + j] = std::complex<double>(distribution(generator), distribution(generator));
+            mat[j * n + i] = mat[i * n + j];
+        }
+    }
+
+    std::complex<double> expected = hafnian::hafnian(mat);
+    std::complex<double> haf = hafnian::do_chunk_recursive(mat, n, 0, 1ULL << (n / 2));
+    EXPECT_NEAR(std::real(expected), std::real(haf), tol);
+    EXPECT_NEAR(std::imag(expected), std::imag(haf), tol);
+
+    // split the leaves at random points
+    std::uniform_int_distribution<unsigned long long int> split(0, 1ULL << (n / 2));
+    std::vector<unsigned long long int> bounds = {0, 1ULL << (n / 2)};
+    for (int i = 0; i < 6; i++)
+        bounds.push_back(split(generator));
+    std::sort(bounds.begin(), bounds.end());
+
+    haf = 0.0;
+    for (std::size_t i = 0; i + 1 < bounds.size(); i++)
+        haf += hafnian::do_chunk_recursive(mat, n, bounds[i], bounds[i + 1] - bounds[i]);
+
+    EXPECT_NEAR(std::real(expected), std::real(haf), tol);
+    EXPECT_NEAR(std::imag(expected), std::imag(haf), tol);
+
+    // a range of two leaves, which differ in the deepest level only
+    // when the first is even, is the sum of its leaves
+    for (unsigned long long int x = 0; x < (1ULL << (n / 2)); x += 37) {
+        std::complex<double> leaf = hafnian::do_chunk_recursive(mat, n, x, 1);
+        std::complex<double> pair = hafnian::do_chunk_recursive(mat, n, x, 2);
+        EXPECT_NEAR(std::abs(pair - leaf - hafnian::do_chunk_recursive(mat, n, x + 1, 1)), 0.0, tol);
+    }
+}
+
+}
+
+namespace truncated_product {
+
+// Check the vectorized truncated polynomial products against the scalar loops,
+// for every instruction set supported by the processor.
+TEST(TruncatedProduct, Kernels) {
+    std::default_random_engine generator;
+    generator.seed(20);
+    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+
+    hafnian::simd_level detected = hafnian::detect_simd();
+    std::vector<hafnian::simd_level> levels{hafnian::simd_none, hafnian::simd_avx2, hafnian::simd_avx512};
+
+    for (hafnian::simd_level level : levels) {
+        if (level > detected)
+            continue;
+        hafnian::simd_support() = level;
+
+        for (int n : {1, 3, 4, 8, 13, 20, 64, 70}) {
+            std::vector<double> x(4 * n), c(n + 1), expected(n + 1);
+            std::vector<std::complex<double>> z(4 * n), cz(n + 1), expectedz(n + 1);
+            std::vector<hafnian::double_double> d(4 * n), cd(n + 1), expectedd(n + 1);
+
+            for (int i = 0; i < 4 * n; i++) {
+                x[i] = distribution(generator);
+                z[i] = std::complex<double>(distribution(generator), distribution(generator));
+                d[i] = hafnian::double_double(distribution(generator)) / 3;
+            }
+            for (int i = 0; i <= n; i++) {
+                c[i] = expected[i] = distribution(generator);
+                cz[i] = expectedz[i] = std::complex<double>(distribution(generator), distribution(generator));
+                cd[i] = expectedd[i] = hafnian::double_double(distribution(generator)) / 7;
+            }
+
+            hafnian::add_truncated_products(c.data(), &x[0], &x[n], &x[2 * n], &x[3 * n], n);
+            hafnian::add_truncated_product(expected.data(), &x[0], &x[n], n);
+            hafnian::add_truncated_product(expected.data(), &x[2 * n], &x[3 * n], n);
+
+            hafnian::add_truncated_products(cz.data(), &z[0], &z[n], &z[2 * n], &z[3 * n], n);
+            hafnian::add_truncated_product(expectedz.data(), &z[0], &z[n], n);
+            hafnian::add_truncated_product(expectedz.data(), &z[2 * n], &z[3 * n], n);
+
+            hafnian::add_truncated_products(cd.data(), &d[0], &d[n], &d[2 * n], &d[3 * n], n);
+            hafnian::add_truncated_product(expectedd.data(), &d[0], &d[n], n);
+            hafnian::add_truncated_product(expectedd.data(), &d[2 * n], &d[3 * n], n);
+
+            for (int i = 0; i <= n; i++) {
+                EXPECT_NEAR(expected[i], c[i], 1e-13);
+                EXPECT_NEAR(std::real(expectedz[i]), std::real(cz[i]), 1e-13);
+                EXPECT_NEAR(std::imag(expectedz[i]), std::imag(cz[i]), 1e-13);
+                EXPECT_GT(1e-29, std::abs(static_cast<double>(expectedd[i] - cd[i])));
+            }
+        }
+    }
+
+    hafnian::simd_support() = detected;
+}
+
 }
 
 namespace eigen_real {
@@ -429,207 +704,1656 @@ TEST(HafianEigenDoubleComplex, Empty) {
 }
 
 
+namespace labudde {
 
-namespace approx_real {
+// Check that the La Budde power traces agree with the eigenvalue power traces for a real matrix.
+TEST(PowtraceLabudde, Real) {
+    int n = 7;
+    int l = 10;
+    std::vector<double> mat(n * n, 0.0);
 
-// Unit tests for the real non negative hafnian_approx function
-// Check approx hafnian for random matrices with even dimensions.
-TEST(HafnianApproxNonngeative, Random) {
-    std::vector<double> mat4(16, 0.0);
-    std::vector<double> mat6(36, 0.0);
-    std::vector<double> mat8(64, 0.0);
+    std::default_random_engine generator;
+    generator.seed(20);
+    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+
+    for (int i = 0; i < n * n; i++)
+        mat[i] = distribution(generator);
+
+    std::vector<double> expected = hafnian::powtrace(mat, n, l);
+    std::vector<double> traces = hafnian::powtrace_labudde(mat, n, l);
+
+    for (int i = 0; i < l; i++)
+        EXPECT_NEAR(expected[i], traces[i], tol);
+}
+
+
+// Check that the La Budde power traces agree with the eigenvalue power traces for a complex matrix.
+TEST(PowtraceLabudde, Complex) {
+    int n = 7;
+    int l = 10;
+    std::vector<std::complex<double>> mat(n * n, 0.0);
 
     std::default_random_engine generator;
-    std::normal_distribution<double> distribution(1.0, 0.0);
     generator.seed(20);
+    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
 
-    int n = 4;
-    int nsamples = 20000;
-    std::vector<double> x4(n, 0.0);
+    for (int i = 0; i < n * n; i++)
+        mat[i] = std::complex<double>(distribution(generator), distribution(generator));
 
-    for (int i = 0; i < n; i++) {
-        double randnum = distribution(generator);
-        x4[i]  = randnum;
-    }
+    std::vector<std::complex<double>> expected = hafnian::powtrace(mat, n, l);
+    std::vector<std::complex<double>> traces = hafnian::powtrace_labudde(mat, n, l);
 
-    for (int i = 0; i < n; i++) {
-        for (int j = 0; j < n; j++) {
-            mat4[i * n + j] = x4[i] * x4[j];
-        }
+    for (int i = 0; i < l; i++) {
+        EXPECT_NEAR(std::real(expected[i]), std::real(traces[i]), tol);
+        EXPECT_NEAR(std::imag(expected[i]), std::imag(traces[i]), tol);
     }
+}
 
 
-    n = 6;
-    std::vector<double> x6(n, 0.0);
+// Check the power traces and loop corrections of a bordered complex matrix against direct products.
+TEST(PowtraceLabudde, Loops) {
+    int n = 7;
+    int l = 10;
+    std::vector<std::complex<double>> mat(n * n, 0.0), c(n, 0.0), d(n, 0.0);
+
+    std::default_random_engine generator;
+    generator.seed(20);
+    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
 
+    for (int i = 0; i < n * n; i++)
+        mat[i] = std::complex<double>(distribution(generator), distribution(generator));
     for (int i = 0; i < n; i++) {
-        double randnum = distribution(generator);
-        x6[i]  = randnum;
+        c[i] = std::complex<double>(distribution(generator), distribution(generator));
+        d[i] = std::complex<double>(distribution(generator), distribution(generator));
     }
 
+    std::vector<std::complex<double>> bordered((n + 1) * (n + 1), 0.0);
     for (int i = 0; i < n; i++) {
-        for (int j = 0; j < n; j++) {
-            mat6[i * n + j] = x6[i] * x6[j];
-        }
+        bordered[i + 1] = c[i];
+        bordered[(i + 1) * (n + 1)] = d[i];
+        for (int j = 0; j < n; j++)
+            bordered[(i + 1) * (n + 1) + j + 1] = mat[i * n + j];
     }
 
-    n = 8;
-    std::vector<double> x8(n, 0.0);
+    std::vector<std::complex<double>> traces(l, 0.0), loops(l, 0.0);
+    std::vector<std::complex<double>> scratch(n + 1 + (n + 2) * (n + 2), 0.0);
+    hafnian::loop_powtrace_labudde(bordered.data(), n, l, traces.data(), loops.data(), scratch.data());
 
-    for (int i = 0; i < n; i++) {
-        double randnum = distribution(generator);
-        x8[i]  = randnum;
+    std::vector<std::complex<double>> expected = hafnian::powtrace(mat, n, l);
+    std::vector<std::complex<double>> v(d), w(n, 0.0);
+
+    for (int k = 0; k < l; k++) {
+        std::complex<double> loop = 0.0;
+        for (int i = 0; i < n; i++)
+            loop += c[i] * v[i];
+
+        EXPECT_NEAR(std::real(expected[k]), std::real(traces[k]), tol);
+        EXPECT_NEAR(std::imag(expected[k]), std::imag(traces[k]), tol);
+        EXPECT_NEAR(std::real(loop), std::real(loops[k]), tol);
+        EXPECT_NEAR(std::imag(loop), std::imag(loops[k]), tol);
+
+        for (int i = 0; i < n; i++) {
+            w[i] = 0.0;
+            for (int j = 0; j < n; j++)
+                w[i] += mat[i * n + j] * v[j];
+        }
+        v = w;
     }
+}
+
+// Check hafnian of real complete graphs using the La Budde power traces.
+TEST(HafnianLabudde, CompleteGraphEven) {
+    std::vector<double> mat4(16, 1.0);
+    std::vector<double> mat6(36, 1.0);
+    std::vector<double> mat8(64, 1.0);
+    EXPECT_NEAR(3, hafnian::hafnian_eigen(mat4, hafnian::labudde), tol);
+    EXPECT_NEAR(15, hafnian::hafnian_eigen(mat6, hafnian::labudde), tol);
+    EXPECT_NEAR(105, hafnian::hafnian_eigen(mat8, hafnian::labudde), tol);
+}
+
+
+// Check that the hafnian of a random complex matrix agrees with the recursive algorithm.
+TEST(HafnianLabudde, Random) {
+    int n = 12;
+    std::vector<std::complex<double>> mat(n * n, 0.0);
+
+    std::default_random_engine generator;
+    generator.seed(20);
+    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
 
     for (int i = 0; i < n; i++) {
-        for (int j = 0; j < n; j++) {
-            mat8[i * n + j] = x8[i] * x8[j];
+        for (int j = 0; j <= i; j++) {
+            mat[i * n + j] = std::complex<double>(distribution(generator), distribution(generator));
+            mat[j * n + i] = mat[i * n + j];
         }
     }
 
-    double expected4 = 3.0 * std::accumulate(begin(x4), end(x4), 1, std::multiplies<double>());
-    double expected6 = 15.0 * std::accumulate(begin(x6), end(x6), 1, std::multiplies<double>());
-    double expected8 = 105.0 * std::accumulate(begin(x8), end(x8), 1, std::multiplies<double>());
+    std::complex<double> expected = hafnian::hafnian_recursive_quad(mat);
+    std::complex<double> haf = hafnian::hafnian_eigen(mat, hafnian::labudde);
 
-    double haf4 = hafnian::hafnian_approx(mat4, nsamples);
-    double haf6 = hafnian::hafnian_approx(mat6, nsamples);
-    double haf8 = hafnian::hafnian_approx(mat8, nsamples);
+    EXPECT_NEAR(std::real(expected), std::real(haf), tol2);
+    EXPECT_NEAR(std::imag(expected), std::imag(haf), tol2);
+}
 
-    EXPECT_NEAR(expected4, haf4, haf4 / 15.0);
-    EXPECT_NEAR(expected6, haf6, haf6 / 15.0);
-    EXPECT_NEAR(expected8, haf8, haf8 / 15.0);
 
-}
+// Check that the loop hafnian of a random real matrix agrees with the eigenvalue algorithm.
+TEST(LoopHafnianLabudde, Random) {
+    int n = 10;
+    std::vector<double> mat(n * n, 0.0);
 
-}
+    std::default_random_engine generator;
+    generator.seed(20);
+    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
 
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j <= i; j++) {
+            mat[i * n + j] = distribution(generator);
+            mat[j * n + i] = mat[i * n + j];
+        }
+    }
 
-namespace hafnian_repeated {
+    double expected = hafnian::loop_hafnian_eigen(mat);
+    double haf = hafnian::loop_hafnian_eigen(mat, hafnian::labudde);
 
-// Unit tests for the repeated hafnian function
-// Check repeated hafnian for all zero matrices with even dimensions.
-TEST(HafnianRepeatedDouble, ZeroRpt) {
-    std::vector<double> mat(16, 1.0);
-    std::vector<int> rpt(4, 0);
+    EXPECT_NEAR(expected, haf, tol2);
 
-    double haf = hafnian::hafnian_rpt_quad(mat, rpt);
+    std::vector<double> mat5(25, 1.0);
+    EXPECT_NEAR(26, hafnian::loop_hafnian_eigen(mat5, hafnian::labudde), tol);
+}
 
-    EXPECT_NEAR(1, haf, tol);
 }
 
-// Check repeated hafnian for all ones matrices with even dimensions.
-TEST(HafnianRepeatedDouble, AllOneRpt) {
-    std::vector<double> mat2rand(4, 1.0);
-    std::vector<double> mat2(4, 1.0);
-    std::vector<int> rpt2(2, 1);
+namespace workspace {
 
-    std::vector<double> mat4rand(16, 1.0);
-    std::vector<double> mat4(16, 1.0);
-    std::vector<int> rpt4(4, 1);
+// Check that the subset kernels perform no heap allocations once the workspace is allocated.
+TEST(Workspace, NoAllocations) {
+    int n = 12;
+    std::vector<std::complex<double>> mat(n * n, 0.0);
+    std::vector<double> matr(n * n, 0.0);
+    std::vector<std::complex<double>> C(n, 0.0), D(n, 0.0);
 
     std::default_random_engine generator;
     generator.seed(20);
-    std::normal_distribution<double> distribution(1.0, 0.0);
+    std::uniform_real_distribution<double> distribution(-0.2, 0.2);
 
-    for (int i = 0; i < 2; i++) {
-        for (int j = 0; j < 2; j++) {
-            double randnum = distribution(generator);
-            mat2rand[i * 2 + j] = randnum;
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j <= i; j++) {
+            mat[i * n + j] = std::complex<double>(distribution(generator), distribution(generator));
+            mat[j * n + i] = mat[i * n + j];
+            matr[i * n + j] = distribution(generator);
+            matr[j * n + i] = matr[i * n + j];
         }
     }
 
-    for (int i = 0; i < 4; i++) {
-        for (int j = 0; j < 4; j++) {
-            double randnum = distribution(generator);
-            mat4rand[i * 4 + j] = randnum;
-        }
+    for (int i = 0; i < n; i += 2) {
+        C[i] = mat[(i + 1) * n + i + 1];
+        C[i + 1] = mat[i * n + i];
+        D[i] = mat[i * n + i];
+        D[i + 1] = mat[(i + 1) * n + i + 1];
     }
 
+    unsigned long long int terms = 1ULL << (n / 2);
 
-    double expected2 = mat2[1];
-    double expected2rand = mat2rand[1];
+    hafnian::workspace<std::complex<double>> ws(n, hafnian::eigensolver);
+    hafnian::workspace<double> wsr(n, hafnian::eigensolver);
+    wsr.reserve_lu();
 
-    double expected4 = 3;
-    double expected4rand = mat4rand[1] * mat4rand[11] + mat4rand[2] * mat4rand[7] + mat4rand[3] * mat4rand[6];;
+    std::complex<double> haf = 0.0, lhaf = 0.0, lhaf_labudde = 0.0, haf_labudde = 0.0, haf_gray = 0.0;
+    double hafr = 0.0, tor = 0.0;
 
-    double haf2 = hafnian::hafnian_rpt_quad(mat2, rpt2);
-    double haf2rand = hafnian::hafnian_rpt_quad(mat2rand, rpt2);
-    double haf4 = hafnian::hafnian_rpt_quad(mat4, rpt4);
-    double haf4rand = hafnian::hafnian_rpt_quad(mat4rand, rpt4);
+    allocations = 0;
+    count_allocations = true;
+    Eigen::internal::set_is_malloc_allowed(false);
 
-    EXPECT_NEAR(expected2, haf2, tol);
-    EXPECT_NEAR(expected2rand, haf2rand, tol);
-    EXPECT_NEAR(expected4, haf4, tol);
-    EXPECT_NEAR(expected4rand, haf4rand, tol);
+    for (unsigned long long int x = 0; x < terms; x++) {
+        haf += hafnian::hafnian_term(mat, n, x, ws, hafnian::eigensolver);
+        haf_labudde += hafnian::hafnian_term(mat, n, x, ws, hafnian::labudde);
+        lhaf += hafnian::loop_hafnian_term(mat, C, D, n, x, ws, hafnian::eigensolver);
+        lhaf_labudde += hafnian::loop_hafnian_term(mat, C, D, n, x, ws, hafnian::labudde);
+        hafr += hafnian::hafnian_term(matr, n, x, wsr, hafnian::eigensolver);
+
+        char len;
+        double det = hafnian::torontonian_det(matr, n, x, wsr, len);
+        tor += (len % 2 == 0 ? 1.0 : -1.0) / std::sqrt(det);
+    }
+
+    for (unsigned long long int x = 0; x < terms; x++) {
+        hafnian::gray_seek(mat, n, x, x != 0, ws);
+        haf_gray += hafnian::gray_hafnian_term(n, ws, hafnian::labudde);
+    }
 
+    Eigen::internal::set_is_malloc_allowed(true);
+    count_allocations = false;
+
+    EXPECT_EQ(0, allocations);
+
+    std::complex<double> expected = hafnian::hafnian_recursive_quad(mat);
+    EXPECT_NEAR(std::real(expected), std::real(haf), tol);
+    EXPECT_NEAR(std::imag(expected), std::imag(haf), tol);
+    EXPECT_NEAR(std::real(expected), std::real(haf_labudde), tol);
+    EXPECT_NEAR(std::imag(expected), std::imag(haf_labudde), tol);
+    EXPECT_NEAR(std::real(expected), std::real(haf_gray), tol);
+    EXPECT_NEAR(std::imag(expected), std::imag(haf_gray), tol);
+    EXPECT_NEAR(std::real(lhaf), std::real(lhaf_labudde), tol);
+    EXPECT_NEAR(std::imag(lhaf), std::imag(lhaf_labudde), tol);
+    EXPECT_NEAR(hafnian::hafnian_recursive_quad(matr), hafr, tol);
+    EXPECT_NEAR(hafnian::torontonian_quad(matr), tor, tol);
 }
 
-// Check repeated hafnian for all zero complex matrices with even dimensions.
-TEST(HafnianRepeatedComplex, ZeroRpt) {
-    std::vector<std::complex<double>> mat(16, std::complex<double>(1.0, 0.0));
-    std::vector<int> rpt(4, 0);
+}
 
-    std::complex<double> haf = hafnian::hafnian_rpt_quad(mat, rpt);
+namespace reduction {
 
-    double re = std::real(haf);
-    double im = std::imag(haf);
+// Check that the tree reduction sums all partial sums.
+TEST(TreeReduce, Sum) {
+    for (int len = 0; len < 10; len++) {
+        std::vector<double> partial(len, 0.0);
+        for (int i = 0; i < len; i++)
+            partial[i] = i + 1;
 
-    EXPECT_NEAR(1, re, tol);
-    EXPECT_NEAR(0, im, tol);
+        EXPECT_EQ(len * (len + 1) / 2, tree_reduce(partial));
+    }
 }
 
 
-// Check repeated hafnian for all ones matrices with even dimensions.
-TEST(HafnianRepeatedComplex, AllOneRpt) {
-    std::vector<std::complex<double>> mat2rand(4, std::complex<double>(0.0, 0.0));
-    std::vector<std::complex<double>> mat2(4, std::complex<double>(1.0, 0.0));
-    std::vector<int> rpt2(2, 1);
-
-    std::vector<std::complex<double>> mat4rand(16, std::complex<double>(0.0, 0.0));
-    std::vector<std::complex<double>> mat4(16, std::complex<double>(1.0, 0.0));
-    std::vector<int> rpt4(4, 1);
+// Check that repeated evaluations of the eigenvalue hafnian and loop hafnian are bitwise identical.
+TEST(TreeReduce, Reproducible) {
+    int n = 16;
+    std::vector<std::complex<double>> mat(n * n, 0.0);
 
     std::default_random_engine generator;
     generator.seed(20);
-    std::normal_distribution<double> distribution(1.0, 0.0);
+    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
 
-    for (int i = 0; i < 2; i++) {
-        for (int j = 0; j < 2; j++) {
-            double randnum1 = distribution(generator);
-            double randnum2 = distribution(generator);
-            mat2rand[i * 2 + j] = std::complex<double>(randnum1, randnum2);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j <= i; j++) {
+            mat[i * n + j] = std::complex<double>(distribution(generator), distribution(generator));
+            mat[j * n + i] = mat[i * n + j];
         }
     }
 
-    for (int i = 0; i < 4; i++) {
-        for (int j = 0; j < 4; j++) {
-            double randnum1 = distribution(generator);
-            double randnum2 = distribution(generator);
-            mat4rand[i * 4 + j] = std::complex<double>(randnum1, randnum2);
-        }
+    std::complex<double> haf = hafnian::hafnian(mat);
+    std::complex<double> lhaf = hafnian::loop_hafnian(mat);
+
+    for (int i = 0; i < 3; i++) {
+        std::complex<double> haf2 = hafnian::hafnian(mat);
+        std::complex<double> lhaf2 = hafnian::loop_hafnian(mat);
+
+        EXPECT_EQ(std::real(haf), std::real(haf2));
+        EXPECT_EQ(std::imag(haf), std::imag(haf2));
+        EXPECT_EQ(std::real(lhaf), std::real(lhaf2));
+        EXPECT_EQ(std::imag(lhaf), std::imag(lhaf2));
     }
+}
 
+}
 
-    double expected2_re = std::real(mat2[1]);
-    double expected2_im = std::imag(mat2[1]);
-    double expected2rand_re = std::real(mat2rand[1]);
-    double expected2rand_im = std::imag(mat2rand[1]);
+namespace schedule {
 
-    double expected4_re = 3;
-    double expected4_im = 0;
-    std::complex<double> expected4rand = mat4rand[1] * mat4rand[11] + mat4rand[2] * mat4rand[7] + mat4rand[3] * mat4rand[6];;
-    double expected4rand_re = std::real(expected4rand);
-    double expected4rand_im = std::imag(expected4rand);
+// Check the closed form cost of a range of subsets against a direct summation.
+TEST(Schedule, PrefixCost) {
+    int m = 8;
+    double expected = 0.0;
 
-    std::complex<double> haf2 = hafnian::hafnian_rpt_quad(mat2, rpt2);
-    std::complex<double> haf2rand = hafnian::hafnian_rpt_quad(mat2rand, rpt2);
-    std::complex<double> haf4 = hafnian::hafnian_rpt_quad(mat4, rpt4);
-    std::complex<double> haf4rand = hafnian::hafnian_rpt_quad(mat4rand, rpt4);
+    for (unsigned long long int y = 0; y <= (1ULL << m); y++) {
+        EXPECT_NEAR(expected, subset_prefix_cost(y, m), 1e-9 * (1.0 + expected));
+        if (y < (1ULL << m))
+            expected += subset_cost(popcount(y), m);
+    }
+}
 
-    double haf2_re = std::real(haf2);
-    double haf2_im = std::imag(haf2);
-    double haf2rand_re = std::real(haf2rand);
-    double haf2rand_im = std::imag(haf2rand);
+
+// Check that the balanced ranges cover all subsets and have similar estimated costs.
+TEST(Schedule, BalancedBounds) {
+    int m = 16;
+    int nparts = 7;
+    unsigned long long int X = 1000;
+    unsigned long long int chunksize = (1ULL << m) - X;
+
+    std::vector<unsigned long long int> bounds = balanced_bounds(X, chunksize, m, nparts);
+
+    EXPECT_EQ(nparts + 1, static_cast<int>(bounds.size()));
+    EXPECT_EQ(X, bounds[0]);
+    EXPECT_EQ(X + chunksize, bounds[nparts]);
+
+    double total = subset_prefix_cost(X + chunksize, m) - subset_prefix_cost(X, m);
+
+    for (int i = 0; i < nparts; i++) {
+        EXPECT_LE(bounds[i], bounds[i + 1]);
+        double cost = subset_prefix_cost(bounds[i + 1], m) - subset_prefix_cost(bounds[i], m);
+        EXPECT_NEAR(total / nparts, cost, 0.01 * total / nparts);
+    }
+}
+
+
+// Check that the per-thread times are reported.
+TEST(Schedule, ThreadTimes) {
+    std::vector<double> mat(64, 1.0);
+    std::vector<double> times;
+
+    EXPECT_NEAR(105, hafnian::hafnian(mat, hafnian::eigensolver, hafnian::binary_order, &times), tol);
+    EXPECT_LT(0, static_cast<int>(times.size()));
+    for (auto t : times)
+        EXPECT_LE(0.0, t);
+
+    std::vector<double> tmat(64, 0.0);
+    for (int i = 0; i < 8; i++)
+        tmat[i * 8 + 7 - i] = tanh(asinh(1.0));
+
+    EXPECT_NEAR(1, hafnian::torontonian(tmat, &times), tol);
+    EXPECT_LT(0, static_cast<int>(times.size()));
+}
+
+}
+
+namespace gray {
+
+// Check the closed form cost of a range of Gray encoded subsets against a direct summation.
+TEST(GrayOrder, PrefixCost) {
+    int m = 8;
+    double expected = 0.0;
+
+    for (unsigned long long int y = 0; y <= (1ULL << m); y++) {
+        EXPECT_NEAR(expected, subset_prefix_cost(y, m, true), 1e-9 * (1.0 + expected));
+        if (y < (1ULL << m))
+            expected += subset_cost(popcount(gray_code(y)), m);
+    }
+}
+
+
+// Check that the terms updated in place match the terms gathered from scratch.
+TEST(GrayOrder, Terms) {
+    int n = 10;
+    std::vector<std::complex<double>> mat(n * n, 0.0);
+    std::vector<std::complex<double>> C(n, 0.0), D(n, 0.0);
+
+    std::default_random_engine generator;
+    generator.seed(20);
+    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j <= i; j++) {
+            mat[i * n + j] = std::complex<double>(distribution(generator), distribution(generator));
+            mat[j * n + i] = mat[i * n + j];
+        }
+    }
+
+    for (int i = 0; i < n; i += 2) {
+        C[i] = mat[(i + 1) * n + i + 1];
+        C[i + 1] = mat[i * n + i];
+        D[i] = mat[i * n + i];
+        D[i + 1] = mat[(i + 1) * n + i + 1];
+    }
+
+    hafnian::workspace<std::complex<double>> ws(n), ws_gray(n);
+
+    for (unsigned long long int x = 0; x < (1ULL << (n / 2)); x++) {
+        hafnian::gray_seek(mat, n, x, x != 0, ws_gray);
+
+        std::complex<double> term = hafnian::hafnian_term(mat, n, gray_code(x), ws, hafnian::labudde);
+        std::complex<double> term_gray = hafnian::gray_hafnian_term(n, ws_gray, hafnian::labudde);
+        EXPECT_NEAR(std::real(term), std::real(term_gray), tol);
+        EXPECT_NEAR(std::imag(term), std::imag(term_gray), tol);
+
+        term = hafnian::loop_hafnian_term(mat, C, D, n, gray_code(x), ws, hafnian::labudde);
+        term_gray = hafnian::gray_loop_hafnian_term(C, D, n, ws_gray, hafnian::labudde);
+        EXPECT_NEAR(std::real(term), std::real(term_gray), tol);
+        EXPECT_NEAR(std::imag(term), std::imag(term_gray), tol);
+    }
+}
+
+
+// Check the hafnian and loop hafnian computed in Gray order for random complex matrices.
+TEST(GrayOrder, Random) {
+    int n = 14;
+    std::vector<std::complex<double>> mat(n * n, 0.0);
+
+    std::default_random_engine generator;
+    generator.seed(20);
+    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j <= i; j++) {
+            mat[i * n + j] = std::complex<double>(distribution(generator), distribution(generator));
+            mat[j * n + i] = mat[i * n + j];
+        }
+    }
+
+    std::complex<double> expected = hafnian::hafnian(mat);
+    std::complex<double> haf = hafnian::hafnian(mat, hafnian::labudde, hafnian::gray_order);
+    std::complex<double> haf_eigen = hafnian::hafnian(mat, hafnian::eigensolver, hafnian::gray_order);
+
+    EXPECT_NEAR(std::real(expected), std::real(haf), tol);
+    EXPECT_NEAR(std::imag(expected), std::imag(haf), tol);
+    EXPECT_NEAR(std::real(expected), std::real(haf_eigen), tol);
+    EXPECT_NEAR(std::imag(expected), std::imag(haf_eigen), tol);
+
+    // the loop hafnian is about 50 in magnitude, so its absolute error in
+    // double precision is comparable to tol
+    expected = hafnian::loop_hafnian_recursive_quad(mat);
+    haf = hafnian::loop_hafnian(mat, hafnian::labudde, hafnian::gray_order);
+
+    EXPECT_GT(tol, std::abs(expected - haf) / std::abs(expected));
+}
+
+
+// Check that partial sums in Gray order add up to the hafnian.
+TEST(GrayOrder, PartialSums) {
+    int n = 12;
+    std::vector<double> mat(n * n, 0.0);
+
+    std::default_random_engine generator;
+    generator.seed(20);
+    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j <= i; j++) {
+            mat[i * n + j] = distribution(generator);
+            mat[j * n + i] = mat[i * n + j];
+        }
+    }
+
+    unsigned long long int terms = 1ULL << (n / 2);
+    unsigned long long int split = terms / 3;
+    double haf = hafnian::do_chunk(mat, n, 0, split, hafnian::labudde, hafnian::gray_order)
+                 + hafnian::do_chunk(mat, n, split, terms - split, hafnian::labudde, hafnian::gray_order);
+
+    EXPECT_NEAR(hafnian::hafnian_recursive_quad(mat), haf, tol);
+}
+
+}
+
+namespace shard {
+
+// Check that the shards of the hafnian and loop hafnian add up to the full result.
+TEST(Shard, Hafnian) {
+    int n = 12;
+    std::vector<std::complex<double>> mat(n * n, 0.0);
+
+    std::default_random_engine generator;
+    generator.seed(20);
+    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j <= i; j++) {
+            mat[i * n + j] = std::complex<double>(distribution(generator), distribution(generator));
+            mat[j * n + i] = mat[i * n + j];
+        }
+    }
+
+    std::complex<double> haf = hafnian::hafnian(mat);
+    std::complex<double> lhaf = hafnian::loop_hafnian(mat);
+
+    for (int nshards = 1; nshards <= 5; nshards++) {
+        std::complex<double> haf_sum = 0.0, haf_gray = 0.0, haf_rec = 0.0, lhaf_sum = 0.0;
+
+        for (int k = 0; k < nshards; k++) {
+            haf_sum += hafnian::hafnian_shard(mat, k, nshards);
+            haf_gray += hafnian::hafnian_shard(mat, k, nshards, hafnian::labudde, hafnian::gray_order);
+            haf_rec += hafnian::hafnian_recursive_shard(mat, k, nshards);
+            lhaf_sum += hafnian::loop_hafnian_shard(mat, k, nshards);
+        }
+
+        EXPECT_NEAR(std::real(haf), std::real(haf_sum), tol);
+        EXPECT_NEAR(std::imag(haf), std::imag(haf_sum), tol);
+        EXPECT_NEAR(std::real(haf), std::real(haf_gray), tol);
+        EXPECT_NEAR(std::imag(haf), std::imag(haf_gray), tol);
+        EXPECT_NEAR(std::real(haf), std::real(haf_rec), tol);
+        EXPECT_NEAR(std::imag(haf), std::imag(haf_rec), tol);
+        EXPECT_NEAR(std::real(lhaf), std::real(lhaf_sum), tol);
+        EXPECT_NEAR(std::imag(lhaf), std::imag(lhaf_sum), tol);
+    }
+}
+
+
+// Check that the shards of the Torontonian and permanent add up to the full result.
+TEST(Shard, TorontonianPermanent) {
+    int n = 8;
+    std::vector<double> tmat(n * n, 0.0);
+    std::vector<double> mat(n * n, 0.0);
+
+    for (int i = 0; i < n; i++)
+        tmat[i * n + n - 1 - i] = tanh(asinh(1.0));
+
+    std::default_random_engine generator;
+    generator.seed(20);
+    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+
+    for (int i = 0; i < n * n; i++)
+        mat[i] = distribution(generator);
+
+    double tor = hafnian::torontonian(tmat);
+    double perm = hafnian::permanent(mat);
+
+    for (int nshards = 1; nshards <= 20; nshards += 3) {
+        double tor_sum = 0.0, perm_sum = 0.0;
+
+        for (int k = 0; k < nshards; k++) {
+            tor_sum += hafnian::torontonian_shard(tmat, k, nshards);
+            perm_sum += hafnian::permanent_shard(mat, k, nshards);
+        }
+
+        EXPECT_NEAR(tor, tor_sum, tol);
+        EXPECT_NEAR(perm, perm_sum, tol);
+    }
+}
+
+
+// Check that the shard ranges cover all terms without overlapping.
+TEST(Shard, Ranges) {
+    unsigned long long int terms = 1000;
+    unsigned long long int end = 0;
+
+    for (int k = 0; k < 7; k++) {
+        unsigned long long int X, chunksize;
+        hafnian::shard_range(k, 7, terms, X, chunksize);
+        EXPECT_EQ(end, X);
+        end = X + chunksize;
+    }
+    EXPECT_EQ(terms, end);
+
+    end = 0;
+    for (int k = 0; k < 7; k++) {
+        unsigned long long int X, chunksize;
+        hafnian::balanced_shard_range(k, 7, 10, false, X, chunksize);
+        EXPECT_EQ(end, X);
+        end = X + chunksize;
+    }
+    EXPECT_EQ(1ULL << 10, end);
+}
+
+}
+
+namespace checkpoint {
+
+// Check that the checkpointed algorithms agree with the main interface.
+TEST(Checkpoint, Algorithms) {
+    int n = 8;
+    std::vector<std::complex<double>> mat(n * n, 0.0);
+    std::vector<double> tmat(n * n, 0.0);
+    std::string filename = "checkpoint_test.txt";
+
+    std::default_random_engine generator;
+    generator.seed(20);
+    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j <= i; j++) {
+            mat[i * n + j] = std::complex<double>(distribution(generator), distribution(generator));
+            mat[j * n + i] = mat[i * n + j];
+        }
+        tmat[i * n + n - 1 - i] = tanh(asinh(1.0));
+    }
+
+    std::complex<double> expected = hafnian::hafnian(mat);
+    std::complex<double> haf = hafnian::hafnian_checkpoint(mat, filename, 5);
+    std::remove(filename.c_str());
+    EXPECT_NEAR(std::real(expected), std::real(haf), tol);
+    EXPECT_NEAR(std::imag(expected), std::imag(haf), tol);
+
+    haf = hafnian::hafnian_recursive_checkpoint(mat, filename, 3);
+    std::remove(filename.c_str());
+    EXPECT_NEAR(std::real(expected), std::real(haf), tol);
+    EXPECT_NEAR(std::imag(expected), std::imag(haf), tol);
+
+    expected = hafnian::loop_hafnian(mat);
+    haf = hafnian::loop_hafnian_checkpoint(mat, filename, 5, hafnian::labudde, hafnian::gray_order);
+    std::remove(filename.c_str());
+    EXPECT_NEAR(std::real(expected), std::real(haf), tol);
+    EXPECT_NEAR(std::imag(expected), std::imag(haf), tol);
+
+    expected = hafnian::permanent(mat);
+    haf = hafnian::permanent_checkpoint(mat, filename, 7);
+    std::remove(filename.c_str());
+    EXPECT_NEAR(std::real(expected), std::real(haf), tol);
+    EXPECT_NEAR(std::imag(expected), std::imag(haf), tol);
+
+    EXPECT_NEAR(1, hafnian::torontonian_checkpoint(tmat, filename, 3), tol);
+    std::remove(filename.c_str());
+}
+
+
+// Check that an interrupted computation resumes from its last complete block.
+TEST(Checkpoint, Resume) {
+    int nblocks = 10;
+    int calls = 0;
+    std::string filename = "checkpoint_test.txt";
+    auto block = [&](int k) { calls++; return std::complex<double>(1.0 / (k + 3), k); };
+
+    std::remove(filename.c_str());
+    std::complex<double> expected = hafnian::checkpointed_sum<std::complex<double>>(filename, "test", nblocks, block);
+    EXPECT_EQ(nblocks, calls);
+
+    // keep the first four blocks, and simulate an interruption while writing the fifth
+    std::ifstream in(filename);
+    std::string line, contents;
+    for (int i = 0; i < 5; i++) {
+        std::getline(in, line);
+        contents += line + "\n";
+    }
+    std::getline(in, line);
+    in.close();
+
+    std::ofstream out(filename);
+    out << contents << line.substr(0, line.size() / 2);
+    out.close();
+
+    calls = 0;
+    std::complex<double> haf = hafnian::checkpointed_sum<std::complex<double>>(filename, "test", nblocks, block);
+    EXPECT_EQ(nblocks - 4, calls);
+    EXPECT_EQ(std::real(expected), std::real(haf));
+    EXPECT_EQ(std::imag(expected), std::imag(haf));
+
+    // a complete checkpoint requires no further blocks
+    calls = 0;
+    haf = hafnian::checkpointed_sum<std::complex<double>>(filename, "test", nblocks, block);
+    EXPECT_EQ(0, calls);
+    EXPECT_EQ(std::real(expected), std::real(haf));
+
+    // a checkpoint of a different computation is left untouched
+    calls = 0;
+    double val = hafnian::checkpointed_sum<double>(filename, "other", nblocks, [&](int k) { calls++; return 1.0; });
+    EXPECT_EQ(0, calls);
+    EXPECT_TRUE(std::isnan(val));
+
+    std::remove(filename.c_str());
+}
+
+}
+
+namespace components {
+
+// Check the connected components of a matrix with permuted blocks.
+TEST(Components, Find) {
+    int n = 7;
+    std::vector<double> mat(n * n, 0.0);
+    std::vector<std::vector<int>> expected = {{0, 3, 5}, {1, 6}, {2}, {4}};
+
+    for (auto &c : expected) {
+        for (std::size_t i = 1; i < c.size(); i++) {
+            mat[c[i - 1] * n + c[i]] = 1.0;
+            mat[c[i] * n + c[i - 1]] = 1.0;
+        }
+    }
+    mat[2 * n + 2] = 1.0;
+
+    EXPECT_EQ(expected, hafnian::connected_components(mat, n));
+}
+
+
+// Check the hafnian and loop hafnian of block diagonal matrices after a permutation.
+TEST(Components, Factorised) {
+    int n = 12;
+    std::vector<int> block = {0, 0, 1, 0, 1, 2, 2, 1, 0, 2, 1, 0};
+    std::vector<std::complex<double>> mat(n * n, 0.0);
+
+    std::default_random_engine generator;
+    generator.seed(20);
+    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j <= i; j++) {
+            if (block[i] == block[j]) {
+                mat[i * n + j] = std::complex<double>(distribution(generator), distribution(generator));
+                mat[j * n + i] = mat[i * n + j];
+            }
+        }
+    }
+
+    // blocks of sizes 5, 4 and 3
+    EXPECT_EQ(3, static_cast<int>(hafnian::connected_components(mat, n).size()));
+
+    std::complex<double> lhaf = hafnian::loop_hafnian(mat);
+    std::complex<double> lhaf2 = hafnian::loop_hafnian_eigen(mat);
+    EXPECT_NEAR(std::real(lhaf), std::real(lhaf2), tol);
+    EXPECT_NEAR(std::imag(lhaf), std::imag(lhaf2), tol);
+
+    EXPECT_EQ(0.0, std::abs(hafnian::hafnian_eigen(mat)));
+    EXPECT_EQ(0.0, std::abs(hafnian::hafnian_recursive_quad(mat)));
+
+    // merge the blocks of size 5 and 3 into a single even component
+    mat[0 * n + 5] = mat[5 * n + 0] = 0.5;
+    EXPECT_EQ(2, static_cast<int>(hafnian::connected_components(mat, n).size()));
+
+    std::complex<double> haf = hafnian::hafnian(mat);
+    EXPECT_LT(tol, std::abs(haf));
+    std::complex<double> haf2 = hafnian::hafnian_eigen(mat);
+    std::complex<double> haf3 = hafnian::hafnian_recursive_quad(mat);
+    EXPECT_NEAR(std::real(haf), std::real(haf2), tol);
+    EXPECT_NEAR(std::imag(haf), std::imag(haf2), tol);
+    EXPECT_NEAR(std::real(haf), std::real(haf3), tol);
+    EXPECT_NEAR(std::imag(haf), std::imag(haf3), tol);
+}
+
+
+// Check that the hafnian of a permuted bipartite matrix equals the permanent of its block.
+TEST(Components, Bipartite) {
+    int k = 5;
+    int n = 2 * k;
+    std::vector<int> perm = {3, 7, 0, 9, 5, 1, 8, 2, 6, 4};
+    std::vector<std::complex<double>> B(k * k, 0.0);
+    std::vector<std::complex<double>> mat(n * n, 0.0);
+
+    std::default_random_engine generator;
+    generator.seed(20);
+    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+
+    for (int i = 0; i < k * k; i++)
+        B[i] = std::complex<double>(distribution(generator), distribution(generator));
+
+    // rows perm[0..k-1] are joined to rows perm[k..n-1] only
+    for (int i = 0; i < k; i++) {
+        for (int j = 0; j < k; j++) {
+            mat[perm[i] * n + perm[k + j]] = B[i * k + j];
+            mat[perm[k + j] * n + perm[i]] = B[i * k + j];
+        }
+    }
+
+    std::vector<int> left, right;
+    EXPECT_TRUE(hafnian::bipartition(mat, n, left, right));
+    EXPECT_EQ(k, static_cast<int>(left.size()));
+
+    std::complex<double> expected = hafnian::permanent(B);
+    std::complex<double> haf = hafnian::hafnian(mat);
+    std::complex<double> haf2 = hafnian::hafnian_eigen(mat);
+    std::complex<double> haf3 = hafnian::hafnian_recursive_quad(mat);
+
+    EXPECT_NEAR(std::real(expected), std::real(haf), tol);
+    EXPECT_NEAR(std::imag(expected), std::imag(haf), tol);
+    EXPECT_NEAR(std::real(expected), std::real(haf2), tol);
+    EXPECT_NEAR(std::imag(expected), std::imag(haf2), tol);
+    EXPECT_NEAR(std::real(expected), std::real(haf3), tol);
+    EXPECT_NEAR(std::imag(expected), std::imag(haf3), tol);
+
+    // an edge inside one of the sets breaks the bipartite structure
+    mat[perm[0] * n + perm[1]] = mat[perm[1] * n + perm[0]] = 0.5;
+    EXPECT_FALSE(hafnian::bipartition(mat, n, left, right));
+
+    haf = hafnian::hafnian(mat);
+    haf2 = hafnian::hafnian_eigen(mat);
+    EXPECT_NEAR(std::real(haf), std::real(haf2), tol);
+    EXPECT_NEAR(std::imag(haf), std::imag(haf2), tol);
+}
+
+
+// Check that a connected bipartite graph with sets of different sizes has no perfect matchings.
+TEST(Components, BipartiteUnbalanced) {
+    int n = 6;
+    std::vector<double> mat(n * n, 0.0);
+
+    // vertex 0 is joined to every other vertex
+    for (int i = 1; i < n; i++)
+        mat[i] = mat[i * n] = 1.0;
+
+    EXPECT_EQ(0.0, hafnian::hafnian_eigen(mat));
+    EXPECT_EQ(0.0, hafnian::hafnian_recursive_quad(mat));
+}
+
+}
+
+
+namespace lowrank {
+
+// Returns the flattened matrix V M V^T, where V is n x r and M is r x r.
+template <typename T>
+std::vector<T> lowrank_product(std::vector<T> &V, std::vector<T> &M, int n, int r) {
+    std::vector<T> mat(n * n, 0.0);
+
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            for (int k = 0; k < r; k++) {
+                for (int l = 0; l < r; l++) {
+                    mat[i * n + j] += V[i * r + k] * M[k * r + l] * V[j * r + l];
+                }
+            }
+        }
+    }
+
+    return mat;
+}
+
+
+// Check the low rank hafnian given the factors of a random complex matrix.
+TEST(LowRank, Factors) {
+    int n = 10;
+
+    std::default_random_engine generator;
+    generator.seed(20);
+    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+
+    for (int r = 1; r <= 4; r++) {
+        std::vector<std::complex<double>> V(n * r), M(r * r);
+
+        for (auto &v : V)
+            v = 0.5 * std::complex<double>(distribution(generator), distribution(generator));
+
+        for (int k = 0; k < r; k++) {
+            for (int l = 0; l <= k; l++) {
+                M[k * r + l] = std::complex<double>(distribution(generator), distribution(generator));
+                M[l * r + k] = M[k * r + l];
+            }
+        }
+
+        std::vector<std::complex<double>> mat = lowrank_product(V, M, n, r);
+        std::complex<double> expected = hafnian::hafnian(mat);
+        std::complex<double> haf = hafnian::hafnian_lowrank(V, M, n, r);
+
+        EXPECT_NEAR(std::real(expected), std::real(haf), tol);
+        EXPECT_NEAR(std::imag(expected), std::imag(haf), tol);
+    }
+}
+
+
+// Check the low rank hafnian of dense matrices, including all ones matrices.
+TEST(LowRank, Dense) {
+    int n = 12;
+    int r = 2;
+
+    std::default_random_engine generator;
+    generator.seed(20);
+    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+
+    std::vector<double> V(n * r), M = {1.0, 0.5, 0.5, -1.0};
+    for (auto &v : V)
+        v = distribution(generator);
+
+    std::vector<double> mat = lowrank_product(V, M, n, r);
+    std::vector<double> Vr, Mr;
+
+    EXPECT_EQ(r, hafnian::lowrank_factors(mat, n, 1e-12, Vr, Mr));
+    EXPECT_NEAR(hafnian::hafnian(mat), hafnian::hafnian_lowrank(mat), tol);
+    EXPECT_NEAR(hafnian::hafnian(mat), hafnian::hafnian_lowrank_quad(mat), tol);
+
+    std::vector<std::complex<double>> ones(n * n, std::complex<double>(1.0, 0.0));
+    std::complex<double> haf = hafnian::hafnian_lowrank_quad(ones);
+    EXPECT_NEAR(10395, std::real(haf), tol);
+    EXPECT_NEAR(0, std::imag(haf), tol);
+
+    std::vector<double> ones5(25, 1.0);
+    EXPECT_EQ(0, hafnian::hafnian_lowrank_quad(ones5));
+}
+
+
+// Check that hafnian_eigen uses the low rank algorithm only when it is expected to be faster.
+TEST(LowRank, Dispatch) {
+    EXPECT_TRUE(hafnian::lowrank_preferred(40, 2));
+    EXPECT_FALSE(hafnian::lowrank_preferred(40, 40));
+    EXPECT_FALSE(hafnian::lowrank_preferred(200, 8));
+
+    int n = 16;
+    int r = 2;
+
+    std::default_random_engine generator;
+    generator.seed(20);
+    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+
+    std::vector<std::complex<double>> V(n * r), M(r * r);
+    for (auto &v : V)
+        v = 0.5 * std::complex<double>(distribution(generator), distribution(generator));
+    for (auto &m : M)
+        m = std::complex<double>(distribution(generator), 0.0);
+    M[1] = M[2];
+
+    std::vector<std::complex<double>> mat = lowrank_product(V, M, n, r);
+    std::complex<double> expected = hafnian::hafnian(mat);
+
+    int calls = 0;
+    std::complex<double> haf = hafnian::lowrank_hafnian(mat, [&](std::vector<std::complex<double>> &a) {
+        calls++;
+        return hafnian::hafnian(a);
+    });
+    std::complex<double> haf2 = hafnian::hafnian_eigen(mat);
+
+    EXPECT_EQ(0, calls);
+    EXPECT_NEAR(std::real(expected), std::real(haf), tol);
+    EXPECT_NEAR(std::imag(expected), std::imag(haf), tol);
+    EXPECT_NEAR(std::real(expected), std::real(haf2), tol);
+    EXPECT_NEAR(std::imag(expected), std::imag(haf2), tol);
+}
+
+}
+
+
+namespace sparse {
+
+// Returns the adjacency matrix of the L x L square grid.
+std::vector<double> grid(int L) {
+    int n = L * L;
+    std::vector<double> mat(n * n, 0.0);
+
+    for (int i = 0; i < L; i++) {
+        for (int j = 0; j < L; j++) {
+            int v = i * L + j;
+            if (j + 1 < L)
+                mat[v * n + v + 1] = mat[(v + 1) * n + v] = 1.0;
+            if (i + 1 < L)
+                mat[v * n + v + L] = mat[(v + L) * n + v] = 1.0;
+        }
+    }
+
+    return mat;
+}
+
+
+// Check the width of the path decompositions of paths, cycles and grids.
+TEST(Sparse, Width) {
+    int n = 10;
+    std::vector<double> path(n * n, 0.0);
+
+    for (int i = 0; i + 1 < n; i++)
+        path[i * n + i + 1] = path[(i + 1) * n + i] = 1.0;
+
+    std::vector<std::vector<int>> adj = hafnian::sparse_neighbours(path, n);
+    EXPECT_EQ(2, hafnian::sparse_width(adj, hafnian::sparse_ordering(adj)));
+
+    path[n - 1] = path[(n - 1) * n] = 1.0;
+    adj = hafnian::sparse_neighbours(path, n);
+    EXPECT_EQ(3, hafnian::sparse_width(adj, hafnian::sparse_ordering(adj)));
+
+    std::vector<double> mat = grid(8);
+    adj = hafnian::sparse_neighbours(mat, 64);
+    EXPECT_GE(10, hafnian::sparse_width(adj, hafnian::sparse_ordering(adj)));
+}
+
+
+// Check the number of domino tilings of square grids.
+TEST(Sparse, Grid) {
+    std::vector<double> mat4 = grid(4);
+    std::vector<double> mat6 = grid(6);
+    std::vector<double> mat8 = grid(8);
+    std::vector<double> mat10 = grid(10);
+
+    EXPECT_NEAR(36, hafnian::hafnian_sparse(mat4), tol);
+    EXPECT_NEAR(6728, hafnian::hafnian_sparse(mat6), tol);
+    EXPECT_NEAR(12988816, hafnian::hafnian_sparse_quad(mat8), tol);
+    EXPECT_NEAR(258584046368, hafnian::hafnian_sparse_quad(mat10), tol);
+
+    EXPECT_NEAR(12988816, hafnian::hafnian_eigen(mat8), tol);
+    EXPECT_NEAR(12988816, hafnian::hafnian_recursive_quad(mat8), tol);
+}
+
+
+// Check the hafnian of random banded complex matrices.
+TEST(Sparse, Banded) {
+    int n = 16;
+    int b = 3;
+
+    std::default_random_engine generator;
+    generator.seed(20);
+    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+
+    std::vector<std::complex<double>> mat(n * n, 0.0);
+    for (int i = 0; i < n; i++) {
+        for (int j = i; j < std::min(n, i + b + 1); j++) {
+            mat[i * n + j] = std::complex<double>(distribution(generator), distribution(generator));
+            mat[j * n + i] = mat[i * n + j];
+        }
+    }
+
+    std::complex<double> expected = hafnian::hafnian(mat);
+    std::complex<double> haf = hafnian::hafnian_sparse(mat);
+    std::complex<double> haf2 = hafnian::hafnian_eigen(mat);
+    std::complex<double> haf3 = hafnian::hafnian_recursive_quad(mat);
+
+    EXPECT_NEAR(std::real(expected), std::real(haf), tol);
+    EXPECT_NEAR(std::imag(expected), std::imag(haf), tol);
+    EXPECT_NEAR(std::real(expected), std::real(haf2), tol);
+    EXPECT_NEAR(std::imag(expected), std::imag(haf2), tol);
+    EXPECT_NEAR(std::real(expected), std::real(haf3), tol);
+    EXPECT_NEAR(std::imag(expected), std::imag(haf3), tol);
+}
+
+
+// Check that dense matrices fall back to the given hafnian function.
+TEST(Sparse, Fallback) {
+    int n = 8;
+    std::vector<double> mat(n * n, 1.0);
+    int calls = 0;
+
+    double haf = hafnian::sparse_hafnian(mat, [&](std::vector<double> &a) {
+        calls++;
+        return hafnian::hafnian(a);
+    });
+
+    EXPECT_EQ(1, calls);
+    EXPECT_NEAR(105, haf, tol);
+    EXPECT_NEAR(105, hafnian::hafnian_sparse(mat), tol);
+}
+
+}
+
+
+namespace dispatch {
+
+// Check that the dispatcher chooses the path decomposition hafnian for a large grid.
+TEST(Dispatch, Grid) {
+    int L = 8;
+    int n = L * L;
+    std::vector<double> mat(n * n, 0.0);
+    std::vector<int> rpt(n, 1);
+
+    for (int v = 0; v < n; v++) {
+        if ((v + 1) % L != 0)
+            mat[v * n + v + 1] = mat[(v + 1) * n + v] = 1.0;
+        if (v + L < n)
+            mat[v * n + v + L] = mat[(v + L) * n + v] = 1.0;
+    }
+
+    hafnian::dispatch_decision d;
+    double haf = hafnian::hafnian_auto(mat, rpt, false, hafnian::double_precision, &d);
+
+    EXPECT_EQ(hafnian::sparse_algorithm, d.algorithm);
+    EXPECT_STREQ("sparse", hafnian::dispatch_name(d.algorithm));
+    EXPECT_TRUE(d.integral);
+    EXPECT_EQ(n, d.size);
+    EXPECT_EQ(d.estimated_times[hafnian::sparse_algorithm], d.estimated_time);
+    EXPECT_NEAR(12988816, haf, tol);
+}
+
+
+// Check that the dispatcher chooses the low rank hafnian for a matrix of rank 2.
+TEST(Dispatch, LowRank) {
+    int n = 20;
+    std::vector<int> rpt(n, 1);
+    std::vector<std::complex<double>> V(n * 2);
+
+    std::default_random_engine generator;
+    generator.seed(20);
+    std::uniform_real_distribution<double> distribution(-0.5, 0.5);
+
+    for (auto &v : V)
+        v = std::complex<double>(distribution(generator), distribution(generator));
+
+    std::vector<std::complex<double>> mat(n * n, 0.0);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            mat[i * n + j] = V[2 * i] * V[2 * j] - V[2 * i + 1] * V[2 * j + 1];
+        }
+    }
+
+    hafnian::dispatch_decision d;
+    std::complex<double> haf = hafnian::hafnian_auto(mat, rpt, false, hafnian::double_precision, &d);
+    std::complex<double> expected = hafnian::hafnian(mat);
+
+    EXPECT_EQ(hafnian::lowrank_algorithm, d.algorithm);
+    EXPECT_EQ(2, d.rank);
+    EXPECT_NEAR(std::real(expected), std::real(haf), tol);
+    EXPECT_NEAR(std::imag(expected), std::imag(haf), tol);
+}
+
+
+// Check that the dispatcher chooses the repeated hafnian when rows and columns are repeated many times.
+TEST(Dispatch, Repeated) {
+    std::vector<double> mat = {0.3, 0.5, 0.1, 0.5, -0.2, 0.4, 0.1, 0.4, 0.7};
+    std::vector<int> rpt = {14, 12, 10};
+
+    hafnian::dispatch_decision d;
+    double haf = hafnian::hafnian_auto(mat, rpt, false, hafnian::double_precision, &d);
+    double lhaf = hafnian::hafnian_auto(mat, rpt, true);
+
+    EXPECT_EQ(hafnian::repeated_algorithm, d.algorithm);
+    EXPECT_EQ(36, d.size);
+    EXPECT_NEAR(hafnian::hafnian_rpt_quad(mat, rpt), haf, std::abs(haf) * 1e-12);
+
+    std::vector<double> mu = {0.3, -0.2, 0.7};
+    EXPECT_NEAR(hafnian::loop_hafnian_rpt_quad(mat, mu, rpt), lhaf, std::abs(lhaf) * 1e-12);
+}
+
+
+// Check the loop hafnian, the requested precision and trivial cases.
+TEST(Dispatch, LoopPrecision) {
+    int n = 8;
+    std::vector<int> rpt(n, 1);
+    std::vector<std::complex<double>> mat(n * n);
+
+    std::default_random_engine generator;
+    generator.seed(20);
+    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j <= i; j++) {
+            mat[i * n + j] = std::complex<double>(distribution(generator), distribution(generator));
+            mat[j * n + i] = mat[i * n + j];
+        }
+    }
+
+    std::complex<double> expected = hafnian::loop_hafnian(mat);
+    std::complex<double> lhaf = hafnian::hafnian_auto(mat, rpt, true);
+    EXPECT_NEAR(std::real(expected), std::real(lhaf), tol);
+    EXPECT_NEAR(std::imag(expected), std::imag(lhaf), tol);
+
+    hafnian::dispatch_decision d = hafnian::hafnian_dispatch(mat, rpt, false, hafnian::extended_precision);
+    EXPECT_TRUE(std::isinf(d.estimated_times[hafnian::eigen_algorithm]));
+    EXPECT_NE(hafnian::eigen_algorithm, d.algorithm);
+    EXPECT_FALSE(d.integral);
+
+    expected = hafnian::hafnian(mat);
+    std::complex<double> haf = hafnian::hafnian_auto(mat, rpt, false, hafnian::extended_precision);
+    EXPECT_NEAR(std::real(expected), std::real(haf), tol);
+    EXPECT_NEAR(std::imag(expected), std::imag(haf), tol);
+
+    rpt[0] = 2;
+    d = hafnian::hafnian_dispatch(mat, rpt);
+    EXPECT_EQ(hafnian::trivial_algorithm, d.algorithm);
+    EXPECT_EQ(0.0, std::abs(hafnian::hafnian_auto(mat, rpt)));
+
+    std::vector<int> zeros(n, 0);
+    EXPECT_EQ(1.0, std::real(hafnian::hafnian_auto(mat, zeros, true)));
+}
+
+}
+
+
+namespace modular {
+
+// Check the primes and the Montgomery arithmetic against 128-bit remainders.
+TEST(Modular, Arithmetic) {
+    std::vector<unsigned long long int> primes = hafnian::modular_primes(4);
+
+    EXPECT_EQ(4u, primes.size());
+    EXPECT_TRUE(hafnian::is_prime((1ULL << 61) - 1));
+    EXPECT_FALSE(hafnian::is_prime(((1ULL << 31) - 1) * ((1ULL << 31) - 1)));
+
+    std::default_random_engine generator;
+    generator.seed(137);
+
+    for (unsigned long long int p : primes) {
+        EXPECT_GT(p, 1ULL << 61);
+        EXPECT_LT(p, 1ULL << 62);
+        EXPECT_TRUE(hafnian::is_prime(p));
+
+        hafnian::montgomery m(p);
+        std::uniform_int_distribution<long long int> distribution(-(1LL << 62), 1LL << 62);
+
+        for (int i = 0; i < 100; i++) {
+            long long int a = distribution(generator), b = distribution(generator);
+            unsigned long long int ra = static_cast<unsigned long long int>((a % (long long int)p + (long long int)p) % (long long int)p);
+            unsigned long long int rb = static_cast<unsigned long long int>((b % (long long int)p + (long long int)p) % (long long int)p);
+            unsigned long long int prod = m.to_residue(m.mul(m.from_integer(a), m.from_integer(b)));
+            EXPECT_EQ(hafnian::mulmod(ra, rb, p), prod);
+        }
+    }
+}
+
+
+// Check the reconstruction of positive and negative integers from their residues.
+TEST(Modular, Reconstruct) {
+    std::vector<unsigned long long int> primes = hafnian::modular_primes(3);
+    std::vector<long long int> values = {0, 1, -1, 123456789012345678LL, -987654321098765432LL};
+
+    for (long long int x : values) {
+        std::vector<unsigned long long int> residues;
+        for (unsigned long long int p : primes)
+            residues.push_back(hafnian::montgomery(p).to_residue(hafnian::montgomery(p).from_integer(x)));
+
+        EXPECT_EQ(std::to_string(x), hafnian::crt_reconstruct(residues, primes));
+    }
+}
+
+
+// Check the exact hafnian against the recursive algorithm, and beyond 64 bits.
+TEST(Modular, Hafnian) {
+    std::default_random_engine generator;
+    generator.seed(42);
+    std::uniform_int_distribution<long long int> distribution(-3, 3);
+
+    for (int n = 2; n <= 12; n += 2) {
+        std::vector<long long int> mat(n * n, 0);
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j <= i; j++)
+                mat[i * n + j] = mat[j * n + i] = distribution(generator);
+        }
+
+        EXPECT_EQ(std::to_string(hafnian::hafnian_recursive(mat)), hafnian::hafnian_int(mat));
+    }
+
+    // haf(cJ) = (n-1)!! c^{n/2}
+    std::vector<long long int> mat(16 * 16, 1000000000LL);
+    EXPECT_EQ("2027025" + std::string(72, '0'), hafnian::hafnian_int(mat));
+
+    mat = std::vector<long long int>(18 * 18, -1000000000LL);
+    EXPECT_EQ("-34459425" + std::string(81, '0'), hafnian::hafnian_int(mat));
+
+    mat = std::vector<long long int>(5 * 5, 1);
+    EXPECT_EQ("0", hafnian::hafnian_int(mat));
+
+    mat = std::vector<long long int>(4 * 4, 0);
+    mat[1] = mat[4] = 1;
+    EXPECT_EQ("0", hafnian::hafnian_int(mat));
+}
+
+
+// Check the exact permanent against Ryser's formula, and beyond 64 bits.
+TEST(Modular, Permanent) {
+    std::default_random_engine generator;
+    generator.seed(7);
+    std::uniform_int_distribution<long long int> distribution(-5, 5);
+
+    for (int n = 1; n <= 10; n++) {
+        std::vector<long long int> mat(n * n, 0);
+        for (auto &a : mat)
+            a = distribution(generator);
+
+        EXPECT_EQ(std::to_string(hafnian::permanent(mat)), hafnian::permanent_int(mat));
+    }
+
+    // per(cJ) = n! c^n
+    std::vector<long long int> mat(12 * 12, 1000000000LL);
+    EXPECT_EQ("479001600" + std::string(108, '0'), hafnian::permanent_int(mat));
+
+    mat = std::vector<long long int>(3 * 3, -1000000000LL);
+    EXPECT_EQ("-6" + std::string(27, '0'), hafnian::permanent_int(mat));
+}
+
+}
+
+
+namespace doubledouble {
+
+using hafnian::double_double;
+
+// Returns the double-double nearest to m 2^{-e}, for an integer m given by its decimal digits.
+double_double scaled_decimal(const std::string &m, int e) {
+    double_double x = 0;
+    bool negative = m[0] == '-';
+
+    for (std::size_t i = negative ? 1 : 0; i < m.size(); i++)
+        x = x * 10 + (m[i] - '0');
+
+    x = double_double(std::ldexp(x.hi, -e), std::ldexp(x.lo, -e));
+    return negative ? -x : x;
+}
+
+// Returns the relative difference of two double-doubles.
+double relative(double_double a, double_double b) {
+    return static_cast<double>(abs((a - b) / b));
+}
+
+
+// Check that the arithmetic operations are accurate to about 106 bits.
+TEST(DoubleDouble, Arithmetic) {
+    double_double third = double_double(1) / 3;
+    EXPECT_GT(1e-31, relative(third * 3, 1));
+    EXPECT_NE(0.0, third.lo);
+
+    double_double root = sqrt(double_double(2));
+    EXPECT_GT(1e-31, relative(root * root, 2));
+
+    // 1 + 2^-80 is not representable in double or long double
+    double_double x = double_double(1) + double_double(std::ldexp(1.0, -80));
+    EXPECT_EQ(std::ldexp(1.0, -80), static_cast<double>(x - 1));
+    EXPECT_GT(1e-31, relative(pow(x, -3) * pow(x, 3), 1));
+
+    double_double y = 0.1L;
+    EXPECT_EQ(0.1L, static_cast<long double>(y));
+    EXPECT_TRUE(y > third - third && -y < 0.0 && abs(-y) == y);
+}
+
+
+// Check the permanent, recursive hafnian and repeated hafnian of matrices with
+// dyadic entries against the exact results of the modular integer engine.
+TEST(DoubleDouble, Kernels) {
+    std::default_random_engine generator;
+    generator.seed(11);
+    std::uniform_int_distribution<long long int> distribution(-1024, 1024);
+
+    int n = 12;
+    std::vector<long long int> K(n * n);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j <= i; j++)
+            K[i * n + j] = K[j * n + i] = distribution(generator);
+    }
+
+    std::vector<double_double> mat(n * n);
+    for (int i = 0; i < n * n; i++)
+        mat[i] = std::ldexp(static_cast<double>(K[i]), -10);
+
+    EXPECT_GT(1e-26, relative(hafnian::permanent(mat), scaled_decimal(hafnian::permanent_int(K), 10 * n)));
+    EXPECT_GT(1e-26, relative(hafnian::hafnian_recursive(mat), scaled_decimal(hafnian::hafnian_int(K), 5 * n)));
+
+    int m = 3;
+    std::vector<int> rpt = {4, 2, 6};
+    std::vector<long long int> Km(K.begin(), K.begin() + m * m);
+    for (int i = 0; i < m; i++) {
+        for (int j = 0; j < m; j++)
+            Km[i * m + j] = K[i * n + j];
+    }
+
+    std::vector<double_double> matm(m * m);
+    for (int i = 0; i < m * m; i++)
+        matm[i] = std::ldexp(static_cast<double>(Km[i]), -10);
+
+    std::vector<long long int> Kx = hafnian::expand_repeated(Km, rpt);
+    EXPECT_GT(1e-26, relative(hafnian::hafnian_rpt(matm, rpt), scaled_decimal(hafnian::hafnian_int(Kx), 60)));
+}
+
+
+// Check the kernels on complex double-doubles, and the Torontonian, against long double.
+TEST(DoubleDouble, Complex) {
+    int n = 10;
+    std::default_random_engine generator;
+    generator.seed(5);
+    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+
+    std::vector<std::complex<double>> mat(n * n);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j <= i; j++)
+            mat[i * n + j] = mat[j * n + i] = std::complex<double>(distribution(generator), distribution(generator));
+    }
+
+    std::vector<std::complex<long double>> matl(mat.begin(), mat.end());
+    std::vector<std::complex<double_double>> matd(n * n);
+    for (int i = 0; i < n * n; i++)
+        matd[i] = std::complex<double_double>(mat[i].real(), mat[i].imag());
+
+    std::complex<long double> p1 = hafnian::permanent(matl);
+    std::complex<double> p2 = hafnian::to_complex_double(hafnian::permanent(matd));
+    EXPECT_NEAR(0, std::abs(std::complex<double>(p1) - p2) / std::abs(p1), 1e-14);
+
+    std::complex<long double> h1 = hafnian::hafnian_recursive(matl);
+    std::complex<double> h2 = hafnian::to_complex_double(hafnian::hafnian_recursive(matd));
+    EXPECT_NEAR(0, std::abs(std::complex<double>(h1) - h2) / std::abs(h1), 1e-14);
+
+    // two-mode squeezed vacuum with mean photon number 1, whose Torontonian is 1
+    std::vector<double_double> tmsv(8 * 8, 0.0);
+    for (int i = 0; i < 8; i++)
+        tmsv[i * 8 + 7 - i] = std::sqrt(0.5);
+
+    EXPECT_NEAR(1, static_cast<double>(hafnian::torontonian(tmsv)), 1e-15);
+}
+
+}
+
+
+namespace adaptive {
+
+// Check that well-conditioned matrices are computed in double precision, and
+// agree with the long double kernels.
+TEST(Adaptive, WellConditioned) {
+    int n = 10;
+    std::default_random_engine generator;
+    generator.seed(17);
+    std::uniform_real_distribution<double> distribution(0.0, 1.0);
+
+    std::vector<double> mat(n * n);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j <= i; j++)
+            mat[i * n + j] = mat[j * n + i] = distribution(generator);
+    }
+
+    std::vector<long double> matl(mat.begin(), mat.end());
+    hafnian::adaptive_report report;
+
+    double perm = hafnian::permanent_adaptive(mat, 1e-10, &report);
+    EXPECT_EQ(hafnian::double_precision, report.precision);
+    EXPECT_GT(1e-10, report.estimated_error);
+    EXPECT_NEAR(1, perm / static_cast<double>(hafnian::permanent(matl)), 1e-10);
+
+    double haf = hafnian::hafnian_adaptive(mat, 1e-10, &report);
+    EXPECT_EQ(hafnian::double_precision, report.precision);
+    EXPECT_NEAR(1, haf / static_cast<double>(hafnian::hafnian_recursive(matl)), 1e-10);
+
+    // two-mode squeezed vacuum with mean photon number 1, whose Torontonian is 1
+    std::vector<double> tmsv(8 * 8, 0.0);
+    for (int i = 0; i < 8; i++)
+        tmsv[i * 8 + 7 - i] = std::sqrt(0.5);
+
+    EXPECT_NEAR(1, hafnian::torontonian_adaptive(tmsv, 1e-10, &report), 1e-13);
+    EXPECT_EQ(hafnian::double_precision, report.precision);
+}
+
+
+// Check that the permanent of the matrix of ones, whose Ryser terms
+// \f$(-1)^{n-k}\binom{n}{k}k^n\f$ cancel to many digits, is recomputed in
+// double-double precision and is exact.
+TEST(Adaptive, Cancellation) {
+    int n = 16;
+    std::vector<double> mat(n * n, 1.0);
+    std::vector<std::complex<double>> matc(n * n, 1.0);
+    double exact = 20922789888000.0;
+    hafnian::adaptive_report report;
+
+    EXPECT_EQ(exact, hafnian::permanent_adaptive(mat, 1e-10, &report));
+    EXPECT_EQ(hafnian::extended_precision, report.precision);
+    EXPECT_LT(1e-10, report.estimated_error);
+
+    std::complex<double> perm = hafnian::permanent_adaptive(matc, 1e-10, &report);
+    EXPECT_EQ(std::complex<double>(exact, 0), perm);
+    EXPECT_EQ(hafnian::extended_precision, report.precision);
+
+    // a zero tolerance always recomputes in double-double precision
+    std::default_random_engine generator;
+    generator.seed(3);
+    std::bernoulli_distribution distribution(0.5);
+
+    std::vector<long long int> S(n * n);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j <= i; j++)
+            S[i * n + j] = S[j * n + i] = distribution(generator) ? 1 : -1;
+    }
+
+    std::vector<double> mats(S.begin(), S.end());
+    EXPECT_EQ(std::stod(hafnian::hafnian_int(S)), hafnian::hafnian_adaptive(mats, 0.0, &report));
+    EXPECT_EQ(hafnian::extended_precision, report.precision);
+}
+
+
+// Check the conventions for empty and odd matrices.
+TEST(Adaptive, Edge) {
+    std::vector<double> empty;
+    std::vector<double> odd(9, 1.0);
+    hafnian::adaptive_report report;
+
+    EXPECT_EQ(1.0, hafnian::hafnian_adaptive(empty, 1e-10, &report));
+    EXPECT_EQ(0.0, hafnian::hafnian_adaptive(odd, 1e-10, &report));
+    EXPECT_EQ(1.0, hafnian::permanent_adaptive(empty, 1e-10, &report));
+    EXPECT_EQ(6.0, hafnian::permanent_adaptive(odd, 1e-10, &report));
+    EXPECT_EQ(hafnian::double_precision, report.precision);
+}
+
+}
+
+
+namespace approx_real {
+
+// Unit tests for the real non negative hafnian_approx function
+// Check approx hafnian for random matrices with even dimensions.
+TEST(HafnianApproxNonngeative, Random) {
+    std::vector<double> mat4(16, 0.0);
+    std::vector<double> mat6(36, 0.0);
+    std::vector<double> mat8(64, 0.0);
+
+    std::default_random_engine generator;
+    std::normal_distribution<double> distribution(1.0, 0.0);
+    generator.seed(20);
+
+    int n = 4;
+    int nsamples = 20000;
+    std::vector<double> x4(n, 0.0);
+
+    for (int i = 0; i < n; i++) {
+        double randnum = distribution(generator);
+        x4[i]  = randnum;
+    }
+
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            mat4[i * n + j] = x4[i] * x4[j];
+        }
+    }
+
+
+    n = 6;
+    std::vector<double> x6(n, 0.0);
+
+    for (int i = 0; i < n; i++) {
+        double randnum = distribution(generator);
+        x6[i]  = randnum;
+    }
+
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            mat6[i * n + j] = x6[i] * x6[j];
+        }
+    }
+
+    n = 8;
+    std::vector<double> x8(n, 0.0);
+
+    for (int i = 0; i < n; i++) {
+        double randnum = distribution(generator);
+        x8[i]  = randnum;
+    }
+
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            mat8[i * n + j] = x8[i] * x8[j];
+        }
+    }
+
+    double expected4 = 3.0 * std::accumulate(begin(x4), end(x4), 1, std::multiplies<double>());
+    double expected6 = 15.0 * std::accumulate(begin(x6), end(x6), 1, std::multiplies<double>());
+    double expected8 = 105.0 * std::accumulate(begin(x8), end(x8), 1, std::multiplies<double>());
+
+    double haf4 = hafnian::hafnian_approx(mat4, nsamples);
+    double haf6 = hafnian::hafnian_approx(mat6, nsamples);
+    double haf8 = hafnian::hafnian_approx(mat8, nsamples);
+
+    EXPECT_NEAR(expected4, haf4, haf4 / 15.0);
+    EXPECT_NEAR(expected6, haf6, haf6 / 15.0);
+    EXPECT_NEAR(expected8, haf8, haf8 / 15.0);
+
+}
+
+}
+
+
+namespace hafnian_repeated {
+
+// Unit tests for the repeated hafnian function
+// Check repeated hafnian for all zero matrices with even dimensions.
+TEST(HafnianRepeatedDouble, ZeroRpt) {
+    std::vector<double> mat(16, 1.0);
+    std::vector<int> rpt(4, 0);
+
+    double haf = hafnian::hafnian_rpt_quad(mat, rpt);
+
+    EXPECT_NEAR(1, haf, tol);
+}
+
+// Check repeated hafnian for all ones matrices with even dimensions.
+TEST(HafnianRepeatedDouble, AllOneRpt) {
+    std::vector<double> mat2rand(4, 1.0);
+    std::vector<double> mat2(4, 1.0);
+    std::vector<int> rpt2(2, 1);
+
+    std::vector<double> mat4rand(16, 1.0);
+    std::vector<double> mat4(16, 1.0);
+    std::vector<int> rpt4(4, 1);
+
+    std::default_random_engine generator;
+    generator.seed(20);
+    std::normal_distribution<double> distribution(1.0, 0.0);
+
+    for (int i = 0; i < 2; i++) {
+        for (int j = 0; j < 2; j++) {
+            double randnum = distribution(generator);
+            mat2rand[i * 2 + j] = randnum;
+        }
+    }
+
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            double randnum = distribution(generator);
+            mat4rand[i * 4 + j] = randnum;
+        }
+    }
+
+
+    double expected2 = mat2[1];
+    double expected2rand = mat2rand[1];
+
+    double expected4 = 3;
+    double expected4rand = mat4rand[1] * mat4rand[11] + mat4rand[2] * mat4rand[7] + mat4rand[3] * mat4rand[6];;
+
+    double haf2 = hafnian::hafnian_rpt_quad(mat2, rpt2);
+    double haf2rand = hafnian::hafnian_rpt_quad(mat2rand, rpt2);
+    double haf4 = hafnian::hafnian_rpt_quad(mat4, rpt4);
+    double haf4rand = hafnian::hafnian_rpt_quad(mat4rand, rpt4);
+
+    EXPECT_NEAR(expected2, haf2, tol);
+    EXPECT_NEAR(expected2rand, haf2rand, tol);
+    EXPECT_NEAR(expected4, haf4, tol);
+    EXPECT_NEAR(expected4rand, haf4rand, tol);
+
+}
+
+// Check repeated hafnian for all zero complex matrices with even dimensions.
+TEST(HafnianRepeatedComplex, ZeroRpt) {
+    std::vector<std::complex<double>> mat(16, std::complex<double>(1.0, 0.0));
+    std::vector<int> rpt(4, 0);
+
+    std::complex<double> haf = hafnian::hafnian_rpt_quad(mat, rpt);
+
+    double re = std::real(haf);
+    double im = std::imag(haf);
+
+    EXPECT_NEAR(1, re, tol);
+    EXPECT_NEAR(0, im, tol);
+}
+
+
+// Check repeated hafnian for all ones matrices with even dimensions.
+TEST(HafnianRepeatedComplex, AllOneRpt) {
+    std::vector<std::complex<double>> mat2rand(4, std::complex<double>(0.0, 0.0));
+    std::vector<std::complex<double>> mat2(4, std::complex<double>(1.0, 0.0));
+    std::vector<int> rpt2(2, 1);
+
+    std::vector<std::complex<double>> mat4rand(16, std::complex<double>(0.0, 0.0));
+    std::vector<std::complex<double>> mat4(16, std::complex<double>(1.0, 0.0));
+    std::vector<int> rpt4(4, 1);
+
+    std::default_random_engine generator;
+    generator.seed(20);
+    std::normal_distribution<double> distribution(1.0, 0.0);
+
+    for (int i = 0; i < 2; i++) {
+        for (int j = 0; j < 2; j++) {
+            double randnum1 = distribution(generator);
+            double randnum2 = distribution(generator);
+            mat2rand[i * 2 + j] = std::complex<double>(randnum1, randnum2);
+        }
+    }
+
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            double randnum1 = distribution(generator);
+            double randnum2 = distribution(generator);
+            mat4rand[i * 4 + j] = std::complex<double>(randnum1, randnum2);
+        }
+    }
+
+
+    double expected2_re = std::real(mat2[1]);
+    double expected2_im = std::imag(mat2[1]);
+    double expected2rand_re = std::real(mat2rand[1]);
+    double expected2rand_im = std::imag(mat2rand[1]);
+
+    double expected4_re = 3;
+    double expected4_im = 0;
+    std::complex<double> expected4rand = mat4rand[1] * mat4rand[11] + mat4rand[2] * mat4rand[7] + mat4rand[3] * mat4rand[6];;
+    double expected4rand_re = std::real(expected4rand);
+    double expected4rand_im = std::imag(expected4rand);
+
+    std::complex<double> haf2 = hafnian::hafnian_rpt_quad(mat2, rpt2);
+    std::complex<double> haf2rand = hafnian::hafnian_rpt_quad(mat2rand, rpt2);
+    std::complex<double> haf4 = hafnian::hafnian_rpt_quad(mat4, rpt4);
+    std::complex<double> haf4rand = hafnian::hafnian_rpt_quad(mat4rand, rpt4);
+
+    double haf2_re = std::real(haf2);
+    double haf2_im = std::imag(haf2);
+    double haf2rand_re = std::real(haf2rand);
+    double haf2rand_im = std::imag(haf2rand);
 
     double haf4_re = std::real(haf4);
     double haf4_im = std::imag(haf4);
@@ -649,6 +2373,183 @@ TEST(HafnianRepeatedComplex, AllOneRpt) {
 }
 
 
+// Check that the chunks of the mixed-radix counter add up to the repeated
+// hafnian, and that the result does not depend on the number of threads.
+TEST(HafnianRepeatedDouble, Chunks) {
+    int n = 4;
+    std::vector<int> rpt = {7, 9, 5, 9};
+    std::vector<long double> mat(n * n), mu(n);
+
+    std::default_random_engine generator;
+    generator.seed(20);
+    std::normal_distribution<double> distribution(0.0, 0.3);
+
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j <= i; j++) {
+            mat[i * n + j] = distribution(generator);
+            mat[j * n + i] = mat[i * n + j];
+        }
+        mu[i] = mat[i * n + i];
+    }
+
+    std::vector<long double> big = hafnian::expand_repeated(mat, rpt);
+    std::vector<double> bigd(big.begin(), big.end());
+    double expected = hafnian::hafnian(bigd);
+    double lexpected = hafnian::loop_hafnian(bigd);
+
+    unsigned long long int steps = hafnian::rpt_steps(rpt);
+    EXPECT_EQ(2400ULL, steps);
+    EXPECT_EQ(9ULL, hafnian::rpt_chunks(steps));
+
+    // the double precision hafnian of the expanded matrix loses several
+    // digits, whereas a single chunk is the sequential walk of the counter
+    long double haf = hafnian::hafnian_rpt(mat, rpt);
+    long double lhaf = hafnian::loop_hafnian_rpt(mat, mu, rpt);
+    EXPECT_NEAR(expected, haf, std::abs(expected) * 1e-7);
+    EXPECT_NEAR(lexpected, lhaf, std::abs(lexpected) * 1e-7);
+
+    expected = hafnian::hafnian_rpt_chunk(mat, rpt, 0, steps);
+    lexpected = hafnian::loop_hafnian_rpt_chunk(mat, mu, rpt, 0, steps);
+    EXPECT_NEAR(expected, haf, std::abs(expected) * 1e-12);
+    EXPECT_NEAR(lexpected, lhaf, std::abs(lexpected) * 1e-12);
+
+    // split the steps at arbitrary points
+    std::vector<unsigned long long int> bounds = {0, 1, 17, 600, 601, 1999, steps};
+    long double sum = 0.0, lsum = 0.0;
+    for (std::size_t i = 0; i + 1 < bounds.size(); i++) {
+        sum += hafnian::hafnian_rpt_chunk(mat, rpt, bounds[i], bounds[i + 1] - bounds[i]);
+        lsum += hafnian::loop_hafnian_rpt_chunk(mat, mu, rpt, bounds[i], bounds[i + 1] - bounds[i]);
+    }
+    EXPECT_NEAR(expected, sum, std::abs(expected) * 1e-12);
+    EXPECT_NEAR(lexpected, lsum, std::abs(lexpected) * 1e-12);
+
+#ifdef _OPENMP
+    int nthreads = omp_get_max_threads();
+    omp_set_num_threads(3);
+    EXPECT_EQ(haf, hafnian::hafnian_rpt(mat, rpt));
+    EXPECT_EQ(lhaf, hafnian::loop_hafnian_rpt(mat, mu, rpt));
+    omp_set_num_threads(nthreads);
+#endif
+}
+
+
+// Check that the reflected Gray code changes one digit by one at each step,
+// and that the repeated hafnian is the same in both orders.
+TEST(HafnianRepeatedDouble, GrayOrder) {
+    int n = 4;
+    std::vector<int> rpt = {3, 2, 4, 5};
+    std::vector<long double> mat(n * n), mu(n);
+
+    unsigned long long int total = 2 * hafnian::rpt_steps(rpt);
+    std::vector<int> a = hafnian::rpt_digits(0, rpt), dir;
+    std::vector<int> x = hafnian::rpt_gray_digits(0, rpt, dir);
+    std::vector<bool> visited(total, false);
+
+    for (unsigned long long int X = 0; X < total; X++) {
+        unsigned long long int index = 0;
+        for (int j = n - 1; j >= 0; j--)
+            index = index * (rpt[j] + 1) + x[j];
+
+        EXPECT_FALSE(visited[index]);
+        visited[index] = true;
+
+        std::vector<int> d;
+        EXPECT_EQ(x, hafnian::rpt_gray_digits(X, rpt, d));
+        EXPECT_EQ(dir, d);
+
+        if (X + 1 < total) {
+            int j = hafnian::rpt_gray_next(a, dir, rpt);
+            x[j] += dir[j];
+            EXPECT_EQ(hafnian::rpt_digits(X + 1, rpt), a);
+        }
+    }
+
+    std::default_random_engine generator;
+    generator.seed(20);
+    std::normal_distribution<double> distribution(0.0, 0.3);
+
+    rpt = {7, 9, 5, 9};
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j <= i; j++) {
+            mat[i * n + j] = distribution(generator);
+            mat[j * n + i] = mat[i * n + j];
+        }
+        mu[i] = mat[i * n + i];
+    }
+
+    long double haf = hafnian::hafnian_rpt(mat, rpt);
+    long double lhaf = hafnian::loop_hafnian_rpt(mat, mu, rpt);
+    long double haf_gray = hafnian::hafnian_rpt(mat, rpt, hafnian::gray_order);
+    long double lhaf_gray = hafnian::loop_hafnian_rpt(mat, mu, rpt, hafnian::gray_order);
+    EXPECT_NEAR(haf, haf_gray, std::abs(haf) * 1e-12);
+    EXPECT_NEAR(lhaf, lhaf_gray, std::abs(lhaf) * 1e-12);
+
+    std::vector<unsigned long long int> bounds = {0, 1, 17, 600, 601, 1999, hafnian::rpt_steps(rpt)};
+    long double sum = 0.0, lsum = 0.0;
+    for (std::size_t i = 0; i + 1 < bounds.size(); i++) {
+        sum += hafnian::hafnian_rpt_chunk(mat, rpt, bounds[i], bounds[i + 1] - bounds[i], hafnian::gray_order);
+        lsum += hafnian::loop_hafnian_rpt_chunk(mat, mu, rpt, bounds[i], bounds[i + 1] - bounds[i], hafnian::gray_order);
+    }
+    EXPECT_NEAR(haf, sum, std::abs(haf) * 1e-12);
+    EXPECT_NEAR(lhaf, lsum, std::abs(lhaf) * 1e-12);
+}
+
+
+// Check the batched repeated hafnian against separate computations,
+// including repeated vectors, rows repeated zero times and trivial cases.
+TEST(HafnianRepeatedComplex, Batch) {
+    int n = 5;
+    std::vector<std::complex<long double>> mat(n * n), mu(n);
+
+    std::default_random_engine generator;
+    generator.seed(20);
+    std::normal_distribution<double> distribution(0.0, 0.3);
+
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j <= i; j++) {
+            mat[i * n + j] = std::complex<long double>(distribution(generator), distribution(generator));
+            mat[j * n + i] = mat[i * n + j];
+        }
+        mu[i] = std::complex<long double>(distribution(generator), distribution(generator));
+    }
+
+    std::vector<std::vector<int>> rpts = {
+        {2, 3, 1, 4, 2}, {0, 3, 1, 0, 2}, {2, 3, 1, 4, 2}, {0, 0, 0, 0, 0},
+        {7, 0, 5, 0, 0}, {1, 0, 0, 0, 0}, {0, 6, 1, 5, 0}, {9, 8, 7, 6, 0}};
+
+    std::vector<std::complex<long double>> haf = hafnian::hafnian_rpt_batch(mat, rpts);
+    std::vector<std::complex<long double>> lhaf = hafnian::loop_hafnian_rpt_batch(mat, mu, rpts);
+    std::vector<std::complex<long double>> haf_gray = hafnian::hafnian_rpt_batch(mat, rpts, hafnian::gray_order);
+    ASSERT_EQ(rpts.size(), haf.size());
+    ASSERT_EQ(rpts.size(), lhaf.size());
+
+    for (std::size_t i = 0; i < rpts.size(); i++) {
+        int s = std::accumulate(rpts[i].begin(), rpts[i].end(), 0);
+        std::complex<long double> expected = 1.0L, lexpected = 1.0L;
+
+        if (s > 0) {
+            expected = (s % 2 == 0) ? hafnian::hafnian_rpt(mat, rpts[i]) : 0.0L;
+            lexpected = hafnian::loop_hafnian_rpt(mat, mu, rpts[i]);
+        }
+
+        EXPECT_NEAR(0.0, std::abs(expected - haf[i]), std::abs(expected) * 1e-12);
+        EXPECT_NEAR(0.0, std::abs(expected - haf_gray[i]), std::abs(expected) * 1e-12);
+        EXPECT_NEAR(0.0, std::abs(lexpected - lhaf[i]), std::abs(lexpected) * 1e-12);
+    }
+
+    EXPECT_EQ(haf[0], haf[2]);
+    EXPECT_EQ(lhaf[0], lhaf[2]);
+
+#ifdef _OPENMP
+    int nthreads = omp_get_max_threads();
+    omp_set_num_threads(3);
+    EXPECT_EQ(haf, hafnian::hafnian_rpt_batch(mat, rpts));
+    EXPECT_EQ(lhaf, hafnian::loop_hafnian_rpt_batch(mat, mu, rpts));
+    omp_set_num_threads(nthreads);
+#endif
+}
+
+
 }
 
 namespace loophafnian_eigen {
@@ -794,6 +2695,80 @@ TEST(LoopHafnianEigenComplex, Odd) {
 }
 
 
+namespace loophafnian_recursive {
+
+// Check the recursive loop hafnian for all ones matrices of even and odd dimensions.
+TEST(LoopHafnianRecursiveDouble, Ones) {
+    std::vector<double> mat3(9, 1.0);
+    std::vector<double> mat4(16, 1.0);
+    std::vector<double> mat5(25, 1.0);
+    std::vector<double> mat6(36, 1.0);
+
+    EXPECT_NEAR(4, hafnian::loop_hafnian_recursive_quad(mat3), tol);
+    EXPECT_NEAR(10, hafnian::loop_hafnian_recursive_quad(mat4), tol);
+    EXPECT_NEAR(26, hafnian::loop_hafnian_recursive_quad(mat5), tol);
+    EXPECT_NEAR(76, hafnian::loop_hafnian_recursive_quad(mat6), tol);
+}
+
+
+// Check the recursive loop hafnian of random real matrices against the eigenvalue algorithm.
+TEST(LoopHafnianRecursiveDouble, Random) {
+    std::default_random_engine generator;
+    generator.seed(20);
+    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+
+    for (int n : {2, 7, 12}) {
+        std::vector<double> mat(n * n);
+
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j <= i; j++)
+                mat[i * n + j] = mat[j * n + i] = distribution(generator);
+        }
+
+        double expected = hafnian::loop_hafnian_eigen(mat);
+        double haf = hafnian::loop_hafnian_recursive_quad(mat);
+
+        EXPECT_NEAR(expected, haf, tol2);
+    }
+}
+
+
+// Check the recursive loop hafnian of random complex matrices against the eigenvalue
+// algorithm, and that a zero diagonal gives the hafnian.
+TEST(LoopHafnianRecursiveComplex, Random) {
+    std::default_random_engine generator;
+    generator.seed(21);
+    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+
+    for (int n : {4, 9, 14}) {
+        std::vector<std::complex<double>> mat(n * n);
+
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j <= i; j++)
+                mat[i * n + j] = mat[j * n + i] = std::complex<double>(distribution(generator), distribution(generator));
+        }
+
+        std::complex<double> expected = hafnian::loop_hafnian_eigen(mat);
+        std::complex<double> haf = hafnian::loop_hafnian_recursive_quad(mat);
+
+        EXPECT_NEAR(std::real(expected), std::real(haf), tol2);
+        EXPECT_NEAR(std::imag(expected), std::imag(haf), tol2);
+
+        if (n % 2 == 0) {
+            for (int i = 0; i < n; i++)
+                mat[i * n + i] = 0.0;
+
+            expected = hafnian::hafnian_recursive(mat);
+            haf = hafnian::loop_hafnian_recursive(mat);
+
+            EXPECT_NEAR(std::real(expected), std::real(haf), tol2);
+            EXPECT_NEAR(std::imag(expected), std::imag(haf), tol2);
+        }
+    }
+}
+
+}
+
 namespace loophafnian_repeated {
 
 // Unit tests for the loop hafnian function using repeated
@@ -20,18 +20,7 @@
 #pragma once
 #include <stdafx.h>
 #include <numeric>
-
-#ifdef LAPACKE
-#define EIGEN_SUPERLU_SUPPORT
-#define EIGEN_USE_BLAS
-#define EIGEN_USE_LAPACKE
-
-#define LAPACK_COMPLEX_CUSTOM
-#define lapack_complex_float std::complex<float>
-#define lapack_complex_double std::complex<double>
-#endif
-
-#include <Eigen/Eigenvalues>
+#include <workspace.hpp>
 #include "fsum.hpp"
 
 namespace hafnian {
@@ -79,108 +68,175 @@ char sum(char *dst, Byte m) {
 }
 
 /**
- * Computes the Torontonian of an input matrix.
+ * Calculates the determinant of \f$I-A_x\f$ appearing in term \f$x\f$ of
+ * the Torontonian of matrix `mat`, where \f$A_x\f$ is the submatrix
+ * of `mat` corresponding to the subset \f$x\f$.
  *
- * If the output is NaN, that means that the input matrix does not have
- * a Torontonian with physical meaning.
- *
- * This function uses OpenMP (if available) to parallelize the reduction.
+ * The preallocated memory of the workspace `ws` is used, which must have
+ * reserved its LU decompositions using `workspace::reserve_lu()`.
  *
  * @param mat flattened vector of size \f$n^2\f$, representing an \f$n\times n\f$
  *       row-ordered symmetric matrix.
- * @return Torontonian of the input matrix
+ * @param n size of the matrix
+ * @param x index of the term, representing a subset of the modes
+ * @param ws workspace of the calling thread
+ * @param len on exit, the number of modes in the subset
+ * @return the real part of the determinant
  */
 template <typename T>
-inline T torontonian(std::vector<T> &mat) {
-    int n = std::sqrt(static_cast<double>(mat.size()));
+inline typename workspace<T>::real_t torontonian_det(std::vector<T> &mat, int n, unsigned long long int x,
+        workspace<T> &ws, char &len) {
     Byte m = n / 2;
-    unsigned long long int x = static_cast<unsigned long long int>(pow(2, m));
+    char *dst = ws.dst.data();
+    Byte *short_st = ws.pos.data();
 
-    namespace eg = Eigen;
-    eg::Matrix<T, eg::Dynamic, eg::Dynamic> A = eg::Map<eg::Matrix<T, eg::Dynamic, eg::Dynamic>, eg::Unaligned>(mat.data(), n, n);
+    dec2bin(dst, x, m);
+    len = sum(dst, m);
 
-#ifdef _OPENMP
-    int nthreads = omp_get_max_threads();
-    omp_set_num_threads(nthreads);
-#else
-    int nthreads = 1;
-#endif
+    if (len == 0)
+        return 1.0;
 
-    std::vector<unsigned long long int> threadbound_low(nthreads);
-    std::vector<unsigned long long int> threadbound_hi(nthreads);
+    find2T(dst, m, short_st, len);
 
-    for (int i = 0; i < nthreads; i++) {
+    typename workspace<T>::matrix_t &B = ws.matrices[len];
 
-        threadbound_low[i] = i * x / nthreads;
-        threadbound_hi[i] = (i + 1) * x / nthreads;
+    for (int i = 0; i < 2 * len; i++) {
+        for (int j = 0; j < 2 * len; j++) {
+            B(i, j) = -mat[short_st[j] * n + short_st[i]];
+        }
     }
 
+    for (int i = 0; i < 2 * len; i++) {
+        B(i, i) += static_cast<T>(1);
+    }
 
-    std::vector<T> localsum(nthreads);
-
-    #pragma omp parallel for shared(localsum)
-
-    for (int ii = 0; ii < nthreads; ii++) {
+    return Eigen::numext::real(ws.lus[len].compute(B).determinant());
+}
 
-        T netsum = static_cast<T>(0.0);
-        for (unsigned long long int k = threadbound_low[ii]; k < threadbound_hi[ii]; k++) {
 
+/**
+ * Calculates the partial sum \f$X,X+1,\dots,X+\text{chunksize}-1\f$ of
+ * the terms of the Torontonian of matrix `mat`, where term \f$x\f$
+ * corresponds to the subset of modes given by the binary representation of \f$x\f$.
+ *
+ * Note that if `X=0` and `chunksize=pow(2, n/2)`, then the full Torontonian is calculated.
+ *
+ * This function uses OpenMP (if available) to parallelize the reduction.
+ * The subsets are split between the threads into contiguous ranges of
+ * equal estimated cost (see balanced_bounds()).
+ *
+ * @param mat flattened vector of size \f$n^2\f$, representing an \f$n\times n\f$
+ *       row-ordered symmetric matrix.
+ * @param n size of the matrix
+ * @param X initial index of the partial sum
+ * @param chunksize length of the partial sum
+ * @param times if not null, on exit contains the wall time in seconds
+ *      spent by each thread on its range of subsets
+ * @param magnitude if not null, on exit contains the sum of the absolute
+ *      values of the terms, used to estimate the rounding error (see torontonian_adaptive())
+ * @return the partial sum for the Torontonian
+ */
+template <typename T>
+inline T torontonian_chunk(std::vector<T> &mat, int n, unsigned long long int X, unsigned long long int chunksize,
+                           std::vector<double> *times = nullptr, double *magnitude = nullptr) {
+    Byte m = n / 2;
 
-            unsigned long long int xx = k;
-            char* dst = new char[m];
+#ifdef _OPENMP
+    int nthreads = omp_get_max_threads();
+    omp_set_num_threads(nthreads);
+#else
+    int nthreads = 1;
+#endif
 
-            dec2bin(dst, xx, m);
-            char len = sum(dst, m);
+    // split the subsets into ranges of equal estimated cost rather than equal length,
+    // since the cost of a determinant grows with the cube of the size of the subset
+    std::vector<unsigned long long int> bounds = balanced_bounds(X, chunksize, m, nthreads);
 
-            Byte* short_st = new Byte[2 * len];
-            find2T(dst, m, short_st, len);
-            delete [] dst;
+    std::vector<T> localsum(nthreads);
+    std::vector<double> localabs(nthreads, 0.0);
 
-            eg::Matrix<T, eg::Dynamic, eg::Dynamic> B;
-            B.resize(2 * len, 2 * len);
+    if (times != nullptr)
+        times->assign(nthreads, 0.0);
 
-            for (int i = 0; i < 2 * len; i++) {
-                for (int j = 0; j < 2 * len; j++) {
-                    B(i, j) = -A(short_st[i], short_st[j]);
-                }
-            }
+    #pragma omp parallel for shared(localsum)
 
-            delete [] short_st;
+    for (int ii = 0; ii < nthreads; ii++) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 
-            for (int i = 0; i < 2 * len; i++) {
-                B(i, i) += static_cast<T>(1);
-            }
+        workspace<T> ws(n);
+        ws.reserve_lu();
 
-            T det = std::real(B.determinant());
+        using std::sqrt;
+        using std::abs;
+        T netsum = static_cast<T>(0.0);
+        double netabs = 0.0;
+        for (unsigned long long int k = bounds[ii]; k < bounds[ii + 1]; k++) {
+            char len;
+            T det = torontonian_det(mat, n, k, ws, len);
+            T term = static_cast<T>(1.0) / sqrt(det);
 
             if (len % 2 == 0) {
-                netsum += static_cast<T>(1.0) / std::sqrt(det);
+                netsum += term;
             }
             else {
-                netsum -= static_cast<T>(1.0) / std::sqrt(det);
+                netsum -= term;
             }
 
+            if (magnitude != nullptr)
+                netabs += static_cast<double>(abs(term));
         }
 
         localsum[ii] = netsum;
+        localabs[ii] = netabs;
 
+        if (times != nullptr)
+            (*times)[ii] = elapsed_seconds(start);
     }
 
     int n_local = localsum.size();
-    T final = 0.0;
-    T sign = 1.0;
+    T final = static_cast<T>(0.0);
+    T sign = static_cast<T>(1.0);
 
     if (m % 2 != 0)
-        sign = -1.0;
+        sign = static_cast<T>(-1.0);
 
     for (int i = 0; i < n_local; i++) {
         final += localsum[i]    ;
     }
 
+    if (magnitude != nullptr)
+        *magnitude = std::accumulate(localabs.begin(), localabs.end(), 0.0);
+
     return sign * final;
 }
 
 
+/**
+ * Computes the Torontonian of an input matrix.
+ *
+ * If the output is NaN, that means that the input matrix does not have
+ * a Torontonian with physical meaning.
+ *
+ * This function uses OpenMP (if available) to parallelize the reduction.
+ * The subsets are split between the threads into contiguous ranges of
+ * equal estimated cost (see balanced_bounds()).
+ *
+ * @param mat flattened vector of size \f$n^2\f$, representing an \f$n\times n\f$
+ *       row-ordered symmetric matrix.
+ * @param times if not null, on exit contains the wall time in seconds
+ *      spent by each thread on its range of subsets
+ * @return Torontonian of the input matrix
+ */
+template <typename T>
+inline T torontonian(std::vector<T> &mat, std::vector<double> *times = nullptr) {
+    int n = std::sqrt(static_cast<double>(mat.size()));
+    Byte m = n / 2;
+    unsigned long long int x = static_cast<unsigned long long int>(pow(2, m));
+
+    return torontonian_chunk(mat, n, 0, x, times);
+}
+
+
 /**
  * Computes the Torontonian of an input matrix using the
  * [Shewchuck algorithm](https://github.com/achan001/fsum),
@@ -205,37 +261,12 @@ inline double torontonian_fsum(std::vector<T> &mat) {
 
     fsum::sc_partials netsum;
 
-    namespace eg = Eigen;
-    eg::Matrix<T, eg::Dynamic, eg::Dynamic> A = eg::Map<eg::Matrix<T, eg::Dynamic, eg::Dynamic>, eg::Unaligned>(mat.data(), n, n);
-
-    for (int k = 0; k < x; k++) {
-        unsigned long long int xx = k;
-        char* dst = new char[m];
-
-        dec2bin(dst, xx, m);
-        char len = sum(dst, m);
-
-        Byte* short_st = new Byte[2 * len];
-        find2T(dst, m, short_st, len);
-        delete [] dst;
-
-        // eg::Matrix<double,eg::Dynamic,eg::Dynamic> B(2*len, 2*len, 0.);
-        eg::Matrix<T, eg::Dynamic, eg::Dynamic> B;
-        B.resize(2 * len, 2 * len);
-
-        for (int i = 0; i < 2 * len; i++) {
-            for (int j = 0; j < 2 * len; j++) {
-                B(i, j) = -A(short_st[i], short_st[j]);
-            }
-        }
-
-        delete [] short_st;
-
-        for (int i = 0; i < 2 * len; i++) {
-            B(i, i) += 1;
-        }
+    workspace<T> ws(n);
+    ws.reserve_lu();
 
-        long double det = std::real(B.determinant());
+    for (unsigned long long int k = 0; k < x; k++) {
+        char len;
+        long double det = torontonian_det(mat, n, k, ws, len);
 
         if (len % 2 == 0) {
             netsum += 1.0 / std::sqrt(det);
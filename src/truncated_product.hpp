@@ -0,0 +1,474 @@
+// Copyright 2019 Xanadu Quantum Technologies Inc.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+/**
+ * @file
+ * Contains the truncated polynomial products at the leaves of the
+ * recursive hafnian (see contract_pair()), with vectorized kernels for
+ * `double`, `std::complex<double>` and `double_double`.
+ *
+ * The vectorized kernels keep a block of output coefficients in registers
+ * and accumulate all the products contributing to it, instead of
+ * updating the output once per coefficient of the first factor. Complex
+ * polynomials are split into their real and imaginary parts, and
+ * double-doubles into their leading and trailing parts, so that every
+ * vector holds consecutive coefficients of a single part.
+ *
+ * The AVX2 and AVX-512 kernels are compiled for those instruction sets
+ * through function attributes, independently of the compiler flags, and
+ * the kernel is selected at run time from the instruction sets supported
+ * by the processor (see simd_support()). Other compilers and processors
+ * use the scalar loops.
+ */
+#pragma once
+#include <stdafx.h>
+#include <double_double.hpp>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define HAFNIAN_SIMD 1
+#include <immintrin.h>
+#define HAFNIAN_AVX2 __attribute__((target("avx2,fma")))
+#define HAFNIAN_AVX512 __attribute__((target("avx512f")))
+#endif
+
+namespace hafnian {
+
+/**
+ * Instruction sets used by the vectorized polynomial kernels.
+ */
+enum simd_level {
+    /// Scalar loops.
+    simd_none,
+    /// 256-bit vectors, with fused multiply-add.
+    simd_avx2,
+    /// 512-bit vectors.
+    simd_avx512
+};
+
+/**
+ * Returns the widest instruction set of simd_level supported by the processor.
+ */
+inline simd_level detect_simd() {
+#ifdef HAFNIAN_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return simd_avx512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return simd_avx2;
+#endif
+    return simd_none;
+}
+
+/**
+ * Returns the instruction set used by the polynomial kernels. It is
+ * detected on the first call, and may be lowered by assigning to the
+ * returned reference, for instance to compare the kernels.
+ */
+inline simd_level &simd_support() {
+    static simd_level level = detect_simd();
+    return level;
+}
+
+/// largest degree handled by the vectorized kernels, which keep their
+/// operands on the stack
+const int simd_max_degree = 64;
+
+
+/**
+ * Adds the product of the polynomials `x` and `y` of degree \f$n-1\f$,
+ * multiplied by the indeterminate and truncated to degree \f$n\f$, to the
+ * polynomial `c`.
+ *
+ * @param c polynomial of degree \f$n\f$, updated in place
+ * @param x polynomial of degree \f$n-1\f$
+ * @param y polynomial of degree \f$n-1\f$
+ * @param n degree of the result
+ */
+template <typename T>
+inline void add_truncated_product(T *c, const T *x, const T *y, int n) {
+    for (int u = 0; u < n; u++) {
+        for (int v = 0; v < n - u; v++) {
+            c[u + v + 1] += x[u] * y[v];
+        }
+    }
+}
+
+
+/**
+ * Adds the products \f$x_1y_1+x_2y_2\f$ of polynomials of degree \f$n-1\f$,
+ * multiplied by the indeterminate and truncated to degree \f$n\f$, to the
+ * polynomial `c`. This is the update of the polynomials of the paths in
+ * contract_pair().
+ *
+ * @param c polynomial of degree \f$n\f$, updated in place
+ * @param x1 polynomial of degree \f$n-1\f$
+ * @param y1 polynomial of degree \f$n-1\f$
+ * @param x2 polynomial of degree \f$n-1\f$
+ * @param y2 polynomial of degree \f$n-1\f$
+ * @param n degree of the result
+ */
+template <typename T>
+inline void add_truncated_products(T *c, const T *x1, const T *y1, const T *x2, const T *y2, int n) {
+    add_truncated_product(c, x1, y1, n);
+    add_truncated_product(c, x2, y2, n);
+}
+
+
+#ifdef HAFNIAN_SIMD
+
+// The kernels below compute out[r] = sum_{u<=r} x1[u] y1[r-u] + x2[u] y2[r-u]
+// for r < n in blocks of W coefficients. The factors y are stored after W
+// zeros, so that the window of W coefficients ending at y[r-u] can be
+// loaded for every u up to the end of the block, and are followed by
+// zeros up to a multiple of W.
+
+/**
+ * Copies the polynomials `y1` and `y2` of degree \f$n-1\f$ into `p1` and
+ * `p2` of length \f$W+m\f$, after \f$W\f$ zeros and followed by zeros.
+ */
+inline void pad_factors(double *p1, double *p2, const double *y1, const double *y2, int n, int W, int m) {
+    std::fill(p1, p1 + W + m, 0.0);
+    std::fill(p2, p2 + W + m, 0.0);
+    std::copy(y1, y1 + n, p1 + W);
+    std::copy(y2, y2 + n, p2 + W);
+}
+
+/**
+ * Truncated products of real polynomials, with AVX2.
+ */
+HAFNIAN_AVX2 inline void truncated_products_avx2(double *out, const double *x1, const double *y1,
+                                                 const double *x2, const double *y2, int n) {
+    const int W = 4;
+    int m = (n + W - 1) / W * W;
+    double p1[W + simd_max_degree], p2[W + simd_max_degree];
+    pad_factors(p1, p2, y1, y2, n, W, m);
+
+    for (int r = 0; r < m; r += W) {
+        __m256d acc1 = _mm256_setzero_pd(), acc2 = _mm256_setzero_pd();
+        for (int u = 0; u < std::min(r + W, n); u++) {
+            acc1 = _mm256_fmadd_pd(_mm256_set1_pd(x1[u]), _mm256_loadu_pd(p1 + W + r - u), acc1);
+            acc2 = _mm256_fmadd_pd(_mm256_set1_pd(x2[u]), _mm256_loadu_pd(p2 + W + r - u), acc2);
+        }
+        _mm256_storeu_pd(out + r, _mm256_add_pd(acc1, acc2));
+    }
+}
+
+/**
+ * Truncated products of real polynomials, with AVX-512.
+ */
+HAFNIAN_AVX512 inline void truncated_products_avx512(double *out, const double *x1, const double *y1,
+                                                     const double *x2, const double *y2, int n) {
+    const int W = 8;
+    int m = (n + W - 1) / W * W;
+    double p1[W + simd_max_degree], p2[W + simd_max_degree];
+    pad_factors(p1, p2, y1, y2, n, W, m);
+
+    for (int r = 0; r < m; r += W) {
+        __m512d acc1 = _mm512_setzero_pd(), acc2 = _mm512_setzero_pd();
+        for (int u = 0; u < std::min(r + W, n); u++) {
+            acc1 = _mm512_fmadd_pd(_mm512_set1_pd(x1[u]), _mm512_loadu_pd(p1 + W + r - u), acc1);
+            acc2 = _mm512_fmadd_pd(_mm512_set1_pd(x2[u]), _mm512_loadu_pd(p2 + W + r - u), acc2);
+        }
+        _mm512_storeu_pd(out + r, _mm512_add_pd(acc1, acc2));
+    }
+}
+
+/**
+ * Truncated products of complex polynomials split into real parts `r`
+ * and imaginary parts `i`, with AVX2.
+ */
+HAFNIAN_AVX2 inline void truncated_products_avx2(double *outr, double *outi,
+                                                 const double *x1r, const double *x1i, const double *y1r, const double *y1i,
+                                                 const double *x2r, const double *x2i, const double *y2r, const double *y2i,
+                                                 int n) {
+    const int W = 4;
+    int m = (n + W - 1) / W * W;
+    double p1r[W + simd_max_degree], p1i[W + simd_max_degree], p2r[W + simd_max_degree], p2i[W + simd_max_degree];
+    pad_factors(p1r, p2r, y1r, y2r, n, W, m);
+    pad_factors(p1i, p2i, y1i, y2i, n, W, m);
+
+    for (int r = 0; r < m; r += W) {
+        __m256d re1 = _mm256_setzero_pd(), im1 = _mm256_setzero_pd();
+        __m256d re2 = _mm256_setzero_pd(), im2 = _mm256_setzero_pd();
+        for (int u = 0; u < std::min(r + W, n); u++) {
+            __m256d ar = _mm256_set1_pd(x1r[u]), ai = _mm256_set1_pd(x1i[u]);
+            __m256d br = _mm256_loadu_pd(p1r + W + r - u), bi = _mm256_loadu_pd(p1i + W + r - u);
+            re1 = _mm256_fnmadd_pd(ai, bi, _mm256_fmadd_pd(ar, br, re1));
+            im1 = _mm256_fmadd_pd(ai, br, _mm256_fmadd_pd(ar, bi, im1));
+
+            ar = _mm256_set1_pd(x2r[u]);
+            ai = _mm256_set1_pd(x2i[u]);
+            br = _mm256_loadu_pd(p2r + W + r - u);
+            bi = _mm256_loadu_pd(p2i + W + r - u);
+            re2 = _mm256_fnmadd_pd(ai, bi, _mm256_fmadd_pd(ar, br, re2));
+            im2 = _mm256_fmadd_pd(ai, br, _mm256_fmadd_pd(ar, bi, im2));
+        }
+        _mm256_storeu_pd(outr + r, _mm256_add_pd(re1, re2));
+        _mm256_storeu_pd(outi + r, _mm256_add_pd(im1, im2));
+    }
+}
+
+/**
+ * Truncated products of complex polynomials split into real parts `r`
+ * and imaginary parts `i`, with AVX-512.
+ */
+HAFNIAN_AVX512 inline void truncated_products_avx512(double *outr, double *outi,
+                                                     const double *x1r, const double *x1i, const double *y1r, const double *y1i,
+                                                     const double *x2r, const double *x2i, const double *y2r, const double *y2i,
+                                                     int n) {
+    const int W = 8;
+    int m = (n + W - 1) / W * W;
+    double p1r[W + simd_max_degree], p1i[W + simd_max_degree], p2r[W + simd_max_degree], p2i[W + simd_max_degree];
+    pad_factors(p1r, p2r, y1r, y2r, n, W, m);
+    pad_factors(p1i, p2i, y1i, y2i, n, W, m);
+
+    for (int r = 0; r < m; r += W) {
+        __m512d re1 = _mm512_setzero_pd(), im1 = _mm512_setzero_pd();
+        __m512d re2 = _mm512_setzero_pd(), im2 = _mm512_setzero_pd();
+        for (int u = 0; u < std::min(r + W, n); u++) {
+            __m512d ar = _mm512_set1_pd(x1r[u]), ai = _mm512_set1_pd(x1i[u]);
+            __m512d br = _mm512_loadu_pd(p1r + W + r - u), bi = _mm512_loadu_pd(p1i + W + r - u);
+            re1 = _mm512_fnmadd_pd(ai, bi, _mm512_fmadd_pd(ar, br, re1));
+            im1 = _mm512_fmadd_pd(ai, br, _mm512_fmadd_pd(ar, bi, im1));
+
+            ar = _mm512_set1_pd(x2r[u]);
+            ai = _mm512_set1_pd(x2i[u]);
+            br = _mm512_loadu_pd(p2r + W + r - u);
+            bi = _mm512_loadu_pd(p2i + W + r - u);
+            re2 = _mm512_fnmadd_pd(ai, bi, _mm512_fmadd_pd(ar, br, re2));
+            im2 = _mm512_fmadd_pd(ai, br, _mm512_fmadd_pd(ar, bi, im2));
+        }
+        _mm512_storeu_pd(outr + r, _mm512_add_pd(re1, re2));
+        _mm512_storeu_pd(outi + r, _mm512_add_pd(im1, im2));
+    }
+}
+
+// Double-double arithmetic on vectors of leading parts h and trailing
+// parts l, performing the same operations as double_double.
+
+/// Adds the double-double (bh, bl) to (ah, al), as double_double::operator+=().
+HAFNIAN_AVX2 inline void dd_add_avx2(__m256d &ah, __m256d &al, __m256d bh, __m256d bl) {
+    __m256d s1 = _mm256_add_pd(ah, bh);
+    __m256d bb = _mm256_sub_pd(s1, ah);
+    __m256d s2 = _mm256_add_pd(_mm256_sub_pd(ah, _mm256_sub_pd(s1, bb)), _mm256_sub_pd(bh, bb));
+    __m256d t1 = _mm256_add_pd(al, bl);
+    bb = _mm256_sub_pd(t1, al);
+    __m256d t2 = _mm256_add_pd(_mm256_sub_pd(al, _mm256_sub_pd(t1, bb)), _mm256_sub_pd(bl, bb));
+    s2 = _mm256_add_pd(s2, t1);
+    __m256d s = _mm256_add_pd(s1, s2);
+    s2 = _mm256_sub_pd(s2, _mm256_sub_pd(s, s1));
+    s2 = _mm256_add_pd(s2, t2);
+    ah = _mm256_add_pd(s, s2);
+    al = _mm256_sub_pd(s2, _mm256_sub_pd(ah, s));
+}
+
+/// Returns the double-double product (ah, al)(bh, bl), as double_double::operator*=().
+HAFNIAN_AVX2 inline void dd_mul_avx2(__m256d ah, __m256d al, __m256d bh, __m256d bl, __m256d &ph, __m256d &pl) {
+    __m256d p1 = _mm256_mul_pd(ah, bh);
+    __m256d p2 = _mm256_fmsub_pd(ah, bh, p1);
+    p2 = _mm256_add_pd(p2, _mm256_add_pd(_mm256_mul_pd(ah, bl), _mm256_mul_pd(al, bh)));
+    ph = _mm256_add_pd(p1, p2);
+    pl = _mm256_sub_pd(p2, _mm256_sub_pd(ph, p1));
+}
+
+/// Adds the double-double (bh, bl) to (ah, al), as double_double::operator+=().
+HAFNIAN_AVX512 inline void dd_add_avx512(__m512d &ah, __m512d &al, __m512d bh, __m512d bl) {
+    __m512d s1 = _mm512_add_pd(ah, bh);
+    __m512d bb = _mm512_sub_pd(s1, ah);
+    __m512d s2 = _mm512_add_pd(_mm512_sub_pd(ah, _mm512_sub_pd(s1, bb)), _mm512_sub_pd(bh, bb));
+    __m512d t1 = _mm512_add_pd(al, bl);
+    bb = _mm512_sub_pd(t1, al);
+    __m512d t2 = _mm512_add_pd(_mm512_sub_pd(al, _mm512_sub_pd(t1, bb)), _mm512_sub_pd(bl, bb));
+    s2 = _mm512_add_pd(s2, t1);
+    __m512d s = _mm512_add_pd(s1, s2);
+    s2 = _mm512_sub_pd(s2, _mm512_sub_pd(s, s1));
+    s2 = _mm512_add_pd(s2, t2);
+    ah = _mm512_add_pd(s, s2);
+    al = _mm512_sub_pd(s2, _mm512_sub_pd(ah, s));
+}
+
+/// Returns the double-double product (ah, al)(bh, bl), as double_double::operator*=().
+HAFNIAN_AVX512 inline void dd_mul_avx512(__m512d ah, __m512d al, __m512d bh, __m512d bl, __m512d &ph, __m512d &pl) {
+    __m512d p1 = _mm512_mul_pd(ah, bh);
+    __m512d p2 = _mm512_fmsub_pd(ah, bh, p1);
+    p2 = _mm512_add_pd(p2, _mm512_add_pd(_mm512_mul_pd(ah, bl), _mm512_mul_pd(al, bh)));
+    ph = _mm512_add_pd(p1, p2);
+    pl = _mm512_sub_pd(p2, _mm512_sub_pd(ph, p1));
+}
+
+/**
+ * Truncated products of double-double polynomials split into leading
+ * parts `h` and trailing parts `l`, with AVX2.
+ */
+HAFNIAN_AVX2 inline void truncated_products_dd_avx2(double *outh, double *outl,
+                                                    const double *x1h, const double *x1l, const double *y1h, const double *y1l,
+                                                    const double *x2h, const double *x2l, const double *y2h, const double *y2l,
+                                                    int n) {
+    const int W = 4;
+    int m = (n + W - 1) / W * W;
+    double p1h[W + simd_max_degree], p1l[W + simd_max_degree], p2h[W + simd_max_degree], p2l[W + simd_max_degree];
+    pad_factors(p1h, p2h, y1h, y2h, n, W, m);
+    pad_factors(p1l, p2l, y1l, y2l, n, W, m);
+
+    for (int r = 0; r < m; r += W) {
+        __m256d h1 = _mm256_setzero_pd(), l1 = _mm256_setzero_pd();
+        __m256d h2 = _mm256_setzero_pd(), l2 = _mm256_setzero_pd();
+        __m256d ph, pl;
+        for (int u = 0; u < std::min(r + W, n); u++) {
+            dd_mul_avx2(_mm256_set1_pd(x1h[u]), _mm256_set1_pd(x1l[u]),
+                        _mm256_loadu_pd(p1h + W + r - u), _mm256_loadu_pd(p1l + W + r - u), ph, pl);
+            dd_add_avx2(h1, l1, ph, pl);
+            dd_mul_avx2(_mm256_set1_pd(x2h[u]), _mm256_set1_pd(x2l[u]),
+                        _mm256_loadu_pd(p2h + W + r - u), _mm256_loadu_pd(p2l + W + r - u), ph, pl);
+            dd_add_avx2(h2, l2, ph, pl);
+        }
+        dd_add_avx2(h1, l1, h2, l2);
+        _mm256_storeu_pd(outh + r, h1);
+        _mm256_storeu_pd(outl + r, l1);
+    }
+}
+
+/**
+ * Truncated products of double-double polynomials split into leading
+ * parts `h` and trailing parts `l`, with AVX-512.
+ */
+HAFNIAN_AVX512 inline void truncated_products_dd_avx512(double *outh, double *outl,
+                                                        const double *x1h, const double *x1l, const double *y1h, const double *y1l,
+                                                        const double *x2h, const double *x2l, const double *y2h, const double *y2l,
+                                                        int n) {
+    const int W = 8;
+    int m = (n + W - 1) / W * W;
+    double p1h[W + simd_max_degree], p1l[W + simd_max_degree], p2h[W + simd_max_degree], p2l[W + simd_max_degree];
+    pad_factors(p1h, p2h, y1h, y2h, n, W, m);
+    pad_factors(p1l, p2l, y1l, y2l, n, W, m);
+
+    for (int r = 0; r < m; r += W) {
+        __m512d h1 = _mm512_setzero_pd(), l1 = _mm512_setzero_pd();
+        __m512d h2 = _mm512_setzero_pd(), l2 = _mm512_setzero_pd();
+        __m512d ph, pl;
+        for (int u = 0; u < std::min(r + W, n); u++) {
+            dd_mul_avx512(_mm512_set1_pd(x1h[u]), _mm512_set1_pd(x1l[u]),
+                          _mm512_loadu_pd(p1h + W + r - u), _mm512_loadu_pd(p1l + W + r - u), ph, pl);
+            dd_add_avx512(h1, l1, ph, pl);
+            dd_mul_avx512(_mm512_set1_pd(x2h[u]), _mm512_set1_pd(x2l[u]),
+                          _mm512_loadu_pd(p2h + W + r - u), _mm512_loadu_pd(p2l + W + r - u), ph, pl);
+            dd_add_avx512(h2, l2, ph, pl);
+        }
+        dd_add_avx512(h1, l1, h2, l2);
+        _mm512_storeu_pd(outh + r, h1);
+        _mm512_storeu_pd(outl + r, l1);
+    }
+}
+
+#endif
+
+
+/**
+ * Adds the products \f$x_1y_1+x_2y_2\f$ of real polynomials of degree
+ * \f$n-1\f$, multiplied by the indeterminate and truncated to degree
+ * \f$n\f$, to the polynomial `c`, using the widest kernel available.
+ */
+inline void add_truncated_products(double *c, const double *x1, const double *y1,
+                                   const double *x2, const double *y2, int n) {
+#ifdef HAFNIAN_SIMD
+    simd_level level = simd_support();
+    if (level != simd_none && n <= simd_max_degree) {
+        double out[simd_max_degree];
+
+        if (level == simd_avx512)
+            truncated_products_avx512(out, x1, y1, x2, y2, n);
+        else
+            truncated_products_avx2(out, x1, y1, x2, y2, n);
+
+        for (int r = 0; r < n; r++)
+            c[r + 1] += out[r];
+        return;
+    }
+#endif
+    add_truncated_product(c, x1, y1, n);
+    add_truncated_product(c, x2, y2, n);
+}
+
+
+/**
+ * Adds the products \f$x_1y_1+x_2y_2\f$ of complex polynomials of degree
+ * \f$n-1\f$, multiplied by the indeterminate and truncated to degree
+ * \f$n\f$, to the polynomial `c`, using the widest kernel available.
+ */
+inline void add_truncated_products(std::complex<double> *c, const std::complex<double> *x1, const std::complex<double> *y1,
+                                   const std::complex<double> *x2, const std::complex<double> *y2, int n) {
+#ifdef HAFNIAN_SIMD
+    simd_level level = simd_support();
+    if (level != simd_none && n <= simd_max_degree) {
+        double part[8][simd_max_degree];
+        double outr[simd_max_degree], outi[simd_max_degree];
+        const std::complex<double> *factors[4] = {x1, y1, x2, y2};
+
+        for (int k = 0; k < 4; k++) {
+            for (int u = 0; u < n; u++) {
+                part[2 * k][u] = factors[k][u].real();
+                part[2 * k + 1][u] = factors[k][u].imag();
+            }
+        }
+
+        if (level == simd_avx512)
+            truncated_products_avx512(outr, outi, part[0], part[1], part[2], part[3], part[4], part[5], part[6], part[7], n);
+        else
+            truncated_products_avx2(outr, outi, part[0], part[1], part[2], part[3], part[4], part[5], part[6], part[7], n);
+
+        for (int r = 0; r < n; r++)
+            c[r + 1] += std::complex<double>(outr[r], outi[r]);
+        return;
+    }
+#endif
+    add_truncated_product(c, x1, y1, n);
+    add_truncated_product(c, x2, y2, n);
+}
+
+
+/**
+ * Adds the products \f$x_1y_1+x_2y_2\f$ of double-double polynomials of
+ * degree \f$n-1\f$, multiplied by the indeterminate and truncated to
+ * degree \f$n\f$, to the polynomial `c`, using the widest kernel available.
+ */
+inline void add_truncated_products(double_double *c, const double_double *x1, const double_double *y1,
+                                   const double_double *x2, const double_double *y2, int n) {
+#ifdef HAFNIAN_SIMD
+    simd_level level = simd_support();
+    if (level != simd_none && n <= simd_max_degree) {
+        double part[8][simd_max_degree];
+        double outh[simd_max_degree], outl[simd_max_degree];
+        const double_double *factors[4] = {x1, y1, x2, y2};
+
+        for (int k = 0; k < 4; k++) {
+            for (int u = 0; u < n; u++) {
+                part[2 * k][u] = factors[k][u].hi;
+                part[2 * k + 1][u] = factors[k][u].lo;
+            }
+        }
+
+        if (level == simd_avx512)
+            truncated_products_dd_avx512(outh, outl, part[0], part[1], part[2], part[3], part[4], part[5], part[6], part[7], n);
+        else
+            truncated_products_dd_avx2(outh, outl, part[0], part[1], part[2], part[3], part[4], part[5], part[6], part[7], n);
+
+        for (int r = 0; r < n; r++)
+            c[r + 1] += double_double(outh[r], outl[r]);
+        return;
+    }
+#endif
+    add_truncated_product(c, x1, y1, n);
+    add_truncated_product(c, x2, y2, n);
+}
+
+}
@@ -0,0 +1,182 @@
+// Copyright 2019 Xanadu Quantum Technologies Inc.
+
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+
+//     http://www.apache.org/licenses/LICENSE-2.0
+
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+/**
+ * @file
+ * Contains the preallocated scratch memory shared by the kernels that
+ * enumerate the \f$2^{n/2}\f$ subsets of a matrix, such as the eigenvalue
+ * hafnian, the loop hafnian and the Torontonian.
+ */
+#pragma once
+#include <stdafx.h>
+#include <type_traits>
+
+#ifdef LAPACKE
+#define EIGEN_SUPERLU_SUPPORT
+#define EIGEN_USE_BLAS
+#define EIGEN_USE_LAPACKE
+
+#define LAPACK_COMPLEX_CUSTOM
+#define lapack_complex_float std::complex<float>
+#define lapack_complex_double std::complex<double>
+#endif
+
+#include <Eigen/Eigenvalues>
+#include <Eigen/LU>
+
+namespace hafnian {
+
+/**
+ * Algorithms available for computing the power traces of the
+ * submatrices appearing in the eigenvalue hafnian.
+ */
+enum powtrace_algorithm {
+    /// Diagonalizes each submatrix using the Eigen eigenvalue solvers.
+    eigensolver,
+    /// Hessenberg reduction followed by La Budde's characteristic polynomial
+    /// recursion and Newton's identities; no iterative convergence is required.
+    labudde
+};
+
+/**
+ * Orders in which the subset enumeration kernels visit the subsets, and
+ * hafnian_rpt() the steps of its mixed-radix counter.
+ */
+enum subset_order {
+    /// Visits subset \f$x\f$ at index \f$x\f$, gathering each submatrix from the matrix.
+    binary_order,
+    /// Visits subset gray_code(x) at index \f$x\f$; consecutive subsets differ by a
+    /// single pair of rows/columns, so the submatrix is updated in place.
+    gray_order
+};
+
+/**
+ * Per-thread scratch memory for the subset enumeration kernels.
+ *
+ * All buffers are sized once from the matrix dimension \f$n\f$, so that
+ * processing a subset performs no heap allocations. Every submatrix
+ * encountered by these kernels has an even dimension \f$2k\leq n\f$;
+ * the Eigen matrices and decompositions are therefore cached per
+ * value of \f$k\f$, and are only allocated when requested via
+ * reserve_eigensolvers() or reserve_lu().
+ *
+ * A workspace must not be shared between threads.
+ */
+template <typename T>
+class workspace {
+public:
+    /// Eigen dense matrix type with entries of type `T`
+    typedef Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> matrix_t;
+    /// Eigen eigenvalue solver suitable for matrices of type `matrix_t`
+    typedef typename std::conditional<Eigen::NumTraits<T>::IsComplex,
+            Eigen::ComplexEigenSolver<matrix_t>,
+            Eigen::EigenSolver<matrix_t>>::type solver_t;
+    /// Eigen LU decomposition for matrices of type `matrix_t`
+    typedef Eigen::PartialPivLU<matrix_t> lu_t;
+    /// real type underlying `T`
+    typedef typename Eigen::NumTraits<T>::Real real_t;
+
+    /**
+     * Allocates the scratch memory for matrices of size \f$n\times n\f$.
+     *
+     * @param n size of the matrix
+     * @param method algorithm that will be used to compute power traces;
+     *      the eigenvalue solvers are only allocated if it is `eigensolver`.
+     */
+    explicit workspace(int n, powtrace_algorithm method = labudde)
+        : n(n), dst(n / 2 + 1, 0), pos(n + 1, 0), B(n * n, T(0)), B2((n + 1) * (n + 1), T(0)),
+          C1(n, T(0)), D1(n, T(0)), tmp(n, T(0)), traces(n / 2 + 1, T(0)),
+          factors(n / 2 + 1, T(0)), comb(2 * (n / 2 + 1), T(0)), scratch(n + 1 + (n + 2) * (n + 2), T(0)),
+          eigvals(n, real_t(0)), pvals(n, real_t(0)), order(n / 2, 0), slot(n / 2, -1), pairs(0) {
+        if (method == eigensolver)
+            reserve_eigensolvers();
+    }
+
+    /**
+     * Allocates the submatrices and eigenvalue solvers of every even size.
+     */
+    void reserve_eigensolvers() {
+        reserve_matrices();
+        if (!solvers.empty())
+            return;
+
+        for (int k = 0; k <= n / 2; k++) {
+            solvers.push_back(solver_t(2 * k));
+            // Eigen allocates part of its internal storage on the first
+            // decomposition, so perform it here rather than in the kernels
+            if (k > 0)
+                solvers[k].compute(matrix_t::Identity(2 * k, 2 * k), false);
+        }
+    }
+
+    /**
+     * Allocates the submatrices and LU decompositions of every even size.
+     */
+    void reserve_lu() {
+        reserve_matrices();
+        if (!lus.empty())
+            return;
+
+        for (int k = 0; k <= n / 2; k++) {
+            lus.push_back(lu_t(2 * k));
+            if (k > 0)
+                lus[k].compute(matrix_t::Identity(2 * k, 2 * k));
+        }
+    }
+
+    /// size of the matrix the workspace was allocated for
+    int n;
+    /// binary digits of the subset index
+    std::vector<char> dst;
+    /// rows/columns of the matrix contained in the subset
+    std::vector<Byte> pos;
+    /// flattened submatrix
+    std::vector<T> B;
+    /// second flattened submatrix, with room for one bordering row and column
+    std::vector<T> B2;
+    /// vectors used by the loop hafnian
+    std::vector<T> C1, D1, tmp;
+    /// power traces of the submatrix
+    std::vector<T> traces;
+    /// coefficients of the exponentiated polynomial
+    std::vector<T> factors;
+    /// coefficients of the summed polynomial
+    std::vector<T> comb;
+    /// scratch space for powtrace_labudde() and loop_powtrace_labudde()
+    std::vector<T> scratch;
+    /// eigenvalues and their powers
+    std::vector<std::complex<real_t>> eigvals, pvals;
+    /// Eigen submatrices, indexed by half of their size
+    std::vector<matrix_t> matrices;
+    /// eigenvalue solvers, indexed by half of the matrix size
+    std::vector<solver_t> solvers;
+    /// LU decompositions, indexed by half of the matrix size
+    std::vector<lu_t> lus;
+    /// pair of rows/columns held in each slot of the Gray order submatrix
+    std::vector<int> order;
+    /// slot holding each pair in the Gray order submatrix, or -1 if absent
+    std::vector<int> slot;
+    /// number of pairs in the Gray order submatrix
+    int pairs;
+
+private:
+    void reserve_matrices() {
+        if (!matrices.empty())
+            return;
+
+        for (int k = 0; k <= n / 2; k++)
+            matrices.push_back(matrix_t::Zero(2 * k, 2 * k));
+    }
+};
+
+}